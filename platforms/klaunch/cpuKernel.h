@@ -8,6 +8,14 @@
 #define CPUKERNEL_H
 
 ///CPU kernels
+//
+// A CPU kernel has the cpuKernelFn signature and is run once for each block
+// of the launch grid, e.g.
+//
+//    void cpu_scale(void ** params, int * dims, cpuBlockCtx * blk) { ... }
+//    CPU_REGISTER_KERNEL(cpu_scale);
+//
+// after which cpuLaunchKernel("cpu_scale", ...) runs it.
 
 
 
@@ -7,17 +7,241 @@
 
 
 #include "../util/cpuUtil.h"
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
 #define CPU
 #include "cpuKernel.h"
 #undef CPU
 
+#ifndef CPU_MAX_KERNELS
+#define CPU_MAX_KERNELS          256   // registry slots, a power of 2
+#endif
+#ifndef CPU_MAX_KERNEL_THREADS
+#define CPU_MAX_KERNEL_THREADS   64
+#endif
+
+/////////////////////// KERNEL REGISTRY /////////////////////////////////////
+
+/*
+ * An open addressed hash table of kernels. It is static data, so kernels
+ * may register from static constructors in any order. Slots are only ever
+ * added, and a slot's kernel is published after its name, so lookups need
+ * no lock.
+ */
+typedef struct {
+   unsigned int hash;
+   char * name;
+   cpuKernelFn volatile fn;
+} cpuKernelSlot;
+
+static cpuKernelSlot   g_kernels[CPU_MAX_KERNELS];
+static pthread_mutex_t g_kernelsMutex = PTHREAD_MUTEX_INITIALIZER;
+
+/* cpuHashName: FNV-1a hash of a kernel name */
+static unsigned int cpuHashName(const char * krn) {
+   unsigned int hash = 2166136261u;
+   for (; *krn; krn++) { hash = (hash ^ (unsigned char)*krn) * 16777619u; }
+   return hash;
+}
+
+/* cpuProbe: the slot holding krn, or else the free slot it would go in */
+static int cpuProbe(const char * krn, unsigned int hash) {
+   for (int idx = 0; idx < CPU_MAX_KERNELS; idx++) {
+      int slot = (hash + idx) & (CPU_MAX_KERNELS - 1);
+      if (g_kernels[slot].fn == NULL) { return slot; }
+      if ((g_kernels[slot].hash == hash) && !strcmp(g_kernels[slot].name, krn)) { return slot; }
+   }
+   return -1;
+}
+
+extern "C" int cpuRegisterKernel(const char * krn, cpuKernelFn fn) {
+   unsigned int hash = cpuHashName(krn);
+   pthread_mutex_lock(&g_kernelsMutex);
+   int slot = cpuProbe(krn, hash);
+   if (slot == -1) {
+      printf("CPUUTIL ERROR: No room to register kernel %s %s:%d\n", krn, __FILE__, __LINE__);
+   } else if (g_kernels[slot].fn == NULL) {
+      g_kernels[slot].hash = hash;
+      g_kernels[slot].name = strdup(krn);
+      __sync_synchronize();
+      g_kernels[slot].fn = fn;
+   } else {
+      g_kernels[slot].fn = fn;
+   }
+   pthread_mutex_unlock(&g_kernelsMutex);
+   return slot;
+}
+
+extern "C" int cpuFindKernel(const char * krn) {
+   int slot = cpuProbe(krn, cpuHashName(krn));
+   if ((slot == -1) || (g_kernels[slot].fn == NULL)) { return -1; }
+   return slot;
+}
+
+/////////////////////// LAUNCH THREAD POOL //////////////////////////////////
+
+/* A grid being run; blocks are handed out through next */
+typedef struct {
+   cpuKernelFn fn;
+   void ** params;
+   int * dims;
+   int gDim[HNDIMS];
+   int bDim[HNDIMS];
+   int locMem;
+   int nBlocks;
+   volatile int next;
+} cpuGrid;
+
+/* A pool thread and its block scratch memory */
+typedef struct {
+   pthread_t thread;
+   void * scratch;
+   int scratchSize;
+} cpuWorker;
+
+/*
+ * The pool runs one grid at a time; the launching thread works on it too.
+ * Pool threads are started at the first launch and live as long as the
+ * process.
+ */
+static struct {
+   pthread_mutex_t launchMutex;   // one launch at a time
+   pthread_mutex_t mutex;
+   pthread_cond_t  start;
+   pthread_cond_t  done;
+   int             nThreads;      // including the launching thread
+   unsigned int    generation;    // bumped for each grid
+   int             busy;          // pool threads still on the grid
+   cpuGrid *       grid;
+   cpuWorker       workers[CPU_MAX_KERNEL_THREADS];
+} g_pool = { PTHREAD_MUTEX_INITIALIZER, PTHREAD_MUTEX_INITIALIZER,
+             PTHREAD_COND_INITIALIZER, PTHREAD_COND_INITIALIZER, 0, 0, 0, NULL };
+
+/* cpuRunBlocks: run blocks of the grid until there are none left */
+static void cpuRunBlocks(cpuGrid * grid, cpuWorker * worker) {
+   cpuBlockCtx blk;
+   for (int idx = 0; idx < HNDIMS; idx++) {
+      blk.blockDim[idx] = grid->bDim[idx];
+      blk.gridDim[idx] = grid->gDim[idx];
+   }
+   if (worker->scratchSize < grid->locMem) {
+      free(worker->scratch);
+      worker->scratch = malloc(grid->locMem);
+      worker->scratchSize = worker->scratch ? grid->locMem : 0;
+   }
+   blk.locMem = (grid->locMem > 0) ? worker->scratch : NULL;
+   blk.locMemSize = grid->locMem;
+
+   int block;
+   while ((block = __sync_fetch_and_add(&grid->next, 1)) < grid->nBlocks) {
+      blk.blockIdx[HLENGTH] = block % grid->gDim[HLENGTH];
+      blk.blockIdx[HWIDTH] = (block / grid->gDim[HLENGTH]) % grid->gDim[HWIDTH];
+      blk.blockIdx[HDEPTH] = block / (grid->gDim[HLENGTH] * grid->gDim[HWIDTH]);
+      grid->fn(grid->params, grid->dims, &blk);
+   }
+   return;
+}
+
+/* cpuPoolMain: a pool thread */
+static void * cpuPoolMain(void * arg) {
+   cpuWorker * worker = (cpuWorker *)arg;
+   unsigned int seen = 0;
+   for (;;) {
+      pthread_mutex_lock(&g_pool.mutex);
+      while (g_pool.generation == seen) { pthread_cond_wait(&g_pool.start, &g_pool.mutex); }
+      seen = g_pool.generation;
+      cpuGrid * grid = g_pool.grid;
+      pthread_mutex_unlock(&g_pool.mutex);
+
+      cpuRunBlocks(grid, worker);
+
+      pthread_mutex_lock(&g_pool.mutex);
+      if (--g_pool.busy == 0) { pthread_cond_signal(&g_pool.done); }
+      pthread_mutex_unlock(&g_pool.mutex);
+   }
+   return NULL;
+}
+
+/* cpuStartPool: one thread for each processor the process may run on */
+static void cpuStartPool() {
+   int nCpus = 1;
+#ifdef CPU_COUNT
+   cpu_set_t cpus;
+   if (sched_getaffinity(0, sizeof(cpus), &cpus) == 0) { nCpus = CPU_COUNT(&cpus); }
+#else
+   nCpus = (int)sysconf(_SC_NPROCESSORS_ONLN);
+#endif
+   if (nCpus < 1) { nCpus = 1; }
+   if (nCpus > CPU_MAX_KERNEL_THREADS) { nCpus = CPU_MAX_KERNEL_THREADS; }
+
+   g_pool.nThreads = 1;
+   for (int idx = 1; idx < nCpus; idx++) {
+      pthread_attr_t attr;
+      pthread_attr_init(&attr);
+      pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+      int err = pthread_create(&g_pool.workers[idx].thread, &attr, cpuPoolMain, &g_pool.workers[idx]);
+      pthread_attr_destroy(&attr);
+      if (err != 0) { break; }
+      g_pool.nThreads++;
+   }
+   return;
+}
+
+extern "C" void cpuLaunchKernelHandle(int handle, int * dims, int nParams, int * paramSizes,
+                                      void ** params, int * gDim, int * bDim, int locMem,
+                                      HTaskInfo * info) {
+   if ((handle < 0) || (handle >= CPU_MAX_KERNELS) || (g_kernels[handle].fn == NULL)) {
+      printf("CPUUTIL ERROR: Invalid kernel handle %d %s:%d\n", handle, __FILE__, __LINE__);
+      return;
+   }
+#ifdef CPUUTIL_DEBUG
+   printf("Launching %s on cpu\n", g_kernels[handle].name);
+#endif
+   cpuGrid grid;
+   grid.fn = g_kernels[handle].fn;
+   grid.params = params;
+   grid.dims = dims;
+   grid.nBlocks = 1;
+   for (int idx = 0; idx < HNDIMS; idx++) {
+      grid.gDim[idx] = (gDim && gDim[idx] > 0) ? gDim[idx] : 1;
+      grid.bDim[idx] = (bDim && bDim[idx] > 0) ? bDim[idx] : 1;
+      grid.nBlocks *= grid.gDim[idx];
+   }
+   grid.locMem = (locMem > 0) ? locMem : 0;
+   grid.next = 0;
+
+   pthread_mutex_lock(&g_pool.launchMutex);
+   if (g_pool.nThreads == 0) { cpuStartPool(); }
+   int helpers = g_pool.nThreads - 1;
+   if (helpers > grid.nBlocks - 1) { helpers = grid.nBlocks - 1; }
+   if (helpers > 0) {
+      // every pool thread wakes; the ones with no block left return at once
+      pthread_mutex_lock(&g_pool.mutex);
+      g_pool.grid = &grid;
+      g_pool.busy = g_pool.nThreads - 1;
+      g_pool.generation++;
+      pthread_cond_broadcast(&g_pool.start);
+      pthread_mutex_unlock(&g_pool.mutex);
+   }
+   cpuRunBlocks(&grid, &g_pool.workers[0]);
+   if (helpers > 0) {
+      pthread_mutex_lock(&g_pool.mutex);
+      while (g_pool.busy > 0) { pthread_cond_wait(&g_pool.done, &g_pool.mutex); }
+      pthread_mutex_unlock(&g_pool.mutex);
+   }
+   pthread_mutex_unlock(&g_pool.launchMutex);
+   return;
+}
+
 
 /**
  * cpuLaunchKernel function
  * 
  * \brief  This function uses the specified parameters to execute the
  *         coprocessor function specified by kernel. Any parameters to
- *         the kernel should be included in params.
+ *         the kernel should be included in params. The kernel is found
+ *         in the registry by the hash of its name.
  * 
  * \param  kernel A string naming the kernel to execute
  * \param  dims The dimensions of the data to execute the kernel on
@@ -35,14 +259,12 @@
  
 extern "C" void cpuLaunchKernel(	const char * krn, int * dims, int nParams, int * paramSizes, void ** params,
 										int * gDim, int * bDim, int locMem, HTaskInfo * info) {
-   printf("Launching %s on cpu\n", krn);
-	/*if (!strcmp(krn,"cpu_mc_stage1")) {
-	   cpu_mc_stage1(*((randState**)params[0]), *((phDetPkg**)params[1]), *((uint**)params[2]), *((float*)params[3]), *((int*)params[4]), *((InputStruct**)params[5]));
-	}
-	if (!strcmp(krn,"cpu_mc_stage2")) {
-	   cpu_mc_stage2(*((phDetPkg**)params[0]), *((positionGrid**)params[1]), *((uint**)params[2]), *((float*)params[3]));
-	}*/
-
+   int handle = cpuFindKernel(krn);
+   if (handle == -1) {
+      printf("CPUUTIL ERROR: No kernel %s registered %s:%d\n", krn, __FILE__, __LINE__);
+      return;
+   }
+   cpuLaunchKernelHandle(handle, dims, nParams, paramSizes, params, gDim, bDim, locMem, info);
 	return;
 }
 
@@ -12,10 +12,513 @@
  *  Author: James Brock
  */
 #include "cpuUtil.h"
+#include <pthread.h>
+#include <unistd.h>
+#include <stdint.h>
+#include <sys/mman.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
 #define CPU
 #include "cpuKernel.h"
 #undef CPU
 
+// Moves and clears of at least CPU_MT_BYTES are split across up to
+// CPU_MAX_COPY_THREADS threads, each given no less than CPU_MT_BYTES/2.
+#ifndef CPU_MAX_COPY_THREADS
+#define CPU_MAX_COPY_THREADS  8
+#endif
+#ifndef CPU_MT_BYTES
+#define CPU_MT_BYTES          (4 << 20)
+#endif
+// Destinations of at least CPU_NT_BYTES will not fit in the cache, so they
+// are written with non-temporal (streaming) stores which bypass it.
+#ifndef CPU_NT_BYTES
+#define CPU_NT_BYTES          (8 << 20)
+#endif
+
+// Memory blocks are 64 byte aligned, cached by size class for reuse, and
+// blocks of CPU_MEM_MAP_BYTES or more are mapped straight from the system.
+#define CPU_MEM_ALIGN         64
+#ifndef CPU_MEM_MAP_BYTES
+#define CPU_MEM_MAP_BYTES     (256 << 10)
+#endif
+#define CPU_MEM_HUGE_PAGE     (2 << 20)
+#ifndef CPU_MEM_CACHE_DEPTH
+#define CPU_MEM_CACHE_DEPTH   16    // blocks cached per size class
+#endif
+#define CPU_MEM_NCLASSES      192
+
+/////////////////////// MEMORY CACHE ////////////////////////////////////////
+
+/*
+ * Every block starts with a header, one alignment unit long, in front of
+ * the memory handed out, so that cpuFreeMem does not depend on the dims it
+ * is given.
+ */
+typedef struct cpuMemHdr {
+   struct cpuMemHdr * next;   // in the free list of its class
+   size_t classBytes;         // usable bytes
+   size_t mapBytes;           // bytes mapped, 0 if from the heap
+   size_t pageBytes;          // whole pages of its own, 0 if it shares some
+   int cls;
+   int huge;
+   int locked;
+} cpuMemHdr;
+
+static struct {
+   pthread_mutex_t mutex;
+   int options;
+   cpuMemHdr * free[CPU_MEM_NCLASSES];
+   int nFree[CPU_MEM_NCLASSES];
+   cpuMemStats stats;
+} g_mem = { PTHREAD_MUTEX_INITIALIZER, CPU_MEM_ZERO };
+
+/*
+ * cpuSizeClass: four classes per power of 2, so a block wastes at most a
+ * fifth of itself
+ */
+static int cpuSizeClass(size_t bytes, size_t * classBytes) {
+   if (bytes <= CPU_MEM_ALIGN) { *classBytes = CPU_MEM_ALIGN; return 0; }
+   int k = 6;
+   while (((size_t)2 << k) < bytes) { k++; }
+   // bytes is in (2^k, 2^(k+1)]
+   size_t step = (size_t)1 << (k - 2);
+   size_t m = (bytes - ((size_t)1 << k) + step - 1) / step;
+   *classBytes = ((size_t)1 << k) + m * step;
+   return 1 + (k - 6) * 4 + (int)(m - 1);
+}
+
+/*
+ * cpuNewBlock: a block of a class, from the system; sets *isZero if it is
+ * clear. With CPU_MEM_LOCK a block from the heap is rounded to whole pages,
+ * so that unlocking it can not unlock a page of its neighbours
+ */
+static cpuMemHdr * cpuNewBlock(int cls, size_t classBytes, int * isZero) {
+   size_t total = classBytes + CPU_MEM_ALIGN;
+   char * base = NULL;
+   size_t mapBytes = 0;
+   size_t pageBytes = 0;
+   int huge = 0;
+   *isZero = 0;
+
+   if (total >= CPU_MEM_MAP_BYTES) {
+      long page = sysconf(_SC_PAGESIZE);
+      mapBytes = (total + page - 1) / page * page;
+      void * p = MAP_FAILED;
+      if ((g_mem.options & CPU_MEM_HUGEPAGES) && (total >= CPU_MEM_HUGE_PAGE)) {
+         size_t hugeBytes = (total + CPU_MEM_HUGE_PAGE - 1) / CPU_MEM_HUGE_PAGE * CPU_MEM_HUGE_PAGE;
+#ifdef MAP_HUGETLB
+         p = mmap(NULL, hugeBytes, PROT_READ | PROT_WRITE,
+                  MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+         if (p != MAP_FAILED) { mapBytes = hugeBytes; huge = 1; }
+#endif
+         if (p == MAP_FAILED) {
+            // else ask for transparent huge pages
+            p = mmap(NULL, hugeBytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+            if (p != MAP_FAILED) {
+               mapBytes = hugeBytes;
+#ifdef MADV_HUGEPAGE
+               huge = (madvise(p, hugeBytes, MADV_HUGEPAGE) == 0);
+#endif
+            }
+         }
+      }
+      if (p == MAP_FAILED) {
+         p = mmap(NULL, mapBytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+      }
+      if (p == MAP_FAILED) { return NULL; }
+      // fresh anonymous pages read as zero; they are cleared as they are touched
+      base = (char *)p;
+      pageBytes = mapBytes;
+      *isZero = 1;
+   } else if (g_mem.options & CPU_MEM_LOCK) {
+      long page = sysconf(_SC_PAGESIZE);
+      pageBytes = (total + page - 1) / page * page;
+      if (posix_memalign((void **)&base, page, pageBytes) != 0) { return NULL; }
+   } else if (posix_memalign((void **)&base, CPU_MEM_ALIGN, total) != 0) {
+      return NULL;
+   }
+
+   cpuMemHdr * hdr = (cpuMemHdr *)base;
+   hdr->next = NULL;
+   hdr->classBytes = classBytes;
+   hdr->mapBytes = mapBytes;
+   hdr->pageBytes = pageBytes;
+   hdr->cls = cls;
+   hdr->huge = huge;
+   hdr->locked = 0;
+   return hdr;
+}
+
+/* cpuDropBlock: give a block back to the system */
+static void cpuDropBlock(cpuMemHdr * hdr) {
+   if (hdr->locked && !hdr->mapBytes) { munlock(hdr, hdr->pageBytes); }
+   if (hdr->mapBytes) { munmap(hdr, hdr->mapBytes); } else { free(hdr); }
+   return;
+}
+
+extern "C" void cpuSetMemOptions(int flags) {
+   pthread_mutex_lock(&g_mem.mutex);
+   g_mem.options = flags;
+   pthread_mutex_unlock(&g_mem.mutex);
+   return;
+}
+
+extern "C" void cpuGetMemStats(cpuMemStats * stats) {
+   pthread_mutex_lock(&g_mem.mutex);
+   *stats = g_mem.stats;
+   pthread_mutex_unlock(&g_mem.mutex);
+   return;
+}
+
+extern "C" void cpuTrimMem() {
+   pthread_mutex_lock(&g_mem.mutex);
+   for (int cls = 0; cls < CPU_MEM_NCLASSES; cls++) {
+      while (g_mem.free[cls]) {
+         cpuMemHdr * hdr = g_mem.free[cls];
+         g_mem.free[cls] = hdr->next;
+         g_mem.stats.bytesCached -= hdr->classBytes;
+         if (hdr->huge) { g_mem.stats.bytesHuge -= hdr->classBytes; }
+         if (hdr->locked) { g_mem.stats.bytesLocked -= hdr->pageBytes; }
+         cpuDropBlock(hdr);
+      }
+      g_mem.nFree[cls] = 0;
+   }
+   pthread_mutex_unlock(&g_mem.mutex);
+   return;
+}
+
+/////////////////////// STREAMS AND EVENTS //////////////////////////////////
+
+typedef struct cpuStreamOp {
+   struct cpuStreamOp * next;
+   cpuStreamFn fn;
+   void * arg;
+} cpuStreamOp;
+
+struct cpuStream_s {
+   pthread_t thread;
+   pthread_mutex_t mutex;
+   pthread_cond_t work;       // an operation was queued, or stop was set
+   pthread_cond_t idle;       // the queue ran dry
+   cpuStreamOp * head;
+   cpuStreamOp * tail;
+   int running;               // an operation is being run
+   int stop;
+};
+
+struct cpuEvent_s {
+   pthread_mutex_t mutex;
+   pthread_cond_t done;
+   unsigned int recorded;     // records so far
+   unsigned int completed;    // records reached by their streams
+};
+
+/* What a stream runs to complete, or to wait for, one record of an event */
+typedef struct {
+   cpuEvent event;
+   unsigned int record;
+} cpuEventMark;
+
+/* cpuStreamMain: the stream thread */
+static void * cpuStreamMain(void * arg) {
+   cpuStream stream = (cpuStream)arg;
+   pthread_mutex_lock(&stream->mutex);
+   for (;;) {
+      while (!stream->head && !stream->stop) { pthread_cond_wait(&stream->work, &stream->mutex); }
+      if (!stream->head) { break; }
+      cpuStreamOp * op = stream->head;
+      stream->head = op->next;
+      if (!stream->head) { stream->tail = NULL; }
+      stream->running = 1;
+      pthread_mutex_unlock(&stream->mutex);
+
+      op->fn(op->arg);
+      free(op);
+
+      pthread_mutex_lock(&stream->mutex);
+      stream->running = 0;
+      if (!stream->head) { pthread_cond_broadcast(&stream->idle); }
+   }
+   pthread_mutex_unlock(&stream->mutex);
+   return NULL;
+}
+
+extern "C" cpuStream cpuStreamCreate() {
+   cpuStream stream = (cpuStream)calloc(1, sizeof(struct cpuStream_s));
+   if (!stream) { return NULL; }
+   pthread_mutex_init(&stream->mutex, NULL);
+   pthread_cond_init(&stream->work, NULL);
+   pthread_cond_init(&stream->idle, NULL);
+   if (pthread_create(&stream->thread, NULL, cpuStreamMain, stream) != 0) {
+      printf("CPUUTIL ERROR: Could not start a stream thread %s:%d\n", __FILE__, __LINE__);
+      pthread_mutex_destroy(&stream->mutex);
+      pthread_cond_destroy(&stream->work);
+      pthread_cond_destroy(&stream->idle);
+      free(stream);
+      return NULL;
+   }
+   return stream;
+}
+
+extern "C" void cpuStreamDestroy(cpuStream stream) {
+   if (!stream) { return; }
+   pthread_mutex_lock(&stream->mutex);
+   stream->stop = 1;
+   pthread_cond_signal(&stream->work);
+   pthread_mutex_unlock(&stream->mutex);
+   pthread_join(stream->thread, NULL);
+   pthread_mutex_destroy(&stream->mutex);
+   pthread_cond_destroy(&stream->work);
+   pthread_cond_destroy(&stream->idle);
+   free(stream);
+   return;
+}
+
+extern "C" void cpuStreamEnqueue(cpuStream stream, cpuStreamFn fn, void * arg) {
+   cpuStreamOp * op = (cpuStreamOp *)malloc(sizeof(cpuStreamOp));
+   if (!op) {
+      // no room to queue it; keep the order by running it here, after the rest
+      cpuStreamSynchronize(stream);
+      fn(arg);
+      return;
+   }
+   op->next = NULL;
+   op->fn = fn;
+   op->arg = arg;
+   pthread_mutex_lock(&stream->mutex);
+   if (stream->tail) { stream->tail->next = op; } else { stream->head = op; }
+   stream->tail = op;
+   pthread_cond_signal(&stream->work);
+   pthread_mutex_unlock(&stream->mutex);
+   return;
+}
+
+extern "C" void cpuStreamSynchronize(cpuStream stream) {
+   pthread_mutex_lock(&stream->mutex);
+   while (stream->head || stream->running) { pthread_cond_wait(&stream->idle, &stream->mutex); }
+   pthread_mutex_unlock(&stream->mutex);
+   return;
+}
+
+extern "C" cpuEvent cpuEventCreate() {
+   cpuEvent event = (cpuEvent)calloc(1, sizeof(struct cpuEvent_s));
+   if (!event) { return NULL; }
+   pthread_mutex_init(&event->mutex, NULL);
+   pthread_cond_init(&event->done, NULL);
+   return event;
+}
+
+extern "C" void cpuEventDestroy(cpuEvent event) {
+   if (!event) { return; }
+   pthread_mutex_destroy(&event->mutex);
+   pthread_cond_destroy(&event->done);
+   free(event);
+   return;
+}
+
+/* cpuCompleteEvent: stream operation reached by a record of an event */
+static void cpuCompleteEvent(void * arg) {
+   cpuEventMark * mark = (cpuEventMark *)arg;
+   cpuEvent event = mark->event;
+   pthread_mutex_lock(&event->mutex);
+   // records complete in order, unless the event is recorded on several streams
+   if ((int)(mark->record - event->completed) > 0) { event->completed = mark->record; }
+   pthread_cond_broadcast(&event->done);
+   pthread_mutex_unlock(&event->mutex);
+   free(mark);
+   return;
+}
+
+/* cpuWaitRecord: wait for a record of an event to complete */
+static void cpuWaitRecord(cpuEvent event, unsigned int record) {
+   pthread_mutex_lock(&event->mutex);
+   while ((int)(record - event->completed) > 0) { pthread_cond_wait(&event->done, &event->mutex); }
+   pthread_mutex_unlock(&event->mutex);
+   return;
+}
+
+/* cpuWaitMark: stream operation which waits for a record of an event */
+static void cpuWaitMark(void * arg) {
+   cpuEventMark * mark = (cpuEventMark *)arg;
+   cpuWaitRecord(mark->event, mark->record);
+   free(mark);
+   return;
+}
+
+extern "C" void cpuEventRecord(cpuEvent event, cpuStream stream) {
+   cpuEventMark * mark = (cpuEventMark *)malloc(sizeof(cpuEventMark));
+   if (!mark) {
+      // the event completes once the stream is done with what is queued now
+      cpuStreamSynchronize(stream);
+      return;
+   }
+   pthread_mutex_lock(&event->mutex);
+   mark->event = event;
+   mark->record = ++event->recorded;
+   pthread_mutex_unlock(&event->mutex);
+   cpuStreamEnqueue(stream, cpuCompleteEvent, mark);
+   return;
+}
+
+extern "C" int cpuEventQuery(cpuEvent event) {
+   pthread_mutex_lock(&event->mutex);
+   int done = (event->completed == event->recorded);
+   pthread_mutex_unlock(&event->mutex);
+   return done;
+}
+
+extern "C" void cpuEventWait(cpuEvent event) {
+   pthread_mutex_lock(&event->mutex);
+   unsigned int record = event->recorded;
+   pthread_mutex_unlock(&event->mutex);
+   cpuWaitRecord(event, record);
+   return;
+}
+
+extern "C" void cpuStreamWaitEvent(cpuStream stream, cpuEvent event) {
+   cpuEventMark * mark = (cpuEventMark *)malloc(sizeof(cpuEventMark));
+   if (!mark) {
+      cpuStreamSynchronize(stream);
+      cpuEventWait(event);
+      return;
+   }
+   pthread_mutex_lock(&event->mutex);
+   mark->event = event;
+   mark->record = event->recorded;
+   pthread_mutex_unlock(&event->mutex);
+   cpuStreamEnqueue(stream, cpuWaitMark, mark);
+   return;
+}
+
+/////////////////////// COPY AND CLEAR HELPERS //////////////////////////////
+
+/*
+ * A block of rows, each rowBytes long, copied from src (or cleared, when
+ * src is NULL) to dst. Consecutive rows are pitch bytes apart.
+ */
+typedef struct {
+   char * dst;
+   const char * src;
+   size_t rowBytes;
+   size_t dstPitch;
+   size_t srcPitch;
+   size_t nRows;
+   int streaming;
+} cpuRowJob;
+
+/* cpuPitch: the pitch of a row; a stride shorter than the row means packed */
+static inline size_t cpuPitch(int stride, size_t rowBytes) {
+   return ((size_t)stride > rowBytes) ? (size_t)stride : rowBytes;
+}
+
+/* cpuRowOp: copy or clear one row, with streaming stores if asked */
+static void cpuRowOp(char * dst, const char * src, size_t bytes, int streaming) {
+#ifdef __SSE2__
+   if (streaming && bytes >= 256) {
+      // plain stores up to the first 16 byte boundary of the destination
+      size_t head = (16 - ((uintptr_t)dst & 15)) & 15;
+      if (head) {
+         if (src) { memcpy(dst, src, head); src += head; } else { memset(dst, 0, head); }
+         dst += head; bytes -= head;
+      }
+      __m128i * d = (__m128i *)dst;
+      size_t nVec = bytes / 16;
+      if (src) {
+         const __m128i * s = (const __m128i *)src;
+         for (size_t idx = 0; idx < nVec; idx++) { _mm_stream_si128(d + idx, _mm_loadu_si128(s + idx)); }
+         src += nVec * 16;
+      } else {
+         __m128i zero = _mm_setzero_si128();
+         for (size_t idx = 0; idx < nVec; idx++) { _mm_stream_si128(d + idx, zero); }
+      }
+      dst += nVec * 16; bytes -= nVec * 16;
+   }
+#endif
+   if (bytes) {
+      if (src) { memcpy(dst, src, bytes); } else { memset(dst, 0, bytes); }
+   }
+   return;
+}
+
+/* cpuRunJob: work through a block of rows */
+static void * cpuRunJob(void * arg) {
+   cpuRowJob * job = (cpuRowJob *)arg;
+   char * dst = job->dst;
+   const char * src = job->src;
+   for (size_t row = 0; row < job->nRows; row++) {
+      cpuRowOp(dst, src, job->rowBytes, job->streaming);
+      dst += job->dstPitch;
+      if (src) { src += job->srcPitch; }
+   }
+#ifdef __SSE2__
+   // streaming stores are weakly ordered; make them visible before returning
+   if (job->streaming) { _mm_sfence(); }
+#endif
+   return NULL;
+}
+
+/*
+ * cpuRowsOp: copy (or clear) nRows rows, splitting a large operation across
+ * threads. Packed data is treated as one long row split into byte ranges,
+ * padded data is split by rows.
+ */
+static void cpuRowsOp(char * dst, size_t dstPitch, const char * src, size_t srcPitch,
+                      size_t rowBytes, size_t nRows) {
+   size_t total = rowBytes * nRows;
+   if (total == 0) { return; }
+   int packed = (dstPitch == rowBytes) && (!src || srcPitch == rowBytes);
+   if (packed) { rowBytes = total; nRows = 1; dstPitch = srcPitch = total; }
+
+   int nThreads = 1;
+   if (total >= CPU_MT_BYTES) {
+      long nCpus = sysconf(_SC_NPROCESSORS_ONLN);
+      size_t maxByLoad = total / (CPU_MT_BYTES / 2);
+      nThreads = (nCpus > 1) ? (int)nCpus : 1;
+      if (nThreads > CPU_MAX_COPY_THREADS) { nThreads = CPU_MAX_COPY_THREADS; }
+      if ((size_t)nThreads > maxByLoad) { nThreads = (int)maxByLoad; }
+      if (!packed && (size_t)nThreads > nRows) { nThreads = (int)nRows; }
+      if (nThreads < 1) { nThreads = 1; }
+   }
+
+   cpuRowJob jobs[CPU_MAX_COPY_THREADS];
+   int streaming = (total >= CPU_NT_BYTES);
+   for (int idx = 0; idx < nThreads; idx++) {
+      cpuRowJob * job = &jobs[idx];
+      job->streaming = streaming;
+      job->dstPitch = dstPitch;
+      job->srcPitch = srcPitch;
+      if (packed) {
+         // byte ranges, cut on cache lines
+         size_t first = (total / nThreads * idx) & ~(size_t)63;
+         size_t last = (idx == nThreads - 1) ? total : ((total / nThreads * (idx + 1)) & ~(size_t)63);
+         job->dst = dst + first;
+         job->src = src ? src + first : NULL;
+         job->rowBytes = last - first;
+         job->nRows = 1;
+      } else {
+         size_t first = nRows * idx / nThreads;
+         size_t last = nRows * (idx + 1) / nThreads;
+         job->dst = dst + first * dstPitch;
+         job->src = src ? src + first * srcPitch : NULL;
+         job->rowBytes = rowBytes;
+         job->nRows = last - first;
+      }
+   }
+
+   // the calling thread takes the first block
+   pthread_t threads[CPU_MAX_COPY_THREADS];
+   int started = 1;
+   for (; started < nThreads; started++) {
+      if (pthread_create(&threads[started], NULL, cpuRunJob, &jobs[started]) != 0) { break; }
+   }
+   cpuRunJob(&jobs[0]);
+   for (int idx = started; idx < nThreads; idx++) { cpuRunJob(&jobs[idx]); }
+   for (int idx = 1; idx < started; idx++) { pthread_join(threads[idx], NULL); }
+   return;
+}
+
 /**
  * cpuInitMem function
  * 
@@ -30,15 +533,59 @@
  * \param  ptr A pointer to where the memory pointer is to be stored
  * \return None
  *
+ * Blocks are 64 byte aligned and come from a cache of freed blocks of the
+ * same size class when there is one. They are cleared only if CPU_MEM_ZERO
+ * is set, and not at all when freshly mapped, since those pages are zero.
+ * With CPU_MEM_LOCK they are prefaulted and locked into memory; a block
+ * cached from before the option was set may share pages with other heap
+ * blocks, and is left unlocked.
  */
 extern "C" void * cpuInitMem(int * dims, int typeSize, int * stride, const char * name, HTaskInfo * info, int mapHostFlag) {
-	void * locPtr = NULL;
-   int datSize = 1;
-
+   size_t datSize = typeSize;
    for (int idx = 0; idx < HNDIMS; idx++) { datSize *= dims[idx]; }
-   datSize *= typeSize;
-   locPtr = malloc(datSize);
-   memset(locPtr, 0, datSize);
+
+   size_t classBytes;
+   int cls = cpuSizeClass(datSize, &classBytes);
+   cpuMemHdr * hdr = NULL;
+   int isZero = 0;
+
+   pthread_mutex_lock(&g_mem.mutex);
+   int zero = g_mem.options & CPU_MEM_ZERO;
+   int lock = g_mem.options & CPU_MEM_LOCK;
+   g_mem.stats.allocs++;
+   if ((cls < CPU_MEM_NCLASSES) && g_mem.free[cls]) {
+      hdr = g_mem.free[cls];
+      g_mem.free[cls] = hdr->next;
+      g_mem.nFree[cls]--;
+      g_mem.stats.cacheHits++;
+      g_mem.stats.bytesCached -= classBytes;
+   }
+   pthread_mutex_unlock(&g_mem.mutex);
+
+   int fresh = !hdr;
+   if (fresh) { hdr = cpuNewBlock(cls, classBytes, &isZero); }
+   if (!hdr) {
+      printf("CPUUTIL ERROR: Could not allocate %luB of memory %s:%d\n", (unsigned long)datSize, __FILE__, __LINE__);
+      return NULL;
+   }
+   void * locPtr = (char *)hdr + CPU_MEM_ALIGN;
+   // only blocks which may hold old data are cleared
+   if (zero && !isZero) { memset(locPtr, 0, datSize); }
+   int newlyLocked = 0;
+   if (lock && !hdr->locked && hdr->pageBytes) {
+      // touch every page here, so that first touch places them near this thread
+      volatile char * page = (volatile char *)hdr;
+      long pageSize = sysconf(_SC_PAGESIZE);
+      for (size_t off = 0; off < hdr->pageBytes; off += pageSize) { page[off] = page[off]; }
+      hdr->locked = newlyLocked = (mlock(hdr, hdr->pageBytes) == 0);
+   }
+
+   pthread_mutex_lock(&g_mem.mutex);
+   if (zero && !isZero) { g_mem.stats.zeroed++; }
+   g_mem.stats.bytesInUse += classBytes;
+   if (fresh && hdr->huge) { g_mem.stats.bytesHuge += classBytes; }
+   if (newlyLocked) { g_mem.stats.bytesLocked += hdr->pageBytes; }
+   pthread_mutex_unlock(&g_mem.mutex);
 	return locPtr;
 }
 
@@ -52,16 +599,40 @@ extern "C" void * cpuInitMem(int * dims, int typeSize, int * stride, const char
  * \param  loc The location of the data to be freed
  * \return None
  *
+ * The block is kept for reuse unless its size class already holds
+ * CPU_MEM_CACHE_DEPTH blocks.
  */
 extern "C" void cpuFreeMem( void * ptr, int * dims, int typeSize, const char * name, HTaskInfo * info, int mapHostFlag ) {
-   free(ptr);
+   if (!ptr) { return; }
+   cpuMemHdr * hdr = (cpuMemHdr *)((char *)ptr - CPU_MEM_ALIGN);
+   int cls = hdr->cls;
+
+   pthread_mutex_lock(&g_mem.mutex);
+   g_mem.stats.frees++;
+   g_mem.stats.bytesInUse -= hdr->classBytes;
+   if ((cls < CPU_MEM_NCLASSES) && (g_mem.nFree[cls] < CPU_MEM_CACHE_DEPTH)) {
+      // kept for the next block of its class
+      hdr->next = g_mem.free[cls];
+      g_mem.free[cls] = hdr;
+      g_mem.nFree[cls]++;
+      g_mem.stats.bytesCached += hdr->classBytes;
+      hdr = NULL;
+   } else {
+      if (hdr->huge) { g_mem.stats.bytesHuge -= hdr->classBytes; }
+      if (hdr->locked) { g_mem.stats.bytesLocked -= hdr->pageBytes; }
+   }
+   pthread_mutex_unlock(&g_mem.mutex);
+
+   if (hdr) { cpuDropBlock(hdr); }
 	return;
 }
 
 /**
  * cpuClearMem function
  * 
- * \brief  
+ * \brief  This function zeroes a block of memory, dims[HLENGTH] elements
+ *         per row, one row every stride bytes; the padding between rows is
+ *         left alone. Large blocks are cleared by several threads.
  * \param  dims The dimensions of the memory to be allocated
  * \param  stride The stride (width in bytes) of the data. This only matters
  *         for multi-dimensional data
@@ -71,10 +642,9 @@ extern "C" void cpuFreeMem( void * ptr, int * dims, int typeSize, const char * n
  *
  */
 extern "C" void cpuClearMem(int * dims, int typeSize, int stride, void * ptr, HTaskInfo * info) {
-   int datSize = 1;
-   for (int idx = 0; idx < HNDIMS; idx++) { datSize *= dims[idx]; }
-   datSize *= typeSize;
-   memset(ptr, 0, datSize);
+   size_t rowBytes = (size_t)dims[HLENGTH] * typeSize;
+   cpuRowsOp((char *)ptr, cpuPitch(stride, rowBytes), NULL, 0, rowBytes,
+             (size_t)dims[HWIDTH] * dims[HDEPTH]);
 	return;
 }
 
@@ -97,14 +667,18 @@ extern "C" void cpuClearMem(int * dims, int typeSize, int stride, void * ptr, HT
  * \param  dims The dimensions of the data to be copied
  * \return None
  *
+ * A row is dims[HLENGTH] elements and there are dims[HWIDTH]*dims[HDEPTH]
+ * rows, as for cudaMemcpy3D. A stride shorter than a row means the data is
+ * packed. Large moves are split across threads, and a destination too large
+ * to stay in the cache is written with streaming stores.
  */
 extern "C" void cpuMoveData(	void * dst, int dstStride, HTaskInfo * dstInfo,
 									   void * src, int srcStride, HTaskInfo * srcInfo,
 									   int * dims, int typeSize, const char * name ) {
-   int datSize = 1;
-   for (int idx = 0; idx < HNDIMS; idx++) { datSize *= dims[idx]; }
-   datSize *= typeSize;
-   memcpy(dst, src, datSize);
+   size_t rowBytes = (size_t)dims[HLENGTH] * typeSize;
+   cpuRowsOp((char *)dst, cpuPitch(dstStride, rowBytes),
+             (const char *)src, cpuPitch(srcStride, rowBytes), rowBytes,
+             (size_t)dims[HWIDTH] * dims[HDEPTH]);
 	return;
 }
 
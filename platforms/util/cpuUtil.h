@@ -42,6 +42,54 @@ using namespace ipvtol;
  */
 extern "C" void * cpuInitMem(int * dims, int typeSize, int * stride, const char * name, HTaskInfo * info, int mapHostFlag );
 
+/**
+ * cpuSetMemOptions function
+ *
+ * \brief  This function sets how cpuInitMem obtains memory, for the whole
+ *         process. CPU_MEM_ZERO, set by default, has every block handed out
+ *         cleared; CPU_MEM_HUGEPAGES backs large blocks with huge pages;
+ *         CPU_MEM_LOCK prefaults new blocks, from the allocating thread, and
+ *         locks them into memory.
+ * \param  flags The CPU_MEM_ options wanted
+ * \return None
+ *
+ */
+#define CPU_MEM_ZERO       0x1
+#define CPU_MEM_HUGEPAGES  0x2
+#define CPU_MEM_LOCK       0x4
+extern "C" void cpuSetMemOptions(int flags);
+
+/** Counters of the CPU memory cache */
+typedef struct {
+   unsigned long allocs;       // cpuInitMem calls
+   unsigned long cacheHits;    // ... served from the cache
+   unsigned long frees;        // cpuFreeMem calls
+   unsigned long zeroed;       // blocks cleared with memset
+   size_t        bytesInUse;   // in blocks handed out, by size class
+   size_t        bytesCached;  // in blocks held for reuse
+   size_t        bytesHuge;    // in blocks backed by huge pages, used or cached
+   size_t        bytesLocked;  // in pages locked into memory, used or cached
+} cpuMemStats;
+
+/**
+ * cpuGetMemStats function
+ *
+ * \brief  This function copies the counters of the CPU memory cache.
+ * \param  stats Where to copy them
+ * \return None
+ *
+ */
+extern "C" void cpuGetMemStats(cpuMemStats * stats);
+
+/**
+ * cpuTrimMem function
+ *
+ * \brief  This function returns every cached block to the system.
+ * \return None
+ *
+ */
+extern "C" void cpuTrimMem();
+
 /**
  * cpuFreeMem function
  * 
@@ -117,5 +165,190 @@ extern "C" void cpuLaunchKernel(   const char * krn, int * dims, int nParams, in
                                     void ** params, int * gDim, int * bDim, int locMem,
                                     HTaskInfo * info);
 
+/**
+ * cpuBlockCtx
+ *
+ * \brief  What a CPU kernel knows about the block it is running, in the
+ *         terms of a CUDA launch. The kernel runs the bDim threads of its
+ *         block itself, usually as loops over threadIdx.
+ */
+typedef struct {
+   int blockIdx[HNDIMS];
+   int blockDim[HNDIMS];
+   int gridDim[HNDIMS];
+   // locMem bytes of scratch, private to the block, like CUDA shared memory
+   void * locMem;
+   int locMemSize;
+} cpuBlockCtx;
+
+/** A CPU kernel, run once for each block of the grid */
+typedef void (*cpuKernelFn)(void ** params, int * dims, cpuBlockCtx * blk);
+
+/**
+ * cpuRegisterKernel function
+ *
+ * \brief  This function adds a kernel to the CPU kernel registry, under
+ *         the name cpuLaunchKernel is given for it. Registering a name
+ *         again replaces its kernel.
+ * \param  krn The kernel name
+ * \param  fn The kernel
+ * \return The kernel handle, or -1 if the registry is full
+ *
+ */
+extern "C" int cpuRegisterKernel(const char * krn, cpuKernelFn fn);
+
+/**
+ * cpuFindKernel function
+ *
+ * \brief  This function looks a kernel up once, so that later launches
+ *         can skip the name lookup.
+ * \param  krn The kernel name
+ * \return The kernel handle, or -1 if no kernel has the name
+ *
+ */
+extern "C" int cpuFindKernel(const char * krn);
+
+/**
+ * cpuLaunchKernelHandle function
+ *
+ * \brief  As cpuLaunchKernel, for a kernel found by cpuFindKernel. The
+ *         blocks of the grid are shared out over a pool of threads, one
+ *         for each processor the process may run on, and the call returns
+ *         once every block has run.
+ * \return None
+ *
+ */
+extern "C" void cpuLaunchKernelHandle(int handle, int * dims, int nParams, int * paramSizes,
+                                      void ** params, int * gDim, int * bDim, int locMem,
+                                      HTaskInfo * info);
+
+/**
+ * cpuStream
+ *
+ * \brief  A stream is a worker thread which runs the operations queued on
+ *         it one after another, in order, while the thread which queued
+ *         them carries on. An event marks a point in a stream, and is
+ *         complete once the stream has run everything queued before it.
+ */
+typedef struct cpuStream_s * cpuStream;
+typedef struct cpuEvent_s * cpuEvent;
+
+/** A stream operation; it owns arg and must free it */
+typedef void (*cpuStreamFn)(void * arg);
+
+/**
+ * cpuStreamCreate function
+ *
+ * \brief  This function starts a stream.
+ * \return The stream, or NULL if its thread could not be started
+ *
+ */
+extern "C" cpuStream cpuStreamCreate();
+
+/**
+ * cpuStreamDestroy function
+ *
+ * \brief  This function runs what is queued on a stream, then stops it.
+ * \param  stream The stream
+ * \return None
+ *
+ */
+extern "C" void cpuStreamDestroy(cpuStream stream);
+
+/**
+ * cpuStreamEnqueue function
+ *
+ * \brief  This function queues an operation on a stream.
+ * \param  stream The stream
+ * \param  fn The operation
+ * \param  arg Its argument, handed over to fn
+ * \return None
+ *
+ */
+extern "C" void cpuStreamEnqueue(cpuStream stream, cpuStreamFn fn, void * arg);
+
+/**
+ * cpuStreamSynchronize function
+ *
+ * \brief  This function waits until a stream has run everything queued.
+ * \param  stream The stream
+ * \return None
+ *
+ */
+extern "C" void cpuStreamSynchronize(cpuStream stream);
+
+/**
+ * cpuEventCreate function
+ *
+ * \brief  This function creates an event. An event never recorded is
+ *         complete.
+ * \return The event
+ *
+ */
+extern "C" cpuEvent cpuEventCreate();
+
+/**
+ * cpuEventDestroy function
+ *
+ * \brief  This function frees an event; no stream may still have it queued.
+ * \param  event The event
+ * \return None
+ *
+ */
+extern "C" void cpuEventDestroy(cpuEvent event);
+
+/**
+ * cpuEventRecord function
+ *
+ * \brief  This function moves an event to the end of a stream; it is
+ *         incomplete until the stream gets there.
+ * \param  event The event
+ * \param  stream The stream
+ * \return None
+ *
+ */
+extern "C" void cpuEventRecord(cpuEvent event, cpuStream stream);
+
+/**
+ * cpuEventQuery function
+ *
+ * \brief  This function tells whether an event is complete.
+ * \param  event The event
+ * \return 1 if it is complete, 0 if not
+ *
+ */
+extern "C" int cpuEventQuery(cpuEvent event);
+
+/**
+ * cpuEventWait function
+ *
+ * \brief  This function waits until an event, as last recorded, is complete.
+ * \param  event The event
+ * \return None
+ *
+ */
+extern "C" void cpuEventWait(cpuEvent event);
+
+/**
+ * cpuStreamWaitEvent function
+ *
+ * \brief  This function has a stream wait, before running anything queued
+ *         after this call, until an event, as last recorded, is complete.
+ * \param  stream The stream
+ * \param  event The event
+ * \return None
+ *
+ */
+extern "C" void cpuStreamWaitEvent(cpuStream stream, cpuEvent event);
+
+/**
+ * CPU_REGISTER_KERNEL
+ *
+ * \brief  Registers fn, under its own name, when the program starts.
+ *         For use in cpuKernel.h.
+ */
+#define CPU_REGISTER_KERNEL(fn) \
+   static int fn##_cpuHandle = cpuRegisterKernel(#fn, fn)
+
 #endif
 // END CPU UTILITY FUNCTIONS
@@ -18,6 +18,7 @@
 #define BLOCKINGCQUEUE_H_
 
 #include <ThreadManager.h>
+#include <ConduitWakeup.h>
 #include <shared_ptr.hpp>
 #include <vector>
 
@@ -137,6 +138,12 @@ public:
 	///Query the writable state of the circular queue
 	bool isWriteLocked();
 
+	///Also notify wakeup of each insertion, NULL to stop
+	void setWakeup(ConduitWakeup *wakeup);
+
+	///Notify the wakeup, if any, of an event other than an insertion
+	void notifyWakeup();
+
 
 private:
 	BlockingCQueue(const BlockingCQueue&); // Disabled copy constructor
@@ -154,13 +161,15 @@ private:
 	size_type m_writeIndex;
 	size_type m_capacity;
 	bool m_writeLock;
+	ConduitWakeup * volatile m_wakeup;
 };
 
 
 ////////////////////////IMPLEMENTATION/////////////////////////////////
 template <class T>
 BlockingCQueue<T>::BlockingCQueue(size_type capacity) :
-	m_unread(0), m_readIndex(0), m_writeIndex(0), m_capacity(capacity), m_writeLock(false)
+	m_unread(0), m_readIndex(0), m_writeIndex(0), m_capacity(capacity), m_writeLock(false),
+	m_wakeup(NULL)
 {
 	pthread_mutex_init(&m_mutex, NULL);
 	pthread_mutex_init(&m_readMutex, NULL);
@@ -214,6 +223,7 @@ bool BlockingCQueue<T>::insert(value_type& item)
 	++m_unread;
 	pthread_mutex_unlock(&m_mutex);
 	pthread_cond_signal(&m_not_empty);
+	notifyWakeup();
 	return true;
 }
 
@@ -242,6 +252,7 @@ bool BlockingCQueue<T>::endInsert(value_type& item)
 	m_writeIndex = (m_writeIndex+1) % m_capacity;
 	++m_unread;
 	pthread_cond_signal(&m_not_empty);
+	notifyWakeup();
 	return true;
 }
 
@@ -359,6 +370,21 @@ bool BlockingCQueue<T>::isWriteLocked()
 	return m_writeLock;
 }
 
+template <class T>
+void BlockingCQueue<T>::setWakeup(ConduitWakeup *wakeup)
+{
+	m_wakeup = wakeup;
+	__sync_synchronize();
+}
+
+template <class T>
+void BlockingCQueue<T>::notifyWakeup()
+{
+	ConduitWakeup *wakeup = m_wakeup;
+	if (wakeup)
+		wakeup->notify();
+}
+
 ///////////////////////////////////////////////////////////////////////
 }//end namespace
 #endif /*BLOCKINGCQUEUE_H_*/
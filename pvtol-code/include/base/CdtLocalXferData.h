@@ -17,7 +17,7 @@
 #define CONDUITLOCALXFERDATA_H_
 
 #include <SendRequest.h>
-#include <pthread.h>
+#include <LocalXferRing.h>
 namespace ipvtol
 {
 
@@ -25,17 +25,10 @@ struct CdtLocalXferData
 {
   enum XferType { NONE=0, SYNC=1, ASYNC=2 };
 
-	pthread_mutex_t           clxdMutex;
-	pthread_mutex_t           clxdCvMutex;
-	pthread_cond_t            clxdCond;
+	LocalXferRing             ring;  // frames & EOCs in flight
 	void                     *srcAddr;
 	void                     *destAddr;
 	PvtolXferType             sendType;
-	int                       insertPosted;
-	int                       eocPosted;
-	int                       insertWaiting;
-	int                       extractWaiting;
-	bool                      noBuffAvailable;
 	SendRequest              *sReq;
 };
 
@@ -80,6 +80,12 @@ namespace ipvtol
        //--------------------------------------------------
     int getNumProcs() const;
 
+       // Returns, for each rank, the lowest rank of the
+       //   processes on its host. Collective on the first
+       //   call, which every process must make; cached after
+       //--------------------------------------------------
+    const vector<int>& getHostRanks();
+
     void  barSynch();
 
        // Send Data from current node and to a destination
@@ -157,6 +163,7 @@ namespace ipvtol
     int                     m_pRank; // The local Rank in this communicator
     vector<ProcId>          m_commProcsLongList;
     vector<ProcId>          m_commProcsShortList;
+    vector<int>             m_hostRanks;  // empty until getHostRanks()
     CommType                m_comm;
 
     //   Private Methods
@@ -36,6 +36,9 @@
 #include <LocalMap.h>
 #include <DataMap.h>
 #include <CdtLocalXferData.h>
+#include <ShmXferSegment.h>
+#include <ConduitDepthControl.h>
+#include <ConduitWakeup.h>
 #include <RingIndex.h>
 #include <NTuple.h>
 
@@ -57,7 +60,22 @@ using std::map;
 using boost::shared_ptr;
 
 
+const Route::Flags TRANSPOSE_021 = Route::TRANSPOSE_021;
 const Route::Flags TRANSPOSE_102 = Route::TRANSPOSE_102;
+const Route::Flags TRANSPOSE_120 = Route::TRANSPOSE_120;
+const Route::Flags TRANSPOSE_201 = Route::TRANSPOSE_201;
+const Route::Flags TRANSPOSE_210 = Route::TRANSPOSE_210;
+
+// send each frame's tag in a trailer of the data message, rather than
+//   in a message of its own
+const Route::Flags FUSED_TAG     = Route::FUSED_TAG;
+
+// move only the valid part of each frame, see ConduitInsertIf::setLength()
+const Route::Flags VARIABLE_SIZE = Route::VARIABLE_SIZE;
+
+// relay each frame's tag from destination to destination, down a tree,
+//   rather than sending it from the source to each of them
+const Route::Flags TREE_TAG      = Route::TREE_TAG;
 
 /* forward declarations needed for the Conduit class */
 template <class DATATYPE, class TAGTYPE, bool USE_EOC> class ConduitInsertIf;
@@ -116,24 +134,51 @@ class Conduit {
     typedef Endpoint<DATATYPE, TAGTYPE, USE_EOC> EP;
     typedef typename Endpoint<DATATYPE, TAGTYPE, USE_EOC>::EndpointType EPtype;
 
+    // LoadAware sends each frame to the replicated destination with the
+    //   most free slots, see Connection, rather than by turns. It needs
+    //   Support_Replicated; a single destination is sent every frame
     typedef enum
     {
         Broadcast,
-        RoundRobin
+        RoundRobin,
+        LoadAware
     } DistributionType;
 
+    // what a source does when every slot is taken; the lossy types
+    //   never wait, see the constructor
+    typedef enum
+    {
+        Block,
+        OverwriteOldest,
+        KeepNewest
+    } OverflowType;
+
     static const int PREPOST_FOREVER = -1;
 
     // CONSTRUCTORS
 
     /**
      * @param name the name of the conduit
+     * @param flags Route flags; TRANSPOSE_xxx, FUSED_TAG, VARIABLE_SIZE,
+     *              TREE_TAG
      * @param distType the type of distribution used transmitting to RepTasks
+     * @param overflow what to do when the consumer falls behind. Block
+     * waits for a slot. OverwriteOldest and KeepNewest trade frames for
+     * latency: the source never waits, and the destination discards the
+     * oldest frames waiting when they fill the ring (OverwriteOldest) or
+     * all but the newest (KeepNewest). Within a process a frame which
+     * finds no slot takes the slot of the oldest frame waiting, unless
+     * the destination is reading that one. Frames already handed to MPI
+     * can not be recalled, so between processes the frame is held back
+     * and sent when a slot frees; a newer frame written first replaces
+     * it. flush() and insertEOC() wait to send a held frame. The lossy
+     * types need a depth of at least 2 and no batching.
      *
      */
     Conduit(const string& name,
             Route::Flags flags = Route::DEFAULT_FLAG,
-            DistributionType distType = RoundRobin);
+            DistributionType distType = RoundRobin,
+            OverflowType overflow = Block);
 
     ~Conduit() throw();
 
@@ -160,11 +205,8 @@ class Conduit {
          int   size();
 
          const string&       m_name;
-         int                 m_transferSize;
-         bool                m_masterIsLocal;
+         int                 m_transferSize;  // ints in a descriptor
          int                *m_initCommBuff;
-         vector< Transfer* > m_toMaster;
-         vector< Transfer* > m_fromMaster;
     };//end class ConduitInitComm
 
     typedef Endpoint<DATATYPE, TAGTYPE, USE_EOC> EndpointX;
@@ -181,6 +223,8 @@ class Conduit {
          EndpointX             m_dst;
          bool                 m_dstInitialized;
          bool                 m_dstSetup;
+         bool                 m_extractOpen;  // a lossy dst's frame is out
+         unsigned int         m_ringDrops;    // a local src's, passed over
     };//end class ConduitThreadInfo
 
     void *getThreadInfo();
@@ -196,7 +240,16 @@ class Conduit {
     inline DATATYPE & getInsertHandle();
     inline TAGTYPE & getInsertTagHandle();
     void insert();
+    void sendInsert();
+    void sendHeldInsert(bool wait);
     inline void insertEOC();
+    inline void setInsertLength(int numElts);
+    void insert(const typename DATATYPE::ElType *data, int numElts);
+    void setAdaptiveDepth(int minDepth);
+    inline const ConduitDepthStats & getInsertDepthStats();
+    void setBatch(int numFrames);
+    void insertBatch(const typename DATATYPE::ElType *frames, int numFrames);
+    void flush();
 
     void setupDest(const DataMap & destMap, int depth,
                    const unsigned int lengths[]);
@@ -207,6 +260,12 @@ class Conduit {
     inline void clearEOC();
     DATATYPE & getExtractHandle();
     inline TAGTYPE & getExtractTagHandle();
+    int getExtractLength();
+    const typename DATATYPE::ElType * getExtractData();
+    int getExtractSeqNum();
+    bool setExtractWakeup(ConduitWakeup *wakeup);
+    inline const ConduitDepthStats & getExtractDepthStats();
+    void extractBatch(typename DATATYPE::ElType *frames, int numFrames);
     inline void release();
     void waitForLocalData();
     void localRelease();
@@ -218,16 +277,30 @@ class Conduit {
     void setupComplete(ConduitInitComm & initComm, bool useTag);
     void setupComplete();
 
+    inline OverflowType getOverflow() const;
+
+    // prefault the slots and lock them into memory, at setupComplete(),
+    //   from each thread for its own ends. Call before setupComplete();
+    //   the locks are held until the conduit is destroyed.
+    //   MemoryLock::report() lists them under "<name> src", "<name> dst"
+    //   and, for slots shared between processes, "<name> shm"
+    inline void setLockMemory(bool enable);
+
     friend class ConduitInsertIf<DATATYPE, TAGTYPE, USE_EOC>;
     friend class ConduitExtractIf<DATATYPE, TAGTYPE, USE_EOC>;
 
   private:
     void validateEndpoints();
+    void setupShmXfer(EndpointX &src, EndpointX &dst, bool useTag);
+    void mapShmXfer(EndpointX &src, EndpointX &dst, bool useTag);
+    bool discardStale();
+    void lockSlots();
 
     string               m_name;
     bool                 m_useTag;
     int                  m_tag;
     DistributionType     m_distType;
+    OverflowType         m_overflow;
     bool                 m_srcIsReplicated;
     bool                 m_destIsReplicated;
     bool                 m_setupCompleteDone;
@@ -239,12 +312,17 @@ class Conduit {
 
     int                  m_clxdKey;
     CdtLocalXferData    *m_clxdEntry;
-    RingIndex            m_localXferBufferHeadIndex;
-    RingIndex            m_localXferBufferTailIndex;
+    bool                 m_doShmXfer;//a local xfer between processes
+    ShmXferSegment      *m_shmSeg;   //its slots, if this proc is an end
+    LocalXferRing       *m_xferRing; //the clxd entry's, or the segment's
     int                  m_depth;//used only in local xfers
+    EndpointX           *m_localSrcp;//used only in local xfers
+    bool                 m_lockMemory;
+    size_t               m_shmLocked;//bytes of m_shmSeg locked
 
 //   per thread info is accessed 1st by task ID then by thread rank
     pthread_mutex_t      m_thdInfoMutex;
+    pthread_key_t        m_thdInfoKey;   // caches this thread's entry
     // map<TaskId, map<int, void* > > m_thdInfo;
     map<NTuple, void* > m_thdInfo;
 };//end Conduit class
@@ -335,6 +413,52 @@ class ConduitInsertIf {
     setup(DATATYPE& srcObj,    // user supplied endpoint object
           int depth=1);        // multi-buffering depth
 
+    /**
+     * Lets the number of transfers in flight adapt to the observed
+     * stalls, between minDepth and the depth given to setup(). The
+     * buffer space for the full depth is still allocated. Call it
+     * after setup().
+     *
+     * @param minDepth the smallest number of transfers in flight */
+    inline void setAdaptiveDepth(int minDepth);
+
+    /**
+     * Gives the stall statistics, and the adaptive depth decisions,
+     * of the source end.
+     *
+     * @return the source end's statistics */
+    inline const ConduitDepthStats& getDepthStats();
+
+    /**
+     * Sends numFrames consecutive transfers as one message. Both
+     * multi-buffering depths must be multiples of numFrames, and at
+     * least twice it, and the conduit must go from one processor to
+     * one processor without a transpose. Transfers within a processor
+     * are not batched. Call it after setup().
+     *
+     * @param numFrames the number of transfers per message */
+    inline void setBatch(int numFrames);
+
+    /**
+     * Copies numFrames consecutive frames, each the size of the source
+     * buffer, into the conduit and inserts them. With setBatch(n), a
+     * multiple of n frames completes whole batches.
+     *
+     * This is a Blocking call and will not return until buffer space
+     * is available for the last frame.
+     *
+     * @param frames    the frames to send
+     * @param numFrames the number of frames */
+    inline void insertBatch(const typename DATATYPE::ElType *frames,
+                            int numFrames);
+
+    /**
+     * With setBatch(n), sends the frames of a partly filled batch now
+     * rather than when its last frame is inserted. The rest of the
+     * batch follows in a later message. insertEOC() flushes too.
+     * Without batching it does nothing. */
+    inline void flush();
+
     /**
      * Queries whether the conduit is able to provide the buffer space
      * needed for an outgoing transfer.
@@ -388,6 +512,30 @@ class ConduitInsertIf {
      * */
     inline void insert();
 
+    /**
+     * Sets the number of valid elements in the current source buffer,
+     * so that only those elements are sent by the next insert(). By
+     * default the whole buffer is valid. A length larger than the
+     * buffer requires the VARIABLE_SIZE flag.
+     *
+     * @param numElts the number of valid elements
+     * */
+    inline void setLength(int numElts);
+
+    /**
+     * Copies numElts elements into the next source buffer and sends
+     * them, as if by getHandle(), setLength() and insert(). Frames
+     * larger than the buffer are sent out of line when the Conduit
+     * was constructed with the VARIABLE_SIZE flag.
+     *
+     * This is a Blocking call and will not return until buffer space
+     * is available.
+     *
+     * @param data    the elements to send
+     * @param numElts the number of elements
+     * */
+    inline void insert(const typename DATATYPE::ElType *data, int numElts);
+
     /**
      * Sends an end-of-cycle (EOC).
      *
@@ -537,12 +685,75 @@ class ConduitExtractIf {
      * @return a reference to the conduit's Tag object.  */
     inline TAGTYPE& getTagHandle();
 
+    /**
+     * Gets the number of valid elements in the next available
+     * destination buffer, as set by the sender's setLength() or
+     * insert(data, numElts).
+     *
+     * This is a Blocking call and will not return until data is availble
+     *
+     * @return the number of valid elements  */
+    inline int getLength();
+
+    /**
+     * Gives access to the valid elements of the next available
+     * destination buffer. Unlike getHandle(), this also reaches a frame
+     * which was larger than the buffer. The pointer is valid until
+     * release() is called.
+     *
+     * This is a Blocking call and will not return until data is availble
+     *
+     * @return a pointer to the first valid element  */
+    inline const typename DATATYPE::ElType * getData();
+
+    /**
+     * Gets the source's number for the frame in the next available
+     * destination buffer. Frames are numbered from 0 in the order they
+     * were inserted; a replica of a LoadAware Conduit receives a
+     * subset of them, which a downstream merge may put back in order.
+     *
+     * This is a Blocking call and will not return until data is availble
+     *
+     * @return the frame's sequence number  */
+    inline int getSeqNum();
+
+    /**
+     * Extracts numFrames consecutive frames, copying the valid part of
+     * each into frames at a stride of the destination buffer's size,
+     * and releases them.
+     *
+     * This is a Blocking call and will not return until all the frames
+     * have arrived. A VARIABLE_SIZE frame longer than the destination
+     * buffer throws, and is left unreleased for getExtractData().
+     *
+     * @param frames    receives the frames
+     * @param numFrames the number of frames  */
+    inline void extractBatch(typename DATATYPE::ElType *frames,
+                             int numFrames);
+
+    /**
+     * Gives the starvation statistics of the destination end.
+     *
+     * @return the destination end's statistics  */
+    inline const ConduitDepthStats& getDepthStats();
+
     /**
      * Releases the buffer space so that it can be re-used by another
      * transfer.
      */
     inline void release();
 
+    /**
+     * Notifies wakeup of every frame and EOC inserted, so that a
+     * ConduitSelector may sleep on this conduit. Only a conduit whose
+     * source is in this process can notify; a remote source's frames
+     * must be polled for. Call it after setupComplete(). NULL stops the
+     * notifications.
+     *
+     * @param wakeup the selector's wakeup
+     * @return true if the conduit will notify wakeup  */
+    inline bool setWakeup(ConduitWakeup *wakeup);
+
     private:
       Conduit<DATATYPE, TAGTYPE, USE_EOC> * m_conduit;
 };// end ConduitExtractIf
@@ -555,10 +766,16 @@ class ConduitExtractIf {
 // This structure is used for bookkeeping for both tags and EOCs
 struct ItemTransferInfo
 {
+    ItemTransferInfo() : m_index(0), m_fromNode(0), m_toNode(0),
+                         m_waitFor(-1), m_started(false), m_done(false) { }
+
     int    m_index;
     ProcId m_fromNode;
     ProcId m_toNode;
     shared_ptr< SendRequest > m_sendRequest;
+    int    m_waitFor;    // the entry to arrive before this one is relayed
+    bool   m_started;
+    bool   m_done;
 };
 
 //                  I N L I N E        Methods
@@ -647,6 +864,41 @@ void ConduitInsertIf<DATATYPE, TAGTYPE, USE_EOC>::setup(
     m_conduit->setupSrc(srcObj, depth);
 }
 
+template <class DATATYPE, class TAGTYPE, bool USE_EOC>
+inline void
+ConduitInsertIf<DATATYPE, TAGTYPE, USE_EOC>::setAdaptiveDepth(int minDepth)
+{
+    m_conduit->setAdaptiveDepth(minDepth);
+}
+
+template <class DATATYPE, class TAGTYPE, bool USE_EOC>
+inline const ConduitDepthStats &
+ConduitInsertIf<DATATYPE, TAGTYPE, USE_EOC>::getDepthStats()
+{
+    return m_conduit->getInsertDepthStats();
+}
+
+template <class DATATYPE, class TAGTYPE, bool USE_EOC>
+inline void
+ConduitInsertIf<DATATYPE, TAGTYPE, USE_EOC>::setBatch(int numFrames)
+{
+    m_conduit->setBatch(numFrames);
+}
+
+template <class DATATYPE, class TAGTYPE, bool USE_EOC>
+inline void ConduitInsertIf<DATATYPE, TAGTYPE, USE_EOC>::insertBatch(
+    const typename DATATYPE::ElType *frames,
+    int numFrames)
+{
+    m_conduit->insertBatch(frames, numFrames);
+}
+
+template <class DATATYPE, class TAGTYPE, bool USE_EOC>
+inline void ConduitInsertIf<DATATYPE, TAGTYPE, USE_EOC>::flush()
+{
+    m_conduit->flush();
+}
+
 template <class DATATYPE, class TAGTYPE, bool USE_EOC>
 inline bool ConduitInsertIf<DATATYPE, TAGTYPE, USE_EOC>::available()
 {
@@ -678,6 +930,20 @@ inline void ConduitInsertIf<DATATYPE, TAGTYPE, USE_EOC>::insert()
     m_conduit->insert();
 }
 
+template <class DATATYPE, class TAGTYPE, bool USE_EOC>
+inline void ConduitInsertIf<DATATYPE, TAGTYPE, USE_EOC>::setLength(int numElts)
+{
+    m_conduit->setInsertLength(numElts);
+}
+
+template <class DATATYPE, class TAGTYPE, bool USE_EOC>
+inline void ConduitInsertIf<DATATYPE, TAGTYPE, USE_EOC>::insert(
+    const typename DATATYPE::ElType *data,
+    int numElts)
+{
+    m_conduit->insert(data, numElts);
+}
+
 template <class DATATYPE, class TAGTYPE, bool USE_EOC>
 inline void ConduitInsertIf<DATATYPE, TAGTYPE, USE_EOC>::insertEOC()
 {
@@ -800,6 +1066,47 @@ inline TAGTYPE & ConduitExtractIf<DATATYPE, TAGTYPE, USE_EOC>::getTagHandle()
     return m_conduit->getExtractTagHandle();
 }
 
+template <class DATATYPE, class TAGTYPE, bool USE_EOC>
+inline int ConduitExtractIf<DATATYPE, TAGTYPE, USE_EOC>::getLength()
+{
+    return m_conduit->getExtractLength();
+}
+
+template <class DATATYPE, class TAGTYPE, bool USE_EOC>
+inline const typename DATATYPE::ElType *
+ConduitExtractIf<DATATYPE, TAGTYPE, USE_EOC>::getData()
+{
+    return m_conduit->getExtractData();
+}
+
+template <class DATATYPE, class TAGTYPE, bool USE_EOC>
+inline int ConduitExtractIf<DATATYPE, TAGTYPE, USE_EOC>::getSeqNum()
+{
+    return m_conduit->getExtractSeqNum();
+}
+
+template <class DATATYPE, class TAGTYPE, bool USE_EOC>
+inline bool
+ConduitExtractIf<DATATYPE, TAGTYPE, USE_EOC>::setWakeup(ConduitWakeup *wakeup)
+{
+    return m_conduit->setExtractWakeup(wakeup);
+}
+
+template <class DATATYPE, class TAGTYPE, bool USE_EOC>
+inline void ConduitExtractIf<DATATYPE, TAGTYPE, USE_EOC>::extractBatch(
+    typename DATATYPE::ElType *frames,
+    int numFrames)
+{
+    m_conduit->extractBatch(frames, numFrames);
+}
+
+template <class DATATYPE, class TAGTYPE, bool USE_EOC>
+inline const ConduitDepthStats &
+ConduitExtractIf<DATATYPE, TAGTYPE, USE_EOC>::getDepthStats()
+{
+    return m_conduit->getExtractDepthStats();
+}
+
 template <class DATATYPE, class TAGTYPE, bool USE_EOC>
 inline void ConduitExtractIf<DATATYPE, TAGTYPE, USE_EOC>::release()
 {
@@ -840,6 +1147,19 @@ Conduit<DATATYPE, TAGTYPE, USE_EOC>::setSlotSize( vector<EndpointX>& epv,
     }
 }
 
+template <class DATATYPE, class TAGTYPE, bool USE_EOC>
+inline typename Conduit<DATATYPE, TAGTYPE, USE_EOC>::OverflowType
+Conduit<DATATYPE, TAGTYPE, USE_EOC>::getOverflow() const
+{
+    return m_overflow;
+}
+
+template <class DATATYPE, class TAGTYPE, bool USE_EOC>
+inline void Conduit<DATATYPE, TAGTYPE, USE_EOC>::setLockMemory(bool enable)
+{
+    m_lockMemory = enable;
+}
+
 template <class DATATYPE, class TAGTYPE, bool USE_EOC>
 inline bool Conduit<DATATYPE, TAGTYPE, USE_EOC>::insertAvailable()
 {
@@ -869,9 +1189,16 @@ inline DATATYPE & Conduit<DATATYPE, TAGTYPE, USE_EOC>::getInsertHandle()
 	 << endl;
 #endif // PVTOL_DEBUG
 
-    if ((m_doLocalXfer && m_clxdEntry->noBuffAvailable)
+    //   a lossy src writes into the slot it keeps back; insert() decides
+    //   whether the frame is sent. A frame held there goes first if it
+    //   can, else the frame about to be written replaces it
+    if (m_overflow != Block && myinfo->m_src.isInsertHeld())
+                  sendHeldInsert(false);
+
+    if (m_overflow == Block &&
+        ((m_doLocalXfer && m_xferRing->full())
                             ||
-        (!m_doLocalXfer && myinfo->m_src.noBuffAvailable()))
+        (!m_doLocalXfer && myinfo->m_src.insertWindowFull())))
                   waitForInsertBuff();
 
     return *(myinfo->m_src.getDataAddress());
@@ -890,11 +1217,40 @@ inline void Conduit<DATATYPE, TAGTYPE, USE_EOC>::insertEOC()
 {
     ConduitThreadInfo *myinfo = (ConduitThreadInfo *)getThreadInfo();
 
+    if (myinfo->m_src.isInsertHeld())
+               sendHeldInsert(true);
+
     myinfo->m_src.insertEOC();
     if (m_doLocalXfer)
                insertLocalEOC();
 }
 
+template <class DATATYPE, class TAGTYPE, bool USE_EOC>
+inline void Conduit<DATATYPE, TAGTYPE, USE_EOC>::setInsertLength(int numElts)
+{
+    ConduitThreadInfo *myinfo = (ConduitThreadInfo *)getThreadInfo();
+
+    myinfo->m_src.setInsertLength(numElts);
+}
+
+template <class DATATYPE, class TAGTYPE, bool USE_EOC>
+inline const ConduitDepthStats &
+Conduit<DATATYPE, TAGTYPE, USE_EOC>::getInsertDepthStats()
+{
+    ConduitThreadInfo *myinfo = (ConduitThreadInfo *)getThreadInfo();
+
+    return myinfo->m_src.getDepthControl().getStats();
+}
+
+template <class DATATYPE, class TAGTYPE, bool USE_EOC>
+inline const ConduitDepthStats &
+Conduit<DATATYPE, TAGTYPE, USE_EOC>::getExtractDepthStats()
+{
+    ConduitThreadInfo *myinfo = (ConduitThreadInfo *)getThreadInfo();
+
+    return myinfo->m_dst.getDepthControl().getStats();
+}
+
 template <class DATATYPE, class TAGTYPE, bool USE_EOC>
 inline void Conduit<DATATYPE, TAGTYPE, USE_EOC>::extractAtLeast(int count)
 {
@@ -917,7 +1273,7 @@ inline void Conduit<DATATYPE, TAGTYPE, USE_EOC>::clearEOC()
     ConduitThreadInfo *myinfo = (ConduitThreadInfo *)getThreadInfo();
     myinfo->m_dst.clearEOC();
     if (m_doLocalXfer)
-            --(m_clxdEntry->eocPosted);
+            m_xferRing->clearEOC();
     return;
 }
 
@@ -929,6 +1285,12 @@ inline void Conduit<DATATYPE, TAGTYPE, USE_EOC>::release()
     myinfo->m_dst.release();
     if (m_doLocalXfer)
                  localRelease();
+    myinfo->m_dst.getDepthControl().recordExtract();
+
+    //   a lossy dst claimed the frame in discardStale()
+    if (myinfo->m_extractOpen && m_doLocalXfer)
+                 m_xferRing->unclaim();
+    myinfo->m_extractOpen = false;
 }
 
 
@@ -33,6 +33,7 @@
 
 #include <iostream>
 #include <stdio.h>
+#include <string.h>
 #include <utility>
 #include <vector>
 #include <map>
@@ -174,7 +175,8 @@ static bool isDirectDescendant(ProcId procId, TaskBase *tb)
 template <class DATATYPE, class TAGTYPE, bool USE_EOC>
 Conduit<DATATYPE, TAGTYPE, USE_EOC>::Conduit(const string & name,
                                              Route::Flags flags,
-                                             DistributionType distType) :
+                                             DistributionType distType,
+                                             OverflowType overflow) :
             m_setupCompleteDone(false),
             m_numCommGroups(0),
             m_doLocalXfer(false),
@@ -182,10 +184,17 @@ Conduit<DATATYPE, TAGTYPE, USE_EOC>::Conduit(const string & name,
             m_dstsPerGroup(0),
             m_transposeFlag(flags),
             m_tag(-1),
-            m_depth(-1)
+            m_doShmXfer(false),
+            m_shmSeg(NULL),
+            m_xferRing(NULL),
+            m_depth(-1),
+            m_localSrcp(NULL),
+            m_lockMemory(false),
+            m_shmLocked(0)
 {
 #ifdef PVTOL_DEVELOP
-    if ( !(flags == Route::DEFAULT_FLAG) && !(flags == TRANSPOSE_102) )
+    if ( (flags & ~(Route::TRANSPOSE_MASK | Route::FUSED_TAG |
+                    Route::VARIABLE_SIZE | Route::TREE_TAG)) != 0 )
       {
         throw Exception("Conduit: specified Route flag is not implemented",
                         __FILE__, __LINE__);
@@ -205,13 +214,17 @@ Conduit<DATATYPE, TAGTYPE, USE_EOC>::Conduit(const string & name,
         m_useTag = true;
 
     m_distType = distType;
+    m_overflow = overflow;
     pthread_mutex_init(&m_thdInfoMutex, NULL);
+    if (pthread_key_create(&m_thdInfoKey, NULL) != 0)
+        throw Exception("Conduit: could not create thread info key",
+                        __FILE__, __LINE__);
 
 #ifdef PVTOL_DEVELOP
     // FIXME: remove this limitation
-    if (m_distType != RoundRobin)
+    if (m_distType != RoundRobin && m_distType != LoadAware)
       {
-        throw Exception("Conduit: only round robin distribution is implemented",
+        throw Exception("Conduit: broadcast distribution is not implemented",
                         __FILE__, __LINE__);
       }
 #endif // PVTOL_DEVELOP
@@ -222,6 +235,11 @@ Conduit<DATATYPE, TAGTYPE, USE_EOC>::Conduit(const string & name,
 template <class DATATYPE, class TAGTYPE, bool USE_EOC>
 Conduit<DATATYPE, TAGTYPE, USE_EOC>::~Conduit() throw()
 {
+    if (m_shmLocked != 0)
+        MemoryLock::unlock(m_name + " shm", m_shmSeg->getData(), m_shmLocked);
+    delete m_shmSeg;
+    pthread_key_delete(m_thdInfoKey);
+    pthread_mutex_destroy(&m_thdInfoMutex);
     return;
 }
 
@@ -230,6 +248,13 @@ template <class DATATYPE, class TAGTYPE, bool USE_EOC>
 void *
 Conduit<DATATYPE, TAGTYPE, USE_EOC>::getThreadInfo()
 {
+    //  A thread's (proc, task, thread rank) never changes, so once its
+    //   entry has been looked up (normally by setup) it is kept in a
+    //   thread specific slot and the map and its mutex are bypassed.
+    void  *cached = pthread_getspecific(m_thdInfoKey);
+    if (cached != NULL)
+        return(cached);
+
     PvtolProgram   prog;
     ProcId         procid = prog.getProcId();
     TaskBase      &ct     = prog.getCurrentTask();
@@ -249,6 +274,8 @@ Conduit<DATATYPE, TAGTYPE, USE_EOC>::getThreadInfo()
     ConduitThreadInfo *myinfo = (ConduitThreadInfo *)(m_thdInfo[mapKey]);
     pthread_mutex_unlock(&m_thdInfoMutex);
 
+    pthread_setspecific(m_thdInfoKey, myinfo);
+
     return((void *)myinfo);
 }//end getThreadInfo()
 
@@ -296,7 +323,7 @@ void Conduit<DATATYPE, TAGTYPE, USE_EOC>::setupSrc(
 	  {
 	    if (srcMap == (*firstDstp).getMap())   // like mapped
 	      {
-		if (m_transposeFlag < 0x80)
+		if (!(m_transposeFlag & Route::TRANSPOSED))
 		  {
 		    m_doLocalXfer = true;
 		    
@@ -466,7 +493,7 @@ void Conduit<DATATYPE, TAGTYPE, USE_EOC>::setupDest(
 	    const DataMap  &srcMap = (*firstSrcp).getMap();
 	    if (srcMap == destMap)
 	      {
-		if (m_transposeFlag < 0x80)
+		if (!(m_transposeFlag & Route::TRANSPOSED))
 		  {
 		    m_doLocalXfer = true;
 		    
@@ -626,7 +653,7 @@ void Conduit<DATATYPE, TAGTYPE, USE_EOC>::setupComplete()
 
     setupComplete(initComm, m_useTag);
 
-    if (m_doLocalXfer)
+    if (m_doLocalXfer && !m_doShmXfer)
       {
         EndpointX  *firstSrcp=NULL;
         bool       done = false;
@@ -643,11 +670,8 @@ void Conduit<DATATYPE, TAGTYPE, USE_EOC>::setupComplete()
         }//endfor ita
 
 	int depth = (*firstSrcp).getDepth();
-        m_localXferBufferHeadIndex.setBufSize(depth);
-        m_localXferBufferHeadIndex = 0;
-        m_localXferBufferTailIndex.setBufSize(depth);
-        m_localXferBufferTailIndex = 0;
 	m_depth = depth;
+	m_localSrcp = firstSrcp;
 
         PvtolProgram   prog;
         TaskBase  &ct  = prog.getCurrentTask();
@@ -659,15 +683,8 @@ void Conduit<DATATYPE, TAGTYPE, USE_EOC>::setupComplete()
 	it = clxdDb.find(m_clxdKey);
 	if (it == clxdDb.end())
 	  {//   Create and init entry
-	     pthread_mutex_init(&(clxdDb[m_clxdKey].clxdMutex), NULL);
-	     pthread_mutex_init(&(clxdDb[m_clxdKey].clxdCvMutex), NULL);
-	     pthread_cond_init(&(clxdDb[m_clxdKey].clxdCond), NULL);
+	     clxdDb[m_clxdKey].ring.reset(depth);
 	     clxdDb[m_clxdKey].sendType        = NONE;
-	     clxdDb[m_clxdKey].insertPosted    = 0;
-	     clxdDb[m_clxdKey].eocPosted       = 0;
-	     clxdDb[m_clxdKey].insertWaiting   = 0;
-	     clxdDb[m_clxdKey].extractWaiting  = 0;
-	     clxdDb[m_clxdKey].noBuffAvailable = false;
 	     clxdDb[m_clxdKey].sReq            = NULL;
 	     clxdDb[m_clxdKey].destAddr        = NULL;
 	     clxdDb[m_clxdKey].srcAddr         = NULL;
@@ -675,8 +692,13 @@ void Conduit<DATATYPE, TAGTYPE, USE_EOC>::setupComplete()
 
 	pthread_mutex_unlock(&clxdDbMutex);
 	m_clxdEntry = &(clxdDb[m_clxdKey]);
+	m_xferRing  = &(m_clxdEntry->ring);
+	m_xferRing->setLimit(firstSrcp->getDepthControl().getDepth());
       }//endIf no movement necessary
 
+    if (m_lockMemory)
+        lockSlots();
+
 }//end setupComplete()
  
 
@@ -736,6 +758,42 @@ void Conduit<DATATYPE, TAGTYPE, USE_EOC>::setupComplete(
     m_dstsPerGroup  = 1;
 #endif // Support_Replicated
 
+    // a src and dst in two processes of one host may share their slots
+    setupShmXfer(*firstSrcp, *firstDstp, useTag);
+
+    // a LoadAware src picks among its dsts by their credits; with more
+    //   than one src per group the dsts could not sequence the frames.
+    //   With a single dst there is nothing to choose, and the frames go
+    //   by turns as with RoundRobin. Without Support_Replicated every
+    //   group has a single dst, so credits are never used
+    if (m_distType == LoadAware)
+      {
+        if (m_srcsPerGroup != 1)
+          {
+            throw Exception("Conduit: LoadAware distribution needs an "
+                            "unreplicated source", __FILE__, __LINE__);
+          }
+#ifdef Support_Replicated
+        if (m_dstsPerGroup > 1)
+          {
+            firstSrcp->setLoadAware(true);
+            firstDstp->setLoadAware(true);
+          }
+#endif // Support_Replicated
+      }
+
+    // a lossy src keeps a slot back to write into, and drops frames one
+    //   at a time, which a batch could not
+    if (m_overflow != Block && firstSrcp != NULL)
+      {
+        if (firstSrcp->getDepth() < 2 || firstSrcp->getBatch() > 1)
+          {
+            throw Exception("Conduit: a lossy source needs a depth of 2 "
+                            "or more and no batching", __FILE__, __LINE__);
+          }
+        firstSrcp->setLossy(true);
+      }
+
     unsigned maxSrcNumRanks = 0;
     char ostr[128];
 
@@ -754,6 +812,10 @@ void Conduit<DATATYPE, TAGTYPE, USE_EOC>::setupComplete(
    os=ostr;
    firstDstp->finalSetup(os, m_dstsPerGroup, m_srcsPerGroup,
                          0 /*i / m_numCommGroups*/, useTag, maxSrcNumRanks);
+
+   // only the producer may bound the frames in flight
+   if ((m_shmSeg != NULL) && (firstSrcp->procId() == procId))
+         m_xferRing->setLimit(firstSrcp->getDepthControl().getDepth());
  
     if ((firstSrcp != NULL) && (firstDstp != NULL))
       {
@@ -840,24 +902,108 @@ void Conduit<DATATYPE, TAGTYPE, USE_EOC>::setupComplete(
 template <class DATATYPE, class TAGTYPE, bool USE_EOC>
 void Conduit<DATATYPE, TAGTYPE, USE_EOC>::insert()
 {
-    if (!insertAvailable())
+    ConduitThreadInfo *myinfo = (ConduitThreadInfo *)getThreadInfo();
+
+    if (m_overflow != Block)
+      {//   no slot free, and the frame written is not waited on
+        if (m_doLocalXfer)
+          {//   it takes the oldest frame's slot, unless that is being read
+            while (m_xferRing->full())
+              {
+                if (!m_xferRing->dropOldest())
+                  {
+                    myinfo->m_src.dropInsert();
+                    return;
+                  }
+                myinfo->m_src.getDepthControl().recordInsertDrop();
+              }
+          }
+         else if (!myinfo->m_src.insertAvailable())
+          {//   frames handed to MPI can not be recalled; this one waits
+           //   in its slot for room, see getInsertHandle()
+            myinfo->m_src.holdInsert();
+            return;
+          }
+      }
+     else if (!insertAvailable())
                   waitForInsert();
 
+    sendInsert();
+
+    return;
+}//end insert()
+
+//------------------------------------------------------------------------
+//  Method:     sendInsert
+//
+//  Description: Sends the frame in the head slot, which insert() found
+//               room for
+//
+//  Inputs: none
+//  Returns: void
+//
+//------------------------------------------------------------------------
+template <class DATATYPE, class TAGTYPE, bool USE_EOC>
+void Conduit<DATATYPE, TAGTYPE, USE_EOC>::sendInsert()
+{
     ConduitThreadInfo *myinfo = (ConduitThreadInfo *)getThreadInfo();
+
 #ifdef _DEBUG_2
     PvtolProgram   prog;
     int procId   = prog.getProcId();
     cout << "Cdt[" << procId << "] about to insert EP is "
          << myinfo->m_src << endl;
 #endif // _DEBUG_2
+    int   slot = myinfo->m_src.getHeadBuffIdx();
     myinfo->m_src.insert();
+    if (m_doShmXfer)
+      {//   the dst cannot read the src's records of the frame
+         m_shmSeg->setFrame(slot, myinfo->m_src.getValidLength(slot),
+                            myinfo->m_src.getValidSeqNum(slot));
+      }
     if (m_doLocalXfer)
       {
          insertLocalData();
       }
 
+    //   a safe point to resize the window; frames in flight are untouched
+    if (myinfo->m_src.getDepthControl().recordInsert() && m_doLocalXfer)
+         m_xferRing->setLimit(myinfo->m_src.getDepthControl().getDepth());
+
     return;
-}//end insert()
+}//end sendInsert()
+
+//------------------------------------------------------------------------
+//  Method:     sendHeldInsert
+//
+//  Description: Sends the frame a lossy src held back for want of a slot,
+//               if a slot has freed. Otherwise the frame is dropped, as
+//               the older of it and the frame about to be written, or,
+//               for flush() and insertEOC(), waited on
+//
+//  Inputs: bool wait for a slot rather than drop the frame
+//  Returns: void
+//
+//------------------------------------------------------------------------
+template <class DATATYPE, class TAGTYPE, bool USE_EOC>
+void Conduit<DATATYPE, TAGTYPE, USE_EOC>::sendHeldInsert(bool wait)
+{
+    ConduitThreadInfo *myinfo = (ConduitThreadInfo *)getThreadInfo();
+
+    if (!myinfo->m_src.insertAvailable())
+      {
+        if (!wait)
+          {
+            myinfo->m_src.dropInsert();
+            return;
+          }
+        waitForInsert();
+      }
+
+    sendInsert();
+
+    return;
+}//end sendHeldInsert()
 
 template <class DATATYPE, class TAGTYPE, bool USE_EOC>
 DATATYPE & Conduit<DATATYPE, TAGTYPE, USE_EOC>::getExtractHandle()
@@ -873,22 +1019,24 @@ DATATYPE & Conduit<DATATYPE, TAGTYPE, USE_EOC>::getExtractHandle()
 #endif // _DEBUG_2
 
    if (m_doLocalXfer)
-     {
-       pthread_mutex_lock(&(m_clxdEntry->clxdMutex));
-       if (!(m_clxdEntry->insertPosted) && !(m_clxdEntry->eocPosted))
-         {
-             pthread_mutex_unlock(&(m_clxdEntry->clxdMutex));
-             waitForLocalData();
-         }
-        else
-             pthread_mutex_unlock(&(m_clxdEntry->clxdMutex));
+     {//   a lossy src may drop the frame waited for, see discardStale()
+       do {
+           if (m_xferRing->empty() && !(m_xferRing->eocPosted()))
+                 waitForLocalData();
+       } while ((m_overflow != Block) && !discardStale());
      }
     else
      {//   not local
         if (!extractReady())
           {//   a blocking call
+              double start = ConduitDepthControl::now();
 	      myinfo->m_dst.waitForExtractBuff();
+              myinfo->m_dst.getDepthControl().addStarve(
+                                       ConduitDepthControl::now() - start);
           }//endIf not Ready
+
+        if (m_overflow != Block)
+                discardStale();
      }//endIf not local
 
     return *(myinfo->m_dst.getDataAddress());
@@ -902,48 +1050,326 @@ Conduit<DATATYPE, TAGTYPE, USE_EOC>::getExtractTagHandle()
 
    if (m_doLocalXfer)
      {
-       pthread_mutex_lock(&(m_clxdEntry->clxdMutex));
-       if (!(m_clxdEntry->insertPosted) && !(m_clxdEntry->eocPosted))
-         {
-             pthread_mutex_unlock(&(m_clxdEntry->clxdMutex));
-             waitForLocalData();
-         }
-        else
-             pthread_mutex_unlock(&(m_clxdEntry->clxdMutex));
+       do {
+           if (m_xferRing->empty() && !(m_xferRing->eocPosted()))
+                 waitForLocalData();
+       } while ((m_overflow != Block) && !discardStale());
 
        return myinfo->m_dst.getTagHandleRef();
      }
     else
      {//   not local
+       //   a lossy dst must choose the frame before its tag is read
+       if (m_overflow != Block)
+             getExtractHandle();
+
        return myinfo->m_dst.getExtractTagHandle();
      }//endIf not local
 
 }
 
 
+//------------------------------------------------------------------------
+//  Method:     insert(data, numElts)
+//
+//  Description: Copies numElts elements into the next source slot and
+//               inserts it. A frame larger than a slot is held out of
+//               line by the Endpoint; it can only reach a remote
+//               destination if the Conduit was built with VARIABLE_SIZE
+//
+//  Inputs: ElType * the data, int the number of elements
+//  Returns: void
+//
+//------------------------------------------------------------------------
 template <class DATATYPE, class TAGTYPE, bool USE_EOC>
-void Conduit<DATATYPE, TAGTYPE, USE_EOC>::insertLocalData()
+void Conduit<DATATYPE, TAGTYPE, USE_EOC>::insert(
+                                  const typename DATATYPE::ElType *data,
+                                  int numElts)
 {
-   pthread_mutex_lock(&(m_clxdEntry->clxdMutex));
+    ConduitThreadInfo *myinfo = (ConduitThreadInfo *)getThreadInfo();
 
-   ++(m_clxdEntry->insertPosted);
+#ifdef PVTOL_DEVELOP
+    if ((numElts > myinfo->m_src.getSize()) &&
+        (!m_doLocalXfer || m_doShmXfer) &&
+        !(m_transposeFlag & Route::VARIABLE_SIZE))
+      {
+        throw Exception("Conduit: frame larger than a slot needs VARIABLE_SIZE",
+                        __FILE__, __LINE__);
+      }
+#endif // PVTOL_DEVELOP
 
-   ++m_localXferBufferHeadIndex;
-   if ((m_localXferBufferHeadIndex == m_localXferBufferTailIndex)
-                             &&
-       (m_clxdEntry->insertPosted == m_depth))
-     {
-       m_clxdEntry->noBuffAvailable = true;
-     }
+    //   blocks until the slot is free to be written
+    getInsertHandle();
+    myinfo->m_src.setInsertData(data, numElts);
+    insert();
+}//end insert(data, numElts)
+
+//------------------------------------------------------------------------
+//  Method:     getExtractLength
+//
+//  Description: Gets the number of valid elements in the slot being
+//               extracted. For a local transfer the src and dst share
+//               the slot, so the length recorded by the src is used;
+//               between processes the src records it in the segment
+//
+//  Inputs: none
+//  Returns: int
+//
+//------------------------------------------------------------------------
+template <class DATATYPE, class TAGTYPE, bool USE_EOC>
+int Conduit<DATATYPE, TAGTYPE, USE_EOC>::getExtractLength()
+{
+    ConduitThreadInfo *myinfo = (ConduitThreadInfo *)getThreadInfo();
 
-   if (m_clxdEntry->extractWaiting)
-     {
-       pthread_mutex_lock(&(m_clxdEntry->clxdCvMutex));
-       pthread_cond_signal(&(m_clxdEntry->clxdCond));
-       pthread_mutex_unlock(&(m_clxdEntry->clxdCvMutex));
-     }
+    getExtractHandle();
+    int   slot = myinfo->m_dst.getTailBuffIdx();
 
-   pthread_mutex_unlock(&(m_clxdEntry->clxdMutex));
+    if (m_doShmXfer)
+        return(m_shmSeg->getFrameLength(slot));
+    if (m_doLocalXfer)
+        return(m_localSrcp->getValidLength(slot));
+    return(myinfo->m_dst.getValidLength(slot));
+}//end getExtractLength()
+
+//------------------------------------------------------------------------
+//  Method:     getExtractData
+//
+//  Description: Gets the valid elements of the slot being extracted,
+//               whether held in the slot or out of line
+//
+//  Inputs: none
+//  Returns: ElType *
+//
+//------------------------------------------------------------------------
+template <class DATATYPE, class TAGTYPE, bool USE_EOC>
+const typename DATATYPE::ElType *
+Conduit<DATATYPE, TAGTYPE, USE_EOC>::getExtractData()
+{
+    ConduitThreadInfo *myinfo = (ConduitThreadInfo *)getThreadInfo();
+
+    getExtractHandle();
+    int   slot = myinfo->m_dst.getTailBuffIdx();
+
+    if (m_doLocalXfer && !m_doShmXfer)
+        return(m_localSrcp->getValidData(slot));
+    return(myinfo->m_dst.getValidData(slot));
+}//end getExtractData()
+
+//------------------------------------------------------------------------
+//  Method:     getExtractSeqNum
+//
+//  Description: Gets the source's number for the frame being extracted.
+//               A LoadAware replica has it from the frame's header,
+//               an unreplicated LoadAware dst counts its own frames,
+//               otherwise it is the sequence number of the frame's tag,
+//               kept when the Conduit uses EOCs
+//
+//  Inputs: none
+//  Returns: int
+//
+//------------------------------------------------------------------------
+template <class DATATYPE, class TAGTYPE, bool USE_EOC>
+int Conduit<DATATYPE, TAGTYPE, USE_EOC>::getExtractSeqNum()
+{
+    ConduitThreadInfo *myinfo = (ConduitThreadInfo *)getThreadInfo();
+
+    getExtractHandle();
+    int   slot = myinfo->m_dst.getTailBuffIdx();
+
+    if (m_doShmXfer)
+        return(m_shmSeg->getFrameSeqNum(slot));
+    if (m_doLocalXfer)
+        return(m_localSrcp->getValidSeqNum(slot));
+    if (myinfo->m_dst.isLoadAware())
+        return(myinfo->m_dst.getValidSeqNum(slot));
+    if (m_distType == LoadAware)
+      {// a single dst is sent every frame, in order
+        return(myinfo->m_dst.getSequenceNumber());
+      }
+
+#ifdef PVTOL_DEVELOP
+    if (!USE_EOC)
+      {// only then does the tag carry a sequence number
+        throw Exception("Conduit: frame sequence numbers need EOCs",
+                        __FILE__, __LINE__);
+      }
+#endif // PVTOL_DEVELOP
+
+    return(myinfo->m_dst.getTagAddress()[slot].getSeqNum());
+}//end getExtractSeqNum()
+
+//------------------------------------------------------------------------
+//  Method:     setExtractWakeup
+//
+//  Description: Asks the src to notify a ConduitSelector's wakeup of
+//               each frame and EOC. Only a local transfer's src in this
+//               process shares memory with this dst; other frames must
+//               be polled for
+//
+//  Inputs: the wakeup, or NULL
+//  Returns: true if the wakeup will be notified
+//
+//------------------------------------------------------------------------
+template <class DATATYPE, class TAGTYPE, bool USE_EOC>
+bool Conduit<DATATYPE, TAGTYPE, USE_EOC>::setExtractWakeup(
+                                                ConduitWakeup *wakeup)
+{
+#ifdef PVTOL_DEVELOP
+    if (!m_setupCompleteDone)
+      {
+        throw Exception("Conduit: setWakeup before setupComplete",
+                        __FILE__, __LINE__);
+      }
+#endif // PVTOL_DEVELOP
+
+    if (!m_doLocalXfer || m_doShmXfer)
+        return(false);
+
+    m_xferRing->setWakeup(wakeup);
+    return(true);
+}//end setExtractWakeup()
+
+//------------------------------------------------------------------------
+//  Method:     setAdaptiveDepth
+//
+//  Description: Lets the number of frames this thread's source has in
+//               flight adapt between minDepth and the depth given to
+//               setup(), from the stalls it observes. The buffers are
+//               still allocated for the full depth
+//
+//  Inputs: int the smallest window
+//  Returns: void
+//
+//------------------------------------------------------------------------
+template <class DATATYPE, class TAGTYPE, bool USE_EOC>
+void Conduit<DATATYPE, TAGTYPE, USE_EOC>::setAdaptiveDepth(int minDepth)
+{
+    ConduitThreadInfo *myinfo = (ConduitThreadInfo *)getThreadInfo();
+
+#ifdef PVTOL_DEVELOP
+    if (!myinfo->m_srcInitialized)
+      {
+        throw Exception("Conduit: setAdaptiveDepth before the source setup",
+                        __FILE__, __LINE__);
+      }
+#endif // PVTOL_DEVELOP
+
+    ConduitDepthControl &ctl = myinfo->m_src.getDepthControl();
+    ctl.enable(minDepth);
+
+    //   before setupComplete() the bounds are set by finalSetup()
+    if (m_setupCompleteDone && m_doLocalXfer)
+         m_xferRing->setLimit(ctl.getDepth());
+}//end setAdaptiveDepth()
+
+//------------------------------------------------------------------------
+//  Method:     setBatch
+//
+//  Description: Asks that this thread's source send numFrames frames
+//               per message. The request reaches the destination with
+//               the endpoint exchange of setupComplete()
+//
+//  Inputs: int the number of frames per message
+//  Returns: void
+//
+//------------------------------------------------------------------------
+template <class DATATYPE, class TAGTYPE, bool USE_EOC>
+void Conduit<DATATYPE, TAGTYPE, USE_EOC>::setBatch(int numFrames)
+{
+    ConduitThreadInfo *myinfo = (ConduitThreadInfo *)getThreadInfo();
+
+#ifdef PVTOL_DEVELOP
+    if (!myinfo->m_srcInitialized || m_setupCompleteDone)
+      {
+        throw Exception("Conduit: setBatch must follow the source setup "
+                        "and precede setupComplete", __FILE__, __LINE__);
+      }
+#endif // PVTOL_DEVELOP
+
+    myinfo->m_src.setBatch(numFrames);
+}//end setBatch()
+
+//------------------------------------------------------------------------
+//  Method:     insertBatch
+//
+//  Description: Inserts numFrames frames, each a slot long, taken one
+//               after the other from frames
+//
+//  Inputs: ElType * the frames, int the number of frames
+//  Returns: void
+//
+//------------------------------------------------------------------------
+template <class DATATYPE, class TAGTYPE, bool USE_EOC>
+void Conduit<DATATYPE, TAGTYPE, USE_EOC>::insertBatch(
+                                  const typename DATATYPE::ElType *frames,
+                                  int numFrames)
+{
+    ConduitThreadInfo *myinfo = (ConduitThreadInfo *)getThreadInfo();
+    int                slot   = myinfo->m_src.getSize();
+
+    for (int i = 0; i < numFrames; i++)
+        insert(frames + i * slot, slot);
+}//end insertBatch()
+
+//------------------------------------------------------------------------
+//  Method:     flush
+//
+//  Description: Sends this thread's partly filled batch, or the frame a
+//               lossy src is holding back, if any, now
+//
+//  Inputs: none
+//  Returns: void
+//
+//------------------------------------------------------------------------
+template <class DATATYPE, class TAGTYPE, bool USE_EOC>
+void Conduit<DATATYPE, TAGTYPE, USE_EOC>::flush()
+{
+    ConduitThreadInfo *myinfo = (ConduitThreadInfo *)getThreadInfo();
+
+    if (myinfo->m_src.isInsertHeld())
+         sendHeldInsert(true);
+    myinfo->m_src.flushBatch();
+}//end flush()
+
+//------------------------------------------------------------------------
+//  Method:     extractBatch
+//
+//  Description: Extracts and releases numFrames frames, copying each
+//               one's valid elements to frames at a stride of a slot.
+//               A VARIABLE_SIZE frame longer than a slot does not fit
+//               its place in frames, and is refused unreleased
+//
+//  Inputs: ElType * receives the frames, int the number of frames
+//  Returns: void
+//
+//------------------------------------------------------------------------
+template <class DATATYPE, class TAGTYPE, bool USE_EOC>
+void Conduit<DATATYPE, TAGTYPE, USE_EOC>::extractBatch(
+                                  typename DATATYPE::ElType *frames,
+                                  int numFrames)
+{
+    ConduitThreadInfo *myinfo = (ConduitThreadInfo *)getThreadInfo();
+    int                slot   = myinfo->m_dst.getSize();
+
+    for (int i = 0; i < numFrames; i++)
+      {
+        int   len = getExtractLength();
+        if (len > slot)
+          {
+            throw Exception("Conduit: extractBatch of a frame larger than "
+                            "a slot; use getExtractData() for it",
+                            __FILE__, __LINE__);
+          }
+        memcpy(frames + i * slot, getExtractData(),
+               len * sizeof(typename DATATYPE::ElType));
+        release();
+      }
+}//end extractBatch()
+
+template <class DATATYPE, class TAGTYPE, bool USE_EOC>
+void Conduit<DATATYPE, TAGTYPE, USE_EOC>::insertLocalData()
+{
+   m_xferRing->publish();
 
    return;
 }//end insertLocalData()
@@ -951,17 +1377,7 @@ void Conduit<DATATYPE, TAGTYPE, USE_EOC>::insertLocalData()
 template <class DATATYPE, class TAGTYPE, bool USE_EOC>
 void Conduit<DATATYPE, TAGTYPE, USE_EOC>::insertLocalEOC()
 {
-   pthread_mutex_lock(&(m_clxdEntry->clxdMutex));
-   ++(m_clxdEntry->eocPosted);
-
-   if (m_clxdEntry->extractWaiting)
-     {
-       pthread_mutex_lock(&(m_clxdEntry->clxdCvMutex));
-       pthread_cond_signal(&(m_clxdEntry->clxdCond));
-       pthread_mutex_unlock(&(m_clxdEntry->clxdCvMutex));
-     }
-
-   pthread_mutex_unlock(&(m_clxdEntry->clxdMutex));
+   m_xferRing->postEOC();
 
    return;
 }//end insertLocalEOC()
@@ -973,11 +1389,12 @@ bool Conduit<DATATYPE, TAGTYPE, USE_EOC>::isAtEOC()
    ConduitThreadInfo *myinfo = (ConduitThreadInfo *)getThreadInfo();
    if (m_doLocalXfer)
      {
-       pthread_mutex_lock(&(m_clxdEntry->clxdMutex));
-       if (m_clxdEntry->eocPosted)
-                  rc = myinfo->m_dst.isAtEOC();
-
-       pthread_mutex_unlock(&(m_clxdEntry->clxdMutex));
+       if (m_xferRing->eocPosted())
+         {//   the frames a lossy src dropped count towards the EOC
+           if (m_overflow != Block)
+                  discardStale();
+           rc = myinfo->m_dst.isAtEOC();
+         }
      }
     else
        rc = myinfo->m_dst.isAtEOC();
@@ -988,82 +1405,51 @@ bool Conduit<DATATYPE, TAGTYPE, USE_EOC>::isAtEOC()
 template <class DATATYPE, class TAGTYPE, bool USE_EOC>
 void Conduit<DATATYPE, TAGTYPE, USE_EOC>::waitForInsert()
 {
+   ConduitThreadInfo *myinfo = (ConduitThreadInfo *)getThreadInfo();
+   double             start  = ConduitDepthControl::now();
+
    if (m_doLocalXfer)
      {
-       pthread_mutex_lock(&(m_clxdEntry->clxdMutex));
-       if (!insertAvailable() || !(m_clxdEntry->insertPosted))
-         {
-           pthread_mutex_lock(&(m_clxdEntry->clxdCvMutex));
-           ++(m_clxdEntry->extractWaiting);
-           pthread_mutex_unlock(&(m_clxdEntry->clxdMutex));
-           pthread_cond_wait(&(m_clxdEntry->clxdCond),
-	                 &(m_clxdEntry->clxdCvMutex));
-           --(m_clxdEntry->extractWaiting);
-           pthread_mutex_unlock(&(m_clxdEntry->clxdCvMutex));
-         }
-        else
-         {
-           --(m_clxdEntry->insertPosted);
-           pthread_mutex_unlock(&(m_clxdEntry->clxdMutex));
-         }
+       m_xferRing->waitForSpace();
      }
     else
      {//    data is being moved between procs
-        ConduitThreadInfo *myinfo = (ConduitThreadInfo *)getThreadInfo();
 	myinfo->m_src.waitForInsertBuff();
      }//endIf Local
 
+   myinfo->m_src.getDepthControl().addStall(ConduitDepthControl::now() - start);
+
    return;
 }//end waitForInsert()
 
 template <class DATATYPE, class TAGTYPE, bool USE_EOC>
 void Conduit<DATATYPE, TAGTYPE, USE_EOC>::waitForInsertBuff()
 {
+   ConduitThreadInfo *myinfo = (ConduitThreadInfo *)getThreadInfo();
+   double             start  = ConduitDepthControl::now();
+
    if (m_doLocalXfer)
      {
-       pthread_mutex_lock(&(m_clxdEntry->clxdMutex));
-       if (m_clxdEntry->noBuffAvailable)
-         {
-           pthread_mutex_lock(&(m_clxdEntry->clxdCvMutex));
-           ++(m_clxdEntry->insertWaiting);
-           pthread_mutex_unlock(&(m_clxdEntry->clxdMutex));
-           pthread_cond_wait(&(m_clxdEntry->clxdCond),
-	                 &(m_clxdEntry->clxdCvMutex));
-           pthread_mutex_unlock(&(m_clxdEntry->clxdCvMutex));
-           --(m_clxdEntry->insertWaiting);
-         }
-        else
-         {
-           pthread_mutex_unlock(&(m_clxdEntry->clxdMutex));
-         }
+       m_xferRing->waitForSpace();
      }
     else
      {//    data is being moved between procs
-        ConduitThreadInfo *myinfo = (ConduitThreadInfo *)getThreadInfo();
 	myinfo->m_src.waitForInsertBuff();
      }//endIf Local
 
+   myinfo->m_src.getDepthControl().addStall(ConduitDepthControl::now() - start);
+
    return;
 }//end waitForInsertBuff()
 
 template <class DATATYPE, class TAGTYPE, bool USE_EOC>
 void Conduit<DATATYPE, TAGTYPE, USE_EOC>::waitForLocalData()
 {
-   pthread_mutex_lock(&(m_clxdEntry->clxdMutex));
-   if (!(m_clxdEntry->insertPosted) && !(m_clxdEntry->eocPosted))
-     {
-       pthread_mutex_lock(&(m_clxdEntry->clxdCvMutex));
-       ++(m_clxdEntry->extractWaiting);
-       pthread_mutex_unlock(&(m_clxdEntry->clxdMutex));
-       pthread_cond_wait(&(m_clxdEntry->clxdCond),
-	                 &(m_clxdEntry->clxdCvMutex));
-       pthread_mutex_unlock(&(m_clxdEntry->clxdCvMutex));
-       --(m_clxdEntry->extractWaiting);
-     }
-    else
-     {
-       pthread_mutex_unlock(&(m_clxdEntry->clxdMutex));
-     }
+   ConduitThreadInfo *myinfo = (ConduitThreadInfo *)getThreadInfo();
+   double             start  = ConduitDepthControl::now();
+
+   m_xferRing->waitForData();
+   myinfo->m_dst.getDepthControl().addStarve(ConduitDepthControl::now() - start);
 
    return;
 }//end waitForLocalData()
@@ -1071,22 +1457,77 @@ void Conduit<DATATYPE, TAGTYPE, USE_EOC>::waitForLocalData()
 template <class DATATYPE, class TAGTYPE, bool USE_EOC>
 void Conduit<DATATYPE, TAGTYPE, USE_EOC>::localRelease()
 {
-   pthread_mutex_lock(&(m_clxdEntry->clxdMutex));
-   ++m_localXferBufferTailIndex;
+   m_xferRing->consume();
 
-   if (m_clxdEntry->insertWaiting)
+   return;
+}//end localRelease()
+
+//------------------------------------------------------------------------
+//  Method:     discardStale
+//
+//  Description: Releases, unread, the frames a lossy dst should not
+//               deliver: with KeepNewest all but the newest to have
+//               arrived, with OverwriteOldest the oldest for as long as
+//               the frames waiting leave the src no free slot. Once a
+//               frame has been handed out it stands until release().
+//               A local dst claims the frame from the src, which would
+//               otherwise drop it, and first passes over the slots of
+//               the frames the src has dropped
+//
+//  Inputs: none
+//  Returns: false if a local src dropped every frame waited for
+//
+//------------------------------------------------------------------------
+template <class DATATYPE, class TAGTYPE, bool USE_EOC>
+bool Conduit<DATATYPE, TAGTYPE, USE_EOC>::discardStale()
+{
+   ConduitThreadInfo *myinfo = (ConduitThreadInfo *)getThreadInfo();
+   EndpointX         &dst    = myinfo->m_dst;
+
+   if (myinfo->m_extractOpen)
+          return(true);
+
+   if (m_doLocalXfer)
      {
-       pthread_mutex_lock(&(m_clxdEntry->clxdCvMutex));
-       pthread_cond_signal(&(m_clxdEntry->clxdCond));
-       pthread_mutex_unlock(&(m_clxdEntry->clxdCvMutex));
+       m_xferRing->claim();
+       for (; myinfo->m_ringDrops != m_xferRing->numDropped();
+              myinfo->m_ringDrops++)
+             dst.release();
      }
 
-   --(m_clxdEntry->insertPosted);
-   m_clxdEntry->noBuffAvailable = false;
-   pthread_mutex_unlock(&(m_clxdEntry->clxdMutex));
+   for (;;)
+     {
+       int   waiting = m_doLocalXfer ? m_xferRing->numPosted()
+                                     : dst.numExtractReady();
+       if (waiting == 0)
+         {
+           if (!m_doLocalXfer)
+                 return(true);
+           m_xferRing->unclaim();
+           return(m_xferRing->eocPosted() != 0);
+         }
 
-   return;
-}//end localRelease()
+       bool  stale;
+       if (m_overflow == KeepNewest)
+             stale = (waiting > 1);
+        else if (m_doLocalXfer)
+             stale = m_xferRing->full();
+        else
+             stale = (waiting >= dst.getDepth());
+
+       if (!stale)
+             break;
+
+       dst.release();
+       if (m_doLocalXfer)
+             localRelease();
+       dst.getDepthControl().recordExtractDrop();
+     }//endFor
+
+   myinfo->m_extractOpen = true;
+
+   return(true);
+}//end discardStale()
 
 // Make sure all the endpoints in this mode have
 // consistent sizes
@@ -1124,6 +1565,234 @@ void Conduit<DATATYPE, TAGTYPE, USE_EOC>::validateEndpoints()
     return;
 }//end validateEndpoints()
 
+//------------------------------------------------------------------------
+//  Method:     setupShmXfer
+//
+//  Description: Lets an unreplicated src and dst, each held by a single
+//               processor, share their slots when the two processors
+//               are different processes of one host (MPI_COMM_TYPE_SHARED
+//               peers). The src creates a ShmXferSegment, the dst maps
+//               it, and both endpoints are rebound into it as for a
+//               local transfer, so no frame is sent; the segment's
+//               LocalXferRing paces them instead. Every thread of every
+//               processor of the task must call this, with the same
+//               endpoints, before finalSetup; it does nothing if any of
+//               them cannot share
+//
+//  Inputs: the src & dst endpoints, whether the Conduit has tags
+//  Returns: void
+//
+//------------------------------------------------------------------------
+template <class DATATYPE, class TAGTYPE, bool USE_EOC>
+void Conduit<DATATYPE, TAGTYPE, USE_EOC>::setupShmXfer(EndpointX &src,
+                                                       EndpointX &dst,
+                                                       bool useTag)
+{
+#if defined(_STANDARD_MPI) && defined(__linux__) && (MPI_VERSION >= 3)
+    //   the same on every processor, so all of them take the collective
+    //   steps below or none do
+    if ((m_numCommGroups != 1) || (m_srcsPerGroup != 1) ||
+        (m_dstsPerGroup != 1) ||
+        (m_transposeFlag & (Route::TRANSPOSED | Route::VARIABLE_SIZE)) ||
+        (m_distType == LoadAware) || (m_overflow != Block) ||
+        (src.getBatch() > 1) || (src.getSize() != dst.getSize()) ||
+        (src.getMap().getRankList().getNumRanks() != 1) ||
+        (dst.getMap().getRankList().getNumRanks() != 1))
+          return;
+
+    PvtolProgram   prog;
+    TaskBase      &ct      = prog.getCurrentTask();
+    ProcId         srcProc = src.getMap().getRankList().getRank(0);
+    ProcId         dstProc = dst.getMap().getRankList().getRank(0);
+
+    if (srcProc == dstProc)
+          return;
+
+    //   every thread of a process runs setupComplete, but the collectives
+    //   are made once per process, by its first thread. What it decides
+    //   lives in this Conduit and in the first endpoints, which all the
+    //   threads share; the barrier publishes it before any finalSetup
+    Barrier   bar;
+    if (ct.getLocalThreadRank() == 0)
+          mapShmXfer(src, dst, useTag);
+    bar.synch();
+#else
+    (void)src;
+    (void)dst;
+    (void)useTag;
+#endif // _STANDARD_MPI && __linux__ && MPI-3
+    return;
+}//end setupShmXfer()
+
+//------------------------------------------------------------------------
+//  Method:     mapShmXfer
+//
+//  Description: The collective part of setupShmXfer, made by the first
+//               thread of each process. If the src and dst processes
+//               share a host, the src creates a segment of the slots,
+//               the dst maps it, and both endpoints are rebound to it
+//
+//  Inputs: the src & dst endpoints, whether the Conduit has tags
+//  Returns: void
+//
+//------------------------------------------------------------------------
+template <class DATATYPE, class TAGTYPE, bool USE_EOC>
+void Conduit<DATATYPE, TAGTYPE, USE_EOC>::mapShmXfer(EndpointX &src,
+                                                     EndpointX &dst,
+                                                     bool useTag)
+{
+#if defined(_STANDARD_MPI) && defined(__linux__) && (MPI_VERSION >= 3)
+    typedef TagSeqNumWrapper<TAGTYPE, USE_EOC>  TagWrapper;
+
+    PvtolProgram   prog;
+    TaskBase      &ct      = prog.getCurrentTask();
+    CommScope     &cs      = ct.getCommScope();
+    MPI_Comm       comm    = cs.comm();
+    ProcId         myProc  = prog.getProcId();
+    ProcId         srcProc = src.getMap().getRankList().getRank(0);
+    ProcId         dstProc = dst.getMap().getRankList().getRank(0);
+
+    //   the CommScope works the host map out once, for every Conduit
+    const vector<int>  &hosts = cs.getHostRanks();
+    int   srcRank = cs.rank(srcProc);
+    int   dstRank = cs.rank(dstProc);
+    if (hosts[srcRank] != hosts[dstRank])
+          return;
+
+    //   both ends get the larger depth, at least 2 as for a local xfer
+    int   depth = (src.getDepth() > dst.getDepth()) ? src.getDepth()
+                                                    : dst.getDepth();
+    if (depth < 2)
+          depth = 2;
+
+    size_t   slotBytes = src.getSize() * sizeof(typename DATATYPE::ElType);
+    size_t   tagBytes  = (USE_EOC || useTag) ? depth * sizeof(TagWrapper) : 0;
+    tagBytes = (tagBytes + sizeof(double) - 1) & ~(sizeof(double) - 1);
+    size_t   auxBytes  = tagBytes + (USE_EOC ? depth * sizeof(SeqNum) : 0);
+
+    //   the src creates the segment and tells everyone its name; the dst
+    //   maps it; then all agree whether both ends have it
+    ShmXferSegment  *seg     = new ShmXferSegment;
+    int              info[3] = {0, 0, 0};
+    if (myProc == srcProc)
+      {
+        info[1] = getpid();
+        info[2] = ShmXferSegment::nextTag();
+        info[0] = src.isBlockInternal() &&
+                  seg->create(ShmXferSegment::makeName(m_name, info[1],
+                                                       info[2]),
+                              depth, slotBytes, auxBytes);
+      }
+    MPI_Bcast(info, 3, MPI_INT, srcRank, comm);
+
+    int   ok = info[0];
+    if (ok && (myProc == dstProc))
+      {
+        ok = dst.isBlockInternal() &&
+             seg->open(ShmXferSegment::makeName(m_name, info[1], info[2]),
+                       depth, slotBytes, auxBytes);
+      }
+    int   allOk;
+    MPI_Allreduce(&ok, &allOk, 1, MPI_INT, MPI_MIN, comm);
+
+    //   the dst has it mapped, or never will
+    seg->unlink();
+    if (!allOk)
+      {
+        delete seg;
+        return;
+      }
+
+    //   every processor marks both endpoints, so that none builds a Route
+    m_doShmXfer   = true;
+    m_doLocalXfer = true;
+    src.setDepth(depth);
+    dst.setDepth(depth);
+    src.setLocalXfer(true);
+    dst.setLocalXfer(true);
+
+    if ((myProc != srcProc) && (myProc != dstProc))
+      {
+        delete seg;
+        return;
+      }
+
+    EndpointX   &mine = (myProc == srcProc) ? src : dst;
+    char        *aux  = (char *)seg->getAux();
+    SeqNum      *eocs = (SeqNum *)(aux + tagBytes);
+
+    //   finalSetup clears the tags' sequence numbers; the EOCs are the
+    //   src's to clear, and the dst reads none before the barrier
+    if (USE_EOC && (myProc == srcProc))
+      {
+        for (int i=0; i<depth; i++)
+                  eocs[i] = -1;
+      }
+
+    mine.rebindDdo((typename DATATYPE::ElType *)seg->getData());
+    if (USE_EOC || useTag)
+          mine.rebindTagBuff((TagWrapper *)aux);
+    if (USE_EOC)
+      {
+        vector<SeqNum * >   ebs(1, eocs);
+        mine.setEocBlocks(ebs);
+      }
+
+    m_shmSeg   = seg;
+    m_xferRing = &(seg->getRing());
+    m_depth    = depth;
+#else
+    (void)src;
+    (void)dst;
+    (void)useTag;
+#endif // _STANDARD_MPI && __linux__ && MPI-3
+    return;
+}//end mapShmXfer()
+
+
+//------------------------------------------------------------------------
+//  Method:     lockSlots
+//
+//  Description: Prefaults this thread's ends' slots and locks them into
+//               memory, so that they are placed near the thread which
+//               uses them and the first frames take no page faults. An
+//               end locks only the slots it allocated; where a src and
+//               dst share slots within a process, their owner locks
+//               them. Slots shared between processes are the segment's
+//               own pages, and the end in this process locks them
+//
+//  Inputs: none
+//  Returns: void
+//
+//------------------------------------------------------------------------
+template <class DATATYPE, class TAGTYPE, bool USE_EOC>
+void Conduit<DATATYPE, TAGTYPE, USE_EOC>::lockSlots()
+{
+    ConduitThreadInfo *myinfo = (ConduitThreadInfo *)getThreadInfo();
+    EndpointX         *mine = NULL;
+
+    if (myinfo->m_srcInitialized && myinfo->m_src.isLocal())
+      {
+        myinfo->m_src.lockSlots(m_name + " src");
+        mine = &(myinfo->m_src);
+      }
+    if (myinfo->m_dstInitialized && myinfo->m_dst.isLocal())
+      {
+        myinfo->m_dst.lockSlots(m_name + " dst");
+        mine = &(myinfo->m_dst);
+      }
+
+    if ((m_shmSeg != NULL) && (mine != NULL) && (m_shmLocked == 0))
+      {
+        size_t   bytes = size_t(mine->getDepth()) * mine->getSlotSize() *
+                         sizeof(typename DATATYPE::ElType);
+        m_shmLocked = MemoryLock::lock(m_name + " shm", m_shmSeg->getData(),
+                                       bytes);
+      }
+
+    return;
+}//end lockSlots()
+
 
 /////////////////////////////////////////////////////////////////////////////
 // ConduitInitComm methods
@@ -1135,32 +1804,9 @@ Conduit<DATATYPE, TAGTYPE, USE_EOC>::ConduitInitComm::ConduitInitComm(
     : m_name(name),
       m_transferSize(maxSize)
 {
-    PvtolProgram   prog;
-    TaskBase      &ct = prog.getCurrentTask();
-    CommScope     &cs = ct.getCommScope();
-    int        myrank = cs.rank(cs.getProcId());
-    int numRanks      = cs.getNumProcs();
-    m_masterIsLocal   = (0 == myrank);
+    //   one descriptor is serialized here at a time
     m_initCommBuff    = new int[m_transferSize];
 
-    for( int i=1; i < numRanks; i++ )
-    {
-        Transfer* to(new Transfer(i,
-	                          reinterpret_cast<char *>(m_initCommBuff),
-                                  0,
-	                          reinterpret_cast<char *>(m_initCommBuff),
-                                  m_transferSize) );
-
-        Transfer* fm(new Transfer(0,
-	                          reinterpret_cast<char *>(m_initCommBuff),
-                                  i,
-	                          reinterpret_cast<char *>(m_initCommBuff),
-                                  m_transferSize) );
-
-        m_toMaster.push_back(to);
-        m_fromMaster.push_back(fm);
-    }
-
     return;
 }//end construct ConduitInitComm()
 
@@ -1168,19 +1814,17 @@ Conduit<DATATYPE, TAGTYPE, USE_EOC>::ConduitInitComm::ConduitInitComm(
 template< class DATATYPE, class TAGTYPE, bool USE_EOC>
 Conduit<DATATYPE, TAGTYPE, USE_EOC>::ConduitInitComm::~ConduitInitComm()
 {
-   for (unsigned int i=0; i < m_toMaster.size(); i++)
-                    delete m_toMaster[i];
-
-   for (unsigned int i=0; i < m_fromMaster.size(); i++)
-                    delete m_fromMaster[i];
-
    delete [] m_initCommBuff;
 
    return;
 }//end ~ConduitInitComm()
 
 // This method implements the protocol by which all nodes in the parent
-// task discover all the sources and destinations
+// task discover all the sources and destinations. Each process packs
+// the descriptors of the endpoints it has set up, {type, length,
+// descriptor} apiece, and one MPI_Allgatherv over the task's CommScope
+// hands every process everyone else's; an MPI_Allgather of the packed
+// lengths sizes it
 template < class DATATYPE, class TAGTYPE, bool USE_EOC>
 void Conduit<DATATYPE, TAGTYPE, USE_EOC>::ConduitInitComm::exchangeEndpoints(
                       map<NTuple, void* >& thdInfo,
@@ -1189,8 +1833,8 @@ void Conduit<DATATYPE, TAGTYPE, USE_EOC>::ConduitInitComm::exchangeEndpoints(
     PvtolProgram   prog;
     int      myprocid = prog.getProcId();
     TaskBase      &ct = prog.getCurrentTask();
-    int      numprocs = prog.numProcs();
     CommScope     &cs = ct.getCommScope();
+    int      numRanks = cs.getNumProcs();
     int    myProcRank = cs.rank(cs.getProcId());
     int  myLocThdRank = ct.getLocalThreadRank();
 #ifdef _DEBUG_2
@@ -1202,285 +1846,122 @@ void Conduit<DATATYPE, TAGTYPE, USE_EOC>::ConduitInitComm::exchangeEndpoints(
             procId, taskid, threadid);
 #endif // _DEBUG_2
 
-    EndpointDescript<DATATYPE, TAGTYPE, USE_EOC> endpointDescript;
-    int numMessages;
-    int maxMsgSize;
-    int *msgBuff;
+    if (myLocThdRank != 0)
+            return;
 
-    EPtype epType;
+    EndpointDescript<DATATYPE, TAGTYPE, USE_EOC> endpointDescript;
+    map<NTuple, void* >::iterator ita;
+    vector<int>    packed;
 
-    for (int n=0; n<2; n++) {
-      if (n == 0)
-            epType = EndpointX::SOURCE;
-       else
-            epType = EndpointX::DEST;
-
-      if (m_masterIsLocal && (myLocThdRank == 0))
-        {
-          // receive from everyone except myself in order
-          // this code assumes master is index 0, which is no loss because
-          // that is already assumed by the code which constructs the
-          // toMaster and fromMaster transfers
-          for (int recvProc = 1; recvProc < numprocs; recvProc++) {
-            // since 0 is the master, there is no transfer corresponding to it,
-            // so our the transfer from recvNode is in recvNode - 1
-            m_toMaster[recvProc - 1]->send(2*sizeof(int));
-
-            msgBuff      = beginLocal();
-            numMessages  = msgBuff[0];
-	    maxMsgSize   = msgBuff[1];
+    for (ita=thdInfo.begin(); ita != thdInfo.end(); ita++) {
+          ConduitThreadInfo *ctip = (ConduitThreadInfo *)(*ita).second;
+          for (int n=0; n<2; n++) {
+             EndpointX  &ep     = (n == 0) ? ctip->m_src : ctip->m_dst;
+             bool        inited = (n == 0) ? ctip->m_srcInitialized
+                                           : ctip->m_dstInitialized;
+             if (!ep.isInitialized() || !inited)
+                        continue;
+
+             if (myprocid == ep.procId())
+                        ep.calcSetupCompleteRanks();
+
+             ep.getDescript(endpointDescript);
+             endpointDescript.setNumReplicas(1);
+             endpointDescript.setReplicaRank(0);
+             int  *end = endpointDescript.serialize(beginLocal());
+             int   len = end - beginLocal();
 
 #ifdef PVTOL_DEVELOP
-	    if (m_transferSize < maxMsgSize)
-	      {
-                throw Exception("ConduitInitComm: Msg Size too big! ",
-                                __FILE__, __LINE__);
-	      }
+	     if (len > m_transferSize)
+	       {
+                 throw Exception("ConduitInitComm: Msg Size too big! ",
+                                 __FILE__, __LINE__);
+	       }
 #endif // PVTOL_DEVELOP
-            for (int i = 0; i < numMessages; i++) {
-                // since 0 is the master, there is no transfer corresponding
-                // to it, so our the transfer from recvNode is in recvNode - 1
-                m_toMaster[recvProc - 1]->send(size());
-
-                endpointDescript.deserialize(beginLocal());
-
-		TaskId eptask = endpointDescript.getTaskId();
-		int  epthread = endpointDescript.getThreadId();
-		int  epprocid = endpointDescript.getProcId();
-
-                int   maxLens[] = {MAX_PROCS, MAX_TASKS, MAX_THREADS};
-                NTuple  mapKey(3, maxLens);
-                mapKey[0] = epprocid;
-                mapKey[1] = eptask;
-                mapKey[2] = epthread;
-
-                if (thdInfo.count(mapKey) == 0)
-		  {
-                    (thdInfo[mapKey]) = (void *)new ConduitThreadInfo;
-		  }
-
-                // put this endpoint in its proper place
-		if ((epType == EndpointX::SOURCE)                  &&
-	            (!(((ConduitThreadInfo *)(thdInfo[mapKey]))->m_src.isInitialized())) &&
-		    (!(((ConduitThreadInfo *)(thdInfo[mapKey]))->m_srcInitialized)))
-		  {
-		    ((ConduitThreadInfo *)
-		         (thdInfo[mapKey]))->m_src.setup(
-                                                   endpointDescript, epType);
-	          ((ConduitThreadInfo *)
-		     (thdInfo[mapKey]))->m_srcInitialized = true;
-	          ((ConduitThreadInfo *)
-		     (thdInfo[mapKey]))->m_srcSetup = true;
-		  }
-
-	         if ((epType == EndpointX::DEST)                   &&	
-	            (!(((ConduitThreadInfo *)(thdInfo[mapKey]))->m_dst.isInitialized())) &&
-		    (!(((ConduitThreadInfo *)(thdInfo[mapKey]))->m_dstInitialized)))
-		  {
-		    ((ConduitThreadInfo *)
-		         (thdInfo[mapKey]))->m_dst.setup(
-                                                   endpointDescript, epType);
-	          ((ConduitThreadInfo *)
-		     (thdInfo[mapKey]))->m_dstInitialized = true;
-	          ((ConduitThreadInfo *)
-		     (thdInfo[mapKey]))->m_dstSetup = true;
-		  }
-            }//endFor each msg
-          }//endFor each rcv node
-
-          map<NTuple, void* >::iterator ita;
-          numMessages = 0;
-
-          for (ita=thdInfo.begin(); ita != thdInfo.end(); ita++) {
-                ConduitThreadInfo *ctip = (ConduitThreadInfo *)(*ita).second;
-		if (epType == EndpointX::SOURCE)
-		  {
-	            if (ctip->m_src.isInitialized() && ctip->m_srcInitialized)
-	                             ++numMessages;
-		  }
-                 else
-		  {
-	            if (ctip->m_dst.isInitialized() && ctip->m_dstInitialized)
-	                             ++numMessages;
-		  }
-          }//endfor ita
+             packed.push_back((n == 0) ? EndpointX::SOURCE : EndpointX::DEST);
+             packed.push_back(len);
+             packed.insert(packed.end(), beginLocal(), end);
+          }//endFor src & dest
+    }//endfor ita
 
-          // Send all the endpoint information to each node besides the master
-          // (besides me)
-          for (int sendProc = 1; sendProc < ct.getNumProcesses(); sendProc++)
-          {
-            // send the number of msgs to expect
-            msgBuff    = beginLocal();
-            msgBuff[0] = numMessages;
-	    msgBuff[1] = m_transferSize;
-
-            m_fromMaster[sendProc - 1]->send(2*sizeof(int));
-
-            for (ita=thdInfo.begin(); ita != thdInfo.end(); ita++) {
-                  ConduitThreadInfo *ctip = (ConduitThreadInfo *)(*ita).second;
-	  	  if (epType == EndpointX::SOURCE)
-		    {
-	              if (ctip->m_src.isInitialized() && ctip->m_srcInitialized)
-		        {
-                          if (myprocid == ctip->m_src.procId())
-			                ctip->m_src.calcSetupCompleteRanks();
-
-                          ctip->m_src.getDescript(endpointDescript);
-                          endpointDescript.setNumReplicas(1);
-                          endpointDescript.setReplicaRank(0);
-                          endpointDescript.serialize(beginLocal());
-                          m_fromMaster[sendProc - 1]->send(m_transferSize);
-			}
-		    }
-                   else
-		    {
-	              if (ctip->m_dst.isInitialized() && ctip->m_dstInitialized)
-		        {
-                          if (myprocid == ctip->m_dst.procId())
-			                ctip->m_dst.calcSetupCompleteRanks();
-
-                          ctip->m_dst.getDescript(endpointDescript);
-                          endpointDescript.setNumReplicas(1);
-                          endpointDescript.setReplicaRank(0);
-                          endpointDescript.serialize(beginLocal());
-                          m_fromMaster[sendProc - 1]->send(m_transferSize);
-			}
-		    }
-            }//endfor ita
-          }//endFor each send Node
-        }
-      else if (myLocThdRank == 0)
-        {
-          // count the number of messages to send to the comm master
-          map<NTuple, void* >::iterator ita;
-          numMessages = 0;
-
-          for (ita=thdInfo.begin(); ita != thdInfo.end(); ita++) {
-                ConduitThreadInfo *ctip = (ConduitThreadInfo *)(*ita).second;
-		if (epType == EndpointX::SOURCE)
-		  {
-	            if (ctip->m_src.isInitialized() && ctip->m_srcInitialized)
-	                             ++numMessages;
-		  }
-                 else
-		  {
-	            if (ctip->m_dst.isInitialized() && ctip->m_dstInitialized)
-	                             ++numMessages;
-		  }
-          }//endfor ita
-
-          // send the master a message telling it how many EndpointInfos
-          // I will send
-          msgBuff    = beginLocal();
-          msgBuff[0] = numMessages;
-	  msgBuff[1] = m_transferSize;
-
-          // since 0 is the master, there is no transfer corresponding to it,
-          // so our the transfer from myProcRank is in myProcRank - 1
-          m_toMaster[myProcRank - 1]->send(2*sizeof(int));
-
-          for (ita=thdInfo.begin(); ita != thdInfo.end(); ita++) {
-                  ConduitThreadInfo *ctip = (ConduitThreadInfo *)(*ita).second;
-	  	  if (epType == EndpointX::SOURCE)
-		    {
-	              if (ctip->m_src.isInitialized() && ctip->m_srcInitialized)
-		        {
-                          if (myprocid == ctip->m_src.procId())
-			                ctip->m_src.calcSetupCompleteRanks();
-
-                          ctip->m_src.getDescript(endpointDescript);
-                          endpointDescript.setNumReplicas(1);
-                          endpointDescript.setReplicaRank(0);
-                          endpointDescript.serialize(beginLocal());
-                          m_toMaster[myProcRank - 1]->send(m_transferSize);
-			}
-		    }
-                   else
-		    {
-	              if (ctip->m_dst.isInitialized() && ctip->m_dstInitialized)
-		        {
-                          if (myprocid == ctip->m_dst.procId())
-			                ctip->m_dst.calcSetupCompleteRanks();
-
-                          ctip->m_dst.getDescript(endpointDescript);
-                          endpointDescript.setNumReplicas(1);
-                          endpointDescript.setReplicaRank(0);
-                          endpointDescript.serialize(beginLocal());
-                          m_toMaster[myProcRank - 1]->send(m_transferSize);
-			}
-		    }
-          }//endfor ita
-        
-          // now, receive the entire set of endpoints from the master
-          m_fromMaster[myProcRank - 1]->send(2*sizeof(int));
-
-          msgBuff      = beginLocal();
-          numMessages  = msgBuff[0];
-	  maxMsgSize   = msgBuff[1];
+    int            myCount = packed.size();
+    vector<int>    counts(numRanks);
+    vector<int>    displs(numRanks);
+    MPI_Allgather(&myCount, 1, MPI_INT, &counts[0], 1, MPI_INT, cs.comm());
 
-#ifdef PVTOL_DEVELOP
-	  if (m_transferSize < maxMsgSize)
-	    {
-              throw Exception("ConduitInitComm: Msg Size too big! ",
-                                __FILE__, __LINE__);
-	    }
-#endif // PVTOL_DEVELOP
-          for (int i = 0; i < numMessages; i++) {
-              // since 0 is the master, there is no transfer corresponding
-              // to it, so our the transfer from recvNode is in recvNode - 1
-              m_fromMaster[myProcRank - 1]->send(size());
+    int   total = 0;
+    for (int r = 0; r < numRanks; r++) {
+        displs[r] = total;
+        total    += counts[r];
+    }//endFor each rank
 
-              endpointDescript.deserialize(beginLocal());
+    //   neither buffer may be empty, even if no one has an endpoint
+    packed.push_back(0);
+    vector<int>    all(total + 1);
+    MPI_Allgatherv(&packed[0], myCount, MPI_INT,
+                   &all[0], &counts[0], &displs[0], MPI_INT, cs.comm());
 
-	      TaskId eptask = endpointDescript.getTaskId();
-	      int  epthread = endpointDescript.getThreadId();
-	      int  epprocid = endpointDescript.getProcId();
+    //   place all the sources before any of the destinations
+    for (int n=0; n<2; n++) {
+      EPtype epType = (n == 0) ? EndpointX::SOURCE : EndpointX::DEST;
+
+      for (int r = 0; r < numRanks; r++) {
+        if (r == myProcRank)
+                  continue;
+
+        int   pos = displs[r];
+        while (pos < displs[r] + counts[r]) {
+            EPtype  type = (EPtype)all[pos];
+            int     len  = all[pos + 1];
+            pos += 2;
+            if (type != epType)
+              {
+                pos += len;
+                continue;
+              }
+
+            endpointDescript.deserialize(&all[pos]);
+            pos += len;
+
+	    TaskId eptask = endpointDescript.getTaskId();
+	    int  epthread = endpointDescript.getThreadId();
+	    int  epprocid = endpointDescript.getProcId();
+
+            int   maxLens[] = {MAX_PROCS, MAX_TASKS, MAX_THREADS};
+            NTuple  mapKey(3, maxLens);
+            mapKey[0] = epprocid;
+            mapKey[1] = eptask;
+            mapKey[2] = epthread;
+
+            if (thdInfo.count(mapKey) == 0)
+	      {
+                (thdInfo[mapKey]) = (void *)new ConduitThreadInfo;
+	      }
+            ConduitThreadInfo *ctip = (ConduitThreadInfo *)(thdInfo[mapKey]);
 
-              int   maxLens[] = {MAX_PROCS, MAX_TASKS, MAX_THREADS};
-              NTuple  mapKey(3, maxLens);
-              mapKey[0] = epprocid;
-              mapKey[1] = eptask;
-              mapKey[2] = epthread;
+            // put this endpoint in its proper place
+	    if ((epType == EndpointX::SOURCE)      &&
+	        (!ctip->m_src.isInitialized())     &&
+	        (!ctip->m_srcInitialized))
+	      {
+	        ctip->m_src.setup(endpointDescript, epType);
+	        ctip->m_srcInitialized = true;
+	        ctip->m_srcSetup       = true;
+	      }
 
-              if (thdInfo.count(mapKey) == 0)
-	        {
-                  (thdInfo[mapKey]) = (void *)new ConduitThreadInfo;
-		}
-                
-              // put this endpoint in its proper place
-	      if ((epType == EndpointX::SOURCE)                  &&
-	          (!(((ConduitThreadInfo *)(thdInfo[mapKey]))->m_src.isInitialized())) &&
-		  (!(((ConduitThreadInfo *)(thdInfo[mapKey]))->m_srcInitialized)))
-	        {
-	          ((ConduitThreadInfo *)
-		        (thdInfo[mapKey]))->m_src.setup(
-                                                  endpointDescript, epType);
-	          ((ConduitThreadInfo *)
-		     (thdInfo[mapKey]))->m_srcInitialized = true;
-	          ((ConduitThreadInfo *)
-		     (thdInfo[mapKey]))->m_srcSetup = true;
-	        }
-
-	      if ((epType == EndpointX::DEST)                   &&	
-	          (!(((ConduitThreadInfo *)(thdInfo[mapKey]))->m_dst.isInitialized())) &&
-		  (!(((ConduitThreadInfo *)(thdInfo[mapKey]))->m_dstInitialized)))
-	        {
-	          ((ConduitThreadInfo *)
-		         (thdInfo[mapKey]))->m_dst.setup(
-                                                   endpointDescript, epType);
-	          ((ConduitThreadInfo *)
-		     (thdInfo[mapKey]))->m_dstInitialized = true;
-	          ((ConduitThreadInfo *)
-		     (thdInfo[mapKey]))->m_dstSetup = true;
-	        }
-          }//endFor each msg
-
-        }//endIf master is local
+	    if ((epType == EndpointX::DEST)        &&
+	        (!ctip->m_dst.isInitialized())     &&
+	        (!ctip->m_dstInitialized))
+	      {
+	        ctip->m_dst.setup(endpointDescript, epType);
+	        ctip->m_dstInitialized = true;
+	        ctip->m_dstSetup       = true;
+	      }
+        }//endWhile each endpoint of rank r
+      }//endFor each rank
     }//endFor Src & Dest
 
 #ifdef _DEBUG_2
-    map<TaskId, map<int, void* > >::iterator ita;
-
     sleep(procId * 3);
     cout << prefix << "at end of exchgEP" << endl;
     for (ita=thdInfo.begin(); ita != thdInfo.end(); ita++) {
@@ -1492,7 +1973,6 @@ void Conduit<DATATYPE, TAGTYPE, USE_EOC>::ConduitInitComm::exchangeEndpoints(
                << ", dstSetup=" << ctip->m_dstSetup << endl;
 	  cout << ctip->m_src << endl;
 	  cout << ctip->m_dst << endl;
-       }//endfor itb
     }//endfor ita
 #endif // _DEBUG_2
 
@@ -1509,7 +1989,9 @@ Conduit<DATATYPE, TAGTYPE, USE_EOC>::ConduitThreadInfo::ConduitThreadInfo()
     : m_srcInitialized(false),
       m_srcSetup(false),
       m_dstInitialized(false),
-      m_dstSetup(false)
+      m_dstSetup(false),
+      m_extractOpen(false),
+      m_ringDrops(0)
 {
     return;
 }//end construct ConduitThreadInfo()
@@ -22,6 +22,7 @@
 #include <PvtolBasics.h>
 #include <Transfer.h>
 #include <Route.h>
+#include <PvtolRequest.h>
 #include <Conduit.h>
 #include <ConduitEndpoint.h>
 #include <ConduitSendManager.h>
@@ -49,6 +50,34 @@ namespace ipvtol
 // This class provides the point-to-point connection(s) for each mode.
 // Each mode will have one Connection object for every source/destination
 // pair that needs to communicate.
+//
+// When the Conduit is built with the FUSED_TAG or VARIABLE_SIZE flag,
+// and the frame goes from one processor to one processor without a
+// transpose, each frame is packed into one message:
+//
+//     | FrameHeader | tag & sequence number | pad | valid data |
+//
+// so the receiver completes with one request, and only the valid part
+// of a VARIABLE_SIZE frame is moved. A FUSED_TAG frame larger than
+// FUSED_TAG_MAX_BYTES still uses separate messages, since for it the
+// packing copies cost more than the extra message. A VARIABLE_SIZE
+// frame larger than the slot is announced by its header and its data
+// follows in a message of its own (a rendezvous).
+//
+// When the source asked for batches of n frames (Endpoint::setBatch),
+// and the frames cross processors, n consecutive packed frames go as one
+// message. Both depths are multiples of n, so a batch's slots are
+// contiguous at both ends; the batch is sent, and its receive posted,
+// by its last frame and completes with one request.
+//
+// When the Conduit distributes LoadAware to replicated destinations,
+// every frame is packed, and its header carries the source's number for
+// the frame so that a downstream merge can restore the order. Each
+// destination returns a credit, its count of frames released, to the
+// source on a tag of its own; the source sends each frame to the
+// destination with the most credit (Endpoint::chooseConnection).
+// With a single destination, or without Support_Replicated, a LoadAware
+// Conduit sends its frames unpacked, as a RoundRobin one does.
 
 template <class DATATYPE, class TAGTYPE, bool USE_EOC>
 class Connection
@@ -57,6 +86,20 @@ class Connection
     typedef Endpoint<DATATYPE, TAGTYPE, USE_EOC> EndpointX;
     typedef DataTagSender<DATATYPE, TAGTYPE, USE_EOC> DataTagSenderX;
     typedef EocSender<DATATYPE, TAGTYPE, USE_EOC> EocSenderX;
+    typedef TagSeqNumWrapper<TAGTYPE, USE_EOC> TagWrapperX;
+
+    static const int FUSED_TAG_MAX_BYTES = 256 * 1024;
+
+    // a TREE_TAG tag is relayed in pieces of this size, so that a dst
+    //   passes on the first piece while the rest are still arriving
+    static const int TREE_TAG_CHUNK_BYTES = 64 * 1024;
+
+    struct FrameHeader
+      {
+        int   validLength;   // elements of valid data
+        int   srcSlot;       // sender's slot, used for oversize frames
+        int   seqNum;        // sender's frame number
+      };
 
     Connection(EndpointX & src,   // Local Xfer Constructor
 	       EndpointX & dst);
@@ -72,9 +115,14 @@ class Connection
     inline bool srcLocal();
     inline bool dstLocal();
     inline int  getDataSize();
+    inline bool packFrames() const;
+    inline Transfer & getPackTransfer();
+    inline int  getBatch() const;
+    inline int  nextDispatchSeqNum();
 
     inline vector< shared_ptr<Transfer> > & getTagTransfers();
     inline vector< pair<int, int> >       & getTagTransferNodeList();
+    inline const vector<int>              & getTagTransferRelayList() const;
 
     inline vector< shared_ptr<Transfer> > & getEocTransfers();
     inline vector< pair<int, int> >       & getEocTransferNodeList();
@@ -113,12 +161,37 @@ class Connection
         unsigned srcBufferIndex,
         unsigned dstBufferIndex);
 
+    void sendPacked(
+        SendRequest & srq,
+        unsigned srcBufferIndex,
+        unsigned dstBufferIndex);
+
+    void unpackFrame(unsigned dstBufferIndex);
+
+    bool batchDone(unsigned srcBufferIndex,
+                   unsigned dstBufferIndex,
+                   bool wait);
+
+    void flushBatch();
+
+    bool oversizeDone(unsigned srcBufferIndex,
+                      unsigned dstBufferIndex,
+                      bool wait);
+
+    int  credit();
+    void returnCredit();
+
     inline const vector<unsigned> & getSeqNumLocalDstIndex() const;
 
     inline EndpointX & getSrcEndpoint();
     inline EndpointX & getDstEndpoint();
 
   private:
+    int         packFrame(unsigned srcBufferIndex);
+    void        startBatch(int first, int last, int dstFirst, int lastCount);
+    void        batchArrived(int first);
+    void        buildTagTree(EndpointX & src, EndpointX & dst);
+
     EndpointX                      & m_src;
     EndpointX                      & m_dst;
     bool                            m_srcProcLocal;
@@ -130,6 +203,55 @@ class Connection
     vector< shared_ptr<Transfer> >  m_tagTransfers;
     vector< shared_ptr<SendManager<DataTagSenderX> > > m_sendManagers;
 
+    bool                            m_treeTag;       // tags relayed by dsts
+    vector<int>                     m_tagRelayOf;    // per tag transfer, the
+                                                     //  one bringing its
+                                                     //  piece to the sender,
+                                                     //  -1 from the src
+    vector<int>                     m_tagChunkOffset; // bytes into the tag
+    vector<int>                     m_tagChunkBytes;
+
+    bool                            m_packFrames;
+    bool                            m_packCarriesTag;
+    int                             m_packTagOffset;
+    int                             m_packDataOffset;
+    int                             m_packFrameBytes;
+    char                           *m_packSrcBuff;  // packed frames
+    char                           *m_packDstBuff;
+    shared_ptr<Transfer>            m_packTransfer;
+
+    int                             m_srcProcRank;
+    int                             m_dstProcRank;
+    vector<int>                     m_oversizeTags;  // one per dst slot
+    PvtolRequest                   *m_oversizeReqs;  // one per local slot
+    vector<bool>                    m_oversizePending;
+
+    int                             m_batch;         // frames per message
+    vector< shared_ptr<Transfer> >  m_batchTransfers; // one per dst batch,
+                                                     //  each on its own tag
+    vector< shared_ptr<SendRequest> > m_batchReqs;   // per local slot, for
+                                                     //  the message it leads
+    vector<int>                     m_batchFirst;    // per local slot, first
+                                                     //  slot of its message,
+                                                     //  -1 until started
+    vector<int>                     m_batchLen;      // per message's first
+                                                     //  slot, its frames
+    vector<bool>                    m_batchSlotDone; // per local slot
+    vector<int>                     m_batchNext;     // per src batch, first
+                                                     //  frame not yet sent
+    int                             m_lastSrcSlot;   // newest packed frame,
+    int                             m_lastDstSlot;   //  for flushBatch()
+    int                             m_lastCount;
+
+    bool                            m_loadAware;     // credits steer sends
+    int                             m_creditTag;
+    int                             m_creditBuff;    // credit message
+    PvtolRequest                    m_creditReq;     // src recv, dst send
+    bool                            m_creditPending;
+    int                             m_released;      // frames the dst freed
+    int                             m_dispatched;    // frames sent the dst
+    int                             m_dispatchSeqNum;
+
     RingIndex                       m_mgrsSendIndex;
     RingIndex                       m_mgrsRecvIndex;
     RingIndex                       m_srcBufferIndex;
@@ -137,6 +259,7 @@ class Connection
 
     vector< shared_ptr<SendManager<EocSenderX> > > m_eocSendManagers;
     vector< shared_ptr<Transfer> >  m_eocTransfers;
+    vector< pair<int, int> >        m_eocNodePairs;
     RingIndex                       m_eocMgrsSendIndex;
     RingIndex                       m_eocMgrsRecvIndex;
     RingIndex                       m_eocSrcBufferIndex;
@@ -170,6 +293,35 @@ Connection<DATATYPE, TAGTYPE, USE_EOC>::getDataSize()
     return m_dataSize;
 }
 
+template <class DATATYPE, class TAGTYPE, bool USE_EOC>
+inline bool
+Connection<DATATYPE, TAGTYPE, USE_EOC>::packFrames() const
+{
+    return m_packFrames;
+}
+
+template <class DATATYPE, class TAGTYPE, bool USE_EOC>
+inline Transfer &
+Connection<DATATYPE, TAGTYPE, USE_EOC>::getPackTransfer()
+{
+    return *m_packTransfer;
+}
+
+template <class DATATYPE, class TAGTYPE, bool USE_EOC>
+inline int
+Connection<DATATYPE, TAGTYPE, USE_EOC>::getBatch() const
+{
+    return m_batch;
+}
+
+template <class DATATYPE, class TAGTYPE, bool USE_EOC>
+inline int
+Connection<DATATYPE, TAGTYPE, USE_EOC>::nextDispatchSeqNum()
+{
+    // frames and EOCs sent this connection's dst, in order
+    return m_dispatchSeqNum++;
+}
+
 template <class DATATYPE, class TAGTYPE, bool USE_EOC>
 inline vector< shared_ptr<Transfer> > &
 Connection<DATATYPE, TAGTYPE, USE_EOC>::getTagTransfers()
@@ -184,6 +336,14 @@ Connection<DATATYPE, TAGTYPE, USE_EOC>::getTagTransferNodeList()
     return m_tagNodePairs;
 }
 
+template <class DATATYPE, class TAGTYPE, bool USE_EOC>
+inline const vector<int> &
+Connection<DATATYPE, TAGTYPE, USE_EOC>::getTagTransferRelayList() const
+{
+    // empty unless the tags go down a tree
+    return m_tagRelayOf;
+}
+
 template <class DATATYPE, class TAGTYPE, bool USE_EOC>
 inline vector< shared_ptr<Transfer> > &
 Connection<DATATYPE, TAGTYPE, USE_EOC>::getEocTransfers()
@@ -195,8 +355,9 @@ template <class DATATYPE, class TAGTYPE, bool USE_EOC>
 inline vector< pair<int, int> > &
 Connection<DATATYPE, TAGTYPE, USE_EOC>::getEocTransferNodeList()
 {
-    // EOCs follow the same node-to-node paths as tags
-    return m_tagNodePairs;
+    // EOCs go straight from the src to each dst, even when the tags
+    //   are relayed; the sequence numbers keep them behind the frames
+    return m_eocNodePairs;
 }
 
 template <class DATATYPE, class TAGTYPE, bool USE_EOC>
@@ -248,6 +409,19 @@ inline void Connection<DATATYPE, TAGTYPE, USE_EOC>::sendTag(
                                                 unsigned srcBufferIndex,
                                                 unsigned dstBufferIndex)
 {
+    if (m_treeTag)
+      {// a piece of the tag, from the src's slot or a relaying dst's
+        unsigned fromSlot = (m_tagRelayOf[tagTransferIndex] < 0) ?
+                                 srcBufferIndex : dstBufferIndex;
+        int      offset   = m_tagChunkOffset[tagTransferIndex];
+        this->m_tagTransfers[tagTransferIndex]->isend(
+                            m_tagChunkBytes[tagTransferIndex],
+                            fromSlot * sizeof(TagWrapperX) + offset,
+                            dstBufferIndex * sizeof(TagWrapperX) + offset,
+                            srq);
+        return;
+      }
+
     // Note: since the size of a tag is 1 item, the index into the buffer
     // is the same as the offset into the block, as below
     this->m_tagTransfers[tagTransferIndex]->isend(srcBufferIndex, dstBufferIndex,
@@ -27,6 +27,7 @@
 using boost::scoped_array;
 
 #include <stdio.h>
+#include <string.h>
 #include <utility>
 
 #define PVTOL_DEBUG_1
@@ -44,7 +45,29 @@ Connection<DATATYPE, TAGTYPE, USE_EOC>::Connection(
         m_dst(dst),
 	m_dataSize(0),
 	m_dataStaysInPlace(src.getLocalXfer() && dst.getLocalXfer()),
-	m_spRoute(NULL)
+	m_spRoute(NULL),
+	m_treeTag(false),
+	m_packFrames(false),
+	m_packCarriesTag(USE_EOC || useTag),
+	m_packTagOffset(0),
+	m_packDataOffset(0),
+	m_packFrameBytes(0),
+	m_packSrcBuff(NULL),
+	m_packDstBuff(NULL),
+	m_srcProcRank(-1),
+	m_dstProcRank(-1),
+	m_oversizeReqs(NULL),
+	m_batch(1),
+	m_lastSrcSlot(-1),
+	m_lastDstSlot(-1),
+	m_lastCount(0),
+	m_loadAware(false),
+	m_creditTag(-1),
+	m_creditBuff(0),
+	m_creditPending(false),
+	m_released(0),
+	m_dispatched(0),
+	m_dispatchSeqNum(0)
 {
     m_srcProcLocal = localResponsibilities(src);
     m_dstProcLocal = localResponsibilities(dst);
@@ -63,7 +86,165 @@ Connection<DATATYPE, TAGTYPE, USE_EOC>::Connection(
     unsigned int maxOutstanding = 0;
     if (!m_dataStaysInPlace)
       {// there is some data movement
-        if (m_src.m_depth > 1 || m_dst.m_depth > 1)
+        // A frame can be packed into one message only when the Route
+        //   would be a single contiguous copy, from one processor to one.
+        //   Every input here is SPMD, so all processors agree.
+        int  dataBytes = m_dataSize * sizeof(typename EndpointX::ElType);
+        bool oneToOne  = !(flags & Route::TRANSPOSED) &&
+                         src.getSize() == dst.getSize() &&
+                         src.getProcList().size() == 1 &&
+                         dst.getProcList().size() == 1 &&
+                         src.getSetupCompleteRanks().size() == 1 &&
+                         dst.getSetupCompleteRanks().size() == 1;
+
+        int  batch     = src.getBatch();
+
+        if (batch > 1)
+          {
+            if (!oneToOne)
+              {
+                throw Exception("Connection: batching needs an "
+                                "untransposed, one processor to one "
+                                "processor Conduit", __FILE__, __LINE__);
+              }
+            if ((src.m_depth % batch) != 0 || (dst.m_depth % batch) != 0 ||
+                src.m_depth < 2 * batch || dst.m_depth < 2 * batch)
+              {
+                throw Exception("Connection: both depths must be multiples "
+                                "of the batch size, and at least twice it",
+                                __FILE__, __LINE__);
+              }
+          }
+
+        if (flags & Route::VARIABLE_SIZE)
+          {
+            if (!oneToOne)
+              {
+                throw Exception("Connection: VARIABLE_SIZE needs an "
+                                "untransposed, one processor to one "
+                                "processor Conduit", __FILE__, __LINE__);
+              }
+            m_packFrames = true;
+          }
+         else if (flags & Route::FUSED_TAG)
+          {
+            m_packFrames = oneToOne && m_packCarriesTag &&
+                           dataBytes <= FUSED_TAG_MAX_BYTES;
+          }
+
+        // a replica's frame number travels in its header; an
+        //   unreplicated dst is sent every frame and needs no header
+        if (src.isLoadAware() && dst.m_numInCommGroup > 1)
+          {
+            if (!oneToOne || batch > 1)
+              {
+                throw Exception("Connection: LoadAware distribution needs "
+                                "an untransposed, one processor to one "
+                                "processor Conduit without batching",
+                                __FILE__, __LINE__);
+              }
+            m_packFrames = true;
+          }
+
+        // a batch is a run of packed frames
+        if (batch > 1)
+            m_packFrames = true;
+
+        if (m_packFrames)
+          {
+            const int align  = sizeof(double);
+            m_packTagOffset  = sizeof(FrameHeader);
+            m_packDataOffset = m_packTagOffset;
+            if (m_packCarriesTag)
+                 m_packDataOffset += sizeof(TagWrapperX);
+            m_packDataOffset = (m_packDataOffset + align - 1) / align * align;
+            m_packFrameBytes = m_packDataOffset + dataBytes;
+
+            if (m_srcProcLocal)
+                 m_packSrcBuff = new char[m_packFrameBytes * src.m_depth];
+            if (m_dstProcLocal)
+                 m_packDstBuff = new char[m_packFrameBytes * dst.m_depth];
+
+            // one Transfer covers every slot; sendPacked() gives it the
+            //   slot's byte offset and the frame's byte count
+            int srcRank = src.getSetupCompleteRanks()[0];
+            int dstRank = dst.getSetupCompleteRanks()[0];
+            m_packTransfer.reset(
+                    new Transfer(srcRank, m_packSrcBuff,
+                                 dstRank, m_packDstBuff,
+                                 m_packFrameBytes) );
+
+            // frames larger than a slot go point to point, on a tag per
+            //   dst slot so that each receive matches its own frame
+            CommScope &cs = ct.getCommScope();
+            m_srcProcRank = cs.rank(cs.rankToProcId(srcRank));
+            m_dstProcRank = cs.rank(cs.rankToProcId(dstRank));
+            if (flags & Route::VARIABLE_SIZE)
+              {
+                for (int i = 0; i < dst.m_depth; i++)
+                    m_oversizeTags.push_back(cs.getNextTag());
+                if (m_srcProcLocal || m_dstProcLocal)
+                  {
+                    int depth = m_srcProcLocal ? src.m_depth : dst.m_depth;
+                    m_oversizeReqs = new PvtolRequest[depth];
+                    m_oversizePending.resize(depth, false);
+                  }
+              }
+
+            // within a process a batch saves no messages, so it is
+            //   only kept when the frames cross processors. Each dst
+            //   batch has a Transfer on a tag of its own, so the pieces
+            //   of a flushed batch can only match that batch's receive
+            if (batch > 1 && m_srcProcRank != m_dstProcRank)
+              {
+                for (int i = 0; i < dst.m_depth / batch; i++)
+                  {
+                    shared_ptr<Transfer>
+                        spTrans(
+                            new Transfer(srcRank, m_packSrcBuff,
+                                         dstRank, m_packDstBuff,
+                                         m_packFrameBytes) );
+                    spTrans->setTag(cs.getNextTag());
+                    m_batchTransfers.push_back(spTrans);
+                  }
+
+                if (m_srcProcLocal || m_dstProcLocal)
+                  {
+                    int depth = m_srcProcLocal ? src.m_depth : dst.m_depth;
+                    m_batch = batch;
+                    for (int i = 0; i < depth; i++)
+                      {
+                        shared_ptr<SendRequest>
+                            spReq( new SendRequest(*m_packTransfer) );
+                        m_batchReqs.push_back(spReq);
+                      }
+                    m_batchFirst.resize(depth, -1);
+                    m_batchLen.resize(depth, 0);
+                    m_batchSlotDone.resize(depth, false);
+                    m_batchNext.resize(depth / batch, 0);
+                  }
+              }
+
+            // replicated dsts report their free slots back to the src
+            if (src.isLoadAware() && dst.m_numInCommGroup > 1)
+              {
+                if (m_srcProcRank == m_dstProcRank)
+                  {
+                    throw Exception("Connection: LoadAware replicas must "
+                                    "be on other processors than the src",
+                                    __FILE__, __LINE__);
+                  }
+                m_loadAware = true;
+                m_creditTag = cs.getNextTag();
+                if (m_srcProcLocal)
+                  {
+                    cs.irecv(NULL, &m_creditBuff, sizeof(int),
+                             m_dstProcRank, m_creditTag, m_creditReq);
+                    m_creditPending = true;
+                  }
+              }
+          }
+         else if (m_src.m_depth > 1 || m_dst.m_depth > 1)
           {
             // flags = (Route::Flags)(Route::TAG_WILL_BE_SUPPLIED |
 	    // 			   (unsigned int)flags);
@@ -87,6 +268,9 @@ Connection<DATATYPE, TAGTYPE, USE_EOC>::Connection(
 
         // m_spRoute->setTag(tag);
 
+        // a packed frame's tag rides in its data message
+        m_treeTag = (flags & Route::TREE_TAG) && !m_packFrames;
+
         if (USE_EOC || useTag)
           {
             const vector<int>& srcRanks = src.getSetupCompleteRanks();
@@ -131,20 +315,25 @@ Connection<DATATYPE, TAGTYPE, USE_EOC>::Connection(
                     srcToUse = srcRanks[0];
                   }
 
-                m_tagNodePairs.push_back(std::make_pair(srcProcs[0],
+                m_eocNodePairs.push_back(std::make_pair(srcProcs[0],
 		                                        dstProcs[i]));
+                if (!m_treeTag)
+                     m_tagNodePairs.push_back(m_eocNodePairs.back());
 
-                shared_ptr<Transfer>
-                    spTrans(
-                        new Transfer(srcToUse,
-		                     reinterpret_cast<char *>(src.m_tagBlock),
-                                     dstRanks[i],
-				     reinterpret_cast<char *>(dst.m_tagBlock),
-                                     sizeof(TagSeqNumWrapper<TAGTYPE, false>)) );
+                if (!m_packFrames && !m_treeTag)
+                  {// the tag needs a message of its own
+                    shared_ptr<Transfer>
+                        spTrans(
+                            new Transfer(srcToUse,
+                                         reinterpret_cast<char *>(src.m_tagBlock),
+                                         dstRanks[i],
+                                         reinterpret_cast<char *>(dst.m_tagBlock),
+                                         sizeof(TagSeqNumWrapper<TAGTYPE, false>)) );
 
-                // spTrans->setTag(tag);
+                    // spTrans->setTag(tag);
 
-                m_tagTransfers.push_back(spTrans);
+                    m_tagTransfers.push_back(spTrans);
+                  }
 
                 if (USE_EOC)
                   {
@@ -158,6 +347,11 @@ Connection<DATATYPE, TAGTYPE, USE_EOC>::Connection(
                     m_eocTransfers.push_back(spEocTrans);
                   }
                }//endFor each dest proc
+
+            delete [] srcsForDest;
+
+            if (m_treeTag)
+                 buildTagTree(src, dst);
  
 #ifdef DEBUG_TAGS
             if (pvlProcess.getCurrentTaskMap().findIndex(pvlProcess.getProcId())
@@ -266,8 +460,611 @@ Connection<DATATYPE, TAGTYPE, USE_EOC>::Connection(
 template <class DATATYPE, class TAGTYPE, bool USE_EOC>
 Connection<DATATYPE, TAGTYPE, USE_EOC>::~Connection()
 {
+    delete [] m_packSrcBuff;
+    delete [] m_packDstBuff;
+    delete [] m_oversizeReqs;
+
+    if (!m_oversizeTags.empty())
+      {
+        PvtolProgram   prog;
+        CommScope &cs = prog.getCurrentTask().getCommScope();
+        for (unsigned i = 0; i < m_oversizeTags.size(); i++)
+            cs.returnTag(m_oversizeTags[i]);
+      }
+
+    if (m_creditTag >= 0)
+      {
+        if (m_creditPending)
+          {
+            if (m_srcProcLocal)
+              {// the receive of a credit never sent
+                m_creditReq.cancel();
+              }
+             else
+              {
+                PvtolStatus  stat;
+                m_creditReq.wait(stat);
+              }
+          }
+        PvtolProgram   prog;
+        prog.getCurrentTask().getCommScope().returnTag(m_creditTag);
+      }
 }
 
+//------------------------------------------------------------------------
+//  Method: buildTagTree()
+//
+//  Description: Builds the tag transfers of a TREE_TAG Connection. The
+//               dsts form a binomial tree rooted at the src: with the
+//               src as node 0, node v gets its tag from node v less its
+//               highest bit. The src sends ceil(log2(n+1)) tags rather
+//               than n, and no dst sends more. A dst in the src's own
+//               process takes its tag from the src and relays none.
+//               Each edge carries the tag in pieces, a transfer apiece,
+//               so a dst relays a piece as soon as it has arrived.
+//
+//  Inputs: the src and dst endpoints
+//  Return: none
+//
+//------------------------------------------------------------------------
+template <class DATATYPE, class TAGTYPE, bool USE_EOC>
+void Connection<DATATYPE, TAGTYPE, USE_EOC>::buildTagTree(EndpointX & src,
+                                                          EndpointX & dst)
+{
+    const vector<int>& srcRanks = src.getSetupCompleteRanks();
+    const vector<int>& dstRanks = dst.getSetupCompleteRanks();
+    const vector<int>& srcProcs = src.getProcList();
+    const vector<int>& dstProcs = dst.getProcList();
+
+    int   tagBytes  = sizeof(TagWrapperX);
+    int   numChunks = (tagBytes + TREE_TAG_CHUNK_BYTES - 1) /
+                                               TREE_TAG_CHUNK_BYTES;
+
+    //  the tree's nodes, as indices into the dst lists; node 0 is the src
+    vector<int>  node(1, -1);
+    vector<int>  edgeFirst(1, -1);   // first transfer into each node
+    int          colocated = -1;
+    for (unsigned i = 0; i < dstRanks.size(); i++)
+      {
+        if (dstProcs[i] == srcProcs[0])
+             colocated = i;
+         else
+             node.push_back(i);
+      }
+    edgeFirst.resize(node.size(), -1);
+
+    //  each node's parent precedes it, so the transfer bringing a piece
+    //   to a relaying dst precedes the transfer it relays the piece on
+    for (int v = (colocated >= 0) ? 0 : 1; v < (int)node.size(); v++)
+      {
+        int   to     = (v == 0) ? colocated : node[v];
+        int   parent = 0;
+        if (v > 0)
+          {
+            int   high = 1;
+            while ((high << 1) <= v)
+                 high <<= 1;
+            parent = v - high;
+          }
+
+        int   fromRank;
+        char *fromAddr;
+        if (v == 0 || parent == 0)
+          {
+            fromRank = srcRanks[0];
+            fromAddr = reinterpret_cast<char *>(src.m_tagBlock);
+          }
+         else
+          {
+            fromRank = dstRanks[node[parent]];
+            fromAddr = reinterpret_cast<char *>(dst.m_tagBlock);
+          }
+        ProcId fromProc = (v == 0 || parent == 0) ? srcProcs[0]
+                                                  : dstProcs[node[parent]];
+
+        if (v > 0)
+             edgeFirst[v] = m_tagTransfers.size();
+        for (int c = 0; c < numChunks; c++)
+          {
+            int   offset = c * TREE_TAG_CHUNK_BYTES;
+            int   bytes  = tagBytes - offset;
+            if (bytes > TREE_TAG_CHUNK_BYTES)
+                 bytes = TREE_TAG_CHUNK_BYTES;
+
+            shared_ptr<Transfer>
+                spTrans(
+                    new Transfer(fromRank, fromAddr,
+                                 dstRanks[to],
+                                 reinterpret_cast<char *>(dst.m_tagBlock),
+                                 bytes) );
+            m_tagTransfers.push_back(spTrans);
+            m_tagNodePairs.push_back(std::make_pair(fromProc, dstProcs[to]));
+            m_tagRelayOf.push_back((v == 0 || parent == 0) ? -1
+                                               : edgeFirst[parent] + c);
+            m_tagChunkOffset.push_back(offset);
+            m_tagChunkBytes.push_back(bytes);
+          }//endFor each piece
+      }//endFor each node
+
+    return;
+}//end buildTagTree()
+
+//------------------------------------------------------------------------
+//  Method: packFrame()
+//
+//  Description: Packs the source slot's header, tag and valid data into
+//               its frame. A frame larger than the slot gets just its
+//               header; its data is sent after it, on the oversize tag
+//               of its destination slot.
+//
+//  Inputs: source buffer index
+//  Return: the number of bytes of the frame to send
+//
+//------------------------------------------------------------------------
+template <class DATATYPE, class TAGTYPE, bool USE_EOC>
+int Connection<DATATYPE, TAGTYPE, USE_EOC>::packFrame(
+                                                unsigned srcBufferIndex)
+{
+    typedef typename EndpointX::ElType ElType;
+
+    char *frame = m_packSrcBuff + srcBufferIndex * m_packFrameBytes;
+    FrameHeader *hdr = reinterpret_cast<FrameHeader *>(frame);
+    hdr->validLength = m_src.m_validLengths[srcBufferIndex];
+    hdr->srcSlot     = srcBufferIndex;
+    hdr->seqNum      = m_src.m_frameSeqNums[srcBufferIndex];
+
+    if (m_packCarriesTag)
+      {
+        memcpy(frame + m_packTagOffset,
+               &(m_src.m_tagBlock[srcBufferIndex]),
+               sizeof(TagWrapperX));
+      }
+
+    if (hdr->validLength > (int)m_src.m_slotSize)
+      {// just the header now, the data follows
+        return m_packDataOffset;
+      }
+
+    int bytes = hdr->validLength * sizeof(ElType);
+    memcpy(frame + m_packDataOffset,
+           &(m_src.m_buff[m_src.m_bufferOffsets[srcBufferIndex]]),
+           bytes);
+
+    return m_packDataOffset + bytes;
+}//end packFrame()
+
+//------------------------------------------------------------------------
+//  Method: sendPacked()
+//
+//  Description: Packs the source slot into its frame and starts its
+//               transfer. When batching, only the last frame of a batch
+//               starts the transfer, of the batch's frames not yet sent
+//               (all of them unless flushBatch() sent some), on the
+//               request of the message's first slot. At a destination
+//               which is not also the source this just starts the
+//               receive, of the whole batch.
+//
+//  Inputs: SendRequest ref, source and destination buffer indices
+//  Return: void
+//
+//------------------------------------------------------------------------
+template <class DATATYPE, class TAGTYPE, bool USE_EOC>
+void Connection<DATATYPE, TAGTYPE, USE_EOC>::sendPacked(
+                                                SendRequest & srq,
+                                                unsigned srcBufferIndex,
+                                                unsigned dstBufferIndex)
+{
+    typedef typename EndpointX::ElType ElType;
+
+    // a receive must allow for a full frame
+    int count = m_packFrameBytes;
+
+    if (m_srcProcLocal)
+              count = packFrame(srcBufferIndex);
+
+    if (m_batch > 1)
+      {
+        int pos   = srcBufferIndex % m_batch;
+        int local = m_srcProcLocal ? srcBufferIndex : dstBufferIndex;
+
+#ifdef PVTOL_DEVELOP
+        if ((int)(dstBufferIndex % m_batch) != pos)
+          {
+            throw Exception("Connection: batch slots out of step",
+                            __FILE__, __LINE__);
+          }
+#endif // PVTOL_DEVELOP
+
+        // the slot's previous frame has completed; each slot keeps its
+        //   own state, so the rest of the batch's previous round is
+        //   unaffected
+        m_batchSlotDone[local] = false;
+        m_batchFirst[local]    = -1;
+
+        if (m_srcProcLocal)
+          {
+            m_lastSrcSlot = srcBufferIndex;
+            m_lastDstSlot = dstBufferIndex;
+            m_lastCount   = count;
+          }
+
+        if (pos == m_batch - 1)
+          {// all of the batch's slots are filled, or free to receive
+            int first = local - pos;
+            if (m_srcProcLocal)
+                  first += m_batchNext[local / m_batch];
+            startBatch(first, local,
+                       dstBufferIndex - (local - first), count);
+            if (m_srcProcLocal)
+                  m_batchNext[local / m_batch] = 0;
+          }
+      }
+     else
+      {
+        m_packTransfer->isend(count,
+                              srcBufferIndex * m_packFrameBytes,
+                              dstBufferIndex * m_packFrameBytes,
+                              srq);
+      }
+
+    if (m_srcProcLocal &&
+        m_src.m_validLengths[srcBufferIndex] > (int)m_src.m_slotSize &&
+        m_srcProcRank != m_dstProcRank)
+      {
+        PvtolProgram   prog;
+        CommScope &cs = prog.getCurrentTask().getCommScope();
+        vector<ElType> &data = m_src.m_oversize[srcBufferIndex];
+        cs.isend(&(data[0]), NULL,
+                 m_src.m_validLengths[srcBufferIndex] * sizeof(ElType),
+                 m_dstProcRank, m_oversizeTags[dstBufferIndex],
+                 m_oversizeReqs[srcBufferIndex]);
+        m_oversizePending[srcBufferIndex] = true;
+      }
+
+    return;
+}//end sendPacked()
+
+//------------------------------------------------------------------------
+//  Method: startBatch()
+//
+//  Description: Starts the message of the local slots first to last on
+//               the Transfer of the destination batch it belongs to.
+//               A destination receives into every slot up to the end of
+//               its batch; the source may send fewer frames, when it
+//               was flushed, so each slot's header is cleared first to
+//               tell the frames which came from those which did not.
+//
+//  Inputs: first and last local slots, destination slot of the first,
+//          bytes of the last frame
+//  Return: void
+//
+//------------------------------------------------------------------------
+template <class DATATYPE, class TAGTYPE, bool USE_EOC>
+void Connection<DATATYPE, TAGTYPE, USE_EOC>::startBatch(int first,
+                                                        int last,
+                                                        int dstFirst,
+                                                        int lastCount)
+{
+    int frames = last - first + 1;
+
+    if (!m_srcProcLocal)
+      {
+        for (int i = first; i <= last; i++)
+          {
+            FrameHeader *hdr = reinterpret_cast<FrameHeader *>(
+                                   m_packDstBuff + i * m_packFrameBytes);
+            hdr->srcSlot = -1;
+          }
+      }
+
+    for (int i = first; i <= last; i++)
+          m_batchFirst[i] = first;
+    m_batchLen[first] = frames;
+
+    // a destination has no packed source frames to offset into
+    m_batchTransfers[dstFirst / m_batch]->isend(
+                          (frames - 1) * m_packFrameBytes + lastCount,
+                          (m_srcProcLocal ? first : 0) * m_packFrameBytes,
+                          dstFirst * m_packFrameBytes,
+                          *m_batchReqs[first]);
+
+    return;
+}//end startBatch()
+
+//------------------------------------------------------------------------
+//  Method: batchArrived()
+//
+//  Description: Marks the slots of a completed batch message done. A
+//               destination unpacks the frames which arrived, the
+//               leading slots whose header was filled in, and receives
+//               the rest of the batch again; the source sends them in a
+//               later message.
+//
+//  Inputs: first local slot of the message
+//  Return: void
+//
+//------------------------------------------------------------------------
+template <class DATATYPE, class TAGTYPE, bool USE_EOC>
+void Connection<DATATYPE, TAGTYPE, USE_EOC>::batchArrived(int first)
+{
+    int frames = m_batchLen[first];
+
+    if (m_dstProcLocal)
+      {
+        int arrived = 0;
+        while (arrived < frames)
+          {
+            const FrameHeader *hdr = reinterpret_cast<const FrameHeader *>(
+                           m_packDstBuff + (first + arrived) * m_packFrameBytes);
+            if (hdr->srcSlot < 0)
+                  break;
+            unpackFrame(first + arrived);
+            arrived++;
+          }
+
+        if (arrived < frames)
+              startBatch(first + arrived, first + frames - 1,
+                         first + arrived, m_packFrameBytes);
+        frames = arrived;
+      }
+
+    for (int i = first; i < first + frames; i++)
+          m_batchSlotDone[i] = true;
+
+    return;
+}//end batchArrived()
+
+//------------------------------------------------------------------------
+//  Method: batchDone()
+//
+//  Description: Tests, or waits for, the message carrying a slot's
+//               frame. Completion is kept per slot, so a slot is
+//               done once its own message has completed, whatever
+//               has since become of the other slots of its batch. A
+//               slot whose message has not been started, because the
+//               batch's last frame has not yet been inserted (or freed,
+//               at a destination), can not be waited for.
+//
+//  Inputs: source and destination buffer indices, true to block
+//  Return: true if the slot's frame is complete
+//
+//------------------------------------------------------------------------
+template <class DATATYPE, class TAGTYPE, bool USE_EOC>
+bool Connection<DATATYPE, TAGTYPE, USE_EOC>::batchDone(
+                                                unsigned srcBufferIndex,
+                                                unsigned dstBufferIndex,
+                                                bool wait)
+{
+    int local = m_srcProcLocal ? srcBufferIndex : dstBufferIndex;
+
+    while (!m_batchSlotDone[local])
+      {
+        int first = m_batchFirst[local];
+        if (first < 0)
+          {
+#ifdef PVTOL_DEVELOP
+            if (wait)
+              {
+                throw Exception("Connection: wait on a batch which was "
+                                "never started", __FILE__, __LINE__);
+              }
+#endif // PVTOL_DEVELOP
+            return false;
+          }
+
+        if (wait)
+              m_batchReqs[first]->wait();
+         else if (!m_batchReqs[first]->test())
+              return false;
+
+        batchArrived(first);
+      }
+
+    return true;
+}//end batchDone()
+
+//------------------------------------------------------------------------
+//  Method: flushBatch()
+//
+//  Description: At a source, sends the frames of a partly filled batch
+//               now rather than when its last frame is inserted. The
+//               batch's remaining frames go in a later message, on the
+//               same destination batch's tag.
+//
+//  Inputs: none
+//  Return: void
+//
+//------------------------------------------------------------------------
+template <class DATATYPE, class TAGTYPE, bool USE_EOC>
+void Connection<DATATYPE, TAGTYPE, USE_EOC>::flushBatch()
+{
+    if (m_batch < 2 || !m_srcProcLocal || m_lastSrcSlot < 0 ||
+        m_batchFirst[m_lastSrcSlot] >= 0)
+              return;
+
+    int pos   = m_lastSrcSlot % m_batch;
+    int b     = m_lastSrcSlot / m_batch;
+    int first = m_lastSrcSlot - pos + m_batchNext[b];
+
+    startBatch(first, m_lastSrcSlot,
+               m_lastDstSlot - (m_lastSrcSlot - first), m_lastCount);
+    m_batchNext[b] = pos + 1;
+
+    return;
+}//end flushBatch()
+
+//------------------------------------------------------------------------
+//  Method: unpackFrame()
+//
+//  Description: Copies a received frame's tag and data into the
+//               destination slot. When the header announces a frame
+//               larger than the slot, a receive of its data into the
+//               slot's oversize buffer is started; oversizeDone()
+//               completes it. Called once the frame's request has
+//               completed, from the test path too, so it never blocks.
+//
+//  Inputs: destination buffer index
+//  Return: void
+//
+//------------------------------------------------------------------------
+template <class DATATYPE, class TAGTYPE, bool USE_EOC>
+void Connection<DATATYPE, TAGTYPE, USE_EOC>::unpackFrame(
+                                                unsigned dstBufferIndex)
+{
+    typedef typename EndpointX::ElType ElType;
+
+    if (!m_dstProcLocal)
+              return;
+
+    const char *frame = m_packDstBuff + dstBufferIndex * m_packFrameBytes;
+    const FrameHeader *hdr = reinterpret_cast<const FrameHeader *>(frame);
+    int   len = hdr->validLength;
+
+    if (m_packCarriesTag)
+      {
+        memcpy(&(m_dst.m_tagBlock[dstBufferIndex]),
+               frame + m_packTagOffset,
+               sizeof(TagWrapperX));
+      }
+
+    m_dst.m_validLengths[dstBufferIndex] = len;
+    m_dst.m_frameSeqNums[dstBufferIndex] = hdr->seqNum;
+    if (len <= (int)m_dst.m_slotSize)
+      {
+        memcpy(&(m_dst.m_buff[m_dst.m_bufferOffsets[dstBufferIndex]]),
+               frame + m_packDataOffset,
+               len * sizeof(ElType));
+      }
+     else if (m_srcProcRank == m_dstProcRank)
+      {// the sender's copy is in this process
+        m_dst.m_oversize[dstBufferIndex] = m_src.m_oversize[hdr->srcSlot];
+      }
+     else
+      {// the data comes on the slot's own tag
+        PvtolProgram   prog;
+        CommScope &cs = prog.getCurrentTask().getCommScope();
+        vector<ElType> &data = m_dst.m_oversize[dstBufferIndex];
+        data.resize(len);
+        cs.irecv(NULL, &(data[0]), len * sizeof(ElType),
+                 m_srcProcRank, m_oversizeTags[dstBufferIndex],
+                 m_oversizeReqs[dstBufferIndex]);
+        m_oversizePending[dstBufferIndex] = true;
+      }
+
+    return;
+}//end unpackFrame()
+
+//------------------------------------------------------------------------
+//  Method: oversizeDone()
+//
+//  Description: Tests, or waits for, the message carrying an oversize
+//               frame's data: its send from the source slot, or its
+//               receive into the destination slot.
+//
+//  Inputs: source and destination buffer indices, true to block
+//  Return: true if the slot has no oversize message outstanding
+//
+//------------------------------------------------------------------------
+template <class DATATYPE, class TAGTYPE, bool USE_EOC>
+bool Connection<DATATYPE, TAGTYPE, USE_EOC>::oversizeDone(
+                                                unsigned srcBufferIndex,
+                                                unsigned dstBufferIndex,
+                                                bool wait)
+{
+    unsigned slot = m_srcProcLocal ? srcBufferIndex : dstBufferIndex;
+
+    if (m_oversizeReqs == NULL || !m_oversizePending[slot])
+              return true;
+
+    PvtolStatus  stat;
+    if (wait)
+      {
+        m_oversizeReqs[slot].wait(stat);
+      }
+     else
+      {
+        int flag = 0;
+        m_oversizeReqs[slot].test(&flag, stat);
+        if (!flag)
+              return false;
+      }
+
+    m_oversizePending[slot] = false;
+
+    return true;
+}//end oversizeDone()
+
+//------------------------------------------------------------------------
+//  Method: credit()
+//
+//  Description: At a LoadAware src, collects any credits the dst has
+//               returned and gives the number of the dst's slots not
+//               holding a frame sent to it. It may be negative, when
+//               frames wait at the src for a slot to free.
+//
+//  Inputs: none
+//  Return: the dst's free slots
+//
+//------------------------------------------------------------------------
+template <class DATATYPE, class TAGTYPE, bool USE_EOC>
+int Connection<DATATYPE, TAGTYPE, USE_EOC>::credit()
+{
+    if (!m_loadAware)
+              return m_dst.m_depth;
+
+    PvtolProgram   prog;
+    CommScope &cs = prog.getCurrentTask().getCommScope();
+    PvtolStatus    stat;
+    int            flag = 1;
+    while (flag)
+      {
+        m_creditReq.test(&flag, stat);
+        if (flag)
+          {// credits are cumulative, the newest is the largest
+            if (m_creditBuff > m_released)
+                   m_released = m_creditBuff;
+            cs.irecv(NULL, &m_creditBuff, sizeof(int),
+                     m_dstProcRank, m_creditTag, m_creditReq);
+          }
+      }
+
+    return m_dst.m_depth - (m_dispatched - m_released);
+}//end credit()
+
+//------------------------------------------------------------------------
+//  Method: returnCredit()
+//
+//  Description: At a LoadAware dst, tells the src that one more frame
+//               has been released. The count sent is cumulative, so a
+//               lost race between two credits costs nothing. The
+//               previous credit, a few bytes, has normally left already.
+//
+//  Inputs: none
+//  Return: void
+//
+//------------------------------------------------------------------------
+template <class DATATYPE, class TAGTYPE, bool USE_EOC>
+void Connection<DATATYPE, TAGTYPE, USE_EOC>::returnCredit()
+{
+    if (!m_loadAware)
+              return;
+
+    m_released++;
+
+    PvtolStatus    stat;
+    if (m_creditPending)
+              m_creditReq.wait(stat);
+
+    PvtolProgram   prog;
+    CommScope &cs = prog.getCurrentTask().getCommScope();
+    m_creditBuff = m_released;
+    cs.isend(&m_creditBuff, NULL, sizeof(int),
+             m_srcProcRank, m_creditTag, m_creditReq);
+    m_creditPending = true;
+
+    return;
+}//end returnCredit()
+
 template <class DATATYPE, class TAGTYPE, bool USE_EOC>
 SendManager< DataTagSender<DATATYPE, TAGTYPE, USE_EOC> > *
 Connection<DATATYPE, TAGTYPE, USE_EOC>::getManagerForSrc()
@@ -312,9 +1109,18 @@ Connection<DATATYPE, TAGTYPE, USE_EOC>::getManagerForSrc()
     // on the first call to getManagerFor*
     if (mgr->getState() == SendManager<DataTagSenderX>::IDLE)
     {
-        mgr->setBufferIndices(m_srcBufferIndex, m_dstBufferIndex);
-        m_srcBufferIndex += m_dst.m_numInCommGroup;
-        m_dstBufferIndex += m_src.m_numInCommGroup;
+        if (m_loadAware)
+          {// frames go where the credits say, not by the fixed schedule
+            mgr->setBufferIndices(m_src.m_bufferHeadIndex, m_dstBufferIndex);
+            m_dstBufferIndex += m_src.m_numInCommGroup;
+            m_dispatched++;
+          }
+         else
+          {
+            mgr->setBufferIndices(m_srcBufferIndex, m_dstBufferIndex);
+            m_srcBufferIndex += m_dst.m_numInCommGroup;
+            m_dstBufferIndex += m_src.m_numInCommGroup;
+          }
     }
 
 #ifdef PVTOL_DEVELOP
@@ -0,0 +1,348 @@
+/**
+ *    File: ConduitDepthControl.h
+ *
+ *  Copyright (c) 2008, Massachusetts Institute of Technology
+ *  All rights reserved.
+ *
+ *  \author  $LastChangedBy$
+ *  \date    $LastChangedDate$
+ *  \version $LastChangedRevision$
+ *  \brief   Definition of the ConduitDepthControl class
+ *    A ConduitDepthControl keeps the stall and starvation statistics of
+ *    a Conduit Endpoint and, when adaptive depth is enabled, sizes the
+ *    number of frames a source may have in flight from the stalls it
+ *    observes.
+ *
+ *  $Id$
+ *
+ */
+#ifndef PVTOL_CONDUITDEPTHCONTROL_H
+#define PVTOL_CONDUITDEPTHCONTROL_H
+
+#include <sys/time.h>
+#include <iostream>
+
+namespace ipvtol
+{
+  using std::ostream;
+  using std::endl;
+
+  /** Statistics of one Conduit Endpoint. The insert counters are kept
+   *   by a source, the extract counters by a destination.
+   */
+  struct ConduitDepthStats
+  {
+    int             minDepth;       // adaptive bounds, equal if not adaptive
+    int             maxDepth;
+    int             depth;          // frames currently allowed in flight
+    unsigned long   inserts;
+    unsigned long   insertStalls;   // inserts which waited for a slot
+    double          stallSeconds;
+    unsigned long   extracts;
+    unsigned long   extractStarves; // extracts which waited for data
+    double          starveSeconds;
+    unsigned long   grows;
+    unsigned long   shrinks;
+    unsigned long   insertDrops;    // lossy: frames the source discarded
+    unsigned long   extractDrops;   // lossy: frames discarded unread
+  };
+
+  /** ConduitDepthControl decides how many of an Endpoint's buffer slots
+   *   a source may fill before it must wait for one to be freed.
+   *
+   *   The buffers, and the persistent requests bound to them, are set up
+   *   collectively by Conduit::setupComplete(), so they are allocated for
+   *   the maximum depth once. What adapts is the window of slots in use:
+   *   it is examined every EPOCH inserts and
+   *     - doubles, up to the maximum, if the source stalled on a full
+   *       window in more than one insert of the epoch,
+   *     - shrinks by one, down to the minimum, after QUIET_EPOCHS epochs
+   *       without a stall.
+   *   Growing fast and shrinking slowly absorbs bursts without letting a
+   *   single late frame pin the window wide. A shrink is always safe, the
+   *   frames already in flight drain before the next insert is allowed.
+   *
+   *   Consumer starvation is counted but does not change the window; a
+   *   deeper ring can not help a consumer whose producer is the slower.
+   *
+   *   Only the thread which owns the Endpoint may use the object.
+   *
+   * @see Conduit, Endpoint, LocalXferRing
+   */
+  class ConduitDepthControl
+  {
+  //++++++++++++++
+    public:
+  //++++++++++++++
+    ConduitDepthControl();
+
+    /** Enable adaptive depth. The maximum is the Endpoint's depth.
+     * @param  int the smallest window
+     * @return void
+     */
+    void enable(int minDepth);
+
+    /** Is adaptive depth enabled?
+     * @return bool
+     */
+    bool enabled() const;
+
+    /** Set the number of buffer slots, the largest possible window
+     * @param  int the Endpoint's depth
+     * @return void
+     */
+    void setMaxDepth(int maxDepth);
+
+    /** Get the number of frames currently allowed in flight
+     * @return int
+     */
+    int getDepth() const;
+
+    /** Note time spent waiting for a slot by the frame being inserted
+     * @param  double seconds waited
+     * @return void
+     */
+    void addStall(double secs);
+
+    /** Close the frame being inserted and adapt at the end of an epoch
+     * @return bool true if the window changed
+     */
+    bool recordInsert();
+
+    /** Note time spent waiting for data by the frame being extracted
+     * @param  double seconds waited
+     * @return void
+     */
+    void addStarve(double secs);
+
+    /** Close the frame being extracted
+     * @return void
+     */
+    void recordExtract();
+
+    /** Note a frame the source discarded rather than wait for a slot
+     * @return void
+     */
+    void recordInsertDrop();
+
+    /** Note a frame the destination discarded unread
+     * @return void
+     */
+    void recordExtractDrop();
+
+    /** Get the statistics
+     * @return ConduitDepthStats ref
+     */
+    const ConduitDepthStats & getStats() const;
+
+    /** Get the current time in seconds, for timing the waits
+     * @return double
+     */
+    static double now();
+
+  //++++++++++++++
+    private:
+  //++++++++++++++
+    enum {
+        EPOCH        = 16,  // inserts between decisions
+        QUIET_EPOCHS = 4    // stall free epochs before a shrink
+    };
+
+    bool adapt();
+
+    //   Private Data
+    //-------------------------------------
+    ConduitDepthStats  m_stats;
+    bool               m_enabled;
+    int                m_minRequested;
+    bool               m_frameStalled;
+    bool               m_frameStarved;
+    unsigned int       m_epochInserts;
+    unsigned int       m_epochStalls;
+    unsigned int       m_quietEpochs;
+  };
+
+  ostream& operator<<(ostream& output, const ConduitDepthStats& stats);
+
+
+//                    I N L I N E   Methods
+//------------------------------------------------------------
+
+inline
+  ConduitDepthControl::ConduitDepthControl() :
+      m_enabled(false),
+      m_minRequested(1),
+      m_frameStalled(false),
+      m_frameStarved(false),
+      m_epochInserts(0),
+      m_epochStalls(0),
+      m_quietEpochs(0)
+   {
+     m_stats.minDepth       = 1;
+     m_stats.maxDepth       = 1;
+     m_stats.depth          = 1;
+     m_stats.inserts        = 0;
+     m_stats.insertStalls   = 0;
+     m_stats.stallSeconds   = 0.0;
+     m_stats.extracts       = 0;
+     m_stats.extractStarves = 0;
+     m_stats.starveSeconds  = 0.0;
+     m_stats.grows          = 0;
+     m_stats.shrinks        = 0;
+     m_stats.insertDrops    = 0;
+     m_stats.extractDrops   = 0;
+   }
+
+inline
+  void ConduitDepthControl::enable(int minDepth)
+   {
+     m_enabled      = true;
+     m_minRequested = (minDepth > 0) ? minDepth : 1;
+     setMaxDepth(m_stats.maxDepth);
+   }
+
+inline
+  bool ConduitDepthControl::enabled() const
+   { return(m_enabled); }
+
+inline
+  void ConduitDepthControl::setMaxDepth(int maxDepth)
+   {
+     m_stats.maxDepth = (maxDepth > 0) ? maxDepth : 1;
+     if (!m_enabled)
+       {
+         m_stats.minDepth = m_stats.maxDepth;
+         m_stats.depth    = m_stats.maxDepth;
+         return;
+       }
+     m_stats.minDepth = (m_minRequested < m_stats.maxDepth) ? m_minRequested
+                                                            : m_stats.maxDepth;
+     m_stats.depth    = m_stats.minDepth;
+   }
+
+inline
+  int ConduitDepthControl::getDepth() const
+   { return(m_stats.depth); }
+
+inline
+  void ConduitDepthControl::addStall(double secs)
+   {
+     m_frameStalled        = true;
+     m_stats.stallSeconds += secs;
+   }
+
+inline
+  bool ConduitDepthControl::recordInsert()
+   {
+     m_stats.inserts++;
+     if (m_frameStalled)
+       {
+         m_stats.insertStalls++;
+         m_epochStalls++;
+         m_frameStalled = false;
+       }
+     if (++m_epochInserts < EPOCH)
+         return(false);
+     return(adapt());
+   }
+
+inline
+  void ConduitDepthControl::addStarve(double secs)
+   {
+     m_frameStarved         = true;
+     m_stats.starveSeconds += secs;
+   }
+
+inline
+  void ConduitDepthControl::recordExtract()
+   {
+     m_stats.extracts++;
+     if (m_frameStarved)
+       {
+         m_stats.extractStarves++;
+         m_frameStarved = false;
+       }
+   }
+
+inline
+  void ConduitDepthControl::recordInsertDrop()
+   {
+     m_stats.insertDrops++;
+     m_frameStalled = false;
+   }
+
+inline
+  void ConduitDepthControl::recordExtractDrop()
+   { m_stats.extractDrops++; }
+
+inline
+  const ConduitDepthStats & ConduitDepthControl::getStats() const
+   { return(m_stats); }
+
+inline
+  double ConduitDepthControl::now()
+   {
+     struct timeval  tv;
+     gettimeofday(&tv, NULL);
+     return(tv.tv_sec + 1.0e-6 * tv.tv_usec);
+   }
+
+inline
+  bool ConduitDepthControl::adapt()
+   {
+     int   old = m_stats.depth;
+
+     if (m_enabled)
+       {
+         if (m_epochStalls > 1)
+           {
+             m_quietEpochs = 0;
+             m_stats.depth = (2 * old < m_stats.maxDepth) ? 2 * old
+                                                          : m_stats.maxDepth;
+           }
+         else if (m_epochStalls == 0)
+           {
+             if ((++m_quietEpochs >= QUIET_EPOCHS) &&
+                 (old > m_stats.minDepth))
+               {
+                 m_quietEpochs = 0;
+                 m_stats.depth = old - 1;
+               }
+           }
+         else
+             m_quietEpochs = 0;
+       }//endIf enabled
+
+     m_epochInserts = 0;
+     m_epochStalls  = 0;
+
+     if (m_stats.depth > old)
+         m_stats.grows++;
+      else if (m_stats.depth < old)
+         m_stats.shrinks++;
+     return(m_stats.depth != old);
+   }
+
+inline
+  ostream& operator<<(ostream& output, const ConduitDepthStats& stats)
+   {
+     output << "depth " << stats.depth
+            << " [" << stats.minDepth << ", " << stats.maxDepth << "]"
+            << " grows " << stats.grows
+            << " shrinks " << stats.shrinks << endl
+            << "  inserts " << stats.inserts
+            << " stalled " << stats.insertStalls
+            << " (" << stats.stallSeconds << " s)" << endl
+            << "  extracts " << stats.extracts
+            << " starved " << stats.extractStarves
+            << " (" << stats.starveSeconds << " s)";
+     if (stats.insertDrops || stats.extractDrops)
+         output << endl
+                << "  dropped " << stats.insertDrops << " at insert, "
+                << stats.extractDrops << " unread";
+     return(output);
+   }
+
+}// end namespace
+
+#endif // PVTOL_CONDUITDEPTHCONTROL_H not defined
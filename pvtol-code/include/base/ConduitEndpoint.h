@@ -22,6 +22,8 @@
 #include <Map.h>
 #include <DataMap.h>
 #include <RingIndex.h>
+#include <ConduitDepthControl.h>
+#include <MemoryLock.h>
 #include <HierArray.h>
 
 #include <string>
@@ -75,6 +77,7 @@ class EndpointDescript
     int          m_isSrc;
     int          m_isDst;
     int          m_isLocalXfer;
+    int          m_batch;
     TaskBase    *m_task;
     TaskId       m_taskid;
     int          m_threadid;
@@ -197,14 +200,47 @@ class Endpoint {
     inline vector<SeqNum * >&  getEocBlocks();
     void   setEocBlocks(vector<SeqNum * >  &ebs);
 
+    // variable size frames
+    void setInsertLength(int numElts);
+    void setInsertData(const ElType *data, int numElts);
+    inline int  getValidLength(int slot) const;
+    inline const ElType * getValidData(int slot) const;
+
+    // frames sent per message, set at the src before setupComplete
+    void setBatch(int numFrames);
+    inline int getBatch() const;
+    void flushBatch();
+
+    // load-aware dispatch to replicated dsts, set before finalSetup
+    inline void setLoadAware(bool loadAware);
+    inline bool isLoadAware() const;
+    inline int  getValidSeqNum(int slot) const;
+
+    // a lossy src never waits for a slot, set before finalSetup
+    inline void setLossy(bool lossy);
+    inline bool isLossy() const;
+
+    // adaptive depth & stall statistics
+    inline ConduitDepthControl & getDepthControl();
+
+    // prefault the slots and lock them into memory, from the thread
+    //   which uses them; see Conduit::setLockMemory()
+    void lockSlots(const string & owner);
+    inline size_t getLockedBytes() const;
+
     // src end only methods
     bool insertAvailable();
+    inline bool insertWindowFull() const;
     void insert();
+    void dropInsert();
+    void holdInsert();
+    inline bool isInsertHeld() const;
     bool insertEOCAvailable();
     void insertEOC();
     
     // dst end only methods
     bool extractReady();
+    int  numExtractReady();
     void release();
     void extractAtLeast(int count, bool setupCompleteDone);
     void beginPrepost();
@@ -228,7 +264,9 @@ class Endpoint {
     private:
 
     bool tryStartReceive();
+    void unlockSlots();
     bool tryStartEocReceive();
+    void chooseConnection();
     void mapToProcList(const Map& map, vector<int> & pl);
     void mapToProcRankList(const Map& map, vector<int> & pl);
 
@@ -259,12 +297,23 @@ class Endpoint {
     TagSeqNumWrapper<TAGTYPE, USE_EOC>   *m_tagBlock;
     TAGTYPE                              *m_tagHandlePtr;
     vector<unsigned>                      m_bufferOffsets;
+    vector<int>                           m_validLengths; // per slot
+    vector< vector<ElType> >              m_oversize;     // frames > slot
+    int                                   m_insertLength;
+    int                                   m_batch;
+    bool                                  m_loadAware;
+    bool                                  m_lossy;
+    bool                                  m_insertHeld;   // lossy, unsent
+    vector<int>                           m_frameSeqNums; // per slot
     vector<SendManager<DataTagSenderX> * > m_bufferMgmt;
     vector<EocManagerList>                m_eocBufferMgmt;
 
     // fields not transmitted
     string          m_name;
     bool            m_initialized;
+    string          m_lockOwner;
+    char           *m_lockedAddr;   // the slots' own pages, locked
+    size_t          m_lockedBytes;
     RingIndex       m_bufferHeadIndex;  
     RingIndex       m_bufferTailIndex;
     RingIndex       m_eocBufferHeadIndex;
@@ -297,6 +346,9 @@ class Endpoint {
 
     // doing a local xFer
     bool   m_localXfer;
+
+    // window of slots a src may fill, stall & starvation statistics
+    ConduitDepthControl  m_depthCtl;
 };
 
 //     I N L I N E      Methods
@@ -426,6 +478,91 @@ inline bool Endpoint<DATATYPE, TAGTYPE, USE_EOC>::noBuffAvailable() const
 }
 
 
+template<class DATATYPE, class TAGTYPE, bool USE_EOC>
+inline bool Endpoint<DATATYPE, TAGTYPE, USE_EOC>::insertWindowFull() const
+{
+   //   a local xfer is bounded by the Conduit's LocalXferRing instead
+   if (m_localXfer)
+             return(false);
+
+   if (noBuffAvailable())
+             return(true);
+
+   //   slots from the tail up to the head are still in flight
+   int inUse = (int)m_bufferHeadIndex - (int)m_bufferTailIndex;
+   if (inUse < 0)
+             inUse += m_depth;
+
+   //   a batch leaves as a whole, so the window holds whole batches
+   int window = m_depthCtl.getDepth();
+   if (m_batch > 1)
+     {
+       window = (window + m_batch - 1) / m_batch * m_batch;
+       if (window > m_depth)
+             window = m_depth;
+     }
+
+   return(inUse >= window);
+}
+
+
+template<class DATATYPE, class TAGTYPE, bool USE_EOC>
+inline int Endpoint<DATATYPE, TAGTYPE, USE_EOC>::getBatch() const
+{
+   return m_batch;
+}
+
+template<class DATATYPE, class TAGTYPE, bool USE_EOC>
+inline void Endpoint<DATATYPE, TAGTYPE, USE_EOC>::setLoadAware(bool loadAware)
+{
+   m_loadAware = loadAware;
+}
+
+template<class DATATYPE, class TAGTYPE, bool USE_EOC>
+inline bool Endpoint<DATATYPE, TAGTYPE, USE_EOC>::isLoadAware() const
+{
+   return m_loadAware;
+}
+
+template<class DATATYPE, class TAGTYPE, bool USE_EOC>
+inline int Endpoint<DATATYPE, TAGTYPE, USE_EOC>::getValidSeqNum(int slot) const
+{
+   return m_frameSeqNums[slot];
+}
+
+template<class DATATYPE, class TAGTYPE, bool USE_EOC>
+inline void Endpoint<DATATYPE, TAGTYPE, USE_EOC>::setLossy(bool lossy)
+{
+   m_lossy = lossy;
+}
+
+template<class DATATYPE, class TAGTYPE, bool USE_EOC>
+inline bool Endpoint<DATATYPE, TAGTYPE, USE_EOC>::isLossy() const
+{
+   return m_lossy;
+}
+
+template<class DATATYPE, class TAGTYPE, bool USE_EOC>
+inline bool Endpoint<DATATYPE, TAGTYPE, USE_EOC>::isInsertHeld() const
+{
+   return m_insertHeld;
+}
+
+
+template<class DATATYPE, class TAGTYPE, bool USE_EOC>
+inline ConduitDepthControl &
+ Endpoint<DATATYPE, TAGTYPE, USE_EOC>::getDepthControl()
+{
+   return m_depthCtl;
+}
+
+template<class DATATYPE, class TAGTYPE, bool USE_EOC>
+inline size_t Endpoint<DATATYPE, TAGTYPE, USE_EOC>::getLockedBytes() const
+{
+   return m_lockedBytes;
+}
+
+
 template<class DATATYPE, class TAGTYPE, bool USE_EOC>
 inline bool Endpoint<DATATYPE, TAGTYPE, USE_EOC>::isInitialized() const
 {
@@ -507,6 +644,10 @@ inline int Endpoint<DATATYPE, TAGTYPE, USE_EOC>::getSequenceNumber()
 template<class DATATYPE, class TAGTYPE, bool USE_EOC>
 inline int Endpoint<DATATYPE, TAGTYPE, USE_EOC>::getSequenceNumberIncrement()
 {
+    // a load-aware dst counts just the frames it was sent
+    if (m_loadAware)
+            return 1;
+
     return m_numInCommGroup;
 }
 
@@ -545,6 +686,24 @@ inline void Endpoint<DATATYPE, TAGTYPE, USE_EOC>::rebindTagBuff(
   return;
 }//end rebindTagBuff()
 
+template<class DATATYPE, class TAGTYPE, bool USE_EOC>
+inline int
+Endpoint<DATATYPE, TAGTYPE, USE_EOC>::getValidLength(int slot) const
+{
+    return m_validLengths[slot];
+}
+
+template<class DATATYPE, class TAGTYPE, bool USE_EOC>
+inline const typename DATATYPE::ElType *
+Endpoint<DATATYPE, TAGTYPE, USE_EOC>::getValidData(int slot) const
+{
+    // a frame larger than a slot arrives in its own buffer
+    if (m_validLengths[slot] > (int)m_slotSize)
+               return &(m_oversize[slot][0]);
+
+    return &(m_buff[m_bufferOffsets[slot]]);
+}
+
 template<class DATATYPE, class TAGTYPE, bool USE_EOC>
 inline bool Endpoint<DATATYPE, TAGTYPE, USE_EOC>::isBlockInternal() const
 {
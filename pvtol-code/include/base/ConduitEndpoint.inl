@@ -24,6 +24,7 @@
 #include <Exception.h>
 
 #include <stdio.h>
+#include <string.h>
 #include <utility>
 #include <iostream>
 
@@ -43,6 +44,7 @@ EndpointDescript<DATATYPE, TAGTYPE, USE_EOC>::EndpointDescript() :
     m_isSrc(0),
     m_isDst(0),
     m_isLocalXfer(0),
+    m_batch(1),
     m_task(NULL),
     m_taskid(-1),
     m_threadid(-1),
@@ -77,6 +79,7 @@ int * EndpointDescript<DATATYPE, TAGTYPE, USE_EOC>::serialize(int * buf)
     *(buf++) = m_isSrc;
     *(buf++) = m_isDst;
     *(buf++) = m_isLocalXfer;
+    *(buf++) = m_batch;
 
     union {
       TaskBase * tb;
@@ -152,6 +155,7 @@ int * EndpointDescript<DATATYPE, TAGTYPE, USE_EOC>::deserialize(int * buf)
     m_isSrc       = *(buf++);
     m_isDst       = *(buf++);
     m_isLocalXfer = *(buf++);
+    m_batch       = *(buf++);
 
     union {
       TaskBase * tb;
@@ -220,6 +224,7 @@ int EndpointDescript<DATATYPE, TAGTYPE, USE_EOC>::getSerializedSize()
 
     maxSize += 3; // space for m_depth, m_numReplicas, m_replicaRank
     maxSize += 4; // space for m_procId, m_isSrc, m_isDst, m_isLocalXfer
+    maxSize += 1; // space for m_batch
     maxSize += 2; // space for m_taskid, m_threadid
     int taskPtrSize = sizeof(TaskBase *)/sizeof(int);
     if ((taskPtrSize * sizeof(int)) <  sizeof(TaskBase *))
@@ -249,7 +254,14 @@ Endpoint<DATATYPE, TAGTYPE, USE_EOC>::Endpoint() :
     m_internalEoc(false),
     m_tagBlock(NULL),
     m_tagHandlePtr(NULL), 
+    m_insertLength(-1),
+    m_batch(1),
+    m_loadAware(false),
+    m_lossy(false),
+    m_insertHeld(false),
     m_initialized(false),
+    m_lockedAddr(NULL),
+    m_lockedBytes(0),
     m_slotSize(0),
     m_task(NULL),
     m_taskid(-1),
@@ -276,8 +288,15 @@ Endpoint<DATATYPE, TAGTYPE, USE_EOC>::Endpoint(const string& dataName) :
     m_internalEoc(false),
     m_tagBlock(NULL),
     m_tagHandlePtr(NULL), 
+    m_insertLength(-1),
+    m_batch(1),
+    m_loadAware(false),
+    m_lossy(false),
+    m_insertHeld(false),
     m_name(dataName),
     m_initialized(false),
+    m_lockedAddr(NULL),
+    m_lockedBytes(0),
     m_slotSize(0),
     m_task(NULL),
     m_taskid(-1),
@@ -293,6 +312,8 @@ Endpoint<DATATYPE, TAGTYPE, USE_EOC>::Endpoint(const string& dataName) :
 template<class DATATYPE, class TAGTYPE, bool USE_EOC>
 Endpoint<DATATYPE, TAGTYPE, USE_EOC>::~Endpoint( )
 {
+    unlockSlots();
+
     if (m_map != NULL)
                 delete m_map;
 
@@ -527,6 +548,8 @@ void Endpoint<DATATYPE, TAGTYPE, USE_EOC>::setup(
      else
               m_localXfer = false;
 
+    m_batch = descript.m_batch;
+
     m_initialized  = true;
     m_endpointType = type;
 
@@ -563,6 +586,7 @@ void Endpoint<DATATYPE, TAGTYPE, USE_EOC>::getDescript(
     descript.m_taskid      = m_taskid;
     descript.m_threadid    = m_threadid;
     descript.m_isLocalXfer = m_localXfer;
+    descript.m_batch       = m_batch;
     if (m_endpointType == SOURCE)
                 descript.m_isSrc = 1;
       else
@@ -591,6 +615,8 @@ template<class DATATYPE, class TAGTYPE, bool USE_EOC>
 void Endpoint<DATATYPE, TAGTYPE, USE_EOC>::rebuildDdo(int size,
                                                       int numOppositeCommGroup)
 {
+  unlockSlots();
+
   if ((m_ddo != NULL) && m_internalObject)
     {
        m_block->release();
@@ -825,6 +851,8 @@ void Endpoint<DATATYPE, TAGTYPE, USE_EOC>::calcSetupCompleteRanks()
 template<class DATATYPE, class TAGTYPE, bool USE_EOC>
 void Endpoint<DATATYPE, TAGTYPE, USE_EOC>::rebindDdo(typename DATATYPE::ElType *newBuff)
 {
+  unlockSlots();
+
   if (m_ddo != NULL)
     {
        m_block->release();
@@ -914,12 +942,32 @@ void Endpoint<DATATYPE, TAGTYPE, USE_EOC>::finalSetup(const string & name,
     m_extractRoundRobinIndex = m_rankInCommGroup % numOppositeCommGroup;
     
         m_nextSequenceNumber = rankInCommGroup;
+        if (m_loadAware)
+                m_nextSequenceNumber = 0;
 
         for (int i = 0; i < m_depth; i++)
         {
             m_bufferOffsets.push_back(i * m_slotSize);
         }
 
+        // until told otherwise, every frame fills its slot
+        m_validLengths.clear();
+        m_validLengths.resize(m_depth, m_slotSize);
+        m_oversize.clear();
+        m_oversize.resize(m_depth);
+        m_insertLength = -1;
+        m_insertHeld = false;
+        m_frameSeqNums.clear();
+        m_frameSeqNums.resize(m_depth, 0);
+
+        // every slot may be in flight unless adaptive depth narrows it;
+        //   a lossy src keeps one back to write into while all the
+        //   others are in flight
+        if (m_lossy && m_depth > 1)
+            m_depthCtl.setMaxDepth(m_depth - 1);
+         else
+            m_depthCtl.setMaxDepth(m_depth);
+
         m_bufferHeadIndex.setBufSize(m_depth);
         m_bufferHeadIndex = 0;
         m_bufferTailIndex.setBufSize(m_depth);
@@ -989,6 +1037,64 @@ void Endpoint<DATATYPE, TAGTYPE, USE_EOC>::finalSetup(const string & name,
 }//end finalSetup()
 
 
+template<class DATATYPE, class TAGTYPE, bool USE_EOC>
+void Endpoint<DATATYPE, TAGTYPE, USE_EOC>::lockSlots(const string & owner)
+{
+    // only the endpoint which allocated the slots locks them, once
+    if (!m_internalBuff || (m_buff == NULL) || (m_lockedBytes != 0))
+        return;
+
+    size_t      bytes = size_t(m_depth) * m_slotSize * sizeof(ElType);
+    uintptr_t   page  = sysconf(_SC_PAGESIZE);
+    uintptr_t   first = ((uintptr_t)m_buff + page - 1) & ~(page - 1);
+    uintptr_t   end   = ((uintptr_t)m_buff + bytes) & ~(page - 1);
+
+    // the slots came from the heap and share their end pages with other
+    //   blocks; only the pages wholly theirs are locked, so that
+    //   unlocking them can not unlock another block's
+    MemoryLock::prefault(m_buff, bytes);
+    if (end > first)
+      {
+        m_lockedBytes = MemoryLock::lock(owner, (void *)first, end - first);
+        m_lockedAddr  = (char *)first;
+        m_lockOwner   = owner;
+      }
+
+    return;
+}//end lockSlots()
+
+
+template<class DATATYPE, class TAGTYPE, bool USE_EOC>
+void Endpoint<DATATYPE, TAGTYPE, USE_EOC>::unlockSlots()
+{
+    if (m_lockedBytes == 0)
+        return;
+
+    MemoryLock::unlock(m_lockOwner, m_lockedAddr, m_lockedBytes);
+    m_lockedAddr  = NULL;
+    m_lockedBytes = 0;
+
+    return;
+}//end unlockSlots()
+
+
+//------------------------------------------------------------------------
+//  Method:     insertAvailable
+//
+//  Description: Tells whether a src may fill its head slot now. The
+//               frames in flight must leave room in the window of
+//               ConduitDepthControl, which may be narrower than the
+//               ring; when they do not, the send of the oldest frame,
+//               at the tail, is tested and its slot freed if it has
+//               completed. The head slot's own manager is not the one
+//               to test: with a narrowed window the head slot is free
+//               while the window is full, and only with the full depth
+//               in flight are the head and tail the same slot
+//
+//  Inputs: none
+//  Returns: true if a frame may be inserted
+//
+//------------------------------------------------------------------------
 template<class DATATYPE, class TAGTYPE, bool USE_EOC>
 bool Endpoint<DATATYPE, TAGTYPE, USE_EOC>::insertAvailable()
 {
@@ -998,53 +1104,53 @@ bool Endpoint<DATATYPE, TAGTYPE, USE_EOC>::insertAvailable()
         return true;
       }
 
-    // check for a free buffer slot
-    SendManager<DataTagSenderX> * pSendManager;
-    pSendManager = m_bufferMgmt[m_bufferHeadIndex];
-
-    if (pSendManager == 0)
+    // check for a free buffer slot within the window
+    if (!insertWindowFull())
       {
         return true;
       }
-    else
-      {
+
 #ifdef PVTOL_DEVELOP
-        if (m_bufferHeadIndex != m_bufferTailIndex)
-          {
-            // if these aren't equal when the buffer is full, then something
-            // in the buffer management has been messed up
-	    cout << "EP: about to throw: head = " << m_bufferHeadIndex
-	         << ", tail = " << m_bufferTailIndex << endl;
-	    sleep(2);
-            throw Exception("Endpoint: internal error: buffer full and "
-                            " buffer head index != buffer tail index",
-                            __FILE__, __LINE__);
-          }
+    if ((m_bufferMgmt[m_bufferHeadIndex] != 0) &&
+        (m_bufferHeadIndex != m_bufferTailIndex))
+      {
+        // if these aren't equal when the buffer is full, then something
+        // in the buffer management has been messed up
+        cout << "EP: about to throw: head = " << m_bufferHeadIndex
+             << ", tail = " << m_bufferTailIndex << endl;
+        sleep(2);
+        throw Exception("Endpoint: internal error: buffer full and "
+                        " buffer head index != buffer tail index",
+                        __FILE__, __LINE__);
+      }
 #endif // PVTOL_DEVELOP
 
-        // try to complete the SendManager object to
-        // free the slot
-        if (pSendManager->testComplete())
-          {
-            pSendManager->release();
-            m_bufferMgmt[m_bufferHeadIndex] = 0;
-            // Since the tail indicates the oldest buffer slot still in use,
-            // advance that
-            m_bufferTailIndex++;
-            return true;
-          }
-        else
-          {
-            return false;
-          }
-      }//endIf pSendManager != 0
+    // try to complete the SendManager object of the oldest slot
+    // still in use to free it
+    SendManager<DataTagSenderX> * pSendManager;
+    pSendManager = m_bufferMgmt[m_bufferTailIndex];
+
+    if (pSendManager->testComplete())
+      {
+        pSendManager->release();
+        m_bufferMgmt[m_bufferTailIndex] = 0;
+        // Since the tail indicates the oldest buffer slot still in use,
+        // advance that
+        m_bufferTailIndex++;
+        // a shrunken window may still be full
+        return(!insertWindowFull());
+      }
+    else
+      {
+        return false;
+      }
 
 }//end insertAvailable()
 
 template<class DATATYPE, class TAGTYPE, bool USE_EOC>
 void Endpoint<DATATYPE, TAGTYPE, USE_EOC>::waitForInsertBuff()
 {
-   if (noBuffAvailable())
+   while (insertWindowFull())
      {
        // the tail indicates the oldest buffer slot still in use,
        m_bufferMgmt[m_bufferTailIndex]->waitCommComplete();
@@ -1053,7 +1159,7 @@ void Endpoint<DATATYPE, TAGTYPE, USE_EOC>::waitForInsertBuff()
        m_bufferMgmt[m_bufferTailIndex]->release();
        m_bufferMgmt[m_bufferTailIndex] = 0;
        m_bufferTailIndex++;
-     }//endIf
+     }//endWhile
 
    return;
 }//end waitForInsertBuff()
@@ -1130,16 +1236,35 @@ void Endpoint<DATATYPE, TAGTYPE, USE_EOC>::insert()
 #endif // _DEBUG_2
 
 
+    // a load-aware src sends to the replica with the most free slots
+    if (m_loadAware && !m_localXfer)
+            chooseConnection();
+
     // grab the appropriate outgoing connection
     Connection<DATATYPE, TAGTYPE, USE_EOC> & connection =
                     *m_connections[m_roundRobinIndex];
 
-    // put the sequence number in the tag buffer, if applicable
+    // put the sequence number in the tag buffer, if applicable. A
+    //   load-aware dst sequences the frames sent to it, the frame's own
+    //   number rides in its header for a downstream merge
+    m_frameSeqNums[m_bufferHeadIndex] = getSequenceNumber();
     if (m_tagBlock)
       {
-        m_tagBlock[m_bufferHeadIndex].setSeqNum(getSequenceNumber());
+        if (m_loadAware && !m_localXfer)
+            m_tagBlock[m_bufferHeadIndex].setSeqNum(
+                                      connection.nextDispatchSeqNum());
+         else
+            m_tagBlock[m_bufferHeadIndex].setSeqNum(getSequenceNumber());
       }
 
+    // record how much of the frame is valid
+    if (m_insertLength < 0)
+            m_validLengths[m_bufferHeadIndex] = m_slotSize;
+     else
+            m_validLengths[m_bufferHeadIndex] = m_insertLength;
+    m_insertLength = -1;
+    m_insertHeld = false;
+
     incrementSequenceNumber();
 
     if(!m_localXfer)
@@ -1183,6 +1308,191 @@ void Endpoint<DATATYPE, TAGTYPE, USE_EOC>::insert()
     return;
 }//end insert()
 
+//------------------------------------------------------------------------
+//  Method:     dropInsert
+//
+//  Description: Discards the frame written into the head slot of a lossy
+//               src instead of sending it. The slot, and the sequence
+//               number, are used again by the next frame
+//
+//  Inputs: none
+//  Returns: void
+//
+//------------------------------------------------------------------------
+template<class DATATYPE, class TAGTYPE, bool USE_EOC>
+void Endpoint<DATATYPE, TAGTYPE, USE_EOC>::dropInsert()
+{
+    m_insertLength = -1;
+    m_insertHeld = false;
+    m_depthCtl.recordInsertDrop();
+
+    return;
+}//end dropInsert()
+
+//------------------------------------------------------------------------
+//  Method:     holdInsert
+//
+//  Description: Keeps the frame written into the head slot of a lossy
+//               src, which found no slot free, unsent. The Conduit sends
+//               it once a slot frees, or drops it, with dropInsert(),
+//               when a newer frame is written first
+//
+//  Inputs: none
+//  Returns: void
+//
+//------------------------------------------------------------------------
+template<class DATATYPE, class TAGTYPE, bool USE_EOC>
+void Endpoint<DATATYPE, TAGTYPE, USE_EOC>::holdInsert()
+{
+    m_insertHeld = true;
+
+    return;
+}//end holdInsert()
+
+//------------------------------------------------------------------------
+//  Method: chooseConnection()
+//
+//  Description: Points the round robin index at the connection whose
+//               replicated dst has the most free slots, as last reported
+//               by its credits. Ties go to the first connection after
+//               the one last used, so equally loaded replicas still
+//               take turns.
+//
+//  Inputs: none
+//  Return: void
+//
+//------------------------------------------------------------------------
+template<class DATATYPE, class TAGTYPE, bool USE_EOC>
+void Endpoint<DATATYPE, TAGTYPE, USE_EOC>::chooseConnection()
+{
+    RingIndex   index = m_roundRobinIndex;
+    int         best  = m_roundRobinIndex;
+    int         most  = m_connections[best]->credit();
+
+    for (unsigned i = 1; i < m_connections.size(); i++)
+      {
+        index += m_numInCommGroup;
+        int credit = m_connections[index]->credit();
+        if (credit > most)
+          {
+            most = credit;
+            best = index;
+          }
+      }
+
+    m_roundRobinIndex = best;
+
+    return;
+}//end chooseConnection()
+
+//------------------------------------------------------------------------
+//  Method: setInsertLength()
+//
+//  Description: Declares how many of the leading elements of the next
+//               frame to be inserted are valid. Only those are moved
+//               by a VARIABLE_SIZE Conduit.
+//
+//  Inputs: number of valid elements, at most the slot size
+//  Return: void
+//
+//------------------------------------------------------------------------
+template<class DATATYPE, class TAGTYPE, bool USE_EOC>
+void Endpoint<DATATYPE, TAGTYPE, USE_EOC>::setInsertLength(int numElts)
+{
+#ifdef PVTOL_DEVELOP
+    if (numElts < 0 || numElts > (int)m_slotSize)
+      {
+        throw Exception("Conduit: insert length is larger than a slot",
+                        __FILE__, __LINE__);
+      }
+#endif // PVTOL_DEVELOP
+
+    m_insertLength = numElts;
+
+    return;
+}//end setInsertLength()
+
+//------------------------------------------------------------------------
+//  Method: setBatch()
+//
+//  Description: Asks that numFrames consecutive frames be sent as one
+//               message. Travels to the dst with the endpoint's
+//               descriptor, so it must be set before setupComplete.
+//
+//  Inputs: number of frames per message
+//  Return: void
+//
+//------------------------------------------------------------------------
+template<class DATATYPE, class TAGTYPE, bool USE_EOC>
+void Endpoint<DATATYPE, TAGTYPE, USE_EOC>::setBatch(int numFrames)
+{
+#ifdef PVTOL_DEVELOP
+    if (numFrames < 1)
+      {
+        throw Exception("Conduit: a batch needs at least one frame",
+                        __FILE__, __LINE__);
+      }
+#endif // PVTOL_DEVELOP
+
+    m_batch = numFrames;
+
+    return;
+}//end setBatch()
+
+//------------------------------------------------------------------------
+//  Method: flushBatch()
+//
+//  Description: Sends the frames of a partly filled batch now, on every
+//               connection, rather than when the batch's last frame is
+//               inserted.
+//
+//  Inputs: none
+//  Return: void
+//
+//------------------------------------------------------------------------
+template<class DATATYPE, class TAGTYPE, bool USE_EOC>
+void Endpoint<DATATYPE, TAGTYPE, USE_EOC>::flushBatch()
+{
+    if (m_batch < 2 || m_localXfer || !m_ddo || !m_ddo->isLocal())
+             return;
+
+    for (unsigned i = 0; i < m_connections.size(); i++)
+             m_connections[i]->flushBatch();
+
+    return;
+}//end flushBatch()
+
+//------------------------------------------------------------------------
+//  Method: setInsertData()
+//
+//  Description: Fills the next frame to be inserted from data. A frame
+//               which fits copies into the slot; a larger one is kept
+//               in a buffer of its own, to be sent apart from the slot.
+//
+//  Inputs: the data and its number of elements
+//  Return: void
+//
+//------------------------------------------------------------------------
+template<class DATATYPE, class TAGTYPE, bool USE_EOC>
+void Endpoint<DATATYPE, TAGTYPE, USE_EOC>::setInsertData(const ElType *data,
+                                                         int numElts)
+{
+    if (numElts <= (int)m_slotSize)
+      {
+        memcpy(&(m_buff[m_bufferOffsets[m_bufferHeadIndex]]), data,
+               numElts * sizeof(ElType));
+      }
+     else
+      {
+        m_oversize[m_bufferHeadIndex].assign(data, data + numElts);
+      }
+
+    m_insertLength = numElts;
+
+    return;
+}//end setInsertData()
+
+
 template<class DATATYPE, class TAGTYPE, bool USE_EOC>
 bool Endpoint<DATATYPE, TAGTYPE, USE_EOC>::insertEOCAvailable()
 {
@@ -1275,6 +1585,9 @@ void Endpoint<DATATYPE, TAGTYPE, USE_EOC>::insertEOC()
                         __FILE__, __LINE__);
       }
 
+    // the frames before the EOC must not wait for the rest of a batch
+    flushBatch();
+
     if (m_localXfer)
       {
          // put the sequence number of the EOC in the approriate block
@@ -1316,9 +1629,17 @@ void Endpoint<DATATYPE, TAGTYPE, USE_EOC>::insertEOC()
 
             // put the sequence number of the EOC in the approriate block
             // to prepare it for sending
-            (m_eocBlocks[eocCnxnIndex])[m_eocBufferHeadIndex] =
-                    getSequenceNumber();
-            incrementSequenceNumber();
+            if (m_loadAware)
+              {// it follows the frames this connection's dst was sent
+                (m_eocBlocks[eocCnxnIndex])[m_eocBufferHeadIndex] =
+                        connection.nextDispatchSeqNum();
+              }
+             else
+              {
+                (m_eocBlocks[eocCnxnIndex])[m_eocBufferHeadIndex] =
+                        getSequenceNumber();
+                incrementSequenceNumber();
+              }
         
             // get a SendManager for this destination and kick off the send
             m_eocBufferMgmt[m_eocBufferHeadIndex].m_managers[eocCnxnIndex] =
@@ -1394,6 +1715,47 @@ bool Endpoint<DATATYPE, TAGTYPE, USE_EOC>::extractReady()
     return true;
 }//end extractReady()
 
+//------------------------------------------------------------------------
+//  Method:     numExtractReady
+//
+//  Description: Counts the frames, from the tail on, which have arrived
+//               and may be extracted one after the other. Used by a
+//               lossy dst to skip to the newest. A local xfer dst is
+//               counted by the Conduit's LocalXferRing instead
+//
+//  Inputs: none
+//  Returns: int the number of frames, 0 if the tail's has not arrived
+//
+//------------------------------------------------------------------------
+template<class DATATYPE, class TAGTYPE, bool USE_EOC>
+int Endpoint<DATATYPE, TAGTYPE, USE_EOC>::numExtractReady()
+{
+    if (!extractReady())
+            return 0;
+    if (m_localXfer || !m_ddo || !m_ddo->isLocal())
+            return 1;
+
+    int   count = 1;
+    while (count < m_depth)
+      {
+        SendManager<DataTagSenderX> * pSendManager;
+        pSendManager = m_bufferMgmt[m_bufferTailIndex + count];
+
+        if (!pSendManager || !pSendManager->testComplete())
+                break;
+
+        // a frame whose EOC must be extracted first ends the run
+        if (USE_EOC && (m_tagBlock[m_bufferTailIndex + count].getSeqNum() !=
+                        getSequenceNumber() +
+                                   count * getSequenceNumberIncrement()))
+                break;
+
+        count++;
+      }//endWhile
+
+    return count;
+}//end numExtractReady()
+
 template<class DATATYPE, class TAGTYPE, bool USE_EOC>
 void Endpoint<DATATYPE, TAGTYPE, USE_EOC>::release()
 {
@@ -1426,6 +1788,10 @@ void Endpoint<DATATYPE, TAGTYPE, USE_EOC>::release()
     if (!m_localXfer)
               pSendManager->release();
 
+    // tell a load-aware src that this replica has a slot free
+    if (m_loadAware && !m_localXfer)
+              m_connections[0]->returnCredit();
+
     m_bufferMgmt[m_bufferTailIndex] = 0;
     m_bufferTailIndex++;
 
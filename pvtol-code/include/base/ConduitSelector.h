@@ -0,0 +1,215 @@
+/**
+ *    File: ConduitSelector.h
+ *
+ *  Copyright (c) 2008, Massachusetts Institute of Technology
+ *  All rights reserved.
+ *
+ *  \author  $LastChangedBy$
+ *  \date    $LastChangedDate$
+ *  \version $LastChangedRevision$
+ *  \brief   Definition of the ConduitSelector class
+ *    A ConduitSelector lets one consumer thread wait until any of several
+ *    conduit extract interfaces has a frame (or an EOC) ready, rather
+ *    than polling each of them in turn.
+ *
+ *  $Id$
+ *
+ */
+#ifndef PVTOL_CONDUITSELECTOR_H
+#define PVTOL_CONDUITSELECTOR_H
+
+#include <ConduitWakeup.h>
+
+#include <vector>
+#include <sched.h>
+
+namespace ipvtol
+{
+  using std::vector;
+
+  /** ConduitSelector waits for any of a set of extract interfaces,
+   *   Conduit::ExtractIf or SharedConduit::ConduitExtractIf, to become
+   *   ready.
+   *
+   *   An end whose frames come from the same process notifies the
+   *   selector's ConduitWakeup when a frame or an EOC is inserted, so
+   *   the consumer sleeps on a single futex. An end fed by MPI can not
+   *   notify; its preposted receives are tested by ready(), and while
+   *   any such end is registered the consumer sleeps for at most the
+   *   poll interval between scans.
+   *
+   *   The ends are scanned by turns, starting after the last end found
+   *   ready, so that a busy conduit does not starve the others.
+   *
+   *   Ends must be added after setupComplete(), by the consumer thread,
+   *   which must be the only one to use the selector. An end may be
+   *   registered with one selector only.
+   *
+   * @see Conduit, SharedConduit, ConduitWakeup
+   */
+  class ConduitSelector
+  {
+  //++++++++++++++
+    public:
+  //++++++++++++++
+    ConduitSelector();
+    ~ConduitSelector();
+
+    /** Register an extract interface
+     * @param  EXTRACTIF the interface, which is copied
+     * @return int the index wait() and poll() return for it
+     */
+    template <class EXTRACTIF>
+    int add(EXTRACTIF eif);
+
+    /** Get the number of registered interfaces
+     * @return int
+     */
+    int size() const;
+
+    /** Find a ready interface without waiting
+     * @return int its index, or -1 if none is ready
+     */
+    int poll();
+
+    /** Wait until an interface is ready
+     * @return int its index
+     */
+    int wait();
+
+    /** Set the longest sleep between scans of the ends fed by MPI
+     * @param  double seconds
+     * @return void
+     */
+    void setPollInterval(double secs);
+
+  //++++++++++++++
+    private:
+  //++++++++++++++
+    enum {
+        SPIN_LIMIT  = 64,   // busy scans before a wait yields
+        YIELD_LIMIT = 16    // yielding scans before a wait sleeps
+    };
+
+    /** One registered end */
+    class End
+    {
+      public:
+        virtual ~End() { }
+        virtual bool ready() = 0;
+        virtual bool setWakeup(ConduitWakeup *wakeup) = 0;
+    };
+
+    template <class EXTRACTIF>
+    class ExtractEnd : public End
+    {
+      public:
+        ExtractEnd(const EXTRACTIF &eif) : m_if(eif) { }
+        bool ready()
+         { return(m_if.ready() || m_if.isAtEOC()); }
+        bool setWakeup(ConduitWakeup *wakeup)
+         { return(m_if.setWakeup(wakeup)); }
+      private:
+        EXTRACTIF   m_if;
+    };
+
+    //   Private Data
+    //-------------------------------------
+    vector<End *>   m_ends;
+    int             m_next;          // first end of the next scan
+    int             m_numRemote;     // ends which can not notify
+    double          m_pollInterval;
+    ConduitWakeup   m_wakeup;
+
+    // methods declared private to prevent their use
+    //    Assignment Operator, Copy Constructor
+    //-------------------------------------
+    ConduitSelector& operator=(const ConduitSelector& rhs);
+    ConduitSelector(const ConduitSelector& other);
+  };
+
+
+//                    I N L I N E   Methods
+//------------------------------------------------------------
+
+inline
+  ConduitSelector::ConduitSelector() :
+      m_next(0),
+      m_numRemote(0),
+      m_pollInterval(50.0e-6)
+   { }
+
+inline
+  ConduitSelector::~ConduitSelector()
+   {
+     for (unsigned i = 0; i < m_ends.size(); i++)
+       {
+         m_ends[i]->setWakeup(NULL);
+         delete m_ends[i];
+       }
+   }
+
+template <class EXTRACTIF>
+inline
+  int ConduitSelector::add(EXTRACTIF eif)
+   {
+     End  *end = new ExtractEnd<EXTRACTIF>(eif);
+     if (!end->setWakeup(&m_wakeup))
+         m_numRemote++;
+
+     m_ends.push_back(end);
+     return(m_ends.size() - 1);
+   }
+
+inline
+  int ConduitSelector::size() const
+   { return(m_ends.size()); }
+
+inline
+  int ConduitSelector::poll()
+   {
+     int   numEnds = m_ends.size();
+     for (int k = 0; k < numEnds; k++)
+       {
+         int   i = (m_next + k) % numEnds;
+         if (m_ends[i]->ready())
+           {
+             m_next = (i + 1) % numEnds;
+             return(i);
+           }
+       }
+     return(-1);
+   }
+
+inline
+  int ConduitSelector::wait()
+   {
+     int   idx;
+
+     for (int i=0; i<SPIN_LIMIT+YIELD_LIMIT; i++)
+       {
+         if ((idx = poll()) >= 0)
+             return(idx);
+         if (i >= SPIN_LIMIT)
+             sched_yield();
+       }
+
+     for (;;)
+       {
+         //  a notify after seen is read changes the futex word, so
+         //   the wait below returns at once rather than sleeping
+         int   seen = m_wakeup.getSeq();
+         __sync_synchronize();
+         if ((idx = poll()) >= 0)
+             return(idx);
+         m_wakeup.wait(seen, (m_numRemote > 0) ? m_pollInterval : -1.0);
+       }
+   }
+
+inline
+  void ConduitSelector::setPollInterval(double secs)
+   { m_pollInterval = (secs > 0.0) ? secs : 0.0; }
+
+}// end namespace
+
+#endif // PVTOL_CONDUITSELECTOR_H not defined
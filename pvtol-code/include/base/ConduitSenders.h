@@ -75,13 +75,15 @@ class DataTagSender
        void cancelComm();
 
     private:
+       void startTag(TagTransferInfo & info);
 
     ConnectionX &            m_connection;
     int                     m_srcBufferIndex;
     int                     m_dstBufferIndex;
 
-    SendRequest             m_sendRequest;
+    SendRequest             m_sendRequest;   // the DDO, or a packed frame
     bool                    m_ddoRequestDone;
+    bool                    m_packFrames;
 
     vector<TagTransferInfo> m_tagInfo;
     bool                    m_tagRequestDone;
@@ -152,7 +154,10 @@ inline bool DataTagSender<DATATYPE, TAGTYPE, USE_EOC>::isDstLocal()
 template <class DATATYPE, class TAGTYPE, bool USE_EOC>
 inline void DataTagSender<DATATYPE, TAGTYPE, USE_EOC>::waitCommComplete()
 {
-   m_sendRequest.wait();
+   if (m_packFrames)
+       waitForTag();
+    else
+       m_sendRequest.wait();
 
    return;
 }
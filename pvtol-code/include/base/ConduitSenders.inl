@@ -39,9 +39,12 @@ DataTagSender<DATATYPE, TAGTYPE, USE_EOC>::DataTagSender(
                                                 SenderConfig & connection) :
             m_connection(connection),
             m_tagRequestDone(false),
-            m_ddoRequestDone(false)
+            m_ddoRequestDone(false),
+            m_packFrames(connection.packFrames())
 {
-    if (connection.getDataSize() > 0)
+    if (m_packFrames)
+            m_sendRequest.setup(connection.getPackTransfer());
+     else if (connection.getDataSize() > 0)
             m_sendRequest.setup(connection.getRoute());
   
     m_tagRequestCheckIndex = 0;
@@ -52,6 +55,10 @@ DataTagSender<DATATYPE, TAGTYPE, USE_EOC>::DataTagSender(
     const vector< shared_ptr<Transfer > > & tagTransfers =
             connection.getTagTransfers();
 
+    // a TREE_TAG dst relays each piece of the tag after it arrives
+    const vector<int> & relayOf = connection.getTagTransferRelayList();
+    vector<int>  infoIndex(tagTransfers.size(), -1);
+
     PvtolProgram   prog;
     ProcId myProcId = prog.getProcId();
 
@@ -78,6 +85,14 @@ DataTagSender<DATATYPE, TAGTYPE, USE_EOC>::DataTagSender(
             currentTagTransfer.m_toNode = tagTransferNodeList[i].second;
             currentTagTransfer.m_sendRequest.reset(
                 new SendRequest(*tagTransfers[i]) );
+            if (!relayOf.empty() && relayOf[i] >= 0 &&
+                myProcId == tagTransferNodeList[i].first)
+            {
+                // the piece comes to this node first, so it is listed
+                //   before this transfer
+                currentTagTransfer.m_waitFor = infoIndex[relayOf[i]];
+            }
+            infoIndex[i] = m_tagInfo.size();
             m_tagInfo.push_back(currentTagTransfer);
         }
     }
@@ -94,7 +109,15 @@ template <class DATATYPE, class TAGTYPE, bool USE_EOC>
 void DataTagSender<DATATYPE, TAGTYPE, USE_EOC>::beginComm()
 {
     // send DDO
-    if (m_connection.getDataSize() > 0)
+    if (m_packFrames)
+      {// the tag rides in the DDO's message; there are no tag sends
+         m_connection.sendPacked(m_sendRequest,
+                                m_srcBufferIndex,
+                                m_dstBufferIndex);
+         m_ddoRequestDone = false;
+         m_tagRequestDone = false;
+      }
+     else if (m_connection.getDataSize() > 0)
       {
          m_connection.send(m_sendRequest, m_srcBufferIndex, m_dstBufferIndex);
          m_ddoRequestDone = false;
@@ -111,13 +134,13 @@ void DataTagSender<DATATYPE, TAGTYPE, USE_EOC>::beginComm()
 #endif // PVTOL_DEBUG_1
       }
 
-    // send tags if any
+    // send tags if any; a relayed piece waits for its arrival
     for (unsigned i = 0; i < m_tagInfo.size(); i++)
     {
-        m_connection.sendTag(m_tagInfo[i].m_index,
-                             *m_tagInfo[i].m_sendRequest,
-                             m_srcBufferIndex,
-                             m_dstBufferIndex);
+        m_tagInfo[i].m_started = false;
+        m_tagInfo[i].m_done    = false;
+        if (m_tagInfo[i].m_waitFor < 0)
+            startTag(m_tagInfo[i]);
         m_tagRequestDone = false;
     }
     m_tagRequestCheckIndex = 0;
@@ -131,28 +154,75 @@ bool DataTagSender<DATATYPE, TAGTYPE, USE_EOC>::testCommComplete()
 {
     if (!m_ddoRequestDone)
     {
-        // try to finish sending the DDO
-        m_ddoRequestDone = m_sendRequest.test();
-        if (!m_ddoRequestDone)
+        if (m_connection.getBatch() > 1)
         {
-            // can't finish it now
-            return false;
+            // the frame travels with the rest of its batch
+            if (!m_connection.batchDone(m_srcBufferIndex,
+                                        m_dstBufferIndex, false))
+            {
+                return false;
+            }
+        }
+        else
+        {
+            // try to finish sending the DDO
+            if (!m_sendRequest.test())
+            {
+                // can't finish it now
+                return false;
+            }
+
+            if (m_packFrames)
+                m_connection.unpackFrame(m_dstBufferIndex);
         }
+        m_ddoRequestDone = true;
+    }
+
+    // an oversize frame's data goes after its header
+    if (m_packFrames && !m_connection.oversizeDone(m_srcBufferIndex,
+                                                   m_dstBufferIndex, false))
+    {
+        return false;
     }
                 
-    // we've finished the DDO; now try the tags
-    while (m_tagRequestCheckIndex < m_tagInfo.size()) {
-        if (m_tagInfo[m_tagRequestCheckIndex].m_sendRequest->test())
+    // we've finished the DDO; now try the tags, relaying on any piece
+    //   which has arrived
+    bool  tagsDone = true;
+    for (unsigned i = m_tagRequestCheckIndex; i < m_tagInfo.size(); i++) {
+        TagTransferInfo & info = m_tagInfo[i];
+        if (info.m_done)
+            continue;
+
+        if (!info.m_started)
+          {
+            if (!m_tagInfo[info.m_waitFor].m_done)
+              {
+                tagsDone = false;
+                continue;
+              }
+            startTag(info);
+          }
+
+        if (info.m_sendRequest->test())
           {
             // finished this tag
-            m_tagRequestCheckIndex++;
+            info.m_done = true;
           }
          else
           {
-            // can't finish the tags
-            return false;
+            tagsDone = false;
           }
-    }//endWhile
+    }//endFor
+
+    while (m_tagRequestCheckIndex < m_tagInfo.size() &&
+           m_tagInfo[m_tagRequestCheckIndex].m_done)
+        m_tagRequestCheckIndex++;
+
+    if (!tagsDone)
+      {
+        // can't finish the tags
+        return false;
+      }
 
     // finished everything
     m_tagRequestDone = true;
@@ -163,10 +233,33 @@ bool DataTagSender<DATATYPE, TAGTYPE, USE_EOC>::testCommComplete()
 template <class DATATYPE, class TAGTYPE, bool USE_EOC>
 void DataTagSender<DATATYPE, TAGTYPE, USE_EOC>::waitForTag()
 {
-    if (!m_tagRequestDone)
+    if (m_packFrames)
+      {// one request carries both the DDO and the tag
+        if (!m_ddoRequestDone && m_connection.getBatch() > 1)
+          {
+            m_connection.batchDone(m_srcBufferIndex, m_dstBufferIndex, true);
+            m_ddoRequestDone = true;
+          }
+         else if (!m_ddoRequestDone)
+          {
+            m_sendRequest.wait();
+            m_connection.unpackFrame(m_dstBufferIndex);
+            m_ddoRequestDone = true;
+          }
+
+        m_connection.oversizeDone(m_srcBufferIndex, m_dstBufferIndex, true);
+        m_tagRequestDone = true;
+      }
+     else if (!m_tagRequestDone)
       {
         for (int i=0; i < m_tagInfo.size(); i++) {
+               if (m_tagInfo[i].m_done)
+                     continue;
+               // a relayed piece's arrival was waited for above
+               if (!m_tagInfo[i].m_started)
+                     startTag(m_tagInfo[i]);
                m_tagInfo[i].m_sendRequest->wait();
+               m_tagInfo[i].m_done = true;
         }//endFor
 
         m_tagRequestDone = true;
@@ -179,19 +272,31 @@ void DataTagSender<DATATYPE, TAGTYPE, USE_EOC>::waitForTag()
 template <class DATATYPE, class TAGTYPE, bool USE_EOC>
 void DataTagSender<DATATYPE, TAGTYPE, USE_EOC>::cancelComm()
 {
-    if (!m_ddoRequestDone)
+    if (!m_ddoRequestDone && m_connection.getBatch() == 1)
     {
-        // cancel sending the DDO
+        // cancel sending the DDO; a batch's request is the Connection's
         m_sendRequest.cancel();
     }
                 
     // we've canceled the DDO; now do the tags
     for (unsigned int i = 0; i < m_tagInfo.size(); i++)
     {
-        m_tagInfo[i].m_sendRequest->cancel();
+        if (m_tagInfo[i].m_started)
+            m_tagInfo[i].m_sendRequest->cancel();
     }
 
 }//end cancelComm()
+
+template <class DATATYPE, class TAGTYPE, bool USE_EOC>
+void DataTagSender<DATATYPE, TAGTYPE, USE_EOC>::startTag(
+                                                TagTransferInfo & info)
+{
+    m_connection.sendTag(info.m_index,
+                         *info.m_sendRequest,
+                         m_srcBufferIndex,
+                         m_dstBufferIndex);
+    info.m_started = true;
+}//end startTag()
    
 
 template <class DATATYPE, class TAGTYPE, bool USE_EOC>
@@ -0,0 +1,132 @@
+/**
+ *    File: ConduitWakeup.h
+ *
+ *  Copyright (c) 2008, Massachusetts Institute of Technology
+ *  All rights reserved.
+ *
+ *  \author  $LastChangedBy$
+ *  \date    $LastChangedDate$
+ *  \version $LastChangedRevision$
+ *  \brief   Definition of the ConduitWakeup class
+ *    A ConduitWakeup lets one consumer thread sleep until any of several
+ *    same process conduits receives a frame. Producers bump a counter
+ *    which doubles as a futex word; the consumer parks on it.
+ *
+ *  $Id$
+ *
+ */
+#ifndef PVTOL_CONDUITWAKEUP_H
+#define PVTOL_CONDUITWAKEUP_H
+
+#include <sched.h>
+#include <limits.h>
+#include <time.h>
+#ifdef __linux__
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+#endif // __linux__
+
+namespace ipvtol
+{
+
+  /** ConduitWakeup is the event a ConduitSelector sleeps on. The
+   *   conduits registered with the selector call notify() whenever a
+   *   frame or an EOC is inserted; it costs an atomic add, and a system
+   *   call only when the consumer is asleep.
+   *
+   *   The consumer must read getSeq() before it checks its conduits and
+   *   pass the value to wait(), so that a notify() between the check and
+   *   the wait is not lost.
+   *
+   * @see ConduitSelector, LocalXferRing, BlockingCQueue
+   */
+  class ConduitWakeup
+  {
+  //++++++++++++++
+    public:
+  //++++++++++++++
+    ConduitWakeup();
+
+    /** Consumer: get the count of notifications so far
+     * @return int
+     */
+    int getSeq() const;
+
+    /** Producer: wake the consumer, if it sleeps
+     * @return void
+     */
+    void notify();
+
+    /** Consumer: sleep until notified after seen was read, or for at
+     *   most timeoutSecs. A negative timeout waits for ever.
+     * @param  int the value of getSeq() read before the last check
+     * @param  double the longest sleep, in seconds
+     * @return void
+     */
+    void wait(int seen, double timeoutSecs);
+
+  //++++++++++++++
+    private:
+  //++++++++++++++
+    //   Private Data
+    //-------------------------------------
+    volatile int   m_seq;        // futex word
+    volatile int   m_waiters;
+  };
+
+
+//                    I N L I N E   Methods
+//------------------------------------------------------------
+
+inline
+  ConduitWakeup::ConduitWakeup() :
+      m_seq(0),
+      m_waiters(0)
+   { }
+
+inline
+  int ConduitWakeup::getSeq() const
+   { return(m_seq); }
+
+inline
+  void ConduitWakeup::notify()
+   {
+     __sync_fetch_and_add(&m_seq, 1);
+#ifdef __linux__
+     if (m_waiters)
+       {
+         syscall(SYS_futex, const_cast<int *>(&m_seq), FUTEX_WAKE_PRIVATE,
+                 INT_MAX, NULL, NULL, 0);
+       }
+#endif // __linux__
+   }
+
+inline
+  void ConduitWakeup::wait(int seen, double timeoutSecs)
+   {
+#ifdef __linux__
+     struct timespec   ts;
+     struct timespec  *tsp = NULL;
+     if (timeoutSecs >= 0.0)
+       {
+         ts.tv_sec  = (time_t)timeoutSecs;
+         ts.tv_nsec = (long)((timeoutSecs - ts.tv_sec) * 1.0e9);
+         tsp = &ts;
+       }
+
+     __sync_fetch_and_add(&m_waiters, 1);
+     //  returns at once if a notify() changed the word after seen was read
+     syscall(SYS_futex, const_cast<int *>(&m_seq), FUTEX_WAIT_PRIVATE, seen,
+             tsp, NULL, 0);
+     __sync_fetch_and_sub(&m_waiters, 1);
+#else
+     (void)seen;
+     (void)timeoutSecs;
+     sched_yield();
+#endif // __linux__
+   }
+
+}// end namespace
+
+#endif // PVTOL_CONDUITWAKEUP_H not defined
@@ -0,0 +1,335 @@
+/**
+ *    File: FramePool.h
+ *
+ *  Copyright (c) 2008, Massachusetts Institute of Technology
+ *  All rights reserved.
+ *
+ *  \author  $LastChangedBy$
+ *  \date    $LastChangedDate$
+ *  \version $LastChangedRevision$
+ *  \brief   Definition of the FramePool class
+ *    A FramePool builds the frames of a conduit in one contiguous,
+ *    cache line aligned arena, allocated once at setup and optionally
+ *    backed by huge pages, so that frames are addressed by index and
+ *    nothing is allocated while frames flow.
+ *
+ *  $Id$
+ *
+ */
+#ifndef PVTOL_FRAMEPOOL_H
+#define PVTOL_FRAMEPOOL_H
+
+#include <Exception.h>
+#include <MemoryLock.h>
+
+#include <new>
+#include <stdlib.h>
+#include <stddef.h>
+#ifdef __linux__
+#include <sys/mman.h>
+#endif // __linux__
+
+namespace ipvtol
+{
+
+  /** Allocation statistics of a FramePool */
+  struct FramePoolStats
+  {
+    int             frames;
+    size_t          frameStride;   // bytes from one frame to the next
+    size_t          arenaBytes;
+    bool            hugePages;     // the arena is backed by huge pages
+    unsigned long   allocations;   // arenas allocated, by setup only
+    size_t          lockedBytes;   // of the arena, locked into memory
+  };
+
+  /** FramePool holds count objects of type T side by side in a single
+   *   arena. Each frame starts on a cache line, so frames written by
+   *   different threads do not false share.
+   *
+   *   Only the frame objects are pooled; memory a frame allocates for
+   *   itself, as a HierArray does for its data, is not. Frames with
+   *   inline storage are contiguous in full.
+   *
+   *   create() and clear() are not thread safe; get() is.
+   *
+   * @see SharedConduit
+   */
+  template <class T>
+  class FramePool
+  {
+  //++++++++++++++
+    public:
+  //++++++++++++++
+    FramePool();
+    ~FramePool();
+
+    /** Ask for huge pages for the next arena. If the system has none
+     *   to give, ordinary pages are used.
+     * @param  bool enable
+     * @return void
+     */
+    void setHugePages(bool enable);
+
+    /** Lock the next arena into memory once its frames are built, from
+     *   the thread calling create()
+     * @param  bool enable
+     * @param  string the owner, for MemoryLock::report()
+     * @return void
+     */
+    void setLockMemory(bool enable, const std::string &owner);
+
+    /** Build count default constructed frames, replacing any others
+     * @param  int the number of frames
+     * @return void
+     */
+    void create(int count);
+
+    /** Build count frames, each constructed as T(arg)
+     * @param  int the number of frames
+     * @param  ARG the constructor argument, or a frame to copy
+     * @return void
+     */
+    template <class ARG>
+    void create(int count, const ARG &arg);
+
+    /** Destroy the frames and free the arena
+     * @return void
+     */
+    void clear();
+
+    /** Get a frame
+     * @param  int its index
+     * @return T *
+     */
+    T *get(int idx) const;
+
+    /** Get the number of frames
+     * @return int
+     */
+    int size() const;
+
+    /** Get the allocation statistics
+     * @return FramePoolStats ref
+     */
+    const FramePoolStats & getStats() const;
+
+  //++++++++++++++
+    private:
+  //++++++++++++++
+    enum {
+        CACHE_LINE = 64,
+        HUGE_PAGE  = 2 * 1024 * 1024
+    };
+
+    void allocate(int count);
+    void release();
+
+    //   Private Data
+    //-------------------------------------
+    char            *m_arena;
+    bool             m_mapped;      // m_arena came from mmap
+    bool             m_wantHuge;
+    bool             m_wantLock;
+    std::string      m_lockOwner;
+    int              m_built;       // frames constructed so far
+    FramePoolStats   m_stats;
+
+    // methods declared private to prevent their use
+    //    Assignment Operator, Copy Constructor
+    //-------------------------------------
+    FramePool& operator=(const FramePool& rhs);
+    FramePool(const FramePool& other);
+  };
+
+
+//                    I N L I N E   Methods
+//------------------------------------------------------------
+
+template <class T>
+inline
+  FramePool<T>::FramePool() :
+      m_arena(NULL),
+      m_mapped(false),
+      m_wantHuge(false),
+      m_wantLock(false),
+      m_built(0)
+   {
+     m_stats.frames      = 0;
+     m_stats.frameStride = (sizeof(T) + CACHE_LINE - 1) / CACHE_LINE
+                                                        * CACHE_LINE;
+     m_stats.arenaBytes  = 0;
+     m_stats.hugePages   = false;
+     m_stats.allocations = 0;
+     m_stats.lockedBytes = 0;
+   }
+
+template <class T>
+inline
+  FramePool<T>::~FramePool()
+   {
+     try
+       {
+         clear();
+       }
+     catch(...)
+       {}
+   }
+
+template <class T>
+inline
+  void FramePool<T>::setHugePages(bool enable)
+   { m_wantHuge = enable; }
+
+template <class T>
+inline
+  void FramePool<T>::setLockMemory(bool enable, const std::string &owner)
+   {
+     m_wantLock  = enable;
+     m_lockOwner = owner;
+   }
+
+template <class T>
+inline
+  void FramePool<T>::create(int count)
+   {
+     allocate(count);
+     try
+       {
+         for (; m_built < count; m_built++)
+             new (get(m_built)) T();
+       }
+     catch(...)
+       {
+         clear();
+         throw;
+       }
+     if (m_wantLock && (m_built > 0))
+         m_stats.lockedBytes = MemoryLock::lock(m_lockOwner, m_arena,
+                                                m_stats.arenaBytes);
+   }
+
+template <class T>
+template <class ARG>
+inline
+  void FramePool<T>::create(int count, const ARG &arg)
+   {
+     allocate(count);
+     try
+       {
+         for (; m_built < count; m_built++)
+             new (get(m_built)) T(arg);
+       }
+     catch(...)
+       {
+         clear();
+         throw;
+       }
+     if (m_wantLock && (m_built > 0))
+         m_stats.lockedBytes = MemoryLock::lock(m_lockOwner, m_arena,
+                                                m_stats.arenaBytes);
+   }
+
+template <class T>
+inline
+  void FramePool<T>::clear()
+   {
+     while (m_built > 0)
+         get(--m_built)->~T();
+     release();
+   }
+
+template <class T>
+inline
+  T *FramePool<T>::get(int idx) const
+   { return((T *)(m_arena + idx * m_stats.frameStride)); }
+
+template <class T>
+inline
+  int FramePool<T>::size() const
+   { return(m_built); }
+
+template <class T>
+inline
+  const FramePoolStats & FramePool<T>::getStats() const
+   { return(m_stats); }
+
+template <class T>
+inline
+  void FramePool<T>::allocate(int count)
+   {
+     clear();
+     if (count < 1)
+         return;
+
+     size_t   bytes = count * m_stats.frameStride;
+
+#ifdef __linux__
+     if (m_wantHuge)
+       {//  whole huge pages, from the reserved pool if there is one
+         size_t   mapBytes = (bytes + HUGE_PAGE - 1) / HUGE_PAGE * HUGE_PAGE;
+         void    *p = MAP_FAILED;
+#ifdef MAP_HUGETLB
+         p = mmap(NULL, mapBytes, PROT_READ | PROT_WRITE,
+                  MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+         m_stats.hugePages = (p != MAP_FAILED);
+#endif // MAP_HUGETLB
+         if (p == MAP_FAILED)
+           {//  else ask for transparent huge pages
+             p = mmap(NULL, mapBytes, PROT_READ | PROT_WRITE,
+                      MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+#ifdef MADV_HUGEPAGE
+             if (p != MAP_FAILED)
+                 m_stats.hugePages = (madvise(p, mapBytes,
+                                              MADV_HUGEPAGE) == 0);
+#endif // MADV_HUGEPAGE
+           }
+         if (p != MAP_FAILED)
+           {
+             m_arena            = (char *)p;
+             m_mapped           = true;
+             m_stats.arenaBytes = mapBytes;
+           }
+       }//endIf huge pages
+#endif // __linux__
+
+     if (m_arena == NULL)
+       {
+         if (posix_memalign((void **)&m_arena, CACHE_LINE, bytes) != 0)
+           {
+             m_arena = NULL;
+             throw Exception("FramePool: could not allocate the arena",
+                             __FILE__, __LINE__);
+           }
+         m_stats.arenaBytes = bytes;
+         m_stats.hugePages  = false;
+       }
+
+     m_stats.frames = count;
+     m_stats.allocations++;
+   }
+
+template <class T>
+inline
+  void FramePool<T>::release()
+   {
+     if (m_arena == NULL)
+         return;
+     MemoryLock::unlock(m_lockOwner, m_arena, m_stats.lockedBytes);
+     m_stats.lockedBytes = 0;
+#ifdef __linux__
+     if (m_mapped)
+         munmap(m_arena, m_stats.arenaBytes);
+      else
+#endif // __linux__
+         free(m_arena);
+     m_arena            = NULL;
+     m_mapped           = false;
+     m_stats.frames     = 0;
+     m_stats.arenaBytes = 0;
+     m_stats.hugePages  = false;
+   }
+
+}// end namespace
+
+#endif // PVTOL_FRAMEPOOL_H not defined
@@ -0,0 +1,245 @@
+/**
+ *    File: HaloExchange.h
+ *
+ *  Copyright (c) 2008, Massachusetts Institute of Technology
+ *  All rights reserved.
+ *
+ *  \author  $LastChangedBy$
+ *  \date    $LastChangedDate$
+ *  \version $LastChangedRevision$
+ *  \brief   Definition of the HaloExchange class
+ *    A HaloExchange refreshes the overlap (a.k.a. ghost or halo) cells
+ *    of a BLOCK or BLOCK_CYCLIC distributed array whose DataMap was
+ *    built with a non-zero overlap.
+ *
+ *  $Id$
+ *
+ */
+#ifndef PVTOL_HALOEXCHANGE_H
+#define PVTOL_HALOEXCHANGE_H
+
+#include <PvtolBasics.h>
+#include <CommScope.h>
+#include <PvtolRequest.h>
+#include <HierArray.h>
+#include <DataMap.h>
+
+#include <vector>
+
+namespace ipvtol
+{
+
+  /** HaloExchange keeps the overlap cells of a distributed array up to
+   *   date with the values held by their owning processor.
+   *
+   *   The overlap follows the PVL convention used by Pitfalls: a block
+   *   extends "overlap" elements into the block which follows it in that
+   *   dimension. Those trailing elements (the halo) are owned by the
+   *   processor holding the following block. When several dimensions
+   *   have overlap, the faces are joined by edge and corner regions, each
+   *   owned by the diagonal neighbor.
+   *
+   *   Locally, each block is stored as its owned elements immediately
+   *   followed by its halo elements. For BLOCK_CYCLIC distributions the
+   *   local blocks of a dimension are stored one after the other, so the
+   *   local length of a dimension is the sum of its (block + halo)
+   *   lengths; computeLocalLengths() gives the sizes to allocate.
+   *
+   *   All the neighbor geometry, the per peer pack lists and the
+   *   persistent comm requests are computed once, at construction.
+   *   Like a Route, the object must be constructed in a SPMD manner by
+   *   every processor in the current task. Each exchange is split into
+   *   begin(), which packs and starts the sends and receives, and end(),
+   *   which waits for them and unpacks the halos, so that the interior of
+   *   the array may be computed on while the halos are in flight.
+   *
+   * @see Route, Pitfalls, DataMap
+   */
+  class HaloExchange
+  {
+  //++++++++++++++
+    public:
+  //++++++++++++++
+
+    /** Constructor.
+     *  @param map           the DataMap of the distributed array
+     *  @param numDims       number of dimensions of the array
+     *  @param globalLengths the global length of each dimension
+     *  @param localAddr     address of this processor's local block
+     *  @param localStrides  element stride of each local dimension
+     *  @param eltSize       size in bytes of one element
+     */
+    HaloExchange(const DataMap&      map,
+                 int                 numDims,
+                 const unsigned int *globalLengths,
+                 void               *localAddr,
+                 const int          *localStrides,
+                 int                 eltSize);
+
+    /** Constructor, taking the local storage from a HierArray
+     *  @param map           the DataMap of the distributed array
+     *  @param globalLengths the global length of each dimension
+     *  @param localArr      this processor's local part of the array
+     */
+    template<dimension_type N, typename T, class Block>
+    HaloExchange(const DataMap&             map,
+                 const unsigned int        *globalLengths,
+                 HierArray<N, T, Block>    *localArr);
+
+    ~HaloExchange();
+
+    /** Compute the local lengths, halos included, of this processor's
+     *   part of an array distributed by map.
+     *
+     * @param  DataMap ref the map of the array
+     * @param  int the number of dimensions
+     * @param  unsigned int * the global lengths
+     * @param  unsigned int * returns the local length of each dimension
+     * @return void
+     */
+    static void computeLocalLengths(const DataMap&      map,
+                                    int                 numDims,
+                                    const unsigned int *globalLengths,
+                                    unsigned int       *localLengths);
+
+    /** Pack the owned boundary cells and start the exchange
+     * @return void
+     */
+    void begin();
+
+    /** Wait for the exchange started by begin() and unpack the halos
+     * @return void
+     */
+    void end();
+
+    /** Perform a complete exchange, begin() followed by end()
+     * @return void
+     */
+    void exchange();
+
+    /** Is an exchange in progress (begin() called, end() not yet called)?
+     * @return bool
+     */
+    bool inProgress() const;
+
+    /** Get the number of processors this one exchanges halos with
+     * @return int
+     */
+    int getNumPeers() const;
+
+    /** Get the number of halo regions (faces, edges and corners) this
+     *   processor receives
+     * @return int
+     */
+    int getNumHaloRegions() const;
+
+  //++++++++++++++
+    private:
+  //++++++++++++++
+
+    /** One local block of a dimension, with its halo */
+    struct Segment
+      {
+        int   globalStart;
+        int   ownedLen;
+        int   haloLen;
+        int   haloOwner;     // grid coordinate owning the halo
+        int   haloOwnerOff;  // local offset of the halo at its owner
+        int   localOff;      // local offset of the block
+        int   nextBlock;     // global block index holding the halo
+      };
+
+    /** A box of local elements */
+    struct Region
+      {
+        int   start[MAX_DIM];
+        int   len[MAX_DIM];
+      };
+
+    /** Everything exchanged with one other processor */
+    struct Peer
+      {
+        int                  rank;
+        std::vector<Region>  sendRegions;
+        std::vector<Region>  recvRegions;
+        int                  sendBytes;
+        int                  recvBytes;
+        char                *sendBuff;
+        char                *recvBuff;
+        PvtolRequest         sendReq;
+        PvtolRequest         recvReq;
+      };
+
+    void init(const DataMap&      map,
+              const unsigned int *globalLengths,
+              const int          *localStrides);
+
+    static void buildSegments(const DataMap&   map,
+                              int              dim,
+                              unsigned int     globalLength,
+                              std::vector< std::vector<Segment> > &segs);
+
+    void enumerateHalos(const int *coord,
+                        int        ownerIndex,
+                        bool       isRecv);
+
+    int  coordToIndex(const int *coord) const;
+    void indexToCoord(int index, int *coord) const;
+    Peer& getPeer(int rank);
+
+    int  regionBytes(const Region &reg) const;
+    void padRegion(const Region &reg,
+                   int          *start,
+                   int          *len,
+                   int          *stride) const;
+    void packRegion(const Region &reg, char *buff) const;
+    void unpackRegion(const Region &reg, const char *buff);
+    void copyRegion(const Region &src, const Region &dest);
+
+    //   Private Data
+    //-------------------------------------
+    CommScope                                       *m_commScopePtr;
+    int                                              m_numDims;
+    int                                              m_eltSize;
+    char                                            *m_localAddr;
+    int                                              m_strides[MAX_DIM];
+    int                                              m_gridDims[MAX_DIM];
+    int                                              m_myIndex;
+    int                                              m_myCoord[MAX_DIM];
+    int                                              m_tag;
+    bool                                             m_inProgress;
+    int                                              m_numHaloRegions;
+    std::vector<int>                                 m_ranks;
+    std::vector< std::vector<Segment> >              m_segs[MAX_DIM];
+    std::vector<Peer *>                              m_peers;
+    std::vector< std::pair<Region, Region> >         m_selfCopies;
+
+    // methods declared private to prevent their use
+    //    Default Constructor, Assignment Operator, Copy Constructor
+    //-------------------------------------
+    HaloExchange();
+    HaloExchange& operator=(const HaloExchange& rhs);
+    HaloExchange(const HaloExchange& other);
+  };
+
+
+//                    I N L I N E   Methods
+//------------------------------------------------------------
+
+inline
+  bool HaloExchange::inProgress() const
+   { return(m_inProgress); }
+
+inline
+  int HaloExchange::getNumPeers() const
+   { return(m_peers.size()); }
+
+inline
+  int HaloExchange::getNumHaloRegions() const
+   { return(m_numHaloRegions); }
+
+}// end namespace
+
+#include <HaloExchange.inl>
+
+#endif // PVTOL_HALOEXCHANGE_H not defined
@@ -0,0 +1,62 @@
+/**
+ *  File: HaloExchange.inl
+ *
+ *  Copyright (c) 2008, Massachusetts Institute of Technology
+ *  All rights reserved.
+ *
+ *  \author  $LastChangedBy$
+ *  \date    $LastChangedDate$
+ *  \version $LastChangedRevision$
+ *  \brief   Template methods for the HaloExchange class.
+ *
+ *  $Id$
+ */
+
+#ifndef PVTOL_HALOEXCHANGE_INL_
+#define PVTOL_HALOEXCHANGE_INL_
+
+#include <PvtolProgram.h>
+#include <TaskBase.h>
+
+namespace ipvtol
+{
+
+//------------------------------------------------------------------------
+//  Method:     Constructor
+//
+//  Description: Builds a halo exchange for the local part of a
+//               distributed array held in a HierArray
+//
+//  Inputs: DataMap ref, global lengths, HierArray * local part
+//  Returns: void
+//
+//------------------------------------------------------------------------
+template<dimension_type N, typename T, class Block>
+HaloExchange::HaloExchange(const DataMap&             map,
+                           const unsigned int        *globalLengths,
+                           HierArray<N, T, Block>    *localArr) :
+    m_numDims(N),
+    m_eltSize(sizeof(T)),
+    m_localAddr(reinterpret_cast<char *>(localArr->localPointer())),
+    m_myIndex(-1),
+    m_tag(0),
+    m_inProgress(false),
+    m_numHaloRegions(0)
+{
+    int   strides[MAX_DIM];
+
+    PvtolProgram   prog;
+    TaskBase& ct   = prog.getCurrentTask();
+    m_commScopePtr = &(ct.getCommScope());
+
+    for (int i=0; i<(int)N; i++)
+        strides[i] = localArr->stride(i);
+
+    init(map, globalLengths, strides);
+}//end construct
+
+
+} // namespace ipvtol
+
+
+#endif // PVTOL_HALOEXCHANGE_INL_ not defined
@@ -11,6 +11,15 @@
  *  \brief   Class definition & inline methods of HeterogeneousConduit. The Heterogeneous
  *           Conduit class provides a means to transport data objects between two tasks
  *           where at least one task is located on a Heterogeneous-enabled GPU.
+ *           Unless the conduit is shared, frames are moved from the source to the
+ *           destination buffers by a copy engine thread, so that the producer can
+ *           fill its next buffer while the last one is being moved. A frame reaches
+ *           the reader only once its move has completed.
+ *
+ *           Host buffers can be prefaulted and locked into memory at setup, see
+ *           setLockMemory().
+ *
+ *           Define HCONDUIT_DEBUG to log every frame moved.
  *
  *  Author: James Brock
  *  	$Id: $
@@ -22,6 +31,7 @@
 
 #include <PvtolProgram.h>
 #include <HeterogeneousQueue.h>
+#include <MemoryLock.h>
 #include <ThreadManager.h>
 #include <string>
 #include <typeinfo>
@@ -231,6 +241,12 @@ public:
 	///Get the name
 	string getName();
 
+	///Prefault and lock the host (LOC_CPU) buffers into memory as they are set up, from
+	///the thread setting them up. Call before setup; the locks are held until the conduit
+	///is destroyed. MemoryLock::report() lists the bytes locked, under "<name> src" and
+	///"<name> dst".
+	void setLockMemory(bool enable);
+
 	///Setup the source buffers using new DATATYPE
 	void setupSrc(int depth = 1, HTaskInfo * info = NULL, int * dims = NULL);
 	
@@ -255,7 +271,7 @@ public:
 	///Can we read from conduit?
 	inline bool extractReady();
 
-	//Finish setting up the conduit (noop)
+	//Finish setting up the conduit; starts the copy engine once both ends are set up
 	void setupComplete();
 
 	// Sends an end-of-cycle (EOC).
@@ -280,7 +296,8 @@ private:
 	///Get the src data for buffer to write
 	inline DATATYPE & getSrcData();
 
-	///Release the source data
+	///Release the source data. Unless the conduit is shared, this hands the frame
+	///to the copy engine and returns without waiting for the move
 	inline void releaseSrcData();
 	
 	//Get the destination data for read
@@ -288,6 +305,22 @@ private:
 
 	//Release the data 
 	inline void releaseDstData();
+
+	///Start the copy engine thread, if it is not running
+	void startMover();
+
+	///Stop the copy engine thread; frames not yet moved are dropped
+	void stopMover();
+
+	///Copy engine thread entry point
+	static void * moverMain(void * arg);
+
+	///Move frames from the source to the destination buffers until either
+	///queue is write locked
+	void moveFrames();
+
+	///Lock a source or destination buffer just set up, if asked to
+	void lockBuffer(bool src, handle buf, int * dims, HTaskInfo * info);
 	
 	/////////////////////////////////////////////////////////////////////////
 	// PRIVATE MEMBERS
@@ -314,6 +347,16 @@ private:
 	int m_dstStride;
 	bool m_cpyLock;
 	bool m_shared;
+	pthread_t m_mover;           // the copy engine
+	bool m_moverRunning;
+	pthread_mutex_t m_moverMutex;
+	vector<char> m_skipMove;     // per source slot, m_cpyLock when the frame was released
+	unsigned int m_releaseSeq;   // frames released by the producer
+	unsigned int m_moveSeq;      // frames taken by the copy engine
+	bool m_lockMemory;
+	pthread_mutex_t m_lockedMutex;
+	vector<std::pair<handle, size_t> > m_lockedSrc;   // buffers locked, and their bytes
+	vector<std::pair<handle, size_t> > m_lockedDst;
 };
 
 ////////////////////////////////////////////////////////////////////
@@ -455,9 +498,15 @@ template <class DATATYPE> HeterogeneousConduit<DATATYPE>::HeterogeneousConduit(c
 	m_dstsInitialized(false),
 	m_EOC(false),
 	m_cpyLock(false),
-	m_shared(shared) {
+	m_shared(shared),
+	m_moverRunning(false),
+	m_releaseSeq(0),
+	m_moveSeq(0),
+	m_lockMemory(false) {
 		pthread_mutex_init(&m_initSrcMutex, NULL);
 		pthread_mutex_init(&m_initDstMutex, NULL);
+		pthread_mutex_init(&m_moverMutex, NULL);
+		pthread_mutex_init(&m_lockedMutex, NULL);
 		m_srcInfo.location = LOC_INVALID;
 		m_srcInfo.device = -1;
 		m_srcInfo.process = -1;
@@ -470,7 +519,17 @@ template <class DATATYPE> HeterogeneousConduit<DATATYPE>::HeterogeneousConduit(c
 
 //Destructor
 template <class DATATYPE>
-HeterogeneousConduit<DATATYPE>::~HeterogeneousConduit() throw() { return; }
+HeterogeneousConduit<DATATYPE>::~HeterogeneousConduit() throw() {
+	try { stopMover(); } catch(...) {}
+	pthread_mutex_destroy(&m_moverMutex);
+	for (size_t idx = 0; idx < m_lockedSrc.size(); idx++) {
+		MemoryLock::unlock(m_name + " src", m_lockedSrc[idx].first, m_lockedSrc[idx].second);
+	}
+	for (size_t idx = 0; idx < m_lockedDst.size(); idx++) {
+		MemoryLock::unlock(m_name + " dst", m_lockedDst[idx].first, m_lockedDst[idx].second);
+	}
+	pthread_mutex_destroy(&m_lockedMutex);
+}
 
 template <class DATATYPE>
 inline typename HeterogeneousConduit<DATATYPE>::Writer HeterogeneousConduit<DATATYPE>::getWriter() {
@@ -498,6 +557,7 @@ inline void HeterogeneousConduit<DATATYPE>::setupSrc( std::vector<handle> & vecH
 	   m_src.setCapacity(m_bufferLength);
 	   for (int i=0; i< m_bufferLength; ++i) {
 		   m_src.insert(vecHandles[i]);
+		   lockBuffer(true, vecHandles[i], m_srcDims, &m_srcInfo);
 	   }
 	   m_src.reset();
       m_srcsInitialized = true;
@@ -521,6 +581,7 @@ inline void HeterogeneousConduit<DATATYPE>::setupSrc( int depth, HTaskInfo * inf
 		   temp = (handle)initMem(m_srcDims, sizeof(DATATYPE), &m_srcStride, m_name.c_str(), &m_srcInfo, 0);
 		   printf("Initializing memory in conduit %s src on %d device: %X\n",m_name.c_str(), m_srcInfo.location, temp);
 		   m_src.insert(temp);
+		   lockBuffer(true, temp, m_srcDims, &m_srcInfo);
 	   }
 	   m_src.reset();
       m_srcsInitialized = true;
@@ -540,18 +601,11 @@ inline DATATYPE & HeterogeneousConduit<DATATYPE>::getSrcData() {
 template <class DATATYPE>
 inline void HeterogeneousConduit<DATATYPE>::releaseSrcData() {
 	if (!m_shared) {
-	   if (!m_dst.beginInsert(m_readData)) {
-	      throw Exception("Conduit destination is not accepting more data.");
-      }
-      if (!m_cpyLock) {
-	      printf("Moving memory in conduit %s src: From %d:%X to %d:%X\n", m_name.c_str(), m_srcInfo.location, m_writeData, m_dstInfo.location, m_readData);
-	      moveData(m_readData, m_dstStride, &m_dstInfo, m_writeData, m_srcStride, &m_srcInfo,
-	               m_srcDims, sizeof(DATATYPE), m_name.c_str());
-      }
-      if (!m_src.endInsert(m_writeData)) { printf("Note 1: problem in src->endInsert call\n"); }
-      if (!m_src.beginRemove(m_writeData)) { printf("Note 2: problem in src->endInsert call\n"); }
-      if (!m_src.endRemove(m_writeData)) { printf("Note 3: problem in src->endInsert call\n"); }
-      if (!m_dst.endInsert(m_readData)) { printf("Note 4: problem in src->endInsert call\n"); }
+	   if (!m_moverRunning) { startMover(); }
+	   // the slot is ours until endInsert, so the engine reads the flag after we write it
+	   m_skipMove[m_releaseSeq % m_skipMove.size()] = m_cpyLock;
+	   m_releaseSeq++;
+	   if (!m_src.endInsert(m_writeData)) { printf("Note: problem in src->endInsert call\n"); }
    } else {
       if (!m_src.endInsert(m_writeData)) { printf("Shared conduit release src.\n"); }
    }
@@ -576,6 +630,7 @@ inline void HeterogeneousConduit<DATATYPE>::setupDst( int depth, HTaskInfo * inf
 		   handle temp = (handle)initMem(m_dstDims, sizeof(DATATYPE), &m_dstStride, m_name.c_str(), &m_dstInfo, 0);
 		   printf("Initializing memory in conduit %s src on %d device: %X\n",m_name.c_str(), m_dstInfo.location, temp);
 		   m_dst.insert(temp);
+		   lockBuffer(false, temp, m_dstDims, &m_dstInfo);
 	   }
 	   m_dst.reset();
       m_dstsInitialized = true;
@@ -595,6 +650,7 @@ void HeterogeneousConduit<DATATYPE>::setupDst( vector<handle>& vecHandles, HTask
 	   m_dst.setCapacity(m_bufferLength);
 	   for (int i=0; i< m_bufferLength; ++i) {
 		   m_dst.insert(vecHandles[i]);
+		   lockBuffer(false, vecHandles[i], m_dstDims, &m_dstInfo);
 	   }
 	   m_dst.reset();
       m_dstsInitialized = true;
@@ -633,10 +689,81 @@ inline void HeterogeneousConduit<DATATYPE>::releaseDstData() {
 template <class DATATYPE>
 inline void HeterogeneousConduit<DATATYPE>::setupComplete() {
 	//m_src.reset(); m_dst.reset();
+	if (!m_shared && m_srcsInitialized && m_dstsInitialized) { startMover(); }
+}
+
+template <class DATATYPE>
+inline void HeterogeneousConduit<DATATYPE>::startMover() {
+   pthread_mutex_lock(&m_moverMutex);
+   if (m_moverRunning) {
+      pthread_mutex_unlock(&m_moverMutex);
+      return;
+   }
+   if (!m_srcsInitialized || !m_dstsInitialized) {
+      pthread_mutex_unlock(&m_moverMutex);
+      throw Exception("HeterogeneousConduit: both ends must be set up before data is moved",
+                      __FILE__, __LINE__);
+   }
+   m_skipMove.assign(m_src.getCapacity(), 0);
+   m_releaseSeq = 0;
+   m_moveSeq = 0;
+   if (pthread_create(&m_mover, NULL, moverMain, this) != 0) {
+      pthread_mutex_unlock(&m_moverMutex);
+      throw Exception("HeterogeneousConduit: could not start the copy engine",
+                      __FILE__, __LINE__);
+   }
+   m_moverRunning = true;
+   pthread_mutex_unlock(&m_moverMutex);
 }
 
 template <class DATATYPE>
-inline void HeterogeneousConduit<DATATYPE>::insertEOC() { m_EOC = true; }
+inline void HeterogeneousConduit<DATATYPE>::stopMover() {
+   pthread_mutex_lock(&m_moverMutex);
+   if (m_moverRunning) {
+      // wakes the engine wherever it waits
+      m_src.writeLock();
+      m_dst.writeLock();
+      pthread_join(m_mover, NULL);
+      m_moverRunning = false;
+   }
+   pthread_mutex_unlock(&m_moverMutex);
+}
+
+template <class DATATYPE>
+void * HeterogeneousConduit<DATATYPE>::moverMain(void * arg) {
+   static_cast<HeterogeneousConduit<DATATYPE> *>(arg)->moveFrames();
+   return NULL;
+}
+
+template <class DATATYPE>
+inline void HeterogeneousConduit<DATATYPE>::moveFrames() {
+   handle srcData;
+   handle dstData;
+   while (m_src.beginRemove(srcData)) {
+      if (!m_dst.beginInsert(dstData)) { break; }
+      bool skip = m_skipMove[m_moveSeq % m_skipMove.size()];
+      m_moveSeq++;
+      if (!skip) {
+#ifdef HCONDUIT_DEBUG
+         printf("Moving memory in conduit %s src: From %d:%p to %d:%p\n", m_name.c_str(),
+                m_srcInfo.location, (void *)srcData, m_dstInfo.location, (void *)dstData);
+#endif
+         moveData(dstData, m_dstStride, &m_dstInfo, srcData, m_srcStride, &m_srcInfo,
+                  m_srcDims, sizeof(DATATYPE), m_name.c_str());
+      }
+      // the frame is complete for the reader ...
+      m_dst.endInsert(dstData);
+      // ... and the producer may refill the source slot
+      m_src.endRemove(srcData);
+   }
+}
+
+template <class DATATYPE>
+inline void HeterogeneousConduit<DATATYPE>::insertEOC() {
+	// the frames released before the EOC reach the reader before it
+	if (!m_shared && m_moverRunning) { m_src.waitEmpty(); }
+	m_EOC = true;
+}
 
 template <class DATATYPE>
 inline void HeterogeneousConduit<DATATYPE>::clearEOC() { m_EOC = false; }
@@ -653,6 +780,24 @@ inline void HeterogeneousConduit<DATATYPE>::unlock() { m_cpyLock = false; }
 template <class DATATYPE>
 inline string HeterogeneousConduit<DATATYPE>::getName() { return m_name; }
 
+template <class DATATYPE>
+inline void HeterogeneousConduit<DATATYPE>::setLockMemory(bool enable) { m_lockMemory = enable; }
+
+template <class DATATYPE>
+inline void HeterogeneousConduit<DATATYPE>::lockBuffer(bool src, handle buf, int * dims,
+                                                       HTaskInfo * info) {
+   // device memory is the device's business
+   if (!m_lockMemory || (buf == NULL) || (info->location != LOC_CPU)) { return; }
+   size_t bytes = sizeof(DATATYPE);
+   for (int idx = 0; idx < HNDIMS; idx++) { bytes *= dims[idx]; }
+   size_t locked = MemoryLock::lock(m_name + (src ? " src" : " dst"), buf, bytes);
+   if (locked) {
+      pthread_mutex_lock(&m_lockedMutex);
+      (src ? m_lockedSrc : m_lockedDst).push_back(std::make_pair(buf, locked));
+      pthread_mutex_unlock(&m_lockedMutex);
+   }
+}
+
 template <class DATATYPE>
 inline void HeterogeneousConduit<DATATYPE>::clearSrc() {
 	///@todo: 
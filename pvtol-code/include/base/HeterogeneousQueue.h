@@ -57,6 +57,7 @@ public:
 
 	/**
 	 * \brief    Begin the process of two phase insertion.
+	 * 			 It blocks while the queue is full, unless the queue is write locked.
 	 * \param    value_type&   This is the value type which is returned to the user to modify
 	 *
 	 * \return   false if the queue is locked, true otherwise
@@ -118,11 +119,15 @@ public:
 	///Is the queue full?
 	bool is_full() const;
 
+	///Wait until every item inserted has been removed, or the queue is write locked
+	void waitEmpty();
+
 	///Reset the Queue and discard all content
 	void reset();
 
 
-	///Write protect the queue. Prevents adding of new items to queue
+	///Write protect the queue. Prevents adding of new items to queue, and
+	///wakes the threads waiting on it
 	void writeLock();
 
 	///Unlock the queue. The queue is open for writing again
@@ -219,8 +224,13 @@ bool HeterogeneousQueue<DATATYPE>::beginInsert(value_type& item)
 	if (m_writeLock)
 		return false;
 	pthread_mutex_lock(&m_mutex);
-	while (is_full())
+	while (is_full() && !m_writeLock)
 		pthread_cond_wait(&m_not_full, &m_mutex);
+	if (m_writeLock)
+	{
+		pthread_mutex_unlock(&m_mutex);
+		return false;
+	}
 	//Insert the item
 	item = m_container[m_writeIndex];
 	pthread_mutex_unlock(&m_mutex);
@@ -232,11 +242,14 @@ bool HeterogeneousQueue<DATATYPE>::endInsert(value_type& item)
 {
 	if (m_writeLock)
 		return false;
+	// the inserter and the remover may be different threads
+	pthread_mutex_lock(&m_mutex);
 	//Insert the item
 	m_container[m_writeIndex] = item;
 	m_writeIndex = (m_writeIndex+1) % m_capacity;
 	++m_unread;
 	pthread_cond_signal(&m_not_empty);
+	pthread_mutex_unlock(&m_mutex);
 	return true;
 }
 
@@ -287,6 +300,7 @@ bool HeterogeneousQueue<DATATYPE>::beginRemove(value_type& item)
 template <class DATATYPE>
 bool HeterogeneousQueue<DATATYPE>::endRemove(value_type& item) {
 	bool result = false;
+	pthread_mutex_lock(&m_mutex);
 	//remove the item
 	if (!is_empty()) {
 		// Put the item back into the queue, in case the
@@ -302,6 +316,7 @@ bool HeterogeneousQueue<DATATYPE>::endRemove(value_type& item) {
 		pthread_cond_signal(&m_empty);
 	}
 	pthread_cond_signal(&m_not_full);
+	pthread_mutex_unlock(&m_mutex);
 	return result;
 }
 
@@ -315,11 +330,27 @@ bool HeterogeneousQueue<DATATYPE>::is_empty() const { return m_unread == 0; }
 template <class DATATYPE>
 bool HeterogeneousQueue<DATATYPE>::is_full() const { return m_unread == m_capacity; }
 
+template <class DATATYPE>
+void HeterogeneousQueue<DATATYPE>::waitEmpty() {
+	pthread_mutex_lock(&m_mutex);
+	while (m_unread != 0 && !m_writeLock)
+		pthread_cond_wait(&m_empty, &m_mutex);
+	pthread_mutex_unlock(&m_mutex);
+}
+
 template <class DATATYPE>
 void HeterogeneousQueue<DATATYPE>::reset() { m_unread = m_readIndex = m_writeIndex = 0 ; }
 
 template <class DATATYPE>
-void HeterogeneousQueue<DATATYPE>::writeLock() { m_writeLock = true; }
+void HeterogeneousQueue<DATATYPE>::writeLock() {
+	// wake any thread waiting to insert or remove, so that it can give up
+	pthread_mutex_lock(&m_mutex);
+	m_writeLock = true;
+	pthread_cond_broadcast(&m_not_empty);
+	pthread_cond_broadcast(&m_not_full);
+	pthread_cond_broadcast(&m_empty);
+	pthread_mutex_unlock(&m_mutex);
+}
 
 template <class DATATYPE>
 void HeterogeneousQueue<DATATYPE>::writeUnlock() { m_writeLock = false; }
@@ -0,0 +1,424 @@
+/**
+ *    File: LocalXferRing.h
+ *
+ *  Copyright (c) 2008, Massachusetts Institute of Technology
+ *  All rights reserved.
+ *
+ *  \author  $LastChangedBy$
+ *  \date    $LastChangedDate$
+ *  \version $LastChangedRevision$
+ *  \brief   Definition of the LocalXferRing class
+ *    A LocalXferRing does the head/tail bookkeeping of a Conduit whose
+ *    source and destination are in the same process. It is a single
+ *    producer, single consumer ring of counters updated with atomic
+ *    operations, so an insert or a release costs no mutex. A thread
+ *    which finds the ring empty (or full) spins briefly and then parks
+ *    on a futex until the other side makes progress. A ring placed in
+ *    a ShmXferSegment does the same for two processes.
+ *
+ *  $Id$
+ *
+ */
+#ifndef PVTOL_LOCALXFERRING_H
+#define PVTOL_LOCALXFERRING_H
+
+#include <ConduitWakeup.h>
+
+#include <sched.h>
+#include <limits.h>
+#ifdef __linux__
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+#endif // __linux__
+
+namespace ipvtol
+{
+
+  /** LocalXferRing counts the frames inserted into, and released from,
+   *   a same process Conduit. Exactly one thread may insert and exactly
+   *   one thread may extract.
+   *
+   *   The producer's and the consumer's counters live on separate cache
+   *   lines so that the two threads do not false share.
+   *
+   * @see Conduit, CdtLocalXferData
+   */
+  class LocalXferRing
+  {
+  //++++++++++++++
+    public:
+  //++++++++++++++
+    LocalXferRing();
+
+    /** Empty the ring and set its depth. Not thread safe.
+     * @param  int the number of frames the ring holds
+     * @param  bool the ring is in memory shared between processes, so
+     *         its futexes may not be process private
+     * @return void
+     */
+    void reset(int depth, bool shared=false);
+
+    /** Get the number of frames the ring holds
+     * @return int
+     */
+    int getDepth() const;
+
+    /** Producer: bound the number of frames in flight to fewer than
+     *   the depth, for adaptive depth. Frames already in flight drain.
+     * @param  int the new bound, clamped to [1, depth]
+     * @return void
+     */
+    void setLimit(int limit);
+
+    /** Get the number of frames inserted but not yet released
+     * @return int
+     */
+    int numPosted() const;
+
+    /** Is there no frame to extract?
+     * @return bool
+     */
+    bool empty() const;
+
+    /** Is there no room to insert?
+     * @return bool
+     */
+    bool full() const;
+
+    /** Producer: make the frame just written available to the consumer
+     * @return void
+     */
+    void publish();
+
+    /** Consumer: give the frame just read back to the producer
+     * @return void
+     */
+    void consume();
+
+    /** Consumer: block until there is a frame to extract, or an EOC
+     * @return void
+     */
+    void waitForData();
+
+    /** Producer: block until there is room to insert
+     * @return void
+     */
+    void waitForSpace();
+
+    /** Producer: post an end of computation
+     * @return void
+     */
+    void postEOC();
+
+    /** Get the number of posted, uncleared, EOCs
+     * @return int
+     */
+    int eocPosted() const;
+
+    /** Consumer: clear one posted EOC
+     * @return void
+     */
+    void clearEOC();
+
+    /** Producer: discard the oldest frame waiting, for a lossy
+     *   Conduit which finds the ring full. Fails, leaving the ring as
+     *   it was, while the consumer has the oldest frame claimed.
+     * @return bool true if a frame was discarded
+     */
+    bool dropOldest();
+
+    /** Get the number of frames dropOldest() has discarded. Read by a
+     *   consumer holding its claim, to pass over their slots.
+     * @return unsigned int
+     */
+    unsigned int numDropped() const;
+
+    /** Consumer: keep the producer from discarding the oldest frame
+     *   until unclaim(); its consume()s may be made under the claim
+     * @return void
+     */
+    void claim();
+
+    /** Consumer: let the producer discard frames again
+     * @return void
+     */
+    void unclaim();
+
+    /** Consumer: also notify wakeup of each frame and EOC posted, for a
+     *   ConduitSelector. NULL stops the notifications. Not for a shared
+     *   ring, whose producer cannot reach the wakeup.
+     * @param  ConduitWakeup * the selector's wakeup
+     * @return void
+     */
+    void setWakeup(ConduitWakeup *wakeup);
+
+  //++++++++++++++
+    private:
+  //++++++++++++++
+    enum {
+        CACHE_LINE = 64,
+        SPIN_LIMIT  = 128,  // busy polls before a waiter yields
+        YIELD_LIMIT = 16    // yielding polls before a waiter parks
+    };
+    enum { NOBODY, PRODUCER, CONSUMER };
+
+    static void cpuRelax(int spin);
+    static void park(volatile int *seq, int seen, bool shared);
+    static void wake(volatile int *seq, bool shared);
+
+    //   Private Data
+    //-------------------------------------
+    char                   m_pad0[CACHE_LINE];
+
+    //  written by the producer
+    volatile unsigned int  m_head;
+    volatile int           m_dataSeq;        // futex word, data or EOC
+    volatile int           m_eocPosted;
+    unsigned int           m_limit;          // frames allowed in flight
+    char                   m_pad1[CACHE_LINE - 4*sizeof(int)];
+
+    //  written by the consumer
+    volatile unsigned int  m_tail;
+    volatile int           m_spaceSeq;       // futex word, room to insert
+    char                   m_pad2[CACHE_LINE - 2*sizeof(int)];
+
+    //  park flags are written by the side which parks; the pointer
+    //  leads so that the pad below has no alignment hole to account for.
+    //  Whichever side holds m_owner may move the tail of a lossy ring
+    ConduitWakeup *volatile m_wakeup;        // set by the consumer
+    volatile int           m_consumerParked;
+    volatile int           m_producerParked;
+    unsigned int           m_depth;
+    int                    m_shared;         // futexes are not private
+    volatile int           m_owner;          // NOBODY, PRODUCER, CONSUMER
+    volatile unsigned int  m_dropped;        // written under PRODUCER
+    char                   m_pad3[CACHE_LINE - sizeof(ConduitWakeup *) -
+                                  6*sizeof(int)];
+  };
+
+
+//                    I N L I N E   Methods
+//------------------------------------------------------------
+
+inline
+  LocalXferRing::LocalXferRing()
+   { reset(1); }
+
+inline
+  void LocalXferRing::reset(int depth, bool shared)
+   {
+     m_head           = 0;
+     m_tail           = 0;
+     m_dataSeq        = 0;
+     m_spaceSeq       = 0;
+     m_eocPosted      = 0;
+     m_consumerParked = 0;
+     m_producerParked = 0;
+     m_depth          = (depth > 0) ? depth : 1;
+     m_limit          = m_depth;
+     m_shared         = shared;
+     m_owner          = NOBODY;
+     m_dropped        = 0;
+     m_wakeup         = NULL;
+     __sync_synchronize();
+   }
+
+inline
+  int LocalXferRing::getDepth() const
+   { return(m_depth); }
+
+inline
+  void LocalXferRing::setLimit(int limit)
+   {
+     if (limit < 1)
+         limit = 1;
+     m_limit = ((unsigned int)limit < m_depth) ? limit : m_depth;
+   }
+
+inline
+  int LocalXferRing::numPosted() const
+   { return(m_head - m_tail); }
+
+inline
+  bool LocalXferRing::empty() const
+   { return(m_head == m_tail); }
+
+inline
+  bool LocalXferRing::full() const
+   { return((m_head - m_tail) >= m_limit); }
+
+inline
+  int LocalXferRing::eocPosted() const
+   { return(m_eocPosted); }
+
+inline
+  void LocalXferRing::publish()
+   {
+     // the frame's contents must be visible before the new head
+     __sync_synchronize();
+     m_head = m_head + 1;
+     __sync_fetch_and_add(&m_dataSeq, 1);
+     if (m_consumerParked)
+         wake(&m_dataSeq, m_shared);
+     if (m_wakeup)
+         m_wakeup->notify();
+   }
+
+inline
+  void LocalXferRing::consume()
+   {
+     __sync_synchronize();
+     m_tail = m_tail + 1;
+     __sync_fetch_and_add(&m_spaceSeq, 1);
+     if (m_producerParked)
+         wake(&m_spaceSeq, m_shared);
+   }
+
+inline
+  void LocalXferRing::postEOC()
+   {
+     __sync_fetch_and_add(&m_eocPosted, 1);
+     __sync_fetch_and_add(&m_dataSeq, 1);
+     if (m_consumerParked)
+         wake(&m_dataSeq, m_shared);
+     if (m_wakeup)
+         m_wakeup->notify();
+   }
+
+inline
+  void LocalXferRing::clearEOC()
+   { __sync_fetch_and_sub(&m_eocPosted, 1); }
+
+inline
+  bool LocalXferRing::dropOldest()
+   {
+     if (!__sync_bool_compare_and_swap(&m_owner, NOBODY, PRODUCER))
+         return(false);
+
+     bool  dropped = !empty();
+     if (dropped)
+       {
+         m_tail    = m_tail + 1;
+         m_dropped = m_dropped + 1;
+       }
+     __sync_synchronize();
+     m_owner = NOBODY;
+     return(dropped);
+   }
+
+inline
+  unsigned int LocalXferRing::numDropped() const
+   { return(m_dropped); }
+
+inline
+  void LocalXferRing::claim()
+   {
+     //  the producer only holds the ring for a few instructions
+     for (int i=0; !__sync_bool_compare_and_swap(&m_owner, NOBODY, CONSUMER);
+          i++)
+         cpuRelax(i);
+   }
+
+inline
+  void LocalXferRing::unclaim()
+   {
+     __sync_synchronize();
+     m_owner = NOBODY;
+   }
+
+inline
+  void LocalXferRing::setWakeup(ConduitWakeup *wakeup)
+   {
+     m_wakeup = wakeup;
+     __sync_synchronize();
+   }
+
+inline
+  void LocalXferRing::waitForData()
+   {
+     for (int i=0; i<SPIN_LIMIT+YIELD_LIMIT; i++)
+       {
+         if (!empty() || m_eocPosted)
+             return;
+         cpuRelax(i);
+       }
+
+     for (;;)
+       {
+         //  a publish after seen is read changes the futex word, so
+         //   the park below returns at once rather than sleeping
+         int   seen = m_dataSeq;
+         __sync_synchronize();
+         if (!empty() || m_eocPosted)
+             return;
+         __sync_fetch_and_add(&m_consumerParked, 1);
+         park(&m_dataSeq, seen, m_shared);
+         __sync_fetch_and_sub(&m_consumerParked, 1);
+       }
+   }
+
+inline
+  void LocalXferRing::waitForSpace()
+   {
+     for (int i=0; i<SPIN_LIMIT+YIELD_LIMIT; i++)
+       {
+         if (!full())
+             return;
+         cpuRelax(i);
+       }
+
+     for (;;)
+       {
+         int   seen = m_spaceSeq;
+         __sync_synchronize();
+         if (!full())
+             return;
+         __sync_fetch_and_add(&m_producerParked, 1);
+         park(&m_spaceSeq, seen, m_shared);
+         __sync_fetch_and_sub(&m_producerParked, 1);
+       }
+   }
+
+inline
+  void LocalXferRing::cpuRelax(int spin)
+   {
+     if (spin >= SPIN_LIMIT)
+       {//  let the other side run if it shares this processor
+         sched_yield();
+         return;
+       }
+#if defined(__i386__) || defined(__x86_64__)
+     __asm__ __volatile__("pause" ::: "memory");
+#else
+     __sync_synchronize();
+#endif
+   }
+
+inline
+  void LocalXferRing::park(volatile int *seq, int seen, bool shared)
+   {
+#ifdef __linux__
+     syscall(SYS_futex, const_cast<int *>(seq),
+             shared ? FUTEX_WAIT : FUTEX_WAIT_PRIVATE, seen, NULL, NULL, 0);
+#else
+     (void)shared;
+     sched_yield();
+#endif // __linux__
+   }
+
+inline
+  void LocalXferRing::wake(volatile int *seq, bool shared)
+   {
+#ifdef __linux__
+     syscall(SYS_futex, const_cast<int *>(seq),
+             shared ? FUTEX_WAKE : FUTEX_WAKE_PRIVATE, INT_MAX, NULL, NULL, 0);
+#else
+     (void)seq;
+     (void)shared;
+#endif // __linux__
+   }
+
+}// end namespace
+
+#endif // PVTOL_LOCALXFERRING_H not defined
@@ -0,0 +1,216 @@
+/**
+ *    File: MemoryLock.h
+ *
+ *  Copyright (c) 2008, Massachusetts Institute of Technology
+ *  All rights reserved.
+ *
+ *  \author  $LastChangedBy$
+ *  \date    $LastChangedDate$
+ *  \version $LastChangedRevision$
+ *  \brief   Definition of the MemoryLock class
+ *    MemoryLock prefaults buffers and locks them into memory at setup, so
+ *    that the first frames through a pipeline do not fault pages in one
+ *    at a time and later frames do not find them swapped out. It keeps a
+ *    count of the bytes locked by each owner, for a report.
+ *
+ *  $Id$
+ *
+ */
+#ifndef PVTOL_MEMORYLOCK_H
+#define PVTOL_MEMORYLOCK_H
+
+#include <map>
+#include <string>
+#include <ostream>
+#include <stddef.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <pthread.h>
+#ifdef __linux__
+#include <sys/mman.h>
+#endif // __linux__
+
+namespace ipvtol
+{
+
+  /** MemoryLock touches every page of a buffer, from the calling thread
+   *   so that a first touch NUMA policy places the pages near it, then
+   *   mlock()s them. Setup code should call it from the thread that will
+   *   use the buffer.
+   *
+   *   Locking fails quietly, e.g. beyond RLIMIT_MEMLOCK; the buffer is
+   *   still prefaulted and the bytes are not counted as locked. Locks
+   *   do not nest: unlocking a buffer unlocks any page it shares with
+   *   another buffer.
+   *
+   * @see HeterogeneousConduit, FramePool
+   */
+  class MemoryLock
+  {
+  //++++++++++++++
+    public:
+  //++++++++++++++
+
+    /** Touch every page of a buffer, keeping its contents
+     * @param  void * the buffer
+     * @param  size_t its length in bytes
+     * @return void
+     */
+    static void prefault(void *buf, size_t bytes);
+
+    /** Prefault a buffer and lock it into memory
+     * @param  string the owner, for the report
+     * @param  void * the buffer
+     * @param  size_t its length in bytes
+     * @return size_t the bytes locked, 0 if the lock failed
+     */
+    static size_t lock(const std::string &owner, void *buf, size_t bytes);
+
+    /** Unlock a buffer locked by lock()
+     * @param  string the owner, as given to lock()
+     * @param  void * the buffer
+     * @param  size_t what lock() returned
+     * @return void
+     */
+    static void unlock(const std::string &owner, void *buf, size_t bytes);
+
+    /** Get the bytes an owner has locked
+     * @param  string the owner
+     * @return size_t
+     */
+    static size_t getLockedBytes(const std::string &owner);
+
+    /** Write the bytes locked by each owner, one owner a line
+     * @param  ostream ref
+     * @return void
+     */
+    static void report(std::ostream &os);
+
+  //++++++++++++++
+    private:
+  //++++++++++++++
+    typedef std::map<std::string, size_t>  OwnerMap;
+
+    static OwnerMap & owners();
+    static pthread_mutex_t & mutex();
+    static void pageRange(void *buf, size_t bytes, char *&first,
+                          size_t &len);
+  };
+
+
+//                    I N L I N E   Methods
+//------------------------------------------------------------
+
+inline
+  void MemoryLock::prefault(void *buf, size_t bytes)
+   {
+     if ((buf == NULL) || (bytes == 0))
+         return;
+     size_t            page = sysconf(_SC_PAGESIZE);
+     volatile char    *p = (volatile char *)buf;
+     //  a write, not just a read, so that a zero page is not shared
+     for (size_t off=0; off<bytes; off+=page)
+         p[off] = p[off];
+     p[bytes-1] = p[bytes-1];
+   }
+
+inline
+  size_t MemoryLock::lock(const std::string &owner, void *buf, size_t bytes)
+   {
+     prefault(buf, bytes);
+#ifdef __linux__
+     char    *first;
+     size_t   len;
+     pageRange(buf, bytes, first, len);
+     if ((len == 0) || (mlock(first, len) != 0))
+         return(0);
+
+     pthread_mutex_lock(&mutex());
+     owners()[owner] += bytes;
+     pthread_mutex_unlock(&mutex());
+     return(bytes);
+#else
+     (void)owner;
+     return(0);
+#endif // __linux__
+   }
+
+inline
+  void MemoryLock::unlock(const std::string &owner, void *buf, size_t bytes)
+   {
+     if (bytes == 0)
+         return;
+#ifdef __linux__
+     char    *first;
+     size_t   len;
+     pageRange(buf, bytes, first, len);
+     munlock(first, len);
+#endif // __linux__
+
+     pthread_mutex_lock(&mutex());
+     OwnerMap::iterator   it = owners().find(owner);
+     if (it != owners().end())
+       {
+         it->second = (it->second > bytes) ? it->second - bytes : 0;
+         if (it->second == 0)
+             owners().erase(it);
+       }
+     pthread_mutex_unlock(&mutex());
+   }
+
+inline
+  size_t MemoryLock::getLockedBytes(const std::string &owner)
+   {
+     size_t   bytes = 0;
+     pthread_mutex_lock(&mutex());
+     OwnerMap::const_iterator   it = owners().find(owner);
+     if (it != owners().end())
+         bytes = it->second;
+     pthread_mutex_unlock(&mutex());
+     return(bytes);
+   }
+
+inline
+  void MemoryLock::report(std::ostream &os)
+   {
+     pthread_mutex_lock(&mutex());
+     size_t   total = 0;
+     for (OwnerMap::const_iterator it=owners().begin(); it!=owners().end();
+          ++it)
+       {
+         os << "  " << it->first << ": " << it->second << " bytes locked"
+            << std::endl;
+         total += it->second;
+       }
+     os << "  total: " << total << " bytes locked" << std::endl;
+     pthread_mutex_unlock(&mutex());
+   }
+
+inline
+  MemoryLock::OwnerMap & MemoryLock::owners()
+   {
+     static OwnerMap   s_owners;
+     return(s_owners);
+   }
+
+inline
+  pthread_mutex_t & MemoryLock::mutex()
+   {
+     static pthread_mutex_t   s_mutex = PTHREAD_MUTEX_INITIALIZER;
+     return(s_mutex);
+   }
+
+inline
+  void MemoryLock::pageRange(void *buf, size_t bytes, char *&first,
+                             size_t &len)
+   {
+     uintptr_t   page  = sysconf(_SC_PAGESIZE);
+     uintptr_t   start = (uintptr_t)buf & ~(page - 1);
+     uintptr_t   end   = ((uintptr_t)buf + bytes + page - 1) & ~(page - 1);
+     first = (char *)start;
+     len   = (buf == NULL) ? 0 : end - start;
+   }
+
+}// end namespace
+
+#endif // PVTOL_MEMORYLOCK_H not defined
@@ -0,0 +1,531 @@
+/**
+ * File: MergeConduit.h
+ *
+ *  Copyright (c) 2008, Massachusetts Institute of Technology
+ *  All rights reserved.
+ *
+ *  \author  $LastChangedBy$
+ *  \date    $LastChangedDate$
+ *  \version $LastChangedRevision$
+ *  \brief   Class definition  & inline methods of MergeConduit
+ *            MergeInsertIf & MergeExtractIf
+ *            the MergeConduit class provides a means to collect the
+ *              frames of several producers (replicas of a task, or
+ *              parallel branches of a pipeline) back into one consumer,
+ *              in sequence number order or in arrival order.
+ *
+ *            The MergeInsertIf class provides a constrained API for one
+ *            of the source ends of a MergeConduit.
+ *            The MergeExtractIf class provides a constrained API for the
+ *            destination end of a MergeConduit.
+ *
+ *  $Id$
+ *
+ */
+
+#ifndef PVTOL_MERGECONDUIT_H
+#define PVTOL_MERGECONDUIT_H
+
+#include <vector>
+#include <string>
+
+#include <Conduit.h>
+#include <ConduitWakeup.h>
+
+
+namespace ipvtol
+{
+  using std::string;
+  using std::vector;
+
+
+  /* forward declarations needed for the MergeConduit class */
+
+  template <class DATATYPE, class TAGTYPE> class MergeInsertIf;
+  template <class DATATYPE, class TAGTYPE> class MergeExtractIf;
+
+  /**
+   * The tag carried by each of a MergeConduit's inputs: the user's tag
+   * and, if the producer supplied one, the frame's global sequence
+   * number.
+   */
+  template <class TAGTYPE>
+  struct MergeTag
+  {
+    TAGTYPE   m_tag;
+    int       m_seqNum;   // -1 if not supplied by the producer
+  };
+
+  /**
+   * The MergeConduit class collects the frames of numInputs producers
+   * into a single consumer. Each producer has an input of its own, an
+   * ordinary Conduit, so producers and consumer may be in the same or in
+   * different processes.
+   *
+   * With SEQUENCE ordering the consumer receives the frames in the order
+   * of their sequence numbers. A producer may give a frame's number with
+   * MergeInsertIf::setSeqNum(), for instance the number a LoadAware
+   * Conduit delivered it with; otherwise the k-th frame of input i is
+   * numbered k * numInputs + i, undoing a round robin fan-out. The
+   * latter uses the sequence numbers the inputs already keep in their
+   * tags (TagSeqNumWrapper).
+   *
+   * Frames which arrive early wait in their input, so the reorder
+   * buffer is bounded by the inputs' depths, and a producer which runs
+   * too far ahead is held back by its input filling. When every input
+   * holds a frame, or has reached its EOC, and none is the next number,
+   * that number was never sent, and the smallest is delivered instead.
+   *
+   * With ARRIVAL ordering the inputs are visited by turns and the first
+   * frame found is delivered.
+   *
+   * Each producer ends its stream with MergeInsertIf::insertEOC(); the
+   * MergeConduit is at its EOC once every input has delivered its frames
+   * and reached its EOC; MergeExtractIf::wait() then returns false.
+   * While it waits the consumer sleeps on a ConduitWakeup, which the
+   * inputs fed from the same process notify; inputs fed by MPI are
+   * polled between sleeps.
+   *
+   * The consumer must be a single thread; each producer thread must use
+   * only its own input.
+   *
+   * @see Conduit, MulticastConduit
+   *
+   * */
+
+  template <class DATATYPE, class TAGTYPE = NullConduitTag>
+  class MergeConduit
+  {
+  public:
+    typedef MergeInsertIf<DATATYPE, TAGTYPE> InsertIf;
+    typedef MergeExtractIf<DATATYPE, TAGTYPE> ExtractIf;
+    typedef Conduit<DATATYPE, MergeTag<TAGTYPE>, true> InputConduit;
+
+    typedef enum
+    {
+        SEQUENCE,
+        ARRIVAL
+    } OrderType;
+
+  public:
+    typedef DATATYPE DataType;
+
+    // CONSTRUCTORS
+
+    /**
+     * @param name the name of the conduit
+     * @param numInputs the number of producers
+     * @param order the order in which frames are extracted
+     *
+     */
+    MergeConduit(const string& name, int numInputs,
+                 OrderType order = SEQUENCE);
+
+    /**
+     */
+    virtual ~MergeConduit() throw();
+
+    // INITIALIZATION METHODS
+
+  public:
+    /**
+     * @param input which producer's interface, 0 to numInputs-1
+     */
+    InsertIf getInsertIf(int input);
+
+    ExtractIf getExtractIf(void);
+
+    /**
+     * setupComplete() must be called after the source ends and the
+     * destination end have been set up, by every thread which would
+     * call setupComplete() on each input Conduit.
+     *
+     */
+    void
+    setupComplete();
+
+    /**
+     * @return the number of producers
+     */
+    int getNumInputs() const;
+
+  private:
+    void setupSrc(int input, const DataMap& srcMap, int depth,
+                  const unsigned int lengths[]);
+    void setupDest(const DataMap& destMap, int depth,
+                   const unsigned int lengths[]);
+
+    // SOURCE END METHODS
+    bool      insertAvailable(int input);
+    DATATYPE& getInsertHandle(int input);
+    TAGTYPE&  getInsertTagHandle(int input);
+    void      setInsertSeqNum(int input, int seqNum);
+    void      insert(int input);
+
+    void      insertEOC(int input);
+
+    // DESTINATION END METHODS
+    int       selectInput();
+    int       frameSeqNum(int input);
+    bool      inputsAtEOC();
+    bool      waitForFrame();
+    bool      extractReady();
+    bool      isAtEOC();
+    void      clearEOC();
+    DATATYPE& getExtractHandle();
+    TAGTYPE&  getExtractTagHandle();
+    int       getExtractSeqNum();
+    int       getExtractInput();
+    void      release();
+
+  private:
+    enum {
+        SPIN_LIMIT  = 64,   // busy checks before a wait yields
+        YIELD_LIMIT = 16    // yielding checks before a wait sleeps
+    };
+
+    string                     m_name;
+    OrderType                  m_order;
+    vector<InputConduit *>     m_inputs;
+    vector<int>                m_insertSeqNums;  // per input, -1 if none
+
+    //  used by the consumer only
+    int                        m_current;        // input being extracted
+    int                        m_currentSeqNum;
+    int                        m_nextSeqNum;     // SEQUENCE ordering
+    int                        m_nextInput;      // ARRIVAL ordering
+    ConduitWakeup              m_wakeup;
+    bool                       m_wakeupSet;
+    int                        m_numRemote;      // inputs which can not notify
+    double                     m_pollInterval;
+
+    // methods declared private to prevent their use
+    //    Assignment Operator, Copy Constructor
+    //-------------------------------------
+    MergeConduit& operator=(const MergeConduit& rhs);
+    MergeConduit(const MergeConduit& other);
+
+  public:
+
+    friend class MergeInsertIf<DATATYPE, TAGTYPE>;
+    friend class MergeExtractIf<DATATYPE, TAGTYPE>;
+
+  };//end class MergeConduit
+
+
+  /**
+   * The MergeExtractIf class provides a constrained API for the
+   * destination end of a MergeConduit.
+   *
+   * @see MergeConduit
+   *
+   * */
+
+  template <class DATATYPE, class TAGTYPE = NullConduitTag>
+  class MergeExtractIf
+  {
+  private:
+    MergeConduit<DATATYPE, TAGTYPE>* m_conduit;
+
+  public:
+
+    // CONSTRUCTORS
+
+    /**
+     * Default constructor.
+     *
+     */
+    MergeExtractIf(void)
+    {
+      m_conduit = NULL;
+    };
+
+    /**
+     * @param cdt the conduit for which this MergeExtractIf is an
+     * interface
+     */
+    MergeExtractIf(MergeConduit<DATATYPE, TAGTYPE>& cdt)
+    {
+      m_conduit = &cdt;
+    };
+
+    // ASSIGNMENT OPERATOR
+
+    /**
+     */
+    MergeExtractIf& operator=(MergeExtractIf& dif)
+    {
+      m_conduit = dif.m_conduit;
+      return dif;
+    };
+
+    /**@name initialization methods
+     */
+    //@{
+
+  public:
+
+    /**
+     * Sets up the destination end of every input.
+     *
+     * @param destMap the map which defines the distribution of the
+     * destination end of the conduit.
+     *
+     * @param depth the multi-buffering depth of each input
+     *
+     * @param lengths length of each dimension of the destination object
+     */
+    void
+    setup(const DataMap& destMap, int depth, const unsigned int lengths[])
+    {
+      m_conduit->setupDest(destMap, depth, lengths);
+    };
+
+    //@}
+
+
+    /**@name runtime methods
+     */
+    //@{
+
+  public:
+
+    /**
+     * Queries whether the next frame, in the conduit's order, has
+     * arrived.
+     *
+     * @return Returns true if a frame may be extracted.
+     */
+    bool ready()
+    {
+      return m_conduit->extractReady();
+    };
+
+    /**
+     * Blocks until the next frame has arrived or every producer's
+     * stream has ended.
+     *
+     * @return Returns true if a frame may be extracted, false at the
+     *         end of the streams.
+     */
+    bool wait()
+    {
+      return m_conduit->waitForFrame();
+    };
+
+    /**
+     * Queries whether every producer's stream has ended, i.e. each
+     * input has delivered its frames and reached its EOC.
+     *
+     * @return Returns true at the end of the streams.
+     */
+    bool isAtEOC()
+    {
+      return m_conduit->isAtEOC();
+    };
+
+    /**
+     * Clears the EOC of every input, so the producers may start new
+     * streams.
+     *
+     */
+    void clearEOC()
+    {
+      m_conduit->clearEOC();
+    };
+
+    /**
+     * Gives access to the next frame. This is a Blocking call; it
+     * throws if the streams end before another frame arrives, so a
+     * consumer which uses EOCs should call wait() first.
+     *
+     * @return a reference to the conduit data object.  */
+    DATATYPE& getHandle()
+    {
+      return m_conduit->getExtractHandle();
+    };
+
+    /**
+     * Gives access to the next frame's tag. This is a Blocking call.
+     *
+     * @return a reference to the tag.  */
+    TAGTYPE& getTagHandle()
+    {
+      return m_conduit->getExtractTagHandle();
+    };
+
+    /**
+     * Gets the next frame's sequence number. This is a Blocking call.
+     *
+     * @return the sequence number  */
+    int getSeqNum()
+    {
+      return m_conduit->getExtractSeqNum();
+    };
+
+    /**
+     * Gets the producer of the next frame. This is a Blocking call.
+     *
+     * @return the input, 0 to numInputs-1  */
+    int getInput()
+    {
+      return m_conduit->getExtractInput();
+    };
+
+    /**
+     * Releases the buffer space so that it can be re-used by another
+     * transfer.
+     *
+     */
+    void release()
+    {
+      m_conduit->release();
+    };
+    //@}
+
+  };//end class MergeExtractIf
+
+
+  /**
+   * The MergeInsertIf class provides a constrained API for one source
+   * end of a MergeConduit.
+   *
+   * @see MergeConduit
+   *
+   */
+
+  template <class DATATYPE, class TAGTYPE = NullConduitTag>
+  class MergeInsertIf
+  {
+  private:
+    MergeConduit<DATATYPE, TAGTYPE>* m_conduit;
+    int                              m_input;
+
+  public:
+    // INITIALIZATION METHODS
+
+    /**
+     * Default constructor.
+     *
+     */
+    MergeInsertIf(void)
+    {
+      m_conduit = NULL;
+      m_input   = -1;
+    };
+
+    /**
+     * @param cdt the conduit for which this MergeInsertIf is an
+     * interface
+     * @param input the producer's input
+     */
+    MergeInsertIf(MergeConduit<DATATYPE, TAGTYPE>& cdt, int input)
+    {
+      m_conduit = &cdt;
+      m_input   = input;
+    };
+
+    /**
+     */
+    MergeInsertIf& operator=(MergeInsertIf& sif)
+    {
+      m_conduit = sif.m_conduit;
+      m_input   = sif.m_input;
+      return sif;
+    };
+
+    /**@name initialization methods
+     */
+    //@{
+  public:
+
+    /**
+     * @param srcMap the map which defines the distribution of this
+     * producer's end of the conduit.
+     *
+     * @param depth the multi-buffering depth of this producer's input
+     *
+     * @param lengths length of each dimension of the source object
+     */
+    void setup(const DataMap& srcMap, int depth,
+               const unsigned int lengths[])
+    {
+      m_conduit->setupSrc(m_input, srcMap, depth, lengths);
+    };
+
+    //@}
+
+
+    /**@name runtime methods
+     */
+    //@{
+  public:
+
+    /**
+     * Queries whether the input is able to provide the buffer space
+     * needed for an outgoing transfer.
+     *
+     * @return returns true when a buffer is free.
+     */
+    bool available()
+    {
+      return m_conduit->insertAvailable(m_input);
+    };
+
+    /**
+     * Gives access to the data object which provides a
+     * view of the next available buffer space.
+     *
+     * @return a reference to the conduit data object.
+     */
+    DATATYPE& getHandle()
+    {
+      return m_conduit->getInsertHandle(m_input);
+    };
+
+    /**
+     * Gives access to the tag of the next available buffer space.
+     *
+     * @return a reference to the tag.
+     */
+    TAGTYPE& getTagHandle()
+    {
+      return m_conduit->getInsertTagHandle(m_input);
+    };
+
+    /**
+     * Gives the global sequence number of the frame about to be
+     * inserted. Numbers must increase along each input.
+     *
+     * @param seqNum the frame's sequence number
+     */
+    void setSeqNum(int seqNum)
+    {
+      m_conduit->setInsertSeqNum(m_input, seqNum);
+    };
+
+    /**
+     * Sends the current source buffer to the consumer.
+     * */
+    void insert()
+    {
+      m_conduit->insert(m_input);
+    };
+
+    /**
+     * Ends this producer's stream.
+     * */
+    void insertEOC()
+    {
+      m_conduit->insertEOC(m_input);
+    };
+
+    //@}
+  };//end class MergeInsertIf
+
+}//end namespace
+
+#include <MergeConduit.inl>
+
+#endif // PVTOL_MERGECONDUIT_H
+// End of MergeConduit.h
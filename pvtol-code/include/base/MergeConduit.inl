@@ -0,0 +1,437 @@
+/**
+ * File: MergeConduit.inl
+ *
+ *  Copyright (c) 2008, Massachusetts Institute of Technology
+ *  All rights reserved.
+ *
+ *  \author  $LastChangedBy$
+ *  \date    $LastChangedDate$
+ *  \version $LastChangedRevision$
+ *  \brief   Methods of the MergeConduit
+ *             The MergeConduit class collects the frames of several
+ *             producers into one consumer, in sequence number order or
+ *             in arrival order.
+ *
+ *     See Also: MergeConduit.h
+ *
+ *  $Id$
+ *
+ */
+#ifndef PVTOL_MergeConduit_inl
+#define PVTOL_MergeConduit_inl
+
+#include <PvtolBasics.h>
+#include <MergeConduit.h>
+
+#include <sched.h>
+#include <stdio.h>
+
+namespace ipvtol
+{
+  //------------------------------------------------------------------
+
+  template<class DATATYPE, class TAGTYPE>
+  MergeConduit<DATATYPE, TAGTYPE>::MergeConduit(const string& name,
+                                                int numInputs,
+                                                OrderType order)
+    : m_name(name),
+      m_order(order),
+      m_current(-1),
+      m_currentSeqNum(-1),
+      m_nextSeqNum(0),
+      m_nextInput(0),
+      m_wakeupSet(false),
+      m_numRemote(0),
+      m_pollInterval(50.0e-6)
+  {
+    if (numInputs < 1)
+      {
+          throw Exception("MergeCdt: needs at least one input.",
+	                  __FILE__, __LINE__);
+      }
+
+    char  ostr[32];
+    for (int i = 0; i < numInputs; i++)
+      {
+        sprintf(ostr, ":in%d", i);
+        m_inputs.push_back(new InputConduit(name + ostr));
+      }
+    m_insertSeqNums.resize(numInputs, -1);
+  }
+
+  template<class DATATYPE, class TAGTYPE>
+  MergeConduit<DATATYPE, TAGTYPE>::~MergeConduit() throw()
+  {
+    for (unsigned i = 0; i < m_inputs.size(); i++)
+      {
+        delete m_inputs[i];
+      }
+  }
+
+  template<class DATATYPE, class TAGTYPE>
+  MergeInsertIf<DATATYPE, TAGTYPE>
+  MergeConduit<DATATYPE, TAGTYPE>::getInsertIf(int input)
+  {
+#ifdef PVTOL_DEVELOP
+    if (input < 0 || input >= (int)m_inputs.size())
+      {
+          throw Exception("MergeCdt: no such input.", __FILE__, __LINE__);
+      }
+#endif // PVTOL_DEVELOP
+
+    MergeInsertIf<DATATYPE, TAGTYPE> iif(*this, input);
+    return iif;
+  }
+
+  template<class DATATYPE, class TAGTYPE>
+  int MergeConduit<DATATYPE, TAGTYPE>::getNumInputs() const
+  {
+    return m_inputs.size();
+  }
+
+  template<class DATATYPE, class TAGTYPE>
+  void MergeConduit<DATATYPE, TAGTYPE>::setupSrc(int input,
+                                                 const DataMap& srcMap,
+                                                 int depth,
+                                                 const unsigned int lengths[])
+  {
+    m_inputs[input]->getInsertIf().setup(srcMap, depth, lengths);
+
+    return;
+  }
+
+  //-------------------------------------------------------
+  // destination end setup methods
+  //-------------------------------------------------------
+
+  template <class DATATYPE, class TAGTYPE>
+  MergeExtractIf<DATATYPE, TAGTYPE>
+  MergeConduit<DATATYPE, TAGTYPE>::getExtractIf(void)
+  {
+    MergeExtractIf<DATATYPE, TAGTYPE> eif(*this);
+    return eif;
+  };
+
+  template<class DATATYPE, class TAGTYPE>
+  void MergeConduit<DATATYPE, TAGTYPE>::setupDest(const DataMap& dstMap,
+                                                  int depth,
+                                                  const unsigned int lengths[])
+  {
+    for (unsigned i = 0; i < m_inputs.size(); i++)
+      {
+        m_inputs[i]->getExtractIf().setup(dstMap, depth, lengths);
+      }
+
+    return;
+  }
+
+  //-------------------------------------------------------
+
+  template<class DATATYPE, class TAGTYPE>
+  void MergeConduit<DATATYPE, TAGTYPE>::setupComplete(void)
+  {
+    for (unsigned i = 0; i < m_inputs.size(); i++)
+      {
+        m_inputs[i]->setupComplete();
+      }
+  }
+
+  //------------------------------------------------------------------
+
+  template <class DATATYPE, class TAGTYPE>
+  bool MergeConduit<DATATYPE, TAGTYPE>::insertAvailable(int input)
+  {
+    return m_inputs[input]->insertAvailable();
+  }
+
+  template <class DATATYPE, class TAGTYPE>
+  DATATYPE& MergeConduit<DATATYPE, TAGTYPE>::getInsertHandle(int input)
+  {
+    return m_inputs[input]->getInsertHandle();
+  }
+
+  template <class DATATYPE, class TAGTYPE>
+  TAGTYPE& MergeConduit<DATATYPE, TAGTYPE>::getInsertTagHandle(int input)
+  {
+    return m_inputs[input]->getInsertTagHandle().m_tag;
+  }
+
+  template <class DATATYPE, class TAGTYPE>
+  void MergeConduit<DATATYPE, TAGTYPE>::setInsertSeqNum(int input,
+                                                        int seqNum)
+  {
+#ifdef PVTOL_DEVELOP
+    if (seqNum < 0)
+      {
+          throw Exception("MergeCdt: sequence numbers may not be negative.",
+	                  __FILE__, __LINE__);
+      }
+#endif // PVTOL_DEVELOP
+
+    m_insertSeqNums[input] = seqNum;
+  }
+
+  template <class DATATYPE, class TAGTYPE>
+  void MergeConduit<DATATYPE, TAGTYPE>::insert(int input)
+  {
+    // the slot's tag may hold the number of a frame sent before
+    m_inputs[input]->getInsertTagHandle().m_seqNum = m_insertSeqNums[input];
+    m_insertSeqNums[input] = -1;
+
+    m_inputs[input]->insert();
+  }
+
+  template <class DATATYPE, class TAGTYPE>
+  void MergeConduit<DATATYPE, TAGTYPE>::insertEOC(int input)
+  {
+    m_inputs[input]->insertEOC();
+  }
+
+  //------------------------------------------------------------------
+
+  //------------------------------------------------------------------------
+  //  Method:     frameSeqNum
+  //
+  //  Description: Gets the sequence number of the frame waiting in an
+  //               input; the producer's, or else one derived from the
+  //               input's own numbering. The frame must have arrived.
+  //
+  //  Inputs: the input
+  //  Returns: int
+  //
+  //------------------------------------------------------------------------
+  template <class DATATYPE, class TAGTYPE>
+  int MergeConduit<DATATYPE, TAGTYPE>::frameSeqNum(int input)
+  {
+    MergeTag<TAGTYPE> &tag = m_inputs[input]->getExtractTagHandle();
+    if (tag.m_seqNum >= 0)
+        return(tag.m_seqNum);
+
+    return(m_inputs[input]->getExtractSeqNum() * m_inputs.size() + input);
+  }
+
+  //------------------------------------------------------------------------
+  //  Method:     selectInput
+  //
+  //  Description: Finds the input holding the next frame to extract. In
+  //               SEQUENCE order that is the frame with the next number,
+  //               or, once every input holds a frame or is at its EOC,
+  //               the lowest number. The choice stands until the frame
+  //               is released.
+  //
+  //  Inputs: none
+  //  Returns: the input, or -1 if the next frame has not yet arrived
+  //
+  //------------------------------------------------------------------------
+  template <class DATATYPE, class TAGTYPE>
+  int MergeConduit<DATATYPE, TAGTYPE>::selectInput()
+  {
+    if (m_current >= 0)
+        return(m_current);
+
+    int   numInputs = m_inputs.size();
+
+    if (m_order == ARRIVAL)
+      {
+        for (int k = 0; k < numInputs; k++)
+          {
+            int   i = (m_nextInput + k) % numInputs;
+            if (m_inputs[i]->extractReady())
+              {
+                m_current       = i;
+                m_currentSeqNum = frameSeqNum(i);
+                m_nextInput     = (i + 1) % numInputs;
+                break;
+              }
+          }//endFor k
+
+        return(m_current);
+      }//endIf ARRIVAL
+
+    int   best     = -1;
+    int   bestSeq  = 0;
+    int   numReady = 0;   // inputs holding a frame, or at their EOC
+    for (int i = 0; i < numInputs; i++)
+      {
+        if (!m_inputs[i]->extractReady())
+          {// an input whose stream has ended will send nothing earlier
+            if (m_inputs[i]->isAtEOC())
+                numReady++;
+            continue;
+          }
+
+        numReady++;
+        int   seqNum = frameSeqNum(i);
+        if (seqNum <= m_nextSeqNum)
+          {// the next frame, or one overtaken by a gap
+            best     = i;
+            bestSeq  = seqNum;
+            numReady = numInputs;
+            break;
+          }
+        if (best < 0 || seqNum < bestSeq)
+          {
+            best    = i;
+            bestSeq = seqNum;
+          }
+      }//endFor i
+
+    // an input with nothing yet may still send the next number
+    if (best < 0 || numReady < numInputs)
+        return(-1);
+
+    m_current       = best;
+    m_currentSeqNum = bestSeq;
+
+    return(m_current);
+  }
+
+  template <class DATATYPE, class TAGTYPE>
+  bool MergeConduit<DATATYPE, TAGTYPE>::extractReady()
+  {
+    return(selectInput() >= 0);
+  }
+
+  //------------------------------------------------------------------------
+  //  Method:     inputsAtEOC
+  //
+  //  Description: Checks whether every input has delivered its frames
+  //               and reached its EOC.
+  //
+  //  Inputs: none
+  //  Returns: bool
+  //
+  //------------------------------------------------------------------------
+  template <class DATATYPE, class TAGTYPE>
+  bool MergeConduit<DATATYPE, TAGTYPE>::inputsAtEOC()
+  {
+    for (unsigned i = 0; i < m_inputs.size(); i++)
+      {
+        if (!m_inputs[i]->isAtEOC())
+            return(false);
+      }
+    return(true);
+  }
+
+  //------------------------------------------------------------------------
+  //  Method:     waitForFrame
+  //
+  //  Description: Waits until the next frame can be selected or every
+  //               input is at its EOC. Like ConduitSelector::wait() it
+  //               spins, then yields, then sleeps on the wakeup, which the
+  //               inputs fed from this process notify when a frame or an
+  //               EOC is inserted. While any input is fed by MPI the sleep
+  //               is bounded by the poll interval.
+  //
+  //  Inputs: none
+  //  Returns: true if a frame may be extracted, false at the EOC
+  //
+  //------------------------------------------------------------------------
+  template <class DATATYPE, class TAGTYPE>
+  bool MergeConduit<DATATYPE, TAGTYPE>::waitForFrame()
+  {
+    if (!m_wakeupSet)
+      {// the consumer's first wait; the inputs are set up by now
+        for (unsigned i = 0; i < m_inputs.size(); i++)
+          {
+            if (!m_inputs[i]->setExtractWakeup(&m_wakeup))
+                m_numRemote++;
+          }
+        m_wakeupSet = true;
+      }
+
+    for (int i=0; i<SPIN_LIMIT+YIELD_LIMIT; i++)
+      {
+        if (selectInput() >= 0)
+            return(true);
+        if (inputsAtEOC())
+            return(selectInput() >= 0);
+        if (i >= SPIN_LIMIT)
+            sched_yield();
+      }
+
+    for (;;)
+      {
+        //  a notify after seen is read changes the futex word, so
+        //   the wait below returns at once rather than sleeping
+        int   seen = m_wakeup.getSeq();
+        __sync_synchronize();
+        if (selectInput() >= 0)
+            return(true);
+        if (inputsAtEOC())
+            return(selectInput() >= 0);
+        m_wakeup.wait(seen, (m_numRemote > 0) ? m_pollInterval : -1.0);
+      }
+  }
+
+  template <class DATATYPE, class TAGTYPE>
+  bool MergeConduit<DATATYPE, TAGTYPE>::isAtEOC()
+  {
+    return((m_current < 0) && (selectInput() < 0) && inputsAtEOC());
+  }
+
+  template <class DATATYPE, class TAGTYPE>
+  void MergeConduit<DATATYPE, TAGTYPE>::clearEOC()
+  {
+    for (unsigned i = 0; i < m_inputs.size(); i++)
+      {
+        m_inputs[i]->clearEOC();
+      }
+  }
+
+  template <class DATATYPE, class TAGTYPE>
+  DATATYPE& MergeConduit<DATATYPE, TAGTYPE>::getExtractHandle()
+  {
+    if (selectInput() < 0)
+      {
+        if (!waitForFrame())
+          {
+            throw Exception("MergeCdt: every input is at its EOC.",
+                            __FILE__, __LINE__);
+          }
+      }
+
+    return m_inputs[m_current]->getExtractHandle();
+  }
+
+  template <class DATATYPE, class TAGTYPE>
+  TAGTYPE& MergeConduit<DATATYPE, TAGTYPE>::getExtractTagHandle()
+  {
+    getExtractHandle();
+    return m_inputs[m_current]->getExtractTagHandle().m_tag;
+  }
+
+  template <class DATATYPE, class TAGTYPE>
+  int MergeConduit<DATATYPE, TAGTYPE>::getExtractSeqNum()
+  {
+    getExtractHandle();
+    return(m_currentSeqNum);
+  }
+
+  template <class DATATYPE, class TAGTYPE>
+  int MergeConduit<DATATYPE, TAGTYPE>::getExtractInput()
+  {
+    getExtractHandle();
+    return(m_current);
+  }
+
+  template <class DATATYPE, class TAGTYPE>
+  void MergeConduit<DATATYPE, TAGTYPE>::release()
+  {
+#ifdef PVTOL_DEVELOP
+    if (m_current < 0)
+      {
+          throw Exception("MergeCdt: release when no frame extracted.",
+	                  __FILE__, __LINE__);
+      }
+#endif // PVTOL_DEVELOP
+
+    m_inputs[m_current]->release();
+    if (m_currentSeqNum >= m_nextSeqNum)
+        m_nextSeqNum = m_currentSeqNum + 1;
+    m_current = -1;
+  }
+
+}
+
+#endif //  PVTOL_MergeConduit_inl
@@ -0,0 +1,374 @@
+/**
+ *    File: MpmcIndexRing.h
+ *
+ *  Copyright (c) 2008, Massachusetts Institute of Technology
+ *  All rights reserved.
+ *
+ *  \author  $LastChangedBy$
+ *  \date    $LastChangedDate$
+ *  \version $LastChangedRevision$
+ *  \brief   Definition of the MpmcIndexRing class
+ *    A MpmcIndexRing is a bounded, lock-free, multiple producer, multiple
+ *    consumer queue of slot indices. Each cell carries a sequence number
+ *    which tells a producer that the cell is free and a consumer that it
+ *    is full, so a push or a pop costs one compare-and-swap. A thread
+ *    which finds the ring empty (or full) spins briefly and then parks on
+ *    a futex until another thread makes progress.
+ *
+ *  $Id$
+ *
+ */
+#ifndef PVTOL_MPMCINDEXRING_H
+#define PVTOL_MPMCINDEXRING_H
+
+#include <Exception.h>
+
+#include <sched.h>
+#include <stdlib.h>
+#include <limits.h>
+#ifdef __linux__
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+#endif // __linux__
+
+namespace ipvtol
+{
+
+  /** MpmcIndexRing queues the indices of preallocated objects, so that
+   *   the objects themselves, and their reference counts, are never
+   *   touched by the queue. Any number of threads may push and pop.
+   *
+   *   The producers' and the consumers' positions live on separate cache
+   *   lines. The wait counters are written only when a thread parks, so
+   *   a push or a pop which finds no thread asleep makes no system call
+   *   and no extra atomic operation.
+   *
+   * @see SharedConduit, LocalXferRing
+   */
+  class MpmcIndexRing
+  {
+  //++++++++++++++
+    public:
+  //++++++++++++++
+    MpmcIndexRing();
+    ~MpmcIndexRing();
+
+    /** Empty the ring and size it. Not thread safe.
+     * @param  int the number of indices the ring must hold, rounded
+     *          up to a power of 2
+     * @return void
+     */
+    void reset(int capacity);
+
+    /** Get the number of indices the ring holds
+     * @return int
+     */
+    int getCapacity() const;
+
+    /** Get the number of indices queued; exact only when no other
+     *   thread is pushing or popping
+     * @return int
+     */
+    int size() const;
+
+    /** Is the ring empty? As for size()
+     * @return bool
+     */
+    bool empty() const;
+
+    /** Queue an index unless the ring is full
+     * @param  unsigned int the index
+     * @return bool false if the ring was full
+     */
+    bool tryPush(unsigned int idx);
+
+    /** Take the oldest index unless the ring is empty
+     * @param  unsigned int ref receives the index
+     * @return bool false if the ring was empty
+     */
+    bool tryPop(unsigned int &idx);
+
+    /** Queue an index, waiting while the ring is full
+     * @param  unsigned int the index
+     * @return void
+     */
+    void push(unsigned int idx);
+
+    /** Take the oldest index, waiting while the ring is empty
+     * @param  unsigned int ref receives the index
+     * @return void
+     */
+    void pop(unsigned int &idx);
+
+  //++++++++++++++
+    private:
+  //++++++++++++++
+    enum {
+        CACHE_LINE  = 64,
+        SPIN_LIMIT  = 128,  // busy polls before a waiter yields
+        YIELD_LIMIT = 16    // yielding polls before a waiter parks
+    };
+
+    struct Cell
+    {
+      volatile unsigned int  seq;
+      unsigned int           idx;
+    };
+
+    static void cpuRelax(int spin);
+    static void park(volatile int *seq, int seen);
+    static void wake(volatile int *seq, volatile int *waiters);
+
+    //   Private Data
+    //-------------------------------------
+    char                   m_pad0[CACHE_LINE];
+
+    //  moved by the producers
+    volatile unsigned int  m_enqueuePos;
+    volatile int           m_pushSeq;        // futex word, index queued
+    volatile int           m_popWaiters;
+    char                   m_pad1[CACHE_LINE - 3*sizeof(int)];
+
+    //  moved by the consumers
+    volatile unsigned int  m_dequeuePos;
+    volatile int           m_popSeq;         // futex word, cell freed
+    volatile int           m_pushWaiters;
+    char                   m_pad2[CACHE_LINE - 3*sizeof(int)];
+
+    //  read only after reset()
+    Cell                  *m_cells;
+    unsigned int           m_mask;
+    char                   m_pad3[CACHE_LINE - sizeof(int) -
+                                  sizeof(Cell *)];
+
+    // methods declared private to prevent their use
+    //    Assignment Operator, Copy Constructor
+    //-------------------------------------
+    MpmcIndexRing& operator=(const MpmcIndexRing& rhs);
+    MpmcIndexRing(const MpmcIndexRing& other);
+  };
+
+
+//                    I N L I N E   Methods
+//------------------------------------------------------------
+
+inline
+  MpmcIndexRing::MpmcIndexRing() :
+      m_cells(NULL)
+   { reset(1); }
+
+inline
+  MpmcIndexRing::~MpmcIndexRing()
+   { free(m_cells); }
+
+inline
+  void MpmcIndexRing::reset(int capacity)
+   {
+     unsigned int   cells = 1;
+     while ((int)cells < capacity)
+         cells <<= 1;
+
+     free(m_cells);
+     m_cells = NULL;
+     if (posix_memalign((void **)&m_cells, CACHE_LINE,
+                        cells * sizeof(Cell)) != 0)
+       {
+         throw Exception("MpmcIndexRing: could not allocate the cells",
+                         __FILE__, __LINE__);
+       }
+
+     // a cell whose seq equals the position is free to push into
+     for (unsigned int i = 0; i < cells; i++)
+       {
+         m_cells[i].seq = i;
+         m_cells[i].idx = 0;
+       }
+     m_mask        = cells - 1;
+     m_enqueuePos  = 0;
+     m_dequeuePos  = 0;
+     m_pushSeq     = 0;
+     m_popSeq      = 0;
+     m_popWaiters  = 0;
+     m_pushWaiters = 0;
+     __sync_synchronize();
+   }
+
+inline
+  int MpmcIndexRing::getCapacity() const
+   { return(m_mask + 1); }
+
+inline
+  int MpmcIndexRing::size() const
+   {
+     int   n = (int)(m_enqueuePos - m_dequeuePos);
+     return((n < 0) ? 0 : n);
+   }
+
+inline
+  bool MpmcIndexRing::empty() const
+   { return(size() == 0); }
+
+inline
+  bool MpmcIndexRing::tryPush(unsigned int idx)
+   {
+     unsigned int   pos = m_enqueuePos;
+     Cell          *cell;
+
+     for (;;)
+       {
+         cell = &m_cells[pos & m_mask];
+         int   dif = (int)(cell->seq - pos);
+         if (dif == 0)
+           {
+             unsigned int   seen;
+             seen = __sync_val_compare_and_swap(&m_enqueuePos, pos, pos + 1);
+             if (seen == pos)
+                 break;
+             pos = seen;
+           }
+          else if (dif < 0)
+             return(false);
+          else
+             pos = m_enqueuePos;
+       }//endFor
+
+     cell->idx = idx;
+     // the index must be visible before the cell is marked full; the
+     //   barrier also orders the mark before the waiter check below
+     __sync_synchronize();
+     cell->seq = pos + 1;
+     __sync_synchronize();
+
+     if (m_popWaiters)
+         wake(&m_pushSeq, &m_popWaiters);
+     return(true);
+   }
+
+inline
+  bool MpmcIndexRing::tryPop(unsigned int &idx)
+   {
+     unsigned int   pos = m_dequeuePos;
+     Cell          *cell;
+
+     for (;;)
+       {
+         cell = &m_cells[pos & m_mask];
+         int   dif = (int)(cell->seq - (pos + 1));
+         if (dif == 0)
+           {
+             unsigned int   seen;
+             seen = __sync_val_compare_and_swap(&m_dequeuePos, pos, pos + 1);
+             if (seen == pos)
+                 break;
+             pos = seen;
+           }
+          else if (dif < 0)
+             return(false);
+          else
+             pos = m_dequeuePos;
+       }//endFor
+
+     idx = cell->idx;
+     __sync_synchronize();
+     // free for the push one lap later
+     cell->seq = pos + m_mask + 1;
+     __sync_synchronize();
+
+     if (m_pushWaiters)
+         wake(&m_popSeq, &m_pushWaiters);
+     return(true);
+   }
+
+inline
+  void MpmcIndexRing::push(unsigned int idx)
+   {
+     for (int i=0; i<SPIN_LIMIT+YIELD_LIMIT; i++)
+       {
+         if (tryPush(idx))
+             return;
+         cpuRelax(i);
+       }
+
+     for (;;)
+       {
+         //  announce the wait before the last try, so that a pop which
+         //   does not see the waiter is seen by the try
+         __sync_fetch_and_add(&m_pushWaiters, 1);
+         int   seen = m_popSeq;
+         bool  done = tryPush(idx);
+         if (!done)
+             park(&m_popSeq, seen);
+         __sync_fetch_and_sub(&m_pushWaiters, 1);
+         if (done)
+             return;
+       }
+   }
+
+inline
+  void MpmcIndexRing::pop(unsigned int &idx)
+   {
+     for (int i=0; i<SPIN_LIMIT+YIELD_LIMIT; i++)
+       {
+         if (tryPop(idx))
+             return;
+         cpuRelax(i);
+       }
+
+     for (;;)
+       {
+         __sync_fetch_and_add(&m_popWaiters, 1);
+         int   seen = m_pushSeq;
+         bool  done = tryPop(idx);
+         if (!done)
+             park(&m_pushSeq, seen);
+         __sync_fetch_and_sub(&m_popWaiters, 1);
+         if (done)
+             return;
+       }
+   }
+
+inline
+  void MpmcIndexRing::cpuRelax(int spin)
+   {
+     if (spin >= SPIN_LIMIT)
+       {//  let the other side run if it shares this processor
+         sched_yield();
+         return;
+       }
+#if defined(__i386__) || defined(__x86_64__)
+     __asm__ __volatile__("pause" ::: "memory");
+#else
+     __sync_synchronize();
+#endif
+   }
+
+inline
+  void MpmcIndexRing::park(volatile int *seq, int seen)
+   {
+#ifdef __linux__
+     syscall(SYS_futex, const_cast<int *>(seq), FUTEX_WAIT_PRIVATE, seen,
+             NULL, NULL, 0);
+#else
+     (void)seq;
+     (void)seen;
+     sched_yield();
+#endif // __linux__
+   }
+
+inline
+  void MpmcIndexRing::wake(volatile int *seq, volatile int *waiters)
+   {
+     __sync_fetch_and_add(seq, 1);
+#ifdef __linux__
+     if (*waiters)
+         syscall(SYS_futex, const_cast<int *>(seq), FUTEX_WAKE_PRIVATE,
+                 INT_MAX, NULL, NULL, 0);
+#else
+     (void)waiters;
+#endif // __linux__
+   }
+
+}// end namespace
+
+#endif // PVTOL_MPMCINDEXRING_H not defined
@@ -56,6 +56,14 @@ namespace ipvtol
    * The parameter type of a conduit will be a non-distributed object type 
    * that has no references, pointers, or virtual functions
    *
+   * Built with the TREE_TAG flag, the source does not send each frame
+   * to every destination. The destinations form a binomial tree rooted
+   * at the source, and each relays the frame, in pieces, to its children
+   * as the pieces arrive; the source sends ceil(log2(n+1)) copies for n
+   * destinations. A destination relays while its ready() or getHandle()
+   * is called, so one which stops extracting holds up the destinations
+   * below it. Without the flag the source sends to each destination.
+   *
    * @author Eddie Rutledge
    *
    * */
@@ -74,9 +82,12 @@ namespace ipvtol
 
     /**
      * @param name the name of the conduit
+     * @param flags Conduit flags; TREE_TAG relays frames down a tree of
+     *              the destinations
      *
      */
-    MulticastConduit(const string& name);
+    MulticastConduit(const string& name,
+                     Route::Flags flags = Route::DEFAULT_FLAG);
 
     /**
      */
@@ -33,8 +33,9 @@ namespace ipvtol
   //------------------------------------------------------------------
 
   template<class DATATYPE>
-  MulticastConduit<DATATYPE>::MulticastConduit(const string& name) 
-    : m_internalCond(name)
+  MulticastConduit<DATATYPE>::MulticastConduit(const string& name,
+                                               Route::Flags flags)
+    : m_internalCond(name, flags)
   {
   }
 
@@ -32,6 +32,8 @@
 #include <CommScope.h>
 #include <Conduit.h>
 #include <MulticastConduit.h>
+#include <MergeConduit.h>
+#include <ConduitSelector.h>
 //CyclicDist.h (see Dist)
 //D
 #include <DataDistDescription.h>
@@ -52,9 +52,32 @@ namespace ipvtol
     // Forward declarations
     class SendRequest;
 
+    /** PackingInfo describes how a send's data is gathered into a
+     *   contiguous staging buffer before it is sent. It is used to fuse
+     *   an axis permutation into the send, so the data is reordered
+     *   while it is packed rather than in a separate pass.
+     *   The lengths and strides are given in destination axis order,
+     *   i.e. lengths[i] is the length of destination axis i and
+     *   strides[i] the source stride, in elements, along that axis.
+     *   buff is used by the blocking sends; a non-blocking send packs
+     *   into its SendRequest's own buffer, so that sends still in
+     *   flight are not overwritten.
+     */
     class PackingInfo {
       public:
-        // TBD
+        int           numDims;
+        int           eltSize;
+        int           lengths[MAX_DIM];
+        int           strides[MAX_DIM];
+        const char   *srcAddr;
+        char         *buff;
+        int           byteSize;
+
+        PackingInfo();
+        ~PackingInfo();
+
+        void pack(int srcOff) const;
+        void pack(int srcOff, char *dstBuff) const;
     };
 
     class SendInfo {
@@ -156,8 +179,21 @@ class Route
         DEFAULT_FLAG  = 0x00,
         STATIC        = 0x01,  // bit 0 denotes static
         TRANSPOSED    = 0x80,  // bit 5 denotes transposed
-        TRANSPOSE_102 = 0x84,  // bits 1 - 4 describe transpose
-	TAG_WILL_BE_SUPPLIED = 0x100
+        TRANSPOSE_021 = 0x82,  // bits 1 - 4 describe transpose
+        TRANSPOSE_102 = 0x84,
+        TRANSPOSE_120 = 0x86,
+        TRANSPOSE_201 = 0x88,
+        TRANSPOSE_210 = 0x8A,
+        TRANSPOSE_MASK = 0x9E,
+	TAG_WILL_BE_SUPPLIED = 0x100,
+	ASYNC_PROGRESS       = 0x200, // isend hands requests to RouteProgress
+	SEND_ORDER_ROTATED   = 0x400, // bits 10 - 11 select the send order
+	SEND_ORDER_PAIRWISE  = 0x800,
+	SEND_ORDER_RANDOM    = 0xC00,
+	SEND_ORDER_MASK      = 0xC00,
+	FUSED_TAG            = 0x1000, // used by Conduit, ignored by Route
+	VARIABLE_SIZE        = 0x2000, // used by Conduit, ignored by Route
+	TREE_TAG             = 0x4000  // used by Conduit, ignored by Route
     };
 
 
@@ -178,6 +214,45 @@ class Route
  *                              be used when send is performed.
  *                              Note: this is a promise by the user Not
  *                              to use offsets at send-time.
+ *                       Route::TRANSPOSE_abc  the axes are permuted as
+ *                              the data is sent; destination axis 0
+ *                              is source axis a, destination axis 1
+ *                              is source axis b, and so on. e.g.
+ *                              TRANSPOSE_102 is a matrix transpose and
+ *                              TRANSPOSE_021 swaps the two fastest axes
+ *                              of a 3-D cube. See permutationFlag().
+ *                       Route::ASYNC_PROGRESS  the SendRequests given to
+ *                              isend are driven to completion by the
+ *                              process' RouteProgress engine, which
+ *                              fires the SendRequest's callback as each
+ *                              peer completes.
+ *                       Route::SEND_ORDER_xxx  the order in which a
+ *                              source issues its sends, chosen so the
+ *                              sources do not all target the same
+ *                              destination at once:
+ *                              ROTATED  - start with the next rank
+ *                                         after this one and wrap,
+ *                              PAIRWISE - pairwise exchange, the k-th
+ *                                         send goes to rank XOR k
+ *                                         (ROTATED if the number of
+ *                                         ranks is not a power of 2),
+ *                              RANDOM   - a per rank random shuffle of
+ *                                         the peers.
+ *                              The sends to any one peer always keep
+ *                              their order.
+ *                              The default is the SendInfo order.
+ *                       Route::FUSED_TAG  ignored by the Route. A
+ *                              Conduit built with this flag sends each
+ *                              frame's tag in the same message as its
+ *                              data; see Connection.
+ *                       Route::VARIABLE_SIZE  ignored by the Route. A
+ *                              Conduit built with this flag moves only
+ *                              the valid part of each frame; see
+ *                              ConduitInsertIf::setLength().
+ *                       Route::TREE_TAG  ignored by the Route. A
+ *                              Conduit built with this flag relays
+ *                              each frame's tag down a binomial tree of
+ *                              its destinations; see Connection.
  * @return void No return value.
  */
 #ifdef INCLUDE_MAPS
@@ -240,6 +315,31 @@ Route(const HierArray<N, T, Block1 >* srcHA,
  */
  void isend(int srcOffset, int destOffset, SendRequest &request);
 
+/** Get the Route flag for an axis permutation.
+ *
+ * @param perm      int array, perm[i] is the source axis which becomes
+ *                   destination axis i.
+ * @param numDims   the number of dimensions, at most MAX_DIM
+ * @return Flags    the TRANSPOSE_ flag, or DEFAULT_FLAG for the identity
+ */
+ static Flags permutationFlag(const int *perm, int numDims);
+
+/** Limit the number of sends in flight to any one peer. The limit is
+ *   applied by the blocking static send, which then starts each send
+ *   only once the earlier sends to the same peer have drained.
+ *
+ * @param maxSends  the most sends outstanding per peer, 0 (the default)
+ *                   means no limit
+ * @return void No return value.
+ */
+ void setMaxSendsPerPeer(int maxSends);
+
+/** Get the per peer limit on sends in flight
+ *
+ * @return int      the limit, 0 if there is none
+ */
+ int getMaxSendsPerPeer() const;
+
 /** provide number of sources
  *   The numSrcs() method returns the number of sources
  *    for the local node.
@@ -363,6 +463,18 @@ private:
  void unregisterSendRequest(SendRequest *sr);
 
  void transposeLengths( unsigned int* lengths, Flags flags );
+
+ static bool decodePermutation(Flags flags, int numDims, int *perm);
+
+ void setupPermutedSend(const int *srcLengths, const int *srcStrides);
+
+ void packSends(int srcOff);
+
+ void packSends(int srcOff, SendRequest &req);
+
+ void orderSends();
+
+ void windowedStaticSends();
  
  enum Trait {
      NULL_TRAIT=0,
@@ -406,6 +518,11 @@ private:
  int                   m_maxRecvs;
  list<SendRequest *>   m_sendReqs;
  int                   m_numDims;
+ bool                  m_asyncProgress;
+ bool                  m_permuted;
+ int                   m_perm[MAX_DIM];
+ Flags                 m_sendOrder;
+ int                   m_maxSendsPerPeer;
 
 // methods declared private to prevent their use
 //    Default Constructor, Assignment Operator, Copy Constructor
@@ -423,6 +540,23 @@ inline SrcXferInfo::SrcXferInfo() :
         { return; }
 
 
+inline PackingInfo::PackingInfo() :
+        numDims(0),
+        eltSize(0),
+        srcAddr(NULL),
+        buff(NULL),
+        byteSize(0)
+        { return; }
+
+
+inline PackingInfo::~PackingInfo()
+        { delete[] buff; }
+
+
+inline void PackingInfo::pack(int srcOff) const
+        { pack(srcOff, buff); }
+
+
 inline DestXferInfo::DestXferInfo() :
         recvInfo(NULL),
         recvReq(NULL),
@@ -437,6 +571,14 @@ inline
 void Route::send()
 { this->send(0, 0); }
 
+inline
+void Route::setMaxSendsPerPeer(int maxSends)
+{ m_maxSendsPerPeer = (maxSends > 0) ? maxSends : 0; }
+
+inline
+int Route::getMaxSendsPerPeer() const
+{ return(m_maxSendsPerPeer); }
+
 inline
 bool Route::registerSendRequest(SendRequest *sr)
 {
@@ -0,0 +1,167 @@
+/**
+ *    File: RouteProgress.h
+ *
+ *  Copyright (c) 2008, Massachusetts Institute of Technology
+ *  All rights reserved.
+ *
+ *  \author  $LastChangedBy$
+ *  \date    $LastChangedDate$
+ *  \version $LastChangedRevision$
+ *  \brief   Definition of the RouteProgress class
+ *    The RouteProgress object is a per process progress engine for
+ *    non-blocking Route sends. SendRequests posted by a Route built
+ *    with the Route::ASYNC_PROGRESS flag are handed to the engine,
+ *    which drives the underlying comm requests to completion and fires
+ *    the SendRequest's completion callback once for each peer.
+ *
+ *    The engine may run in one of two modes:
+ *       POLLED   - progress is made whenever a PVTOL wait or test is
+ *                  called on any posted SendRequest, or whenever the
+ *                  application calls poll() (e.g. between chunks of a
+ *                  compute kernel).
+ *       THREADED - a dedicated progress thread sweeps the posted
+ *                  SendRequests in the background. Only available when
+ *                  MPI was initialized with MPI_THREAD_MULTIPLE.
+ *
+ *  $Id$
+ *
+ */
+#ifndef PVTOL_ROUTEPROGRESS_H
+#define PVTOL_ROUTEPROGRESS_H
+
+#include <PvtolBasics.h>
+#include <pthread.h>
+
+#include <list>
+
+namespace ipvtol
+{
+  class SendRequest;
+
+  /** Signature of a SendRequest completion callback. It is called once
+   *   for each peer whose part of the send (or receive) has completed.
+   *
+   *   Callbacks are called from whichever thread is driving progress,
+   *   that may be the progress thread. A callback must not post, wait
+   *   on, test or destroy a SendRequest.
+   *
+   * @param  SendRequest ref the request which made progress
+   * @param  int the rank (in the Route's CommScope) of the peer
+   * @param  bool true if the completed part was a receive, false if a send
+   * @param  void * the user argument given to SendRequest::setCallback()
+   */
+  typedef void (*RouteCompletionCallback)(SendRequest &req,
+                                          int          peerRank,
+                                          bool         isRecv,
+                                          void        *arg);
+
+  /** RouteProgress is the process wide progress engine for Routes built
+   *   with the Route::ASYNC_PROGRESS flag. There is one instance per
+   *   process, obtained via instance().
+   *
+   * @see Route, SendRequest
+   */
+  class RouteProgress
+  {
+  //++++++++++++++
+    public:
+  //++++++++++++++
+    enum Mode {
+        POLLED   = 0,
+        THREADED = 1
+    };
+
+    /** Get the engine for this process
+     * @return RouteProgress ref
+     */
+    static RouteProgress& instance();
+
+    /** Start the engine. In THREADED mode a progress thread is created,
+     *   in POLLED mode the call only records the mode.
+     *
+     *   The progress thread calls MPI while the application's threads
+     *   do, so THREADED mode needs MPI_THREAD_MULTIPLE. If MPI provides
+     *   less the engine stays in POLLED mode; getMode() tells which mode
+     *   was started.
+     *
+     * @param  Mode the progress mode
+     * @param  int  microseconds the progress thread sleeps between
+     *              sweeps, 0 means only yield the processor
+     * @return void
+     */
+    void start(Mode mode=POLLED, int pollIntervalUsec=0);
+
+    /** Stop the progress thread, if any. Outstanding SendRequests stay
+     *   posted and will be progressed by polling. Must not be called while
+     *   other threads are blocked in SendRequest::wait().
+     * @return void
+     */
+    void stop();
+
+    /** Get the current progress mode
+     * @return Mode
+     */
+    Mode getMode() const;
+
+    /** Hand a SendRequest, whose comms have been started, to the engine
+     * @param  SendRequest * the request to progress
+     * @return void
+     */
+    void post(SendRequest *req);
+
+    /** Withdraw a SendRequest from the engine. Used when a request is
+     *   destroyed or disassociated before it completes.
+     * @param  SendRequest * the request to withdraw
+     * @return void
+     */
+    void remove(SendRequest *req);
+
+    /** Sweep all posted SendRequests once, firing callbacks for every
+     *   peer that completed.
+     * @return int the number of SendRequests still outstanding
+     */
+    int poll();
+
+    /** Get the number of SendRequests currently posted
+     * @return int
+     */
+    int numPosted();
+
+    ~RouteProgress();
+
+  //++++++++++++++
+    private:
+  //++++++++++++++
+    RouteProgress();
+
+    static void *progressThread(void *arg);
+
+    //   Private Data
+    //-------------------------------------
+    std::list<SendRequest *>  m_posted;
+    pthread_mutex_t           m_mutex;
+    pthread_cond_t            m_workCond;
+    pthread_t                 m_thread;
+    bool                      m_threadRunning;
+    bool                      m_stopRequested;
+    int                       m_pollIntervalUsec;
+    Mode                      m_mode;
+
+    // methods declared private to prevent their use
+    //    Assignment Operator, Copy Constructor
+    //-------------------------------------
+    RouteProgress& operator=(const RouteProgress& rhs);
+    RouteProgress(const RouteProgress& other);
+  };
+
+
+//                    I N L I N E   Methods
+//------------------------------------------------------------
+
+inline
+  RouteProgress::Mode RouteProgress::getMode() const
+   { return(m_mode); }
+
+}// end namespace
+
+#endif // PVTOL_ROUTEPROGRESS_H not defined
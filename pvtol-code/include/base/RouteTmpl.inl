@@ -78,7 +78,11 @@ Route::Route(const HierArray<N, T, Block1 >* srcArr,
     m_destPitfalls(N),
     m_numDims(N),
     m_maxSends(0),
-    m_maxRecvs(0)
+    m_maxRecvs(0),
+    m_asyncProgress((flags & ASYNC_PROGRESS) != 0),
+    m_permuted(false),
+    m_sendOrder(static_cast<Flags>(flags & SEND_ORDER_MASK)),
+    m_maxSendsPerPeer(0)
 {
     PvtolProgram   prog;
     TaskBase& ct   = prog.getCurrentTask();
@@ -102,15 +106,35 @@ Route::Route(const HierArray<N, T, Block1 >* srcArr,
     if (!(TAG_WILL_BE_SUPPLIED & flags))
                m_tag = m_commScopePtr->getNextTag();
 #ifdef PVTOL_DEVELOP
-    if (m_numDims > 2)
+    if (m_numDims > MAX_DIM)
       {
-        cerr << "PvtolRoute: does NOT support more than 2 Dimensions, yet"
-             << endl;
+        cerr << "PvtolRoute: does NOT support more than " << MAX_DIM
+             << " Dimensions, yet" << endl;
 
         throw NotImplementedYet(__FILE__, __LINE__);
       }
 #endif // PVTOL_DEVELOP
 
+    //  an axis permutation is fused into the packing of the sends
+    if (flags & TRANSPOSED)
+      {
+        if (!decodePermutation(flags, m_numDims, m_perm))
+            throw Exception("PvtolRoute: axis permutation does not match "
+                            "the number of dimensions", __FILE__, __LINE__);
+        m_permuted = true;
+
+#ifdef PVTOL_DEVELOP
+        if ((srcArr != NULL) && (destArr != NULL))
+          {
+            for (int d=0; d<m_numDims; d++) {
+                if (destArr->size(d) != srcArr->size(m_perm[d]))
+                    throw Exception("PvtolRoute: dest lengths are not the "
+                                    "permuted src lengths", __FILE__, __LINE__);
+            }
+          }
+#endif // PVTOL_DEVELOP
+      }
+
     if (flags & STATIC)
     {
       if (srcArr != NULL)
@@ -300,6 +324,21 @@ Route::Route(const HierArray<N, T, Block1 >* srcArr,
 			       srcArr->size(),
 			       destProcList[0]
 		              );
+
+	        if (m_permuted)
+	          {
+	            int   srcLengths[MAX_DIM];
+	            int   srcStrides[MAX_DIM];
+
+	            for (int d=0; d<m_numDims; d++) {
+	                srcLengths[d] = srcArr->size(d);
+	                srcStrides[d] = srcArr->stride(d);
+	            }
+	            setupPermutedSend(srcLengths, srcStrides);
+	          }
+
+	        //  as procXferStructs does for the general case
+	        orderSends();
 	      }
 #ifdef NOT_YET
              else
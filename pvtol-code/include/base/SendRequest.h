@@ -27,6 +27,7 @@
 
 #include <PvtolBasics.h>
 #include <PvtolRequest.h>
+#include <RouteProgress.h>
 #include <pthread.h>
 
 namespace ipvtol
@@ -138,6 +139,21 @@ namespace ipvtol
      */
     void cancel();
 
+    /** Set the callback fired, once per peer, as the parts of a send
+     *  complete. Only used when the associated Route was built with the
+     *  Route::ASYNC_PROGRESS flag, in which case the process' RouteProgress
+     *  engine drives the send and calls the callback.
+     *
+     * @param  RouteCompletionCallback the callback, NULL disables it
+     * @param  void * user argument handed back to the callback
+     * @return void No return value.
+     */
+    void setCallback(RouteCompletionCallback cb, void *arg=NULL);
+
+    //              isPosted()
+    //-----------------------------------------------------------
+    bool isPosted() const;
+
     //              preset()
     //-----------------------------------------------------------
     bool preset() const;
@@ -167,6 +183,11 @@ namespace ipvtol
 
   //++++++++++++++
     private:
+  //++++++++++++++
+    //   Private Methods
+    //-------------------------------------
+    void setPosted(bool posted);
+
   //++++++++++++++
     //   Private Data
     //-------------------------------------
@@ -194,11 +215,30 @@ namespace ipvtol
     pthread_cond_t        m_waitCond;
     bool                  m_isWaiting;
 
+    //   asynchronous progress, see RouteProgress
+    RouteCompletionCallback m_callback;
+    void                 *m_callbackArg;
+    int                  *m_sendPeer;
+    int                  *m_recvPeer;
+    bool                 *m_sendComplete;
+    bool                 *m_recvComplete;
+    volatile int          m_isPosted;        // read by waiters on any thread
+
+    //   staging buffers of the Route's permuted sends, indexed as its
+    //     SendInfos; NULL where the send is not packed
+    char                **m_packBuff;
+    int                   m_numPackBuffs;
+
     //   Private Methods, may be used by
     //     SendRequest friends.
     //-------------------------------------
     void setDone();
     void setNotDone();
+    void allocPeerInfo(int maxSends, int maxRecvs);
+    void allocPackBuffs(Route &route);
+    void freePackBuffs();
+    void post();
+    bool progress();
 
     // methods declared private to prevent their use
     //    Copy Constructor
@@ -207,6 +247,7 @@ namespace ipvtol
 
     friend class Transfer;
     friend class Route;
+    friend class RouteProgress;
   };
 
 
@@ -229,6 +270,25 @@ inline
   int SendRequest::recvdCount() const
    { return(m_recvdCount); }
  
+inline
+  bool SendRequest::isPosted() const
+   {
+     int  posted = m_isPosted;
+
+     __sync_synchronize();
+     return(posted != 0);
+   }
+
+//  the barriers order the request's completion state against the flag,
+//  which the RouteProgress engine clears from its own thread
+inline
+  void SendRequest::setPosted(bool posted)
+   {
+     __sync_synchronize();
+     m_isPosted = posted ? 1 : 0;
+     __sync_synchronize();
+   }
+
 inline
   void SendRequest::setDone()
    { m_done = true; }
@@ -27,13 +27,17 @@
 #define SHAREDCONDUIT_H_
 
 #include <PvtolProgram.h>
-#include <BlockingCQueue.h>
+#include <MpmcIndexRing.h>
+#include <FramePool.h>
+#include <ConduitWakeup.h>
 #include <ThreadManager.h>
 #include <string>
 #include <typeinfo>
 #include <shared_ptr.hpp>
 #include <vector>
 #include <queue>
+#include <stdint.h>
+#include <pthread.h>
 
 namespace ipvtol
 {
@@ -52,8 +56,16 @@ public:
 	// PUBLIC TYPES
 	/////////////////////////////////////////////////////////////////////////	  
 	typedef DATATYPE DataType;
-	typedef typename BlockingCQueue<DataType>::DataTypePtr DataTypePtr;
-	typedef typename BlockingCQueue<DataType>::DataTypePtr Handle;
+	typedef shared_ptr<DataType> DataTypePtr;
+	typedef DataTypePtr Handle;
+
+	///What the writer does when the reader falls behind
+	typedef enum
+	{
+		Block,           // wait for a free buffer
+		OverwriteOldest, // discard the oldest unread frame
+		KeepNewest       // discard every unread frame but the newest
+	} OverflowType;
 
 	/////////////////////////////////////////////////////////////////////////
 	// NESTED CLASSES
@@ -169,6 +181,9 @@ public:
 		///Clear the EOC
 		inline void clearEOC();
 
+		///Get the number of frames discarded unread by a lossy conduit
+		inline unsigned long getDropCount();
+
 	private:
 
 		SharedConduit<DATATYPE> * m_conduit;
@@ -255,6 +270,16 @@ public:
 		///IsAtEOC
 		inline bool isAtEOC();
 
+		/**
+		 * Notifies wakeup of every insert and EOC, so that a
+		 * ConduitSelector may sleep on this conduit. NULL stops it.
+		 *
+		 * @return true, the notifications always reach the reader */
+		inline bool setWakeup(ConduitWakeup *wakeup);
+
+		///Get the number of frames discarded unread by a lossy conduit
+		inline unsigned long getDropCount();
+
 	private:
 		SharedConduit<DATATYPE> * m_conduit;
 	};
@@ -277,7 +302,6 @@ public:
 	typedef ConduitInsertIf Writer;
 	typedef ConduitExtractIf Reader;
 
-	//typedef typename BlockingCQueue<DataType>::value_type buffer_type;
 
 
 	/////////////////////////////////////////////////////////////////////////
@@ -290,11 +314,16 @@ public:
 	/**
 	 * \brief    Constructor
 	 * \param    name   name of the conduit
+	 * \param    overflow  what the writer does when no buffer is free.
+	 *           The lossy types take an unread one instead, and wait
+	 *           only while every buffer is being written or read; they
+	 *           count the frames they discard.
 	 * 
 	 * \return   return_type 
 	 *
 	 */
-	SharedConduit(const string& name ="Conduit");
+	SharedConduit(const string& name ="Conduit",
+	              OverflowType overflow = Block);
 
 	///Destructor
 	virtual ~SharedConduit() throw();
@@ -314,14 +343,15 @@ public:
 	///Get the name
 	string getName();
 
-	///Setup the source buffers using new DATATYPE
+	///Setup the source buffers as DATATYPE(), built in one arena.
+	///Their handles do not own them and die with the conduit.
 	void setupSrc(int depth = 1);
 
 	//The setupXXXX methods can be templated on any number of  template params.
-	///Setup the source buffers using new DATATYPE(par)
+	///Setup the source buffers as DATATYPE(par), built in one arena
 	template <class T> void setupSrc(T par, int depth = 1);
 
-	///Setup the source buffers
+	///Setup the source buffers as copies of srcObj, built in one arena
 	void setupSrc(DATATYPE & srcObj, int depth = 1);
 	
 	///Use user-supplied source  buffers
@@ -376,6 +406,20 @@ public:
 	 */
 	inline bool isAtEOC();
 
+	///Get the number of frames discarded unread by a lossy conduit
+	inline unsigned long getDropCount();
+
+	///Back the buffers built by setupSrc with huge pages, if there are any
+	inline void setHugePages(bool enable);
+
+	///Prefault and lock the buffers built by setupSrc into memory, from the
+	///thread setting them up. MemoryLock::report() lists them under the
+	///conduit name.
+	inline void setLockMemory(bool enable);
+
+	///Get the allocation statistics of the buffer arena
+	inline const FramePoolStats & getAllocStats();
+
 	/////////////////////////////////////////////////////////////////////////
 	// PRIVATE METHODSs
 	/////////////////////////////////////////////////////////////////////////
@@ -405,6 +449,25 @@ private:
 
 	//Release the Handles 
 	inline void releaseDestHandle();
+
+	///Make the rings hold every buffer, all free
+	void initSlots();
+
+	///Hand out the buffers built in the arena by index
+	void poolSlots();
+
+	///Handles to arena buffers do not own them
+	struct PoolDeleter
+	{
+		void operator()(DATATYPE *) const { }
+	};
+
+	///Get the slot this thread writes or reads, -1 if none
+	inline int heldSlot(pthread_key_t key);
+	inline void setHeldSlot(pthread_key_t key, int slot);
+
+	///Claim a buffer to write; a lossy conduit may take an unread one
+	inline unsigned int acquireWriteSlot();
 	
 	/////////////////////////////////////////////////////////////////////////
 	// PRIVATE MEMBERS
@@ -413,10 +476,15 @@ private:
 private:
 	string m_name;
 	int m_bufferLength;
-	BlockingCQueue<DataType> m_src;
-	Handle m_readData;
-	Handle m_writeData;
-	//BlockingCQueue<DataType>		m_dest;
+	FramePool<DATATYPE> m_pool;      // the buffers setupSrc builds
+	vector<DataTypePtr> m_objects;   // the buffers, indexed by slot
+	MpmcIndexRing m_free;            // slots the writers may fill
+	MpmcIndexRing m_full;            // slots waiting for the readers
+	pthread_key_t m_writeKey;        // per thread, slot + 1, 0 if none
+	pthread_key_t m_readKey;
+	OverflowType m_overflow;
+	volatile unsigned long m_dropped;
+	ConduitWakeup * volatile m_wakeup;
 	bool m_setupCompleteDone;
 	bool m_srcsInitialized;
 	bool m_dstsInitialized;
@@ -540,6 +608,12 @@ inline void SharedConduit<DATATYPE>::ConduitInsertIf::clearEOC()
 	m_conduit->clearEOC();
 }
 
+template <class DATATYPE>
+inline unsigned long SharedConduit<DATATYPE>::ConduitInsertIf::getDropCount()
+{
+	return m_conduit->getDropCount();
+}
+
 /////////////////////////////////////////////////////////////////////////////
 // ConduitExtractIf methods
 /////////////////////////////////////////////////////////////////////////////
@@ -651,20 +725,44 @@ inline bool SharedConduit<DATATYPE>::ConduitExtractIf::isAtEOC()
 	return m_conduit->isAtEOC();
 }
 
+template <class DATATYPE>
+inline bool SharedConduit<DATATYPE>::ConduitExtractIf::setWakeup(
+		ConduitWakeup *wakeup)
+{
+	m_conduit->m_wakeup = wakeup;
+	__sync_synchronize();
+	return true;
+}
+
+template <class DATATYPE>
+inline unsigned long SharedConduit<DATATYPE>::ConduitExtractIf::getDropCount()
+{
+	return m_conduit->getDropCount();
+}
+
 /////////////////////////////////////////////////////////////////////////////
 // SharedConduit methods
 /////////////////////////////////////////////////////////////////////////////
 
 //Constructor
 template <class DATATYPE>
-SharedConduit<DATATYPE>::SharedConduit(const string & name)
+SharedConduit<DATATYPE>::SharedConduit(const string & name,
+                                       OverflowType overflow)
 :m_name(name),
+m_bufferLength(0),
+m_overflow(overflow),
+m_dropped(0),
+m_wakeup(NULL),
 m_setupCompleteDone(false),
 m_srcsInitialized(false),
 m_dstsInitialized(false),
 m_EOC(false)
 {
    pthread_mutex_init(&m_initMutex, NULL);
+   if (pthread_key_create(&m_writeKey, NULL) != 0 ||
+       pthread_key_create(&m_readKey, NULL) != 0)
+        throw Exception("SharedConduit: could not create thread keys",
+                        __FILE__, __LINE__);
 }//end Cdt Construct()
 
 
@@ -672,7 +770,9 @@ m_EOC(false)
 template <class DATATYPE>
 SharedConduit<DATATYPE>::~SharedConduit() throw()
 {
-	///@todo delete the contents of the source buffer m_src
+	pthread_key_delete(m_writeKey);
+	pthread_key_delete(m_readKey);
+	pthread_mutex_destroy(&m_initMutex);
 	return;
 }
 
@@ -715,7 +815,7 @@ SharedConduit<DATATYPE>::getReader()
 template <class DATATYPE>
 inline bool SharedConduit<DATATYPE>::insertAvailable()
 {
-	return ! m_src.is_full();
+	return !m_free.empty() || (m_overflow != Block && !m_full.empty());
 }
 
 template <class DATATYPE>
@@ -729,16 +829,9 @@ void SharedConduit<DATATYPE>::setupSrc(
    pthread_mutex_lock(&m_initMutex);
    if(!m_srcsInitialized)
    {
-	///@todo Allocate memory in the underlying buffer and reset
 	m_bufferLength = depth;
-	m_src.setCapacity(m_bufferLength);
-	for(int i=0; i< m_bufferLength;++i)
-	{
-		DataTypePtr temp (new DATATYPE(par));
-		m_src.insert(temp);
-	}
-
-	m_src.reset();
+	m_pool.create(m_bufferLength, par);
+	poolSlots();
         m_srcsInitialized=true;
    }
    pthread_mutex_unlock(&m_initMutex);
@@ -754,14 +847,8 @@ void SharedConduit<DATATYPE>::setupSrc(
    if(!m_srcsInitialized)
    {
 	m_bufferLength = depth;
-	m_src.setCapacity(m_bufferLength);
-	for(int i=0; i< m_bufferLength;++i)
-	{
-		DataTypePtr temp(new DATATYPE(srcObj));
-		m_src.insert(temp);
-	}
-
-	m_src.reset();
+	m_pool.create(m_bufferLength, srcObj);
+	poolSlots();
         m_srcsInitialized=true;
    }
    pthread_mutex_unlock(&m_initMutex);
@@ -776,13 +863,10 @@ void SharedConduit<DATATYPE>::setupSrc(
    if(!m_srcsInitialized)
    {
 	m_bufferLength = vecHandles.size();
-	m_src.setCapacity(m_bufferLength);
-	for(int i=0; i< m_bufferLength;++i)
-	{
-		m_src.insert(vecHandles[i]);
-	}
+	m_objects = vecHandles;
+	m_pool.clear();
 
-	m_src.reset();
+	initSlots();
         m_srcsInitialized=true;
    } else {
       std::cerr << "SharedConduit setup: memory already allocated" <<std::endl;
@@ -798,65 +882,118 @@ void SharedConduit<DATATYPE>::setupSrc(int depth)
    if(!m_srcsInitialized)
    {
 	m_bufferLength = depth;
-	m_src.setCapacity(m_bufferLength);
-	for(int i=0; i< m_bufferLength;++i)
-	{
-		DataTypePtr temp(new DATATYPE);
-		m_src.insert(temp);
-	}
-
-	m_src.reset();
+	m_pool.create(m_bufferLength);
+	poolSlots();
         m_srcsInitialized=true;
    }
    pthread_mutex_unlock(&m_initMutex);
 }
 
 template <class DATATYPE>
-inline DATATYPE & SharedConduit<DATATYPE>::getSrcData()
+void SharedConduit<DATATYPE>::initSlots()
 {
-	if (m_src.beginInsert(m_writeData)){
-		return *m_writeData;
+	m_free.reset(m_bufferLength);
+	m_full.reset(m_bufferLength);
+	for (int i = 0; i < m_bufferLength; ++i)
+	{
+		m_free.push(i);
 	}
-	else{
-		throw Exception("Conduit is not accepting more data. It is in Writelocked state");
+	m_dropped = 0;
+}
+
+template <class DATATYPE>
+void SharedConduit<DATATYPE>::poolSlots()
+{
+	// the handles are made once here, so the hot path moves only
+	//   indices and never touches a reference count
+	m_objects.clear();
+	m_objects.reserve(m_bufferLength);
+	for (int i = 0; i < m_bufferLength; ++i)
+	{
+		m_objects.push_back(DataTypePtr(m_pool.get(i), PoolDeleter()));
 	}
+	initSlots();
 }
 
 template <class DATATYPE>
-inline void SharedConduit<DATATYPE>::releaseSrcData()
+inline int SharedConduit<DATATYPE>::heldSlot(pthread_key_t key)
+{
+	return (int)(intptr_t)pthread_getspecific(key) - 1;
+}
+
+template <class DATATYPE>
+inline void SharedConduit<DATATYPE>::setHeldSlot(pthread_key_t key, int slot)
+{
+	pthread_setspecific(key, (void *)(intptr_t)(slot + 1));
+}
+
+template <class DATATYPE>
+inline unsigned int SharedConduit<DATATYPE>::acquireWriteSlot()
 {
-	if (m_src.endInsert(m_writeData))
+	int held = heldSlot(m_writeKey);
+	if (held >= 0)
+		return held;
+
+	unsigned int slot;
+	if (m_overflow == Block || !m_free.tryPop(slot))
 	{
-		m_writeData.reset();
+		// the oldest unread buffer is overwritten rather than waited for
+		if (m_overflow != Block && m_full.tryPop(slot))
+			__sync_fetch_and_add(&m_dropped, 1);
+		else
+			m_free.pop(slot);
 	}
-	
+	setHeldSlot(m_writeKey, slot);
+	return slot;
+}
+
+template <class DATATYPE>
+inline DATATYPE & SharedConduit<DATATYPE>::getSrcData()
+{
+	return *m_objects[acquireWriteSlot()];
+}
+
+template <class DATATYPE>
+inline void SharedConduit<DATATYPE>::releaseSrcData()
+{
+	releaseSrcHandle();
 }
 
 template <class DATATYPE>
 inline typename SharedConduit<DATATYPE>::Handle& SharedConduit<DATATYPE>::getSrcHandle()
 {
-	if (m_src.beginInsert(m_writeData)){
-		return m_writeData;
-	}
-	else{
-		throw Exception("Conduit is not accepting more data. It is in Writelocked state");
-	}
+	return m_objects[acquireWriteSlot()];
 }
 
 template <class DATATYPE>
 inline void SharedConduit<DATATYPE>::releaseSrcHandle()
 {
-	if (m_src.endInsert(m_writeData))
+	int slot = heldSlot(m_writeKey);
+	if (slot < 0)
+		return;
+	setHeldSlot(m_writeKey, -1);
+
+	// every slot fits in either ring, so neither push can wait
+	m_full.push(slot);
+	if (m_overflow == KeepNewest)
 	{
-		m_writeData.reset();
+		unsigned int old;
+		while (m_full.size() > 1 && m_full.tryPop(old))
+		{
+			m_free.push(old);
+			__sync_fetch_and_add(&m_dropped, 1);
+		}
 	}
-	
+
+	ConduitWakeup *wakeup = m_wakeup;
+	if (wakeup)
+		wakeup->notify();
 }
 
 template <class DATATYPE>
 inline bool SharedConduit<DATATYPE>::extractReady()
 {
-	return ! (m_src.is_empty());
+	return !m_full.empty();
 }
 
 template <class DATATYPE>
@@ -896,29 +1033,37 @@ void SharedConduit<DATATYPE>::setupDest(vector<DataTypePtr>& vecHandles)
 template <class DATATYPE>
 inline DATATYPE & SharedConduit<DATATYPE>::getDestData()
 {
-	m_src.beginRemove(m_readData);
-	return *m_readData;
+	return *getDestHandle();
 }
 
 template <class DATATYPE>
 inline void SharedConduit<DATATYPE>::releaseDestData()
 {
-	if (m_src.endRemove(m_readData))
-		m_readData.reset();
+	releaseDestHandle();
 }
 
 template <class DATATYPE>
 inline typename SharedConduit<DATATYPE>::Handle& SharedConduit<DATATYPE>::getDestHandle()
 {
-	m_src.beginRemove(m_readData);
-	return m_readData;
+	int held = heldSlot(m_readKey);
+	if (held < 0)
+	{
+		unsigned int slot;
+		m_full.pop(slot);
+		held = slot;
+		setHeldSlot(m_readKey, held);
+	}
+	return m_objects[held];
 }
 
 template <class DATATYPE>
 inline void SharedConduit<DATATYPE>::releaseDestHandle()
 {
-	if (m_src.endRemove(m_readData))
-		m_readData.reset();
+	int slot = heldSlot(m_readKey);
+	if (slot < 0)
+		return;
+	setHeldSlot(m_readKey, -1);
+	m_free.push(slot);
 }
 
 template <class DATATYPE>
@@ -931,6 +1076,10 @@ template <class DATATYPE>
 inline void SharedConduit<DATATYPE>::insertEOC()
 {
 	m_EOC = true;
+	__sync_synchronize();
+	ConduitWakeup *wakeup = m_wakeup;
+	if (wakeup)
+		wakeup->notify();
 }
 
 template <class DATATYPE>
@@ -945,6 +1094,30 @@ inline bool SharedConduit<DATATYPE>::isAtEOC()
 	return m_EOC;
 }
 
+template <class DATATYPE>
+inline unsigned long SharedConduit<DATATYPE>::getDropCount()
+{
+	return m_dropped;
+}
+
+template <class DATATYPE>
+inline void SharedConduit<DATATYPE>::setHugePages(bool enable)
+{
+	m_pool.setHugePages(enable);
+}
+
+template <class DATATYPE>
+inline void SharedConduit<DATATYPE>::setLockMemory(bool enable)
+{
+	m_pool.setLockMemory(enable, m_name);
+}
+
+template <class DATATYPE>
+inline const FramePoolStats & SharedConduit<DATATYPE>::getAllocStats()
+{
+	return m_pool.getStats();
+}
+
 template <class DATATYPE>
 inline string SharedConduit<DATATYPE>::getName()
 {
@@ -0,0 +1,324 @@
+/**
+ *    File: ShmXferSegment.h
+ *
+ *  Copyright (c) 2008, Massachusetts Institute of Technology
+ *  All rights reserved.
+ *
+ *  \author  $LastChangedBy$
+ *  \date    $LastChangedDate$
+ *  \version $LastChangedRevision$
+ *  \brief   Definition of the ShmXferSegment class
+ *    A ShmXferSegment is a POSIX shared memory segment holding the slots
+ *    of a Conduit whose source and destination are in different
+ *    processes on one host. The producer writes each frame in place and
+ *    the consumer reads it in place; a LocalXferRing at the head of the
+ *    segment, with process shared futexes, hands the slots back and
+ *    forth, so no frame is copied or sent.
+ *
+ *  $Id$
+ *
+ */
+#ifndef PVTOL_SHMXFERSEGMENT_H
+#define PVTOL_SHMXFERSEGMENT_H
+
+#include <LocalXferRing.h>
+#include <MemoryLock.h>
+
+#include <new>
+#include <string>
+#include <stdio.h>
+#include <stddef.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+namespace ipvtol
+{
+
+  /** ShmXferSegment lays out, in one mapping,
+   *    - the LocalXferRing counting the frames in flight,
+   *    - each slot's valid length and sequence number,
+   *    - an auxiliary area, where the Conduit keeps its tags and EOCs,
+   *    - the slots, page aligned, each slotBytes long.
+   *
+   *   The producer create()s the segment, the consumer open()s it once
+   *   it exists, and the producer unlink()s it once the consumer has it
+   *   mapped, so that nothing is left behind if either process dies.
+   *   Each process unmaps its view when the segment is destroyed.
+   *
+   * @see Conduit, LocalXferRing
+   */
+  class ShmXferSegment
+  {
+  //++++++++++++++
+    public:
+  //++++++++++++++
+    ShmXferSegment();
+    ~ShmXferSegment();
+
+    /** Producer: create, map and initialize the segment
+     * @param  string the segment's name, see makeName()
+     * @param  int the number of slots
+     * @param  size_t the bytes in a slot
+     * @param  size_t the bytes in the auxiliary area
+     * @return bool false if the segment could not be created
+     */
+    bool create(const std::string &name, int depth, size_t slotBytes,
+                size_t auxBytes);
+
+    /** Consumer: map a segment the producer has created
+     * @param  string the segment's name
+     * @param  int, size_t, size_t as given to create()
+     * @return bool false if there is no such segment, or it differs
+     */
+    bool open(const std::string &name, int depth, size_t slotBytes,
+              size_t auxBytes);
+
+    /** Producer: remove the segment's name; the mappings stay valid
+     * @return void
+     */
+    void unlink();
+
+    /** Unmap this process's view of the segment
+     * @return void
+     */
+    void close();
+
+    /** Build a name unique to a Conduit and its producer
+     * @param  string the Conduit's name
+     * @param  int the producer's pid
+     * @param  int a tag distinguishing Conduits of the same name
+     * @return string
+     */
+    static std::string makeName(const std::string &conduit, int pid,
+                                int tag);
+
+    /** Get a tag no other segment named by this process has used
+     * @return int
+     */
+    static int nextTag();
+
+    bool isMapped() const;
+    LocalXferRing & getRing();
+    void * getAux();
+    void * getData();
+
+    /** Producer: record the frame just written into a slot
+     * @param  int the slot
+     * @param  int its valid length, in elements
+     * @param  int its sequence number
+     * @return void
+     */
+    void setFrame(int slot, int length, int seqNum);
+
+    int getFrameLength(int slot) const;
+    int getFrameSeqNum(int slot) const;
+
+  //++++++++++++++
+    private:
+  //++++++++++++++
+    enum {
+        CACHE_LINE = 64,
+        MAX_NAME   = 64     // conduit name characters kept in a name
+    };
+
+    struct FrameInfo
+    {
+        int   length;
+        int   seqNum;
+    };
+
+    void layout(int depth, size_t slotBytes, size_t auxBytes);
+    bool map(int fd);
+
+    //   Private Data
+    //-------------------------------------
+    std::string   m_name;
+    char         *m_base;
+    size_t        m_bytes;
+    size_t        m_auxOffset;
+    size_t        m_dataOffset;
+    bool          m_linked;        // this process created the name
+
+    // methods declared private to prevent their use
+    ShmXferSegment(const ShmXferSegment &);
+    ShmXferSegment & operator=(const ShmXferSegment &);
+  };
+
+
+//                    I N L I N E   Methods
+//------------------------------------------------------------
+
+inline
+  ShmXferSegment::ShmXferSegment() :
+      m_base(NULL),
+      m_bytes(0),
+      m_auxOffset(0),
+      m_dataOffset(0),
+      m_linked(false)
+   { }
+
+inline
+  ShmXferSegment::~ShmXferSegment()
+   {
+     unlink();
+     close();
+   }
+
+inline
+  bool ShmXferSegment::create(const std::string &name, int depth,
+                              size_t slotBytes, size_t auxBytes)
+   {
+     close();
+     layout(depth, slotBytes, auxBytes);
+
+     int   fd = shm_open(name.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600);
+     if (fd < 0)
+         return(false);
+     m_name   = name;
+     m_linked = true;
+
+     if ((ftruncate(fd, m_bytes) != 0) || !map(fd))
+       {
+         ::close(fd);
+         unlink();
+         return(false);
+       }
+     ::close(fd);
+
+     //  the pages are zero; fault them in now rather than on the
+     //   first frames, and start the ring empty
+     MemoryLock::prefault(m_base, m_bytes);
+     new (m_base) LocalXferRing;
+     getRing().reset(depth, true);
+     return(true);
+   }
+
+inline
+  bool ShmXferSegment::open(const std::string &name, int depth,
+                            size_t slotBytes, size_t auxBytes)
+   {
+     close();
+     layout(depth, slotBytes, auxBytes);
+
+     int   fd = shm_open(name.c_str(), O_RDWR, 0600);
+     if (fd < 0)
+         return(false);
+
+     struct stat   st;
+     bool          ok = (fstat(fd, &st) == 0) &&
+                        ((size_t)st.st_size == m_bytes) && map(fd);
+     ::close(fd);
+     if (ok && (getRing().getDepth() != depth))
+       {
+         close();
+         ok = false;
+       }
+     return(ok);
+   }
+
+inline
+  void ShmXferSegment::unlink()
+   {
+     if (m_linked)
+       {
+         shm_unlink(m_name.c_str());
+         m_linked = false;
+       }
+   }
+
+inline
+  void ShmXferSegment::close()
+   {
+     if (m_base != NULL)
+       {
+         munmap(m_base, m_bytes);
+         m_base = NULL;
+       }
+   }
+
+inline
+  std::string ShmXferSegment::makeName(const std::string &conduit, int pid,
+                                       int tag)
+   {
+     //  a name may hold no '/' after the first, keep it to [A-Za-z0-9_]
+     std::string   name("/pvtol.");
+     for (size_t i=0; (i<conduit.size()) && (i<MAX_NAME); i++)
+       {
+         char   c = conduit[i];
+         bool   plain = ((c >= 'a') && (c <= 'z')) ||
+                        ((c >= 'A') && (c <= 'Z')) ||
+                        ((c >= '0') && (c <= '9'));
+         name += plain ? c : '_';
+       }
+
+     char   ids[32];
+     sprintf(ids, ".%d.%d", pid, tag);
+     return(name + ids);
+   }
+
+inline
+  int ShmXferSegment::nextTag()
+   {
+     static int   s_tag = 0;
+     return(__sync_fetch_and_add(&s_tag, 1));
+   }
+
+inline
+  bool ShmXferSegment::isMapped() const
+   { return(m_base != NULL); }
+
+inline
+  LocalXferRing & ShmXferSegment::getRing()
+   { return(*(LocalXferRing *)m_base); }
+
+inline
+  void * ShmXferSegment::getAux()
+   { return(m_base + m_auxOffset); }
+
+inline
+  void * ShmXferSegment::getData()
+   { return(m_base + m_dataOffset); }
+
+inline
+  void ShmXferSegment::setFrame(int slot, int length, int seqNum)
+   {
+     FrameInfo   *info = (FrameInfo *)(m_base + sizeof(LocalXferRing));
+     info[slot].length = length;
+     info[slot].seqNum = seqNum;
+   }
+
+inline
+  int ShmXferSegment::getFrameLength(int slot) const
+   { return(((FrameInfo *)(m_base + sizeof(LocalXferRing)))[slot].length); }
+
+inline
+  int ShmXferSegment::getFrameSeqNum(int slot) const
+   { return(((FrameInfo *)(m_base + sizeof(LocalXferRing)))[slot].seqNum); }
+
+inline
+  void ShmXferSegment::layout(int depth, size_t slotBytes, size_t auxBytes)
+   {
+     size_t   page = sysconf(_SC_PAGESIZE);
+     size_t   info = sizeof(LocalXferRing) + depth * sizeof(FrameInfo);
+
+     m_auxOffset  = (info + CACHE_LINE - 1) & ~(size_t)(CACHE_LINE - 1);
+     m_dataOffset = (m_auxOffset + auxBytes + page - 1) & ~(page - 1);
+     m_bytes      = m_dataOffset + depth * slotBytes;
+   }
+
+inline
+  bool ShmXferSegment::map(int fd)
+   {
+     void   *base = mmap(NULL, m_bytes, PROT_READ | PROT_WRITE, MAP_SHARED,
+                         fd, 0);
+     if (base == MAP_FAILED)
+         return(false);
+     m_base = (char *)base;
+     return(true);
+   }
+
+}// end namespace
+
+#endif // PVTOL_SHMXFERSEGMENT_H not defined
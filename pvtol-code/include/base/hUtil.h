@@ -48,6 +48,28 @@ extern "C" void safeBuild( HTaskInfo * info, char * srcFile);
 extern "C" void launchKernel(	const char * krn, int * dims, int nParams, int * paramSizes,
                               void ** params, int * gDim, int * bDim, int locMem,
                               HTaskInfo * info);
+// Stream and event functions. Operations queued on a stream run in order on
+// its own thread, whatever device they are for, while the caller carries on.
+// Their arguments, kernel parameters included, are copied when queued.
+typedef cpuStream hStream;
+typedef cpuEvent  hEvent;
+extern "C" hStream hStreamCreate();
+extern "C" void    hStreamDestroy(     hStream stream );
+extern "C" void    hStreamSynchronize( hStream stream );
+extern "C" void    hStreamWaitEvent(   hStream stream, hEvent event );
+extern "C" hEvent  hEventCreate();
+extern "C" void    hEventDestroy(      hEvent event );
+extern "C" void    hEventRecord(       hEvent event, hStream stream );
+extern "C" int     hEventQuery(        hEvent event );
+extern "C" void    hEventWait(         hEvent event );
+extern "C" void    clearMemAsync( int * dims, int typeSize, int stride, void * ptr,
+                                  HTaskInfo * info, hStream stream );
+extern "C" void    moveDataAsync( void * dst, int dstStride, HTaskInfo * dstInfo,
+                                  void * src, int srcStride, HTaskInfo * srcInfo,
+                                  int * dims, int typeSize, const char * name, hStream stream );
+extern "C" void    launchKernelAsync( const char * krn, int * dims, int nParams, int * paramSizes,
+                                      void ** params, int * gDim, int * bDim, int locMem,
+                                      HTaskInfo * info, hStream stream );
 // Helper functions
 extern "C" hTaskLoc findLocation(HTaskInfo * infos, int ni);
 
@@ -203,5 +225,155 @@ void safeBuild(HTaskInfo * info, char * srcFile) {
    return;
 }
 
+/* Stream and event functions; the CPU backend provides them for every device */
+extern "C" inline hStream hStreamCreate() { return cpuStreamCreate(); }
+extern "C" inline void hStreamDestroy(hStream stream) { cpuStreamDestroy(stream); }
+extern "C" inline void hStreamSynchronize(hStream stream) { cpuStreamSynchronize(stream); }
+extern "C" inline void hStreamWaitEvent(hStream stream, hEvent event) { cpuStreamWaitEvent(stream, event); }
+extern "C" inline hEvent hEventCreate() { return cpuEventCreate(); }
+extern "C" inline void hEventDestroy(hEvent event) { cpuEventDestroy(event); }
+extern "C" inline void hEventRecord(hEvent event, hStream stream) { cpuEventRecord(event, stream); }
+extern "C" inline int hEventQuery(hEvent event) { return cpuEventQuery(event); }
+extern "C" inline void hEventWait(hEvent event) { cpuEventWait(event); }
+
+/* Queued clearMem arguments */
+typedef struct {
+   int dims[HNDIMS];
+   int typeSize;
+   int stride;
+   void * ptr;
+   HTaskInfo info;
+} hClearOp;
+
+extern "C" inline
+void hRunClear(void * arg) {
+   hClearOp * op = (hClearOp *)arg;
+   clearMem(op->dims, op->typeSize, op->stride, op->ptr, &op->info);
+   free(op);
+}
+
+/* clearMemAsync function */
+extern "C" inline
+void clearMemAsync(int * dims, int typeSize, int stride, void * ptr, HTaskInfo * info, hStream stream) {
+   hClearOp * op = (hClearOp *)malloc(sizeof(hClearOp));
+   if (!op) { hStreamSynchronize(stream); clearMem(dims, typeSize, stride, ptr, info); return; }
+   for (int idx = 0; idx < HNDIMS; idx++) { op->dims[idx] = dims[idx]; }
+   op->typeSize = typeSize;
+   op->stride = stride;
+   op->ptr = ptr;
+   op->info = *info;
+   cpuStreamEnqueue(stream, hRunClear, op);
+   return;
+}
+
+/* Queued moveData arguments; name points into the same block */
+typedef struct {
+   void * dst;
+   int dstStride;
+   HTaskInfo dstInfo;
+   void * src;
+   int srcStride;
+   HTaskInfo srcInfo;
+   int dims[HNDIMS];
+   int typeSize;
+   char * name;
+} hMoveOp;
+
+extern "C" inline
+void hRunMove(void * arg) {
+   hMoveOp * op = (hMoveOp *)arg;
+   moveData(op->dst, op->dstStride, &op->dstInfo, op->src, op->srcStride, &op->srcInfo,
+            op->dims, op->typeSize, op->name);
+   free(op);
+}
+
+/* moveDataAsync function */
+extern "C" inline
+void moveDataAsync(void * dst, int dstStride, HTaskInfo * dstInfo, void * src, int srcStride,
+                   HTaskInfo * srcInfo, int * dims, int typeSize, const char * name, hStream stream) {
+   size_t nameLen = strlen(name) + 1;
+   hMoveOp * op = (hMoveOp *)malloc(sizeof(hMoveOp) + nameLen);
+   if (!op) {
+      hStreamSynchronize(stream);
+      moveData(dst, dstStride, dstInfo, src, srcStride, srcInfo, dims, typeSize, name);
+      return;
+   }
+   op->dst = dst;
+   op->dstStride = dstStride;
+   op->dstInfo = *dstInfo;
+   op->src = src;
+   op->srcStride = srcStride;
+   op->srcInfo = *srcInfo;
+   for (int idx = 0; idx < HNDIMS; idx++) { op->dims[idx] = dims[idx]; }
+   op->typeSize = typeSize;
+   op->name = (char *)(op + 1);
+   memcpy(op->name, name, nameLen);
+   cpuStreamEnqueue(stream, hRunMove, op);
+   return;
+}
+
+/*
+ * Queued launchKernel arguments. The kernel name, the parameter pointers and
+ * the parameter values follow in the same block.
+ */
+typedef struct {
+   char * krn;
+   int dims[HNDIMS];
+   int nParams;
+   int * paramSizes;
+   void ** params;
+   int gDim[HNDIMS];
+   int bDim[HNDIMS];
+   int locMem;
+   HTaskInfo info;
+} hLaunchOp;
+
+extern "C" inline
+void hRunLaunch(void * arg) {
+   hLaunchOp * op = (hLaunchOp *)arg;
+   launchKernel(op->krn, op->dims, op->nParams, op->paramSizes, op->params,
+                op->gDim, op->bDim, op->locMem, &op->info);
+   free(op);
+}
+
+/* launchKernelAsync function */
+extern "C" inline
+void launchKernelAsync(const char * krn, int * dims, int nParams, int * paramSizes,
+                       void ** params, int * gDim, int * bDim, int locMem, HTaskInfo * info,
+                       hStream stream) {
+   // the values are kept 8 byte aligned, for parameters of any type
+   size_t valBytes = 0;
+   for (int idx = 0; idx < nParams; idx++) { valBytes += (paramSizes[idx] + 7) & ~7; }
+   size_t krnLen = strlen(krn) + 1;
+   size_t head = (sizeof(hLaunchOp) + nParams * (sizeof(void *) + sizeof(int)) + 7) & ~(size_t)7;
+   hLaunchOp * op = (hLaunchOp *)malloc(head + valBytes + krnLen);
+   if (!op) {
+      hStreamSynchronize(stream);
+      launchKernel(krn, dims, nParams, paramSizes, params, gDim, bDim, locMem, info);
+      return;
+   }
+   op->params = (void **)(op + 1);
+   op->paramSizes = (int *)(op->params + nParams);
+   char * val = (char *)op + head;
+   for (int idx = 0; idx < nParams; idx++) {
+      op->paramSizes[idx] = paramSizes[idx];
+      op->params[idx] = val;
+      memcpy(val, params[idx], paramSizes[idx]);
+      val += (paramSizes[idx] + 7) & ~7;
+   }
+   op->krn = val;
+   memcpy(op->krn, krn, krnLen);
+   for (int idx = 0; idx < HNDIMS; idx++) {
+      op->dims[idx] = dims[idx];
+      op->gDim[idx] = gDim[idx];
+      op->bDim[idx] = bDim[idx];
+   }
+   op->nParams = nParams;
+   op->locMem = locMem;
+   op->info = *info;
+   cpuStreamEnqueue(stream, hRunLaunch, op);
+   return;
+}
+
 #endif
 /* END UTILITY FUNCTIONS */
@@ -260,6 +260,40 @@ int CommScope::getNextTag() throw(Exception)
     return(tag);
   }
 
+/**
+ *                 getHostRanks()
+ *
+ * \brief get the host of each rank, named by the lowest rank of the
+ *          processes sharing it. The first call is collective over
+ *          this CommScope; later ones return the cached answer
+ * \return vector<int> indexed by rank
+ */
+const vector<int>& CommScope::getHostRanks()
+  {
+    if (!m_hostRanks.empty())
+       return(m_hostRanks);
+
+    int   numRanks = getNumProcs();
+    m_hostRanks.resize(numRanks);
+
+#if defined(_STANDARD_MPI) && (MPI_VERSION >= 3)
+    int        myRank, myHost;
+    MPI_Comm   hostComm;
+    MPI_Comm_rank(m_comm, &myRank);
+    MPI_Comm_split_type(m_comm, MPI_COMM_TYPE_SHARED, 0, MPI_INFO_NULL,
+                        &hostComm);
+    MPI_Allreduce(&myRank, &myHost, 1, MPI_INT, MPI_MIN, hostComm);
+    MPI_Comm_free(&hostComm);
+    MPI_Allgather(&myHost, 1, MPI_INT, &m_hostRanks[0], 1, MPI_INT, m_comm);
+#else
+    //   without MPI-3 no two ranks are known to share a host
+    for (int r = 0; r < numRanks; r++)
+       m_hostRanks[r] = r;
+#endif // _STANDARD_MPI && MPI-3
+
+    return(m_hostRanks);
+  }
+
 /**
  *                 returnTag(int tag)
  *
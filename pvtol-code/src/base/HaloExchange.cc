@@ -0,0 +1,888 @@
+/**
+ * File: HaloExchange.cc
+ *
+ *  Copyright (c) 2008, Massachusetts Institute of Technology
+ *  All rights reserved.
+ *
+ *  \author  $LastChangedBy$
+ *  \date    $LastChangedDate$
+ *  \version $LastChangedRevision$
+ *  \brief   Non-inline and non-templated methods of HaloExchange
+ *    A HaloExchange refreshes the overlap cells of a BLOCK or
+ *     BLOCK_CYCLIC distributed array.
+ *
+ * See Also: HaloExchange.inl for templated parts of code
+ *
+ *  $Id$
+ *
+ */
+#include <HaloExchange.h>
+#include <DataDistBase.h>
+#include <DataDistDescription.h>
+#include <PvtolProgram.h>
+#include <TaskBase.h>
+#include <Exception.h>
+
+#include <stdlib.h>
+#include <string.h>
+#include <iostream>
+using std::cout;
+using std::endl;
+using std::vector;
+
+#define noPVTOL_DEBUG
+
+namespace ipvtol
+{
+
+//------------------------------------------------------------------------
+//  Method:     Constructor
+//
+//  Description: Builds a halo exchange for an explicitly described local
+//               buffer. Must be called by every processor in the
+//               current task.
+//
+//  Inputs: DataMap ref, number of dims, global lengths, local address,
+//          local element strides, element size
+//  Returns: void
+//
+//------------------------------------------------------------------------
+HaloExchange::HaloExchange(const DataMap&      map,
+                           int                 numDims,
+                           const unsigned int *globalLengths,
+                           void               *localAddr,
+                           const int          *localStrides,
+                           int                 eltSize) :
+    m_numDims(numDims),
+    m_eltSize(eltSize),
+    m_localAddr(static_cast<char *>(localAddr)),
+    m_myIndex(-1),
+    m_tag(0),
+    m_inProgress(false),
+    m_numHaloRegions(0)
+{
+    PvtolProgram   prog;
+    TaskBase& ct   = prog.getCurrentTask();
+    m_commScopePtr = &(ct.getCommScope());
+
+    init(map, globalLengths, localStrides);
+}//end construct
+
+
+//------------------------------------------------------------------------
+//  Method: destructor
+//
+//  Description: completes any exchange in progress, frees the persistent
+//               requests and the pack buffers
+//
+//  Inputs: none
+//  Return: none
+//
+//------------------------------------------------------------------------
+HaloExchange::~HaloExchange()
+{
+    if (m_inProgress)
+        end();
+
+    for (unsigned int i=0; i<m_peers.size(); i++)
+      {
+        Peer   *peer = m_peers[i];
+
+        if (peer->sendBytes > 0)
+          {
+            peer->sendReq.requestFree();
+            free(peer->sendBuff);
+          }
+        if (peer->recvBytes > 0)
+          {
+            peer->recvReq.requestFree();
+            free(peer->recvBuff);
+          }
+        delete peer;
+      }//endFor each peer
+
+    m_commScopePtr->returnTag(m_tag);
+}//end destruct
+
+
+//------------------------------------------------------------------------
+//  Method: init()
+//
+//  Description: Common constructor code. Works out the geometry of every
+//               processor's blocks and halos, then the faces, edges and
+//               corners this processor sends and receives, and builds
+//               one persistent send and receive per neighbor.
+//
+//  Inputs: DataMap ref, global lengths, local element strides
+//  Return: none
+//
+//------------------------------------------------------------------------
+void HaloExchange::init(const DataMap&      map,
+                        const unsigned int *globalLengths,
+                        const int          *localStrides)
+{
+#ifdef PVTOL_DEVELOP
+    if ((m_numDims < 1) || (m_numDims > MAX_DIM))
+        throw Exception("HaloExchange: number of dimensions not supported",
+                        __FILE__, __LINE__);
+#endif // PVTOL_DEVELOP
+
+    // Every processor in the task takes a tag, to keep them in step
+    m_tag = m_commScopePtr->getNextTag();
+
+    const Grid&      grid      = map.getGrid();
+    const RankList&  rankList  = map.getRankList();
+    int              numGridDims = grid.getNumDimensions();
+    int              numRanks  = rankList.getNumRanks();
+    int              myProcId  = m_commScopePtr->getProcId();
+
+    for (int d=0; d<m_numDims; d++)
+      {
+        m_strides[d]  = localStrides[d];
+        m_gridDims[d] = (d < numGridDims) ? grid.getDimension(d) : 1;
+      }//endFor each dim
+
+    m_ranks.resize(numRanks);
+    for (int i=0; i<numRanks; i++)
+      {
+        ProcId   procId = rankList.getRank(i);
+        m_ranks[i] = m_commScopePtr->rank(procId);
+        if (procId == myProcId)
+            m_myIndex = i;
+      }//endFor each rank in the map
+
+    // Processors outside the map have nothing to exchange
+    if (m_myIndex < 0)
+        return;
+
+    indexToCoord(m_myIndex, m_myCoord);
+
+    for (int d=0; d<m_numDims; d++)
+        buildSegments(map, d, globalLengths[d], m_segs[d]);
+
+    //  The halos this processor receives, then for every other processor
+    //   the halos it needs from this one. Both ends enumerate the
+    //   receiver's halos in the same order, so the pack and unpack
+    //   orders of a message agree.
+    enumerateHalos(m_myCoord, -1, true);
+
+    int   gridCoord[MAX_DIM];
+    for (int q=0; q<numRanks; q++)
+      {
+        if (q == m_myIndex)
+            continue;
+        indexToCoord(q, gridCoord);
+        enumerateHalos(gridCoord, m_myIndex, false);
+      }//endFor each other processor
+
+    for (unsigned int i=0; i<m_peers.size(); i++)
+      {
+        Peer   *peer = m_peers[i];
+
+        peer->sendBytes = 0;
+        for (unsigned int r=0; r<peer->sendRegions.size(); r++)
+            peer->sendBytes += regionBytes(peer->sendRegions[r]);
+        peer->recvBytes = 0;
+        for (unsigned int r=0; r<peer->recvRegions.size(); r++)
+            peer->recvBytes += regionBytes(peer->recvRegions[r]);
+
+        if (peer->sendBytes > 0)
+          {
+            peer->sendBuff = static_cast<char *>(malloc(peer->sendBytes));
+            if (peer->sendBuff == NULL)
+                throw Exception("HaloExchange: could not allocate send buffer",
+                                __FILE__, __LINE__);
+            m_commScopePtr->sendInit(peer->sendBuff, NULL, peer->sendBytes,
+                                     peer->rank, m_tag, peer->sendReq);
+          }
+        if (peer->recvBytes > 0)
+          {
+            peer->recvBuff = static_cast<char *>(malloc(peer->recvBytes));
+            if (peer->recvBuff == NULL)
+                throw Exception("HaloExchange: could not allocate recv buffer",
+                                __FILE__, __LINE__);
+            m_commScopePtr->recvInit(NULL, peer->recvBuff, peer->recvBytes,
+                                     peer->rank, m_tag, peer->recvReq);
+          }
+#ifdef PVTOL_DEBUG
+        cout << "HaloExchange: peer " << peer->rank
+             << " sends " << peer->sendRegions.size() << " regions ("
+             << peer->sendBytes << " bytes), recvs "
+             << peer->recvRegions.size() << " regions ("
+             << peer->recvBytes << " bytes)" << endl;
+#endif // PVTOL_DEBUG
+      }//endFor each peer
+
+    return;
+}//end init()
+
+
+//------------------------------------------------------------------------
+//  Method: computeLocalLengths()
+//
+//  Description: local lengths, halos included, of the calling processor's
+//               part of an array distributed by the given map
+//
+//  Inputs: DataMap ref, number of dims, global lengths
+//  Return: the local lengths
+//
+//------------------------------------------------------------------------
+void HaloExchange::computeLocalLengths(const DataMap&      map,
+                                       int                 numDims,
+                                       const unsigned int *globalLengths,
+                                       unsigned int       *localLengths)
+{
+    PvtolProgram   prog;
+    CommScope&     cs = prog.getCurrentTask().getCommScope();
+
+    const Grid&      grid      = map.getGrid();
+    const RankList&  rankList  = map.getRankList();
+    int              numGridDims = grid.getNumDimensions();
+    int              myIndex   = -1;
+
+    for (int i=0; i<rankList.getNumRanks(); i++)
+      {
+        if (rankList.getRank(i) == cs.getProcId())
+            myIndex = i;
+      }
+
+    for (int d=numDims-1; d>=0; d--)
+      {
+        int   gridDim = (d < numGridDims) ? grid.getDimension(d) : 1;
+
+        localLengths[d] = 0;
+        if (myIndex < 0)
+            continue;
+
+        int   coord = myIndex % gridDim;
+        myIndex /= gridDim;
+
+        vector< vector<Segment> >  segs;
+        buildSegments(map, d, globalLengths[d], segs);
+
+        const vector<Segment>&  mySegs = segs[coord];
+        for (unsigned int s=0; s<mySegs.size(); s++)
+            localLengths[d] += mySegs[s].ownedLen + mySegs[s].haloLen;
+      }//endFor each dim
+
+    return;
+}//end computeLocalLengths()
+
+
+//------------------------------------------------------------------------
+//  Method: begin()
+//
+//  Description: packs the boundary cells owned by this processor into
+//               the send buffers and starts the persistent receives and
+//               sends. Halos owned by this processor itself are copied
+//               directly.
+//
+//  Inputs: none
+//  Return: none
+//
+//------------------------------------------------------------------------
+void HaloExchange::begin()
+{
+#ifdef PVTOL_DEVELOP
+    if (m_inProgress)
+        throw Exception("HaloExchange::begin() called twice without end()",
+                        __FILE__, __LINE__);
+#endif // PVTOL_DEVELOP
+
+    if (m_myIndex < 0)
+        return;
+
+    for (unsigned int i=0; i<m_peers.size(); i++)
+      {
+        if (m_peers[i]->recvBytes > 0)
+            m_peers[i]->recvReq.start();
+      }//endFor each peer
+
+    for (unsigned int i=0; i<m_peers.size(); i++)
+      {
+        Peer   *peer = m_peers[i];
+
+        if (peer->sendBytes > 0)
+          {
+            char   *buff = peer->sendBuff;
+            for (unsigned int r=0; r<peer->sendRegions.size(); r++)
+              {
+                packRegion(peer->sendRegions[r], buff);
+                buff += regionBytes(peer->sendRegions[r]);
+              }
+            peer->sendReq.start();
+          }
+      }//endFor each peer
+
+    for (unsigned int i=0; i<m_selfCopies.size(); i++)
+        copyRegion(m_selfCopies[i].first, m_selfCopies[i].second);
+
+    m_inProgress = true;
+    return;
+}//end begin()
+
+
+//------------------------------------------------------------------------
+//  Method: end()
+//
+//  Description: waits for the receives and unpacks them into the halos,
+//               then waits for the sends so the buffers may be reused
+//
+//  Inputs: none
+//  Return: none
+//
+//------------------------------------------------------------------------
+void HaloExchange::end()
+{
+    PvtolStatus   stat;
+
+    if (m_myIndex < 0)
+        return;
+
+#ifdef PVTOL_DEVELOP
+    if (!m_inProgress)
+        throw Exception("HaloExchange::end() called without begin()",
+                        __FILE__, __LINE__);
+#endif // PVTOL_DEVELOP
+
+    for (unsigned int i=0; i<m_peers.size(); i++)
+      {
+        Peer   *peer = m_peers[i];
+
+        if (peer->recvBytes > 0)
+          {
+            peer->recvReq.wait(stat);
+
+            const char   *buff = peer->recvBuff;
+            for (unsigned int r=0; r<peer->recvRegions.size(); r++)
+              {
+                unpackRegion(peer->recvRegions[r], buff);
+                buff += regionBytes(peer->recvRegions[r]);
+              }
+          }
+      }//endFor each peer
+
+    for (unsigned int i=0; i<m_peers.size(); i++)
+      {
+        if (m_peers[i]->sendBytes > 0)
+            m_peers[i]->sendReq.wait(stat);
+      }//endFor each peer
+
+    m_inProgress = false;
+    return;
+}//end end()
+
+
+//------------------------------------------------------------------------
+//  Method: exchange()
+//
+//  Description: a complete, blocking, halo exchange
+//
+//  Inputs: none
+//  Return: none
+//
+//------------------------------------------------------------------------
+void HaloExchange::exchange()
+{
+    begin();
+    end();
+    return;
+}//end exchange()
+
+
+//------------------------------------------------------------------------
+//  Method: buildSegments()
+//
+//  Description: splits one dimension into its global blocks and gives
+//               each grid coordinate its list of local blocks. A block's
+//               halo is the first "overlap" elements of the block which
+//               follows it, as in Pitfalls.
+//
+//  Inputs: DataMap ref, dimension, global length of that dimension
+//  Return: the segments of each grid coordinate
+//
+//------------------------------------------------------------------------
+void HaloExchange::buildSegments(const DataMap&   map,
+                                 int              dim,
+                                 unsigned int     globalLength,
+                                 vector< vector<Segment> > &segs)
+{
+    const Grid&  grid  = map.getGrid();
+    int          numEls = globalLength;
+    int          p     = (dim < grid.getNumDimensions()) ?
+                              grid.getDimension(dim) : 1;
+
+    const DataDistDescription& dd = map.getDistDescription();
+    DataDistBase::DataDistType  type = DataDistBase::REPLICATED;
+    int                         overlap = 0;
+    int                         blkSize = 0;
+
+    if (dim < grid.getNumDimensions())
+      {
+        type    = dd.getDataDistType(dim);
+        overlap = dd.getOverlapSize(dim);
+      }
+
+    segs.clear();
+    segs.resize(p);
+
+    vector<int>   blkStart;
+    vector<int>   blkLen;
+    vector<int>   blkOwner;
+
+    switch (type)
+      {
+      case DataDistBase::BLOCK:
+        // Same block size as Pitfalls::constructHelper()
+        if ((overlap == 0) || (p == 1))
+            blkSize = (numEls + p - 1) / p;
+         else
+            blkSize = (int)((float)(((float)numEls +
+                                     (((float)p - 1)*(float)overlap)) /
+                                    (float)p) + .5) - overlap;
+        for (int k=0; k<p; k++)
+          {
+            int   start = k * blkSize;
+            int   len   = (k == p-1) ? numEls - start : blkSize;
+
+            if (start + len > numEls)
+                len = numEls - start;
+            blkStart.push_back(start);
+            blkLen.push_back((len > 0) ? len : 0);
+            blkOwner.push_back(k);
+          }
+        break;
+
+      case DataDistBase::CYCLIC:
+      case DataDistBase::BLOCK_CYCLIC:
+        blkSize = (type == DataDistBase::CYCLIC) ? 1 : dd.getBlockSize(dim);
+        for (int k=0; k*blkSize<numEls; k++)
+          {
+            int   len = numEls - k*blkSize;
+
+            blkStart.push_back(k * blkSize);
+            blkLen.push_back((len < blkSize) ? len : blkSize);
+            blkOwner.push_back(k % p);
+          }
+        break;
+
+      default:
+        // Replicated, each processor holds the whole dimension
+        for (int j=0; j<p; j++)
+          {
+            Segment   seg;
+            seg.globalStart  = 0;
+            seg.ownedLen     = numEls;
+            seg.haloLen      = 0;
+            seg.haloOwner    = j;
+            seg.haloOwnerOff = 0;
+            seg.localOff     = 0;
+            seg.nextBlock    = -1;
+            segs[j].push_back(seg);
+          }
+        return;
+      }//end switch on dist type
+
+    int           numBlks = blkStart.size();
+    vector<int>   blkSeg(numBlks, -1);
+    vector<int>   localOff(p, 0);
+
+    for (int k=0; k<numBlks; k++)
+      {
+        if (blkLen[k] == 0)
+            continue;
+
+        Segment   seg;
+        int       owner = blkOwner[k];
+
+        seg.globalStart  = blkStart[k];
+        seg.ownedLen     = blkLen[k];
+        seg.haloLen      = 0;
+        seg.haloOwner    = owner;
+        seg.haloOwnerOff = 0;
+        seg.localOff     = localOff[owner];
+        seg.nextBlock    = -1;
+
+        if ((overlap > 0) && (k+1 < numBlks) && (blkLen[k+1] > 0))
+          {
+            seg.haloLen   = (overlap < blkLen[k+1]) ? overlap : blkLen[k+1];
+            seg.haloOwner = blkOwner[k+1];
+            seg.nextBlock = k+1;
+          }
+
+        localOff[owner] += seg.ownedLen + seg.haloLen;
+        blkSeg[k] = segs[owner].size();
+        segs[owner].push_back(seg);
+      }//endFor each global block
+
+    // The halo's offset at its owner is that of the following block
+    for (int j=0; j<p; j++)
+      {
+        for (unsigned int s=0; s<segs[j].size(); s++)
+          {
+            Segment&  seg = segs[j][s];
+            if (seg.nextBlock >= 0)
+                seg.haloOwnerOff =
+                    segs[seg.haloOwner][blkSeg[seg.nextBlock]].localOff;
+          }
+      }//endFor each grid coordinate
+
+    return;
+}//end buildSegments()
+
+
+//------------------------------------------------------------------------
+//  Method: enumerateHalos()
+//
+//  Description: walks every halo region (face, edge or corner) of the
+//               processor at the given grid coordinate. With isRecv the
+//               coordinate is this processor's and every region is
+//               recorded as a receive (or a local copy). Otherwise only
+//               the regions owned by ownerIndex, i.e. this processor,
+//               are recorded, as sends to the processor at coord.
+//
+//  Inputs: grid coordinate, owner index filter, isRecv
+//  Return: none
+//
+//------------------------------------------------------------------------
+void HaloExchange::enumerateHalos(const int *coord,
+                                  int        ownerIndex,
+                                  bool       isRecv)
+{
+    int   segIdx[MAX_DIM];
+    int   numSegs[MAX_DIM];
+    int   ownerCoord[MAX_DIM];
+    int   numMasks = 1 << m_numDims;
+
+    for (int d=0; d<m_numDims; d++)
+      {
+        segIdx[d]  = 0;
+        numSegs[d] = m_segs[d][coord[d]].size();
+        if (numSegs[d] == 0)
+            return;
+      }
+
+    for (;;)
+      {
+        // Each set bit of the mask selects the halo part of that dim
+        for (int mask=1; mask<numMasks; mask++)
+          {
+            Region   local;
+            Region   remote;
+            bool     valid = true;
+
+            for (int d=0; d<m_numDims && valid; d++)
+              {
+                const Segment&  seg = m_segs[d][coord[d]][segIdx[d]];
+
+                if (mask & (1 << d))
+                  {
+                    if (seg.haloLen == 0)
+                        valid = false;
+                    local.start[d]  = seg.localOff + seg.ownedLen;
+                    local.len[d]    = seg.haloLen;
+                    remote.start[d] = seg.haloOwnerOff;
+                    ownerCoord[d]   = seg.haloOwner;
+                  }
+                 else
+                  {
+                    local.start[d]  = seg.localOff;
+                    local.len[d]    = seg.ownedLen;
+                    remote.start[d] = seg.localOff;
+                    ownerCoord[d]   = coord[d];
+                  }
+                remote.len[d] = local.len[d];
+              }//endFor each dim
+
+            if (!valid)
+                continue;
+
+            int   owner = coordToIndex(ownerCoord);
+
+            if (isRecv)
+              {
+                m_numHaloRegions++;
+                if (owner == m_myIndex)
+                    m_selfCopies.push_back(std::make_pair(remote, local));
+                 else
+                    getPeer(m_ranks[owner]).recvRegions.push_back(local);
+              }
+             else if (owner == ownerIndex)
+              {
+                getPeer(m_ranks[coordToIndex(coord)]).sendRegions.push_back(remote);
+              }
+          }//endFor each halo mask
+
+        // step to the next combination of local blocks
+        int   d = m_numDims - 1;
+        while ((d >= 0) && (++segIdx[d] == numSegs[d]))
+          {
+            segIdx[d] = 0;
+            d--;
+          }
+        if (d < 0)
+            break;
+      }//endFor each combination of blocks
+
+    return;
+}//end enumerateHalos()
+
+
+//------------------------------------------------------------------------
+//  Method: coordToIndex()
+//
+//  Description: grid coordinate to index in the map's RankList. The
+//               grid is laid out with the last dimension varying fastest.
+//
+//  Inputs: int * grid coordinate
+//  Return: int
+//
+//------------------------------------------------------------------------
+int HaloExchange::coordToIndex(const int *coord) const
+{
+    int   index = 0;
+
+    for (int d=0; d<m_numDims; d++)
+        index = index * m_gridDims[d] + coord[d];
+
+    return(index);
+}//end coordToIndex()
+
+
+//------------------------------------------------------------------------
+//  Method: indexToCoord()
+//
+//  Description: index in the map's RankList to grid coordinate
+//
+//  Inputs: int index
+//  Return: int * grid coordinate
+//
+//------------------------------------------------------------------------
+void HaloExchange::indexToCoord(int index, int *coord) const
+{
+    for (int d=m_numDims-1; d>=0; d--)
+      {
+        coord[d] = index % m_gridDims[d];
+        index   /= m_gridDims[d];
+      }
+
+    return;
+}//end indexToCoord()
+
+
+//------------------------------------------------------------------------
+//  Method: getPeer()
+//
+//  Description: finds, or creates, the Peer for a rank
+//
+//  Inputs: int rank in the CommScope
+//  Return: Peer ref
+//
+//------------------------------------------------------------------------
+HaloExchange::Peer& HaloExchange::getPeer(int rank)
+{
+    for (unsigned int i=0; i<m_peers.size(); i++)
+      {
+        if (m_peers[i]->rank == rank)
+            return(*m_peers[i]);
+      }
+
+    Peer   *peer = new Peer;
+    peer->rank      = rank;
+    peer->sendBytes = 0;
+    peer->recvBytes = 0;
+    peer->sendBuff  = NULL;
+    peer->recvBuff  = NULL;
+    m_peers.push_back(peer);
+
+    return(*peer);
+}//end getPeer()
+
+
+//------------------------------------------------------------------------
+//  Method: regionBytes()
+//
+//  Description: size in bytes of a region once packed
+//
+//  Inputs: Region ref
+//  Return: int
+//
+//------------------------------------------------------------------------
+int HaloExchange::regionBytes(const Region &reg) const
+{
+    int   bytes = m_eltSize;
+
+    for (int d=0; d<m_numDims; d++)
+        bytes *= reg.len[d];
+
+    return(bytes);
+}//end regionBytes()
+
+
+//------------------------------------------------------------------------
+//  Method: padRegion()
+//
+//  Description: expresses a region as MAX_DIM dims, padding the leading
+//               dims with unit lengths
+//
+//  Inputs: Region ref
+//  Return: start, length and element stride of each dim
+//
+//------------------------------------------------------------------------
+void HaloExchange::padRegion(const Region &reg,
+                             int          *start,
+                             int          *len,
+                             int          *stride) const
+{
+    int   pad = MAX_DIM - m_numDims;
+
+    for (int d=0; d<MAX_DIM; d++)
+      {
+        if (d < pad)
+          {
+            start[d]  = 0;
+            len[d]    = 1;
+            stride[d] = 0;
+          }
+         else
+          {
+            start[d]  = reg.start[d-pad];
+            len[d]    = reg.len[d-pad];
+            stride[d] = m_strides[d-pad];
+          }
+      }//endFor each padded dim
+
+    return;
+}//end padRegion()
+
+
+//------------------------------------------------------------------------
+//  Method: packRegion()
+//
+//  Description: copies a region of the local block into a buffer
+//
+//  Inputs: Region ref, buffer
+//  Return: none
+//
+//------------------------------------------------------------------------
+void HaloExchange::packRegion(const Region &reg, char *buff) const
+{
+    int   start[MAX_DIM], len[MAX_DIM], stride[MAX_DIM];
+
+    padRegion(reg, start, len, stride);
+
+    int   rowBytes = len[2] * m_eltSize;
+
+    for (int i=0; i<len[0]; i++)
+      {
+        for (int j=0; j<len[1]; j++)
+          {
+            const char *row = m_localAddr + m_eltSize *
+                               ((start[0]+i)*stride[0] +
+                                (start[1]+j)*stride[1] +
+                                 start[2]*stride[2]);
+            if (stride[2] == 1)
+              {
+                memcpy(buff, row, rowBytes);
+                buff += rowBytes;
+              }
+             else
+              {
+                for (int k=0; k<len[2]; k++)
+                  {
+                    memcpy(buff, row + k*stride[2]*m_eltSize, m_eltSize);
+                    buff += m_eltSize;
+                  }
+              }
+          }//endFor dim 1
+      }//endFor dim 0
+
+    return;
+}//end packRegion()
+
+
+//------------------------------------------------------------------------
+//  Method: unpackRegion()
+//
+//  Description: copies a buffer into a region of the local block
+//
+//  Inputs: Region ref, buffer
+//  Return: none
+//
+//------------------------------------------------------------------------
+void HaloExchange::unpackRegion(const Region &reg, const char *buff)
+{
+    int   start[MAX_DIM], len[MAX_DIM], stride[MAX_DIM];
+
+    padRegion(reg, start, len, stride);
+
+    int   rowBytes = len[2] * m_eltSize;
+
+    for (int i=0; i<len[0]; i++)
+      {
+        for (int j=0; j<len[1]; j++)
+          {
+            char *row = m_localAddr + m_eltSize *
+                         ((start[0]+i)*stride[0] +
+                          (start[1]+j)*stride[1] +
+                           start[2]*stride[2]);
+            if (stride[2] == 1)
+              {
+                memcpy(row, buff, rowBytes);
+                buff += rowBytes;
+              }
+             else
+              {
+                for (int k=0; k<len[2]; k++)
+                  {
+                    memcpy(row + k*stride[2]*m_eltSize, buff, m_eltSize);
+                    buff += m_eltSize;
+                  }
+              }
+          }//endFor dim 1
+      }//endFor dim 0
+
+    return;
+}//end unpackRegion()
+
+
+//------------------------------------------------------------------------
+//  Method: copyRegion()
+//
+//  Description: copies one region of the local block to another of the
+//               same shape, used for halos owned by this processor
+//
+//  Inputs: source Region ref, destination Region ref
+//  Return: none
+//
+//------------------------------------------------------------------------
+void HaloExchange::copyRegion(const Region &src, const Region &dest)
+{
+    int   srcStart[MAX_DIM], destStart[MAX_DIM];
+    int   len[MAX_DIM], stride[MAX_DIM];
+
+    padRegion(src, srcStart, len, stride);
+    padRegion(dest, destStart, len, stride);
+
+    for (int i=0; i<len[0]; i++)
+      {
+        for (int j=0; j<len[1]; j++)
+          {
+            for (int k=0; k<len[2]; k++)
+              {
+                int   srcOff  = (srcStart[0]+i)*stride[0] +
+                                (srcStart[1]+j)*stride[1] +
+                                (srcStart[2]+k)*stride[2];
+                int   destOff = (destStart[0]+i)*stride[0] +
+                                (destStart[1]+j)*stride[1] +
+                                (destStart[2]+k)*stride[2];
+                memcpy(m_localAddr + destOff*m_eltSize,
+                       m_localAddr + srcOff*m_eltSize, m_eltSize);
+              }
+          }
+      }//endFor dim 0
+
+    return;
+}//end copyRegion()
+
+}//end Namespace
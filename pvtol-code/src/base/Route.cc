@@ -23,12 +23,17 @@
  */
 #include <Route.h>
 #include <SendRequest.h>
+#include <RouteProgress.h>
 #include <PvtolStatus.h>
 #include <NTuple.h>
 #include <PvtolProgram.h>
 #include <TaskBase.h>
 #include <scoped_array.hpp>
 #include <unistd.h>
+#include <stdlib.h>
+#include <algorithm>
+#include <map>
+#include <utility>
 #include <iostream>
 
 #define no_DEBUG_1
@@ -39,6 +44,9 @@ namespace ipvtol
     using std::cerr;
     using std::cout;
     using std::endl;
+    using std::map;
+    using std::pair;
+    using std::sort;
     using boost::scoped_array;
 
 
@@ -68,7 +76,7 @@ void Route::simpleSendInfo(void    *srcBlkAddr,
         m_currSrcXfer.sendInfo->destAddr        = destBlkAddr;
         m_currSrcXfer.sendInfo->byteSize        = dataSize * m_eltSize;
         m_currSrcXfer.sendInfo->destPfIdx       = 0;
-        m_currSrcXfer.sendInfo->destRank        = destProc;
+        m_currSrcXfer.sendInfo->destRank        = m_commScopePtr->rank(destProc);
         m_currSrcXfer.sendInfo->sendIsLocal     = false;
         m_currSrcXfer.sendInfo->destAddrOffset  = 0;
         m_currSrcXfer.sendInfo->serStartIdx     = 0;
@@ -121,7 +129,7 @@ void Route::simpleRecvInfo(void    *srcBlkAddr,
         m_currDestXfer.recvInfo->srcAddr           = srcBlkAddr;
         m_currDestXfer.recvInfo->byteSize          = dataSize * m_eltSize;
         m_currDestXfer.recvInfo->srcPfIdx          = 0;
-        m_currDestXfer.recvInfo->srcRank           = srcProc;
+        m_currDestXfer.recvInfo->srcRank           = m_commScopePtr->rank(srcProc);
         m_currDestXfer.recvInfo->unpackingRequired = false;//No packing Yet
         m_currDestXfer.recvInfo->recvIsLocal       = false;
         m_currDestXfer.recvInfo->packInfo          = NULL;
@@ -970,17 +978,17 @@ void Route::procXferStructs()
     if (m_currSrcXfer.sendInfo != NULL)
       {
 	// set up each send
-        //const RankList &destRanks =  m_destMap->getRankList();
+        const RankList &destRanks =  m_destMap->getRankList();
 
         for (i=0; i<m_currSrcXfer.numSends; i++) {
-#ifdef NOT_YET
 	      destRank = m_commScopePtr->rank(
-                    destRanks[m_currSrcXfer.sendInfo[i].destPfIdx]);
-#endif // NOT_YET
+                    destRanks.getRank(m_currSrcXfer.sendInfo[i].destPfIdx));
 	      m_currSrcXfer.sendInfo[i].sendIsLocal = false;
 	      m_currSrcXfer.sendInfo[i].destRank    = destRank;
         }//endFor each send
 
+        orderSends();
+
         if (m_trait == STATIC_ROUTE)
           {
                 // use the sendInfos to build the persisant sends
@@ -1010,11 +1018,11 @@ void Route::procXferStructs()
     if (m_currDestXfer.recvInfo != NULL)
       {
 	//  set up each receive
+        const RankList &srcRanks =  m_srcMap->getRankList();
+
         for (i=0; i<m_currDestXfer.numRecvs; i++) {
-#ifdef NOT_YET
 	        srcRank = m_commScopePtr->rank(
-                    srcRanks[m_currDestXfer.recvInfo[i].srcPfIdx]);
-#endif // NOT_YET
+                    srcRanks.getRank(m_currDestXfer.recvInfo[i].srcPfIdx));
 		m_currDestXfer.recvInfo[i].recvIsLocal = false;
 		m_currDestXfer.recvInfo[i].srcRank     = srcRank;
         }//endFor each recv
@@ -1120,6 +1128,11 @@ void Route::isend(int srcOff, int destOff, SendRequest &req)
             cerr << "RteiSend: unknown trait " << m_trait << endl;
             throw Exception("PvlRoute: isend() FAILED!", __FILE__, __LINE__);
     }//end case of trait
+
+    //  let the progress engine drive whatever was started
+    if (m_asyncProgress && !req.m_done)
+        req.post();
+
     return;
 }//end isend(int, int, SendRequest&)
 
@@ -1291,8 +1304,18 @@ void Route::staticSend()
 
      if (m_isSrc)
        {
+          if (m_permuted)
+              packSends(0);
+
           nonLocalSends = m_currSrcXfer.numSends;
 
+          //  a per peer limit interleaves the starts with the waits
+          if (m_maxSendsPerPeer > 0)
+            {
+              windowedStaticSends();
+              nonLocalSends = 0;
+            }
+
           for (i=0; i<nonLocalSends; i++) {
                  (m_currSrcXfer.sendReq[i]).start();
 #ifdef _DEBUG_2
@@ -1382,10 +1405,14 @@ void Route::nonStaticSend(int srcOff, int destOff)
 
     if (m_srcIsLocal && (m_currSrcXfer.sendInfo != NULL))
     {
+        if (m_permuted)
+            packSends(srcOff);
+
         for (i=0; i<m_currSrcXfer.numSends; i++)
         {
-	  srcAddr = static_cast<char *>
-	    (m_currSrcXfer.sendInfo[i].addr) + (srcOff * m_eltSize);
+	  srcAddr = static_cast<char *>(m_currSrcXfer.sendInfo[i].addr);
+	  if (!m_currSrcXfer.sendInfo[i].packingRequired)
+	      srcAddr += (srcOff * m_eltSize);
 	  destAddr = static_cast<char *>
 	    (m_currSrcXfer.sendInfo[i].destAddr) +
 	    (destOff * m_eltSize);
@@ -1491,9 +1518,15 @@ void Route::iNonStaticSend(int srcOff, int destOff, SendRequest &sendReq)
 
     if (m_srcIsLocal && (m_currSrcXfer.sendInfo != NULL))
     {
+        if (m_permuted)
+            packSends(srcOff, sendReq);
+
         for (i=0, numIssued=0; i<m_currSrcXfer.numSends; i++) {
-	  srcAddr = static_cast<char *>
-	    (m_currSrcXfer.sendInfo[i].addr) + (srcOff * m_eltSize);
+	  if (m_currSrcXfer.sendInfo[i].packingRequired)
+	      srcAddr = sendReq.m_packBuff[i];
+	   else
+	      srcAddr = static_cast<char *>(m_currSrcXfer.sendInfo[i].addr) +
+	                (srcOff * m_eltSize);
 	  destAddr = static_cast<char *>
 	    (m_currSrcXfer.sendInfo[i].destAddr) +
 	    (destOff * m_eltSize);
@@ -1578,6 +1611,9 @@ void Route::iStaticSend(SendRequest &req)
       {
             int  numSendReqs = req.numSends();
 
+            if (m_permuted)
+                packSends(0, req);
+
 #ifdef _DEBUG_1
          cout << "Rte[" << procid << "," << taskid << "," << threadid
               << "], this is src"
@@ -2086,7 +2122,12 @@ Route::~Route() throw()
             delete[] m_currSrcXfer.sendReq;
 
     if (m_currSrcXfer.sendInfo != NULL)
+      {
+            for (int j=0; j<m_currSrcXfer.numSends; j++) {
+                delete m_currSrcXfer.sendInfo[j].packInfo;
+            }
             delete[] m_currSrcXfer.sendInfo;
+      }
 
     if (m_currDestXfer.recvReq != NULL)
             delete[] m_currDestXfer.recvReq;
@@ -2121,24 +2162,448 @@ Route::~Route() throw()
 //  Method: transposeLengths
 //
 //  Description:
-//     When the TRANSPOSE_102 flag is set this method will reorder
-//     the inputted unsigned int array.
+//     When one of the TRANSPOSE_ flags is set this method will reorder
+//     the inputted unsigned int array so that it holds the lengths of
+//     the destination, i.e. lengths[i] becomes lengths[perm[i]].
 //
 //  Inputs:
 //
-//     lengths      integer array to modify if necessary.
+//     lengths      integer array, of MAX_DIM entries, to modify if
+//                  necessary.
 //
 //     flags        Route flags that are used in the Route constructor.
 //
 //------------------------------------------------------------------------
 void Route::transposeLengths( unsigned int* lengths, Flags flags )
 {
-    if ( flags & TRANSPOSE_102 )
-    {
-        unsigned int newRow = lengths[0];
-        lengths[0] = lengths[1];
-        lengths[1] = newRow;
+    int            perm[MAX_DIM];
+    unsigned int   srcLengths[MAX_DIM];
+
+    if (!(flags & TRANSPOSED))
+        return;
+
+    decodePermutation(flags, MAX_DIM, perm);
+
+    for (int d=0; d<MAX_DIM; d++) {
+        srcLengths[d] = lengths[d];
+    }
+
+    for (int d=0; d<MAX_DIM; d++) {
+        lengths[d] = srcLengths[perm[d]];
+    }
+    return;
+}
+
+
+//------------------------------------------------------------------------
+//  Method: decodePermutation
+//
+//  Description:
+//     Decodes the axis permutation held in bits 1 - 4 of the flags.
+//     perm[i] is set to the source axis which becomes destination
+//     axis i. Axes beyond numDims are left in place.
+//
+//  Inputs:
+//
+//     flags        Route flags that are used in the Route constructor.
+//
+//     numDims      the number of dimensions of the data.
+//
+//     perm         integer array, of MAX_DIM entries, to fill in.
+//
+//  Return: false if the permutation does not apply to numDims
+//------------------------------------------------------------------------
+bool Route::decodePermutation(Flags flags, int numDims, int *perm)
+{
+    //              021      102      120      201      210
+    static const int permTable[5][3] = { {0,2,1}, {1,0,2}, {1,2,0},
+                                         {2,0,1}, {2,1,0} };
+    int   code = (flags & (TRANSPOSE_MASK & ~TRANSPOSED)) >> 1;
+    int   d;
+
+    for (d=0; d<MAX_DIM; d++) {
+        perm[d] = d;
+    }
+
+    if (!(flags & TRANSPOSED))
+        return(true);
+
+    if ((code < 1) || (code > 5))
+        return(false);
+
+    for (d=0; d<MAX_DIM; d++) {
+        if ((d >= numDims) && (permTable[code-1][d] != d))
+            return(false);// permutes an axis we do not have
+
+        perm[d] = permTable[code-1][d];
+    }
+
+    return(true);
+}
+
+
+//------------------------------------------------------------------------
+//  Method: permutationFlag
+//
+//  Description:
+//     Converts an axis permutation into the TRANSPOSE_ flag describing
+//     it. perm[i] is the source axis which becomes destination axis i.
+//
+//  Inputs:
+//
+//     perm         integer array of numDims entries.
+//
+//     numDims      the number of dimensions, at most MAX_DIM.
+//
+//  Return: the Flags value
+//------------------------------------------------------------------------
+Route::Flags Route::permutationFlag(const int *perm, int numDims)
+{
+    static const Flags permFlags[5] = { TRANSPOSE_021, TRANSPOSE_102,
+                                        TRANSPOSE_120, TRANSPOSE_201,
+                                        TRANSPOSE_210 };
+    int    candidate[MAX_DIM];
+    bool   identity = true;
+    int    d;
+
+    if ((numDims < 1) || (numDims > MAX_DIM))
+        throw Exception("PvtolRoute: bad number of dimensions for permutation",
+                        __FILE__, __LINE__);
+
+    for (d=0; d<numDims; d++) {
+        if (perm[d] != d)
+            identity = false;
+    }
+    if (identity)
+        return(DEFAULT_FLAG);
+
+    for (int f=0; f<5; f++) {
+        if (!decodePermutation(permFlags[f], numDims, candidate))
+            continue;
+
+        for (d=0; (d<numDims) && (candidate[d] == perm[d]); d++)
+            ;
+        if (d == numDims)
+            return(permFlags[f]);
+    }//endFor each permutation flag
+
+    throw Exception("PvtolRoute: invalid axis permutation",
+                    __FILE__, __LINE__);
+    return(DEFAULT_FLAG);
+}
+
+
+//------------------------------------------------------------------------
+//  Method: setupPermutedSend
+//
+//  Description:
+//     Builds the PackingInfo for the send(s) of a permuting Route. The
+//     send is redirected to a contiguous staging buffer which is filled,
+//     in destination order, by packSends() each time the Route sends.
+//
+//  Inputs:
+//
+//     srcLengths   the local lengths of the source, in source axis order
+//
+//     srcStrides   the strides, in elements, of the source
+//
+//------------------------------------------------------------------------
+void Route::setupPermutedSend(const int *srcLengths, const int *srcStrides)
+{
+    for (int i=0; i<m_currSrcXfer.numSends; i++) {
+        SendInfo     &si = m_currSrcXfer.sendInfo[i];
+        PackingInfo  *pi = new PackingInfo;
+
+        pi->numDims  = m_numDims;
+        pi->eltSize  = m_eltSize;
+        pi->srcAddr  = static_cast<const char *>(si.addr);
+        pi->byteSize = si.byteSize;
+        for (int d=0; d<m_numDims; d++) {
+            pi->lengths[d] = srcLengths[m_perm[d]];
+            pi->strides[d] = srcStrides[m_perm[d]];
+        }
+        pi->buff = new char[si.byteSize];
+
+        si.addr            = pi->buff;
+        si.packingRequired = true;
+        si.packInfo        = pi;
+    }//endFor each send
+
+    return;
+}
+
+
+//------------------------------------------------------------------------
+//  Method: packSends
+//
+//  Description:
+//     Packs, and so permutes, the source data of every send which
+//     requires it into its staging buffer.
+//
+//  Inputs:
+//
+//     srcOff       offset, in elements, into the source
+//
+//------------------------------------------------------------------------
+void Route::packSends(int srcOff)
+{
+    for (int i=0; i<m_currSrcXfer.numSends; i++) {
+        if (m_currSrcXfer.sendInfo[i].packingRequired)
+            m_currSrcXfer.sendInfo[i].packInfo->pack(srcOff);
+    }
+    return;
+}
+
+
+//------------------------------------------------------------------------
+//  Method: packSends
+//
+//  Description:
+//     As above, but packs into the SendRequest's own staging buffers,
+//     so a non-blocking send does not overwrite the data of an earlier
+//     one, made with another SendRequest, which is still in flight.
+//
+//  Inputs:
+//
+//     srcOff       offset, in elements, into the source
+//
+//     req          the SendRequest the sends will be issued on
+//
+//------------------------------------------------------------------------
+void Route::packSends(int srcOff, SendRequest &req)
+{
+    for (int i=0; i<m_currSrcXfer.numSends; i++) {
+        if (m_currSrcXfer.sendInfo[i].packingRequired)
+            m_currSrcXfer.sendInfo[i].packInfo->pack(srcOff,
+                                                     req.m_packBuff[i]);
+    }
+    return;
+}
+
+
+//------------------------------------------------------------------------
+//  Method: orderSends
+//
+//  Description:
+//     Reorders the SendInfos according to the SEND_ORDER_ flags. In
+//     SendInfo order every source tends to start with the same
+//     destination, so the receivers see the sends arrive as a burst, one
+//     receiver at a time. Rotating, or pairing, the order about this
+//     rank spreads the sends out. Only the order of the peers changes;
+//     the sends to any one peer keep their order, since they share the
+//     Route's tag and MPI matches them to the receives in that order.
+//     Must be called, once the destRanks are CommScope ranks, before any
+//     requests are built from the SendInfos.
+//
+//------------------------------------------------------------------------
+void Route::orderSends()
+{
+    int   numSends = m_currSrcXfer.numSends;
+
+    if ((m_sendOrder == DEFAULT_FLAG) || (numSends < 2))
+        return;
+
+    int   numProcs = m_commScopePtr->getNumProcs();
+    int   myRank   = m_commScopePtr->rank(m_commScopePtr->getProcId());
+    bool  powerOf2 = (numProcs & (numProcs - 1)) == 0;
+
+    vector< pair<int, int> >  order(numSends);
+
+    for (int i=0; i<numSends; i++) {
+        int   destRank = m_currSrcXfer.sendInfo[i].destRank;
+        int   key;
+
+        if ((m_sendOrder == SEND_ORDER_PAIRWISE) && powerOf2)
+            key = destRank ^ myRank;
+         else
+            key = (destRank - myRank + numProcs) % numProcs;
+        order[i] = pair<int, int>(key, i);
+    }
+    //  sorting the (key, index) pairs keeps sends to one peer in order
+    sort(order.begin(), order.end());
+
+    //  each peer's sends are now a run of order, given as (start, count)
+    vector< pair<int, int> >  peers;
+    for (int i=0; i<numSends; i++) {
+        if ((i == 0) || (order[i].first != order[i-1].first))
+            peers.push_back(pair<int, int>(i, 0));
+        peers.back().second++;
+    }
+
+    if (m_sendOrder == SEND_ORDER_RANDOM)
+      {//  a shuffle of the peers seeded by the rank, reproducible from
+       //   run to run
+        unsigned int   seed = (myRank + 1) * 2654435761u;
+
+        for (int i=(int)peers.size()-1; i>0; i--) {
+            int   j = rand_r(&seed) % (i + 1);
+            pair<int, int>   tmp = peers[i];
+            peers[i] = peers[j];
+            peers[j] = tmp;
+        }
+      }
+
+    vector<SendInfo>   reordered;
+    reordered.reserve(numSends);
+    for (unsigned int p=0; p<peers.size(); p++) {
+        for (int i=0; i<peers[p].second; i++)
+            reordered.push_back(
+                  m_currSrcXfer.sendInfo[order[peers[p].first + i].second]);
+    }
+    for (int i=0; i<numSends; i++)
+        m_currSrcXfer.sendInfo[i] = reordered[i];
+
+    return;
+}//end orderSends()
+
+
+//------------------------------------------------------------------------
+//  Method: windowedStaticSends
+//
+//  Description:
+//     Starts the persistent sends, in order, while keeping no more than
+//     m_maxSendsPerPeer of them in flight to any one peer, and waits for
+//     them all. A send held back by the limit is started as soon as the
+//     oldest outstanding send completes.
+//
+//------------------------------------------------------------------------
+void Route::windowedStaticSends()
+{
+    int           numSends  = m_currSrcXfer.numSends;
+    int           numStarted = 0;
+    int           firstIdle = 0;
+    PvtolStatus   stat;
+
+    map<int, int>  inFlight;   // by destRank
+    vector<bool>   started(numSends, false);
+    list<int>      active;
+
+    while ((numStarted < numSends) || !active.empty())
+      {
+        for (int i=firstIdle; i<numSends; i++) {
+            int   destRank = m_currSrcXfer.sendInfo[i].destRank;
+
+            if (started[i] || (inFlight[destRank] >= m_maxSendsPerPeer))
+                continue;
+
+            (m_currSrcXfer.sendReq[i]).start();
+            started[i] = true;
+            inFlight[destRank]++;
+            numStarted++;
+            active.push_back(i);
+        }//endFor each send not yet started
+        while ((firstIdle < numSends) && started[firstIdle])
+            firstIdle++;
+
+        if (!active.empty())
+          {
+            int   i = active.front();
+            active.pop_front();
+            (m_currSrcXfer.sendReq[i]).wait(stat);
+            inFlight[m_currSrcXfer.sendInfo[i].destRank]--;
+          }
+      }//endWhile sends outstanding
+
+    return;
+}//end windowedStaticSends()
+
+
+//------------------------------------------------------------------------
+//  Function: permuteCopy
+//
+//  Description:
+//     Gathers a (at most) 3-D strided source into a contiguous
+//     destination. ELT is a POD of the element size so the compiler
+//     can move each element with a single load/store.
+//
+//------------------------------------------------------------------------
+template <int SIZE> struct PackElt { char b[SIZE]; };
+
+template <class ELT>
+static void permuteCopy(const char *src, char *dst,
+                        const int *len, const int *str)
+{
+    const ELT  *s = reinterpret_cast<const ELT *>(src);
+    ELT        *d = reinterpret_cast<ELT *>(dst);
+    int         s2 = str[2];
+
+    for (int i0=0; i0<len[0]; i0++) {
+        for (int i1=0; i1<len[1]; i1++) {
+            const ELT  *sp = s + i0*str[0] + i1*str[1];
+            for (int i2=0; i2<len[2]; i2++) {
+                *d++ = *sp;
+                sp  += s2;
+            }
+        }
     }
+}
+
+
+//------------------------------------------------------------------------
+//  Method: PackingInfo::pack
+//
+//  Description:
+//     Copies the source data into dstBuff, in destination axis order.
+//
+//  Inputs:
+//
+//     srcOff       offset, in elements, into the source
+//
+//     dstBuff      the staging buffer, byteSize long
+//
+//------------------------------------------------------------------------
+void PackingInfo::pack(int srcOff, char *dstBuff) const
+{
+    int          len[MAX_DIM];
+    int          str[MAX_DIM];
+    int          pad = MAX_DIM - numDims;
+    const char  *src = srcAddr + (srcOff * eltSize);
+
+    //  treat everything as 3-D, padding the slow axes
+    for (int d=0; d<MAX_DIM; d++) {
+        len[d] = (d < pad) ? 1 : lengths[d-pad];
+        str[d] = (d < pad) ? 0 : strides[d-pad];
+    }
+
+    if (str[2] == 1)
+      {//  the fastest dest axis is also contiguous in the source
+        int    rowBytes = len[2] * eltSize;
+        char  *dst      = dstBuff;
+
+        for (int i0=0; i0<len[0]; i0++) {
+            for (int i1=0; i1<len[1]; i1++) {
+                memcpy(dst, src + (i0*str[0] + i1*str[1])*eltSize, rowBytes);
+                dst += rowBytes;
+            }
+        }
+        return;
+      }
+
+    switch (eltSize) {
+        case 4:
+            permuteCopy<PackElt<4> >(src, dstBuff, len, str);
+            break;
+        case 8:
+            permuteCopy<PackElt<8> >(src, dstBuff, len, str);
+            break;
+        case 16:
+            permuteCopy<PackElt<16> >(src, dstBuff, len, str);
+            break;
+        default:
+          {
+            char  *dst = dstBuff;
+            for (int i0=0; i0<len[0]; i0++) {
+                for (int i1=0; i1<len[1]; i1++) {
+                    for (int i2=0; i2<len[2]; i2++) {
+                        memcpy(dst, src + (i0*str[0] + i1*str[1] +
+                                           i2*str[2])*eltSize, eltSize);
+                        dst += eltSize;
+                    }
+                }
+            }
+          }
+    }//end case of element size
+
     return;
 }
 
@@ -0,0 +1,306 @@
+/**
+ * File: RouteProgress.cc
+ *
+ *  Copyright (c) 2008, Massachusetts Institute of Technology
+ *  All rights reserved.
+ *
+ *  \author  $LastChangedBy$
+ *  \date    $LastChangedDate$
+ *  \version $LastChangedRevision$
+ *  \brief   Non-inline methods of RouteProgress
+ *    The RouteProgress object is a per process progress engine for
+ *    non-blocking Route sends.
+ *
+ *  $Id$
+ *
+ */
+#include <RouteProgress.h>
+#include <SendRequest.h>
+#include <Exception.h>
+
+#include <sched.h>
+#include <unistd.h>
+#include <iostream>
+using std::cout;
+using std::endl;
+
+#define noPVTOL_DEBUG
+
+namespace ipvtol
+{
+
+//------------------------------------------------------------------------
+//  Method: instance()
+//
+//  Description: returns the progress engine for this process
+//
+//  Inputs: none
+//  Returns: RouteProgress ref
+//
+//------------------------------------------------------------------------
+RouteProgress& RouteProgress::instance()
+  {
+    static RouteProgress  theEngine;
+    return(theEngine);
+  }//end instance()
+
+
+//------------------------------------------------------------------------
+//  Method:     Constructor
+//
+//  Description: Constructs an idle, POLLED mode, engine
+//
+//  Inputs: none
+//  Returns: void
+//
+//------------------------------------------------------------------------
+RouteProgress::RouteProgress() :
+       m_threadRunning(false),
+       m_stopRequested(false),
+       m_pollIntervalUsec(0),
+       m_mode(POLLED)
+  {
+    pthread_mutex_init(&m_mutex, NULL);
+    pthread_cond_init(&m_workCond, NULL);
+    return;
+  }//end construct
+
+
+//------------------------------------------------------------------------
+//  Method: destructor
+//
+//  Description: stops the progress thread if it is running
+//
+//  Inputs: none
+//  Return: none
+//
+//------------------------------------------------------------------------
+RouteProgress::~RouteProgress()
+  {
+    stop();
+    pthread_cond_destroy(&m_workCond);
+    pthread_mutex_destroy(&m_mutex);
+  }//end destruct
+
+
+//------------------------------------------------------------------------
+//  Method: start()
+//
+//  Description: start the engine in the given mode. THREADED falls
+//               back to POLLED unless MPI provides MPI_THREAD_MULTIPLE.
+//
+//  Inputs: Mode, and the microseconds to sleep between sweeps
+//  Return: none
+//
+//------------------------------------------------------------------------
+void RouteProgress::start(Mode mode, int pollIntervalUsec)
+  {
+    if (mode == THREADED)
+      {
+        int   initialized = 0;
+        int   provided    = MPI_THREAD_SINGLE;
+        MPI_Initialized(&initialized);
+        if (initialized)
+            MPI_Query_thread(&provided);
+        if (provided != MPI_THREAD_MULTIPLE)
+          {
+#ifdef PVTOL_DEBUG
+            cout << "RouteProgress: MPI is not MPI_THREAD_MULTIPLE,"
+                 << " progress is POLLED" << endl;
+#endif // PVTOL_DEBUG
+            mode = POLLED;
+          }
+      }
+
+    pthread_mutex_lock(&m_mutex);
+    m_mode             = mode;
+    m_pollIntervalUsec = pollIntervalUsec;
+
+    if ((mode == THREADED) && !m_threadRunning)
+      {
+        m_stopRequested = false;
+        if (pthread_create(&m_thread, NULL,
+                           RouteProgress::progressThread, this) != 0)
+          {
+            m_mode = POLLED;
+            pthread_mutex_unlock(&m_mutex);
+            throw Exception("RouteProgress: could not create progress thread",
+                            __FILE__, __LINE__);
+          }
+        m_threadRunning = true;
+      }
+    pthread_mutex_unlock(&m_mutex);
+
+    return;
+  }//end start()
+
+
+//------------------------------------------------------------------------
+//  Method: stop()
+//
+//  Description: stop the progress thread, fall back to POLLED mode
+//
+//  Inputs: none
+//  Return: none
+//
+//------------------------------------------------------------------------
+void RouteProgress::stop()
+  {
+    pthread_mutex_lock(&m_mutex);
+    if (!m_threadRunning)
+      {
+        m_mode = POLLED;
+        pthread_mutex_unlock(&m_mutex);
+        return;
+      }
+    m_stopRequested = true;
+    pthread_cond_signal(&m_workCond);
+    pthread_mutex_unlock(&m_mutex);
+
+    pthread_join(m_thread, NULL);
+
+    pthread_mutex_lock(&m_mutex);
+    m_threadRunning = false;
+    m_mode          = POLLED;
+    pthread_mutex_unlock(&m_mutex);
+
+    return;
+  }//end stop()
+
+
+//------------------------------------------------------------------------
+//  Method: post()
+//
+//  Description: add a started SendRequest to the set being progressed
+//
+//  Inputs: SendRequest *
+//  Return: none
+//
+//------------------------------------------------------------------------
+void RouteProgress::post(SendRequest *req)
+  {
+    pthread_mutex_lock(&m_mutex);
+    m_posted.push_back(req);
+    pthread_cond_signal(&m_workCond);
+    pthread_mutex_unlock(&m_mutex);
+    return;
+  }//end post()
+
+
+//------------------------------------------------------------------------
+//  Method: remove()
+//
+//  Description: withdraw a SendRequest. Since sweeps hold the engine
+//               mutex, once remove() returns the request is no longer
+//               being touched by the engine.
+//
+//  Inputs: SendRequest *
+//  Return: none
+//
+//------------------------------------------------------------------------
+void RouteProgress::remove(SendRequest *req)
+  {
+    pthread_mutex_lock(&m_mutex);
+    m_posted.remove(req);
+    pthread_mutex_unlock(&m_mutex);
+    return;
+  }//end remove()
+
+
+//------------------------------------------------------------------------
+//  Method: poll()
+//
+//  Description: sweep every posted SendRequest once
+//
+//  Inputs: none
+//  Return: int, the number of requests still outstanding
+//
+//------------------------------------------------------------------------
+int RouteProgress::poll()
+  {
+    int   numLeft;
+
+    pthread_mutex_lock(&m_mutex);
+    std::list<SendRequest *>::iterator  iter = m_posted.begin();
+    while (iter != m_posted.end())
+      {
+        if ((*iter)->progress())
+            iter = m_posted.erase(iter);
+         else
+            ++iter;
+      }//endWhile each posted request
+    numLeft = m_posted.size();
+    pthread_mutex_unlock(&m_mutex);
+
+    return(numLeft);
+  }//end poll()
+
+
+//------------------------------------------------------------------------
+//  Method: numPosted()
+//
+//  Description: number of SendRequests currently being progressed
+//
+//  Inputs: none
+//  Return: int
+//
+//------------------------------------------------------------------------
+int RouteProgress::numPosted()
+  {
+    int   num;
+
+    pthread_mutex_lock(&m_mutex);
+    num = m_posted.size();
+    pthread_mutex_unlock(&m_mutex);
+
+    return(num);
+  }//end numPosted()
+
+
+//------------------------------------------------------------------------
+//  Method: progressThread()
+//
+//  Description: body of the progress thread. Sleeps while nothing is
+//               posted, otherwise sweeps the posted requests.
+//
+//  Inputs: void * the RouteProgress object
+//  Return: NULL
+//
+//------------------------------------------------------------------------
+void *RouteProgress::progressThread(void *arg)
+  {
+    RouteProgress  *engine = static_cast<RouteProgress *>(arg);
+
+#ifdef PVTOL_DEBUG
+    cout << "RouteProgress: progress thread started" << endl;
+#endif // PVTOL_DEBUG
+
+    for (;;)
+      {
+        pthread_mutex_lock(&engine->m_mutex);
+        while (engine->m_posted.empty() && !engine->m_stopRequested)
+               pthread_cond_wait(&engine->m_workCond, &engine->m_mutex);
+
+        if (engine->m_stopRequested)
+          {
+            pthread_mutex_unlock(&engine->m_mutex);
+            break;
+          }
+        pthread_mutex_unlock(&engine->m_mutex);
+
+        engine->poll();
+
+        if (engine->m_pollIntervalUsec > 0)
+            usleep(engine->m_pollIntervalUsec);
+         else
+            sched_yield();
+      }//endFor ever
+
+#ifdef PVTOL_DEBUG
+    cout << "RouteProgress: progress thread exiting" << endl;
+#endif // PVTOL_DEBUG
+
+    return(NULL);
+  }//end progressThread()
+
+}//end Namespace
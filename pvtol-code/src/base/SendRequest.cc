@@ -28,6 +28,7 @@
 #include <PvtolRequest.h>
 #include <SendRequest.h>
 #include <Route.h>
+#include <RouteProgress.h>
 #include <Exception.h>
 
 #include <iostream>
@@ -61,7 +62,16 @@ SendRequest::SendRequest() :
        m_currRouteDestXfer(NULL),
 	   m_associatedRoute(NULL),
        m_associatedTransfer(NULL),
-       m_isWaiting(false)
+       m_isWaiting(false),
+       m_callback(NULL),
+       m_callbackArg(NULL),
+       m_sendPeer(NULL),
+       m_recvPeer(NULL),
+       m_sendComplete(NULL),
+       m_recvComplete(NULL),
+       m_isPosted(0),
+       m_packBuff(NULL),
+       m_numPackBuffs(0)
 
   {
     pthread_mutex_init(&m_waitMutex, NULL);
@@ -93,7 +103,16 @@ SendRequest::SendRequest(Route &route) :
        m_currRouteDestXfer(NULL),
        m_associatedRoute(&route),
        m_associatedTransfer(NULL),
-       m_isWaiting(false)
+       m_isWaiting(false),
+       m_callback(NULL),
+       m_callbackArg(NULL),
+       m_sendPeer(NULL),
+       m_recvPeer(NULL),
+       m_sendComplete(NULL),
+       m_recvComplete(NULL),
+       m_isPosted(0),
+       m_packBuff(NULL),
+       m_numPackBuffs(0)
   {
     int   i, persist;
     m_preset  = true;
@@ -113,24 +132,36 @@ SendRequest::SendRequest(Route &route) :
     if (route.m_maxRecvs)
               m_recvRequest = new PvtolRequest[route.m_maxRecvs];
 
+    allocPeerInfo(route.m_maxSends, route.m_maxRecvs);
+    allocPackBuffs(route);
+
     if (route.m_currSrcXfer.sendInfo == NULL)
            m_numSends = 0;
       else
        {
             m_numSends = route.m_currSrcXfer.numSends;
 
+	    for (i=0; i<m_numSends; i++)
+	        m_sendPeer[i] = route.m_currSrcXfer.sendInfo[i].destRank;
+
 	    if (route.m_trait == Route::STATIC_ROUTE)
 	      {//       setup Persistant Sends
 	        for(persist=0, i=0; i<m_numSends; i++) {
 		  if (!route.m_currSrcXfer.sendInfo[i].sendIsLocal)
 		    {
+		      void  *addr = route.m_currSrcXfer.sendInfo[i].addr;
+		      if (route.m_currSrcXfer.sendInfo[i].packingRequired)
+		          addr = m_packBuff[i];
+
 		      route.m_commScopePtr->sendInit(
-			    route.m_currSrcXfer.sendInfo[i].addr,
+			    addr,
 			    route.m_currSrcXfer.sendInfo[i].destAddr,
 			    route.m_currSrcXfer.sendInfo[i].byteSize,
 			    route.m_currSrcXfer.sendInfo[i].destRank,
 			    route.m_tag,
-			    m_sendRequest[persist++]);
+			    m_sendRequest[persist]);
+		      m_sendPeer[persist++] =
+			    route.m_currSrcXfer.sendInfo[i].destRank;
 		    }//endIf send is local
 		}//endFor all sends
 
@@ -144,6 +175,9 @@ SendRequest::SendRequest(Route &route) :
        {
 	    m_numRecvs    = route.m_currDestXfer.numRecvs;
 
+	    for (i=0; i<m_numRecvs; i++)
+	        m_recvPeer[i] = route.m_currDestXfer.recvInfo[i].srcRank;
+
 	    if (route.m_trait == Route::STATIC_ROUTE)
 	      {//       setup Persistant Recvs
 	        for(persist=0, i=0; i<m_numRecvs; i++) {
@@ -155,7 +189,9 @@ SendRequest::SendRequest(Route &route) :
 			   route.m_currDestXfer.recvInfo[i].byteSize,
 			   route.m_currDestXfer.recvInfo[i].srcRank,
 			   route.m_tag,
-			   m_recvRequest[persist++]);
+			   m_recvRequest[persist]);
+		     m_recvPeer[persist++] =
+			   route.m_currDestXfer.recvInfo[i].srcRank;
 		    }//endIf recv is local
 		}//endFor All Recvs
 
@@ -192,7 +228,16 @@ SendRequest::SendRequest(const Transfer &transfer) :
 	   m_currRouteDestXfer(NULL),
 	   m_associatedRoute(NULL),
        m_associatedTransfer(&transfer),
-       m_isWaiting(false)
+       m_isWaiting(false),
+       m_callback(NULL),
+       m_callbackArg(NULL),
+       m_sendPeer(NULL),
+       m_recvPeer(NULL),
+       m_sendComplete(NULL),
+       m_recvComplete(NULL),
+       m_isPosted(0),
+       m_packBuff(NULL),
+       m_numPackBuffs(0)
 
   {
 
@@ -273,24 +318,36 @@ SendRequest::SendRequest(const Transfer &transfer) :
     if (route.m_maxRecvs)
               m_recvRequest = new PvtolRequest[route.m_maxRecvs];
 
+    allocPeerInfo(route.m_maxSends, route.m_maxRecvs);
+    allocPackBuffs(route);
+
     if (route.m_currSrcXfer.sendInfo == NULL)
            m_numSends = 0;
       else
        {
             m_numSends = route.m_currSrcXfer.numSends;
 
+	    for (i=0; i<m_numSends; i++)
+	        m_sendPeer[i] = route.m_currSrcXfer.sendInfo[i].destRank;
+
 	    if (route.m_trait == Route::STATIC_ROUTE)
 	      {//       setup Persistant Sends
 	        for(persist=0, i=0; i<m_numSends; i++) {
 		  if (!route.m_currSrcXfer.sendInfo[i].sendIsLocal)
 		    {
+		      void  *addr = route.m_currSrcXfer.sendInfo[i].addr;
+		      if (route.m_currSrcXfer.sendInfo[i].packingRequired)
+		          addr = m_packBuff[i];
+
 		      route.m_commScopePtr->sendInit(
-			    route.m_currSrcXfer.sendInfo[i].addr,
+			    addr,
 			    route.m_currSrcXfer.sendInfo[i].destAddr,
 			    route.m_currSrcXfer.sendInfo[i].byteSize,
 			    route.m_currSrcXfer.sendInfo[i].destRank,
 			    route.m_tag,
-			    m_sendRequest[persist++]);
+			    m_sendRequest[persist]);
+		      m_sendPeer[persist++] =
+			    route.m_currSrcXfer.sendInfo[i].destRank;
 		    }//endIf send is local
 		}//endFor all sends
 
@@ -304,6 +361,9 @@ SendRequest::SendRequest(const Transfer &transfer) :
        {
 	    m_numRecvs    = route.m_currDestXfer.numRecvs;
 
+	    for (i=0; i<m_numRecvs; i++)
+	        m_recvPeer[i] = route.m_currDestXfer.recvInfo[i].srcRank;
+
 	    if (route.m_trait == Route::STATIC_ROUTE)
 	      {//       setup Persistant Recvs
 	        for(persist=0, i=0; i<m_numRecvs; i++) {
@@ -315,7 +375,9 @@ SendRequest::SendRequest(const Transfer &transfer) :
 			   route.m_currDestXfer.recvInfo[i].byteSize,
 			   route.m_currDestXfer.recvInfo[i].srcRank,
 			   route.m_tag,
-			   m_recvRequest[persist++]);
+			   m_recvRequest[persist]);
+		     m_recvPeer[persist++] =
+			   route.m_currDestXfer.recvInfo[i].srcRank;
 		    }//endIf recv is local
 		}//endFor All Recvs
 
@@ -333,7 +395,8 @@ SendRequest::SendRequest(const Transfer &transfer) :
 //  Method:     setup for a particular transfer
 //          setup(Transfer &transfer)
 //
-//  Description: setup for a particular transfer
+//  Description: setup for a particular transfer, as the constructor
+//               from a Transfer does, for a default constructed request
 //
 //  Inputs: a ref to a Transfer obj
 //  Returns: void
@@ -341,11 +404,53 @@ SendRequest::SendRequest(const Transfer &transfer) :
 //------------------------------------------------------------------------
  void SendRequest::setup(const Transfer &transfer)
   {
-    m_eltSize = transfer.m_eltSize;
-    throw NotImplementedYet(__FILE__, __LINE__);
+    m_preset             = true;
+    m_eltSize            = transfer.m_eltSize;
+    m_associatedTransfer = &transfer;
+
+    pthread_mutex_init(&m_waitMutex, NULL);
+    pthread_mutex_init(&m_waitCvMutex, NULL);
+    pthread_cond_init(&m_waitCond, NULL);
+
+    if (transfer.m_isSrc)
+      {
+           m_numSends = 1;
+      }
+
+    if (transfer.m_isDest)
+      {
+           m_numRecvs = 1;
+      }
+
+    if (transfer.m_trait == Transfer::STATIC_TRANSFER)
+      {
+       if (transfer.m_isSrc)
+         {
+   	   m_sendRequest = const_cast<PvtolRequest *>(&transfer.m_req);
+         }
+
+       if (transfer.m_isDest)
+         {
+   	   m_recvRequest = const_cast<PvtolRequest *>(&transfer.m_req);
+         }
+      }
+     else
+      {
+       if (transfer.m_isSrc)
+         {
+   	   m_sendRequest = new PvtolRequest[1];
+	   m_iBuiltReqs = true;
+         }
+
+       if (transfer.m_isDest)
+         {
+	   m_recvRequest = new PvtolRequest[1];
+	   m_iBuiltReqs = true;
+         }
+      }//endIf Static or not
 
     return;
-  }//end setup for a Route
+  }//end setup for a Transfer
 
 
 //------------------------------------------------------------------------
@@ -373,6 +478,15 @@ SendRequest::SendRequest(const Transfer &transfer) :
         &&  (m_recvRequest == NULL) && (m_sendRequest == NULL))
 	          return(m_done);
 
+    if (isPosted())
+      {//   the RouteProgress engine owns the comm requests
+        RouteProgress &engine = RouteProgress::instance();
+
+        if (engine.getMode() == RouteProgress::POLLED)
+                 engine.poll();
+        return(m_done);
+      }
+
     if (!m_done)
       {
 	for (i=0, rcvdCount=0; rc && (i<m_numRecvs); i++) {
@@ -439,6 +553,29 @@ SendRequest::SendRequest(const Transfer &transfer) :
              pthread_mutex_unlock(&m_waitMutex);
       }//endIf assoc Xfer is btwn threads of same process
 
+    if (isPosted())
+      {//   the RouteProgress engine owns the comm requests
+        RouteProgress &engine = RouteProgress::instance();
+
+        if (engine.getMode() == RouteProgress::POLLED)
+          {
+            while (isPosted())
+                 engine.poll();
+          }
+         else
+          {
+            pthread_mutex_lock(&m_waitCvMutex);
+            while (isPosted())
+              {
+                m_isWaiting = true;
+                pthread_cond_wait(&m_waitCond, &m_waitCvMutex);
+              }
+            m_isWaiting = false;
+            pthread_mutex_unlock(&m_waitCvMutex);
+          }
+        return(m_done);
+      }//endIf request was handed to the progress engine
+
     if (!m_done)
       {
 	 for (i=0, m_recvdCount=0; i<m_numRecvs; i++) {
@@ -474,6 +611,12 @@ SendRequest::SendRequest(const Transfer &transfer) :
     int    i;
   //PvtolStatus stat;
 
+    if (isPosted())
+      {
+        RouteProgress::instance().remove(this);
+        setPosted(false);
+      }
+
     if (!m_done)
       {
 	   for (i=0, m_recvdCount=0; i<m_numRecvs; i++) {
@@ -489,6 +632,212 @@ SendRequest::SendRequest(const Transfer &transfer) :
   }//end cancel()
 
 
+//------------------------------------------------------------------------
+//  Method: setCallback()
+//
+//  Description: Set the per peer completion callback used when the
+//               request is progressed by the RouteProgress engine
+//
+//  Inputs: RouteCompletionCallback, void * user argument
+//
+//------------------------------------------------------------------------
+ void SendRequest::setCallback(RouteCompletionCallback cb, void *arg)
+  {
+#ifdef PVTOL_DEVELOP
+    if (isPosted())
+        throw Exception("SendRequest: cannot change callback while posted",
+                        __FILE__, __LINE__);
+#endif // PVTOL_DEVELOP
+    m_callback    = cb;
+    m_callbackArg = arg;
+  }//end setCallback()
+
+
+//------------------------------------------------------------------------
+//  Method: allocPeerInfo()
+//
+//  Description: Allocate the per peer bookkeeping used for asynchronous
+//               progress. Sized like the PvtolRequest arrays.
+//
+//  Inputs: the max number of sends and recvs of the Route
+//
+//------------------------------------------------------------------------
+ void SendRequest::allocPeerInfo(int maxSends, int maxRecvs)
+  {
+    delete[] m_sendPeer;
+    delete[] m_recvPeer;
+    delete[] m_sendComplete;
+    delete[] m_recvComplete;
+
+    m_sendPeer     = NULL;
+    m_recvPeer     = NULL;
+    m_sendComplete = NULL;
+    m_recvComplete = NULL;
+
+    if (maxSends)
+      {
+        m_sendPeer     = new int[maxSends];
+        m_sendComplete = new bool[maxSends];
+      }
+
+    if (maxRecvs)
+      {
+        m_recvPeer     = new int[maxRecvs];
+        m_recvComplete = new bool[maxRecvs];
+      }
+  }//end allocPeerInfo()
+
+
+//------------------------------------------------------------------------
+//  Method: allocPackBuffs()
+//
+//  Description: Allocate a staging buffer for each of the Route's sends
+//               which is packed, i.e. permuted, before it is sent. Each
+//               SendRequest has its own, so the sends of several
+//               SendRequests may be in flight at once.
+//
+//  Inputs: the Route the SendRequest is setup for
+//
+//------------------------------------------------------------------------
+ void SendRequest::allocPackBuffs(Route &route)
+  {
+    int    i;
+
+    freePackBuffs();
+
+    if (!route.m_permuted || (route.m_currSrcXfer.sendInfo == NULL))
+        return;
+
+    m_numPackBuffs = route.m_currSrcXfer.numSends;
+    m_packBuff     = new char *[m_numPackBuffs];
+
+    for (i=0; i<m_numPackBuffs; i++) {
+        if (route.m_currSrcXfer.sendInfo[i].packingRequired)
+            m_packBuff[i] = new char[route.m_currSrcXfer.sendInfo[i].byteSize];
+         else
+            m_packBuff[i] = NULL;
+    }
+  }//end allocPackBuffs()
+
+
+//------------------------------------------------------------------------
+//  Method: freePackBuffs()
+//
+//  Description: Free the staging buffers
+//
+//  Inputs: none
+//
+//------------------------------------------------------------------------
+ void SendRequest::freePackBuffs()
+  {
+    for (int i=0; i<m_numPackBuffs; i++)
+        delete[] m_packBuff[i];
+    delete[] m_packBuff;
+
+    m_packBuff     = NULL;
+    m_numPackBuffs = 0;
+  }//end freePackBuffs()
+
+
+//------------------------------------------------------------------------
+//  Method: post()
+//
+//  Description: Hand the, already started, sends and recvs over to
+//               the RouteProgress engine
+//
+//  Inputs: none
+//
+//------------------------------------------------------------------------
+ void SendRequest::post()
+  {
+    int    i;
+
+#ifdef PVTOL_DEVELOP
+    if (isPosted())
+        throw Exception("SendRequest: request is already posted",
+                        __FILE__, __LINE__);
+#endif // PVTOL_DEVELOP
+
+    for (i=0; i<m_numRecvs; i++)
+         m_recvComplete[i] = false;
+
+    for (i=0; i<m_numSends; i++)
+         m_sendComplete[i] = false;
+
+    m_recvdCount = 0;
+    setPosted(true);
+
+    RouteProgress::instance().post(this);
+  }//end post()
+
+
+//------------------------------------------------------------------------
+//  Method: progress()
+//
+//  Description: Test each outstanding send & recv once, firing the
+//               callback for every peer that completed. Only called by
+//               the RouteProgress engine, with its mutex held, so it is
+//               never run by two threads at once.
+//
+//  Inputs: none
+//
+//  Return: bool - true  => every send & recv has completed
+//
+//------------------------------------------------------------------------
+ bool SendRequest::progress()
+  {
+    int    i, flag;
+    bool   allDone = true;
+    PvtolStatus stat;
+
+    for (i=0; i<m_numRecvs; i++) {
+      if (!m_recvComplete[i])
+        {
+          flag = 1;
+          (m_recvRequest[i]).test(&flag, stat);
+          if (flag)
+            {
+              m_recvComplete[i] = true;
+              m_recvdCount += stat.getCount();
+              if (m_callback != NULL)
+                  m_callback(*this, m_recvPeer[i], true, m_callbackArg);
+            }
+           else
+              allDone = false;
+        }
+    }//endFor each recv req
+
+    for (i=0; i<m_numSends; i++) {
+      if (!m_sendComplete[i])
+        {
+          flag = 1;
+          (m_sendRequest[i]).test(&flag, stat);
+          if (flag)
+            {
+              m_sendComplete[i] = true;
+              if (m_callback != NULL)
+                  m_callback(*this, m_sendPeer[i], false, m_callbackArg);
+            }
+           else
+              allDone = false;
+        }
+    }//endFor each send req
+
+    if (!allDone)
+        return(false);
+
+    m_recvdCount /= m_eltSize;
+
+    pthread_mutex_lock(&m_waitCvMutex);
+    m_done     = true;
+    setPosted(false);
+    pthread_cond_broadcast(&m_waitCond);
+    pthread_mutex_unlock(&m_waitCvMutex);
+
+    return(true);
+  }//end progress()
+
+
 //------------------------------------------------------------------------
 //  Method:     disassociate
 //          disassociate(Route &route)
@@ -503,6 +852,12 @@ void SendRequest::disassociate(Route &route)
  {
    m_associatedRoute = NULL;
 
+   if (isPosted())
+     {
+        RouteProgress::instance().remove(this);
+        setPosted(false);
+     }
+
    if (m_iBuiltReqs)
      {
 	if (m_recvRequest != NULL)
@@ -512,8 +867,18 @@ void SendRequest::disassociate(Route &route)
 		delete[] m_sendRequest;
      }
 
-   m_recvRequest = NULL;
-   m_sendRequest = NULL;
+   delete[] m_sendPeer;
+   delete[] m_recvPeer;
+   delete[] m_sendComplete;
+   delete[] m_recvComplete;
+   freePackBuffs();
+
+   m_recvRequest  = NULL;
+   m_sendRequest  = NULL;
+   m_sendPeer     = NULL;
+   m_recvPeer     = NULL;
+   m_sendComplete = NULL;
+   m_recvComplete = NULL;
    m_numSends    = 0;
    m_numRecvs    = 0;
    m_done        = true;
@@ -551,9 +916,18 @@ const SendRequest& SendRequest::operator=(const SendRequest &rhs)
 //------------------------------------------------------------------------
 SendRequest::~SendRequest()
   {
+    if (isPosted())
+	 RouteProgress::instance().remove(this);
+
     if (m_associatedRoute != NULL)
 	 m_associatedRoute->unregisterSendRequest(this);
 
+    delete[] m_sendPeer;
+    delete[] m_recvPeer;
+    delete[] m_sendComplete;
+    delete[] m_recvComplete;
+    freePackBuffs();
+
     if (m_iBuiltReqs)
       {
 	if (m_recvRequest != NULL)
@@ -0,0 +1,144 @@
+/**
+ *    File: testConduitBatch.cc
+ *
+ *  Copyright (c) 2009, Massachusetts Institute of Technology
+ *  All rights reserved.
+ *
+ *  \author  $LastChangedBy$
+ *  \date    $LastChangedDate$
+ *  \version $LastChangedRevision$
+ *  \brief   Test of a batched Conduit, setBatch(), between two
+ *           processes. The frames go more than three times around the
+ *           ring of slots, so every slot of a batch is reused while the
+ *           rest of its batch's previous round may not yet have been
+ *           looked at. One batch is flushed part way, with flush(), and
+ *           the stream ends in the middle of a batch, which insertEOC()
+ *           flushes. Every frame must arrive intact and in order.
+ *
+ *           Run on 2 processes; rank 0 inserts, rank 1 extracts.
+ *
+ *  $Id$
+ *
+ */
+#include <Pvtol.h>
+
+#include <sys/time.h>
+#include <iostream>
+#include <vector>
+
+using namespace ipvtol;
+using std::cout;
+using std::endl;
+
+namespace
+{
+    typedef HierArray<1, float, Dense<1, float> >   Frame;
+    typedef Conduit<Frame>                           Cdt;
+
+    const int   LEN      = 1024;
+    const int   DEPTH    = 8;
+    const int   BATCH    = 4;
+    const int   FRAMES   = 3 * DEPTH + BATCH / 2;  // ends mid batch
+    const int   FLUSH_AT = DEPTH + 1;               // half of a batch
+    const int   EXTRACT_BATCHED = 2 * BATCH;
+
+    float value(int frame, int i)
+     { return(float(frame * LEN + i)); }
+
+    double now()
+     {
+       struct timeval tv;
+       gettimeofday(&tv, NULL);
+       return(tv.tv_sec + tv.tv_usec * 1e-6);
+     }
+
+    int checkFrame(int f, const float *data, int len)
+     {
+       int   wrong = (len == LEN) ? 0 : 1;
+
+       for (int i=0; i<LEN && !wrong; i++)
+           if (data[i] != value(f, i))
+               wrong++;
+       if (wrong)
+           cout << "testConduitBatch: frame " << f << " is wrong" << endl;
+       return(wrong);
+     }
+}
+
+
+int main(int argc, char *argv[])
+{
+    PvtolProgram   prog(argc, argv);
+    CommScope     &cs = prog.getCurrentTask().getCommScope();
+    int            me = prog.getProcId();
+    int            bad = 0;
+
+    if (cs.getNumProcs() < 2)
+      {
+        cout << "testConduitBatch: needs 2 processes" << endl;
+        return(1);
+      }
+
+    RankId         srcRank = 0;
+    RankId         dstRank = 1;
+    RuntimeMap     srcMap(RankList(1, &srcRank), Grid(1),
+                          DataDistDescription(BlockDist()));
+    RuntimeMap     dstMap(RankList(1, &dstRank), Grid(1),
+                          DataDistDescription(BlockDist()));
+    unsigned int   lengths[1] = { LEN };
+
+    Cdt               cdt("testConduitBatch");
+    Cdt::InsertIf     ins(cdt);
+    Cdt::ExtractIf    ext(cdt);
+
+    ins.setup(srcMap, DEPTH, lengths);
+    ins.setBatch(BATCH);
+    ext.setup(dstMap, DEPTH, lengths);
+    cdt.setupComplete();
+
+    if (me == srcRank)
+      {
+        std::vector<float>   frame(LEN);
+
+        for (int f=0; f<FRAMES; f++) {
+            for (int i=0; i<LEN; i++)
+                frame[i] = value(f, i);
+            ins.insert(&frame[0], LEN);
+
+            if (f == FLUSH_AT)
+                ins.flush();
+        }
+
+        ins.insertEOC();
+      }
+
+    if (me == dstRank)
+      {
+        std::vector<float>   frames(EXTRACT_BATCHED * LEN);
+
+        ext.extractBatch(&frames[0], EXTRACT_BATCHED);
+        for (int f=0; f<EXTRACT_BATCHED; f++)
+            bad += checkFrame(f, &frames[f * LEN], LEN);
+
+        for (int f=EXTRACT_BATCHED; f<FRAMES; f++) {
+            int   len = ext.getLength();
+            bad += checkFrame(f, ext.getData(), len);
+            ext.release();
+        }
+
+        double   giveUp = now() + 30.0;
+        while (!ext.isAtEOC() && now() < giveUp)
+            ;
+        if (!ext.isAtEOC())
+          {
+            cout << "testConduitBatch: no EOC after the last frame" << endl;
+            bad++;
+          }
+
+        cout << "testConduitBatch: " << FRAMES << " frames in batches of "
+             << BATCH << ", depth " << DEPTH << ", "
+             << (bad ? "FAILED" : "passed") << endl;
+      }
+
+    return(bad ? 1 : 0);
+}
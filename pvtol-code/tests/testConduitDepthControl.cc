@@ -0,0 +1,141 @@
+/**
+ *    File: testConduitDepthControl.cc
+ *
+ *  Copyright (c) 2009, Massachusetts Institute of Technology
+ *  All rights reserved.
+ *
+ *  \author  $LastChangedBy$
+ *  \date    $LastChangedDate$
+ *  \version $LastChangedRevision$
+ *  \brief   Test of adaptive Conduit depth, ConduitDepthControl, sizing
+ *           the window of a LocalXferRing as a same process Conduit does.
+ *           A producer and a consumer take turns, a tick at a time, so
+ *           the run is the same on any machine. In a burst the producer
+ *           outpaces the consumer and stalls on a full window, which
+ *           must grow to the ring's depth; in a lull the consumer keeps
+ *           up, and the window must shrink back to its minimum. A
+ *           second burst must grow it again. No frame may be inserted
+ *           while the window is full, even just after it shrinks.
+ *
+ *  $Id$
+ *
+ */
+#include <ConduitDepthControl.h>
+#include <LocalXferRing.h>
+
+#include <iostream>
+
+using namespace ipvtol;
+using std::cout;
+using std::endl;
+
+namespace
+{
+    const int   DEPTH     = 16;
+    const int   MIN_DEPTH = 2;
+    const int   BURST     = 400;    // inserts in a burst
+    const int   LULL      = 1200;   // inserts in a lull, enough to shrink
+
+    struct Pipe
+    {
+        LocalXferRing         ring;
+        ConduitDepthControl   ctl;
+        int                   overfilled;   // inserts into a full window
+    };
+
+    //  the consumer's turn: extract up to rate frames
+    void consumeTick(Pipe &p, int rate)
+     {
+       for (int i=0; i<rate; i++)
+         {
+           if (p.ring.empty())
+             {
+               p.ctl.addStarve(0.0);
+               return;
+             }
+           p.ring.consume();
+           p.ctl.recordExtract();
+         }
+     }
+
+    //  insert numFrames frames, perTick a tick, while the consumer
+    //   extracts rate frames a tick; a full window waits a tick
+    void run(Pipe &p, int numFrames, int perTick, int rate)
+     {
+       int   sent = 0;
+
+       while (sent < numFrames)
+         {
+           for (int i=0; (i<perTick) && (sent<numFrames); i++)
+             {
+               while (p.ring.full())
+                 {
+                   p.ctl.addStall(0.0);
+                   consumeTick(p, rate);
+                 }
+               if (p.ring.numPosted() >= p.ctl.getDepth())
+                   p.overfilled++;
+               p.ring.publish();
+               sent++;
+
+               //   as Conduit::sendInsert() resizes the window
+               if (p.ctl.recordInsert())
+                   p.ring.setLimit(p.ctl.getDepth());
+             }
+           consumeTick(p, rate);
+         }
+     }
+
+    bool check(const char *phase, Pipe &p, int wanted, unsigned long grows,
+               unsigned long shrinks)
+     {
+       const ConduitDepthStats  &s = p.ctl.getStats();
+       bool   ok = (s.depth == wanted) && (p.overfilled == 0) &&
+                   (s.grows >= grows) && (s.shrinks >= shrinks);
+
+       cout << phase << ": window " << s.depth << " [" << s.minDepth
+            << ", " << s.maxDepth << "], " << s.grows << " grows, "
+            << s.shrinks << " shrinks, " << s.insertStalls << " of "
+            << s.inserts << " inserts stalled, " << p.overfilled
+            << " into a full window" << (ok ? "" : "  FAILED") << endl;
+       return(ok);
+     }
+}
+
+
+int main()
+{
+    Pipe   p;
+    bool   ok = true;
+
+    p.overfilled = 0;
+    p.ring.reset(DEPTH);
+    p.ctl.setMaxDepth(DEPTH);
+    p.ctl.enable(MIN_DEPTH);
+    p.ring.setLimit(p.ctl.getDepth());
+
+    //  MIN_DEPTH doubles to DEPTH in three steps; it shrinks back one
+    //   slot at a time
+    run(p, BURST, 8, 2);
+    ok = check("burst ", p, DEPTH, 3, 0) && ok;
+
+    run(p, LULL, 1, 4);
+    ok = check("lull  ", p, MIN_DEPTH, 3, DEPTH - MIN_DEPTH) && ok;
+
+    run(p, BURST, 8, 2);
+    ok = check("burst ", p, DEPTH, 6, DEPTH - MIN_DEPTH) && ok;
+
+    //  the consumer drains what is left
+    consumeTick(p, DEPTH);
+    const ConduitDepthStats  &s = p.ctl.getStats();
+    bool   counted = p.ring.empty() &&
+                     (s.inserts == (unsigned long)(2 * BURST + LULL)) &&
+                     (s.extracts == s.inserts) && (s.extractStarves > 0);
+    cout << s.inserts << " inserts, " << s.extracts << " extracts, "
+         << s.extractStarves << " starved" << (counted ? "" : "  FAILED")
+         << endl;
+    ok = ok && counted;
+
+    cout << "testConduitDepthControl: " << (ok ? "passed" : "FAILED") << endl;
+    return(ok ? 0 : 1);
+}
@@ -0,0 +1,218 @@
+/**
+ *    File: testConduitSelector.cc
+ *
+ *  Copyright (c) 2009, Massachusetts Institute of Technology
+ *  All rights reserved.
+ *
+ *  \author  $LastChangedBy$
+ *  \date    $LastChangedDate$
+ *  \version $LastChangedRevision$
+ *  \brief   Test of the ConduitSelector, with stand-ins for the extract
+ *           interfaces of Conduits: some fed from the same process,
+ *           which notify the selector's wakeup, and one fed "by MPI",
+ *           which can not and is polled. poll() must find nothing when
+ *           nothing is ready, take ready ends by turns, and count an
+ *           EOC as ready. Then one producer thread per end sends frames
+ *           in bursts and ends with an EOC, while the consumer takes
+ *           them with wait(); every frame and every EOC must be seen.
+ *           With only local ends the consumer sleeps without a timeout,
+ *           so a lost wake hangs the test until the alarm fails it.
+ *           The selector must unregister its wakeup when destroyed.
+ *
+ *  $Id$
+ *
+ */
+#include <ConduitSelector.h>
+
+#include <pthread.h>
+#include <signal.h>
+#include <unistd.h>
+#include <iostream>
+
+using namespace ipvtol;
+using std::cout;
+using std::endl;
+
+namespace
+{
+    const int   NUM_ENDS   = 3;         // the most in a test
+    const int   NUM_FRAMES = 20000;     // per end
+    const int   BURST      = 500;       // frames between naps
+    const int   TIME_LIMIT = 60;        // seconds, a lost wake hangs
+
+    //  what a Conduit's end holds: frames waiting, and an EOC after them
+    struct EndState
+    {
+        volatile int              frames;
+        volatile int              eoc;
+        ConduitWakeup * volatile  wakeup;
+        bool                      remote;   // fed by MPI, can not notify
+    };
+
+    //  a stand-in for Conduit::ExtractIf; copied by the selector
+    class FakeExtractIf
+    {
+      public:
+        FakeExtractIf(EndState *state) : m_state(state) { }
+        bool ready()
+         { return(m_state->frames > 0); }
+        bool isAtEOC()
+         { return((m_state->frames == 0) && m_state->eoc); }
+        bool setWakeup(ConduitWakeup *wakeup)
+         {
+           if (m_state->remote)
+               return(false);
+           m_state->wakeup = wakeup;
+           return(true);
+         }
+      private:
+        EndState   *m_state;
+    };
+
+    void reset(EndState &s, bool remote)
+     {
+       s.frames = 0;
+       s.eoc    = 0;
+       s.wakeup = NULL;
+       s.remote = remote;
+     }
+
+    //  as a Conduit's insert(): publish, then notify a local consumer
+    void post(EndState &s, bool eoc)
+     {
+       if (eoc)
+           s.eoc = 1;
+        else
+           __sync_fetch_and_add(&s.frames, 1);
+       __sync_synchronize();
+       ConduitWakeup  *w = s.wakeup;
+       if (w != NULL)
+           w->notify();
+     }
+
+    void *producer(void *arg)
+     {
+       EndState   *s = static_cast<EndState *>(arg);
+       for (int i=0; i<NUM_FRAMES; i++)
+         {
+           post(*s, false);
+           if ((i % BURST) == BURST - 1)
+               usleep(1000);
+         }
+       post(*s, true);
+       return(NULL);
+     }
+
+    bool checkPoll()
+     {
+       EndState          ends[NUM_ENDS];
+       ConduitSelector   sel;
+       for (int i=0; i<NUM_ENDS; i++)
+         {
+           reset(ends[i], i == NUM_ENDS - 1);      // the last by MPI
+           sel.add(FakeExtractIf(&ends[i]));
+         }
+
+       bool   idle = (sel.poll() == -1) && (sel.size() == NUM_ENDS);
+
+       //  every end ready: taken by turns, not the first over again
+       for (int i=0; i<NUM_ENDS; i++)
+           ends[i].frames = 2;
+       int    order[2 * NUM_ENDS];
+       bool   byTurns = true;
+       for (int k=0; k<2*NUM_ENDS; k++)
+         {
+           order[k] = sel.poll();
+           if ((order[k] < 0) || (order[k] != (k % NUM_ENDS)))
+               byTurns = false;
+           if (order[k] >= 0)
+               ends[order[k]].frames--;
+         }
+       bool   drained = (sel.poll() == -1);
+
+       //  an EOC alone is ready
+       ends[1].eoc = 1;
+       bool   eocReady = (sel.poll() == 1);
+
+       bool   ok = idle && byTurns && drained && eocReady;
+       cout << "poll: " << (idle ? "idle" : "NOT IDLE") << " when empty, "
+            << (byTurns ? "by turns" : "NOT BY TURNS") << ", "
+            << (eocReady ? "EOC ready" : "EOC NOT READY")
+            << (ok ? "" : "  FAILED") << endl;
+       return(ok);
+     }
+
+    //  numEnds ends, the last fed by MPI if withRemote
+    bool checkWait(int numEnds, bool withRemote)
+     {
+       EndState    ends[NUM_ENDS];
+       pthread_t   threads[NUM_ENDS];
+       int         received[NUM_ENDS];
+       int         eocs = 0;
+       bool        registered = true;
+       {
+         ConduitSelector   sel;
+         sel.setPollInterval(100.0e-6);
+         for (int i=0; i<numEnds; i++)
+           {
+             reset(ends[i], withRemote && (i == numEnds - 1));
+             received[i] = 0;
+             sel.add(FakeExtractIf(&ends[i]));
+             registered = registered && ((ends[i].wakeup != NULL) ==
+                                         !ends[i].remote);
+           }
+
+         //  the ends are added before the producers start
+         for (int i=0; i<numEnds; i++)
+             pthread_create(&threads[i], NULL, producer, &ends[i]);
+
+         while (eocs < numEnds)
+           {
+             int   i = sel.wait();
+             if (ends[i].frames > 0)
+               {
+                 __sync_fetch_and_sub(&ends[i].frames, 1);
+                 received[i]++;
+               }
+              else
+               {
+                 //  at its EOC; cleared, as Conduit::clearEOC()
+                 ends[i].eoc = 0;
+                 eocs++;
+               }
+           }
+         for (int i=0; i<numEnds; i++)
+             pthread_join(threads[i], NULL);
+       }
+
+       bool   ok = registered;
+       bool   unregistered = true;
+       for (int i=0; i<numEnds; i++)
+         {
+           ok = ok && (received[i] == NUM_FRAMES);
+           unregistered = unregistered && (ends[i].wakeup == NULL);
+           cout << "end " << i << (ends[i].remote ? " (MPI)  " : " (local)")
+                << ": " << received[i] << " frames" << endl;
+         }
+       ok = ok && unregistered;
+       cout << "wait: " << eocs << " EOCs, wakeups "
+            << (registered ? "registered" : "NOT REGISTERED") << " and "
+            << (unregistered ? "unregistered" : "LEFT REGISTERED")
+            << (ok ? "" : "  FAILED") << endl;
+       return(ok);
+     }
+}
+
+
+int main()
+{
+    bool   ok = true;
+    alarm(TIME_LIMIT);
+
+    ok = checkPoll() && ok;
+    ok = checkWait(NUM_ENDS - 1, false) && ok;
+    ok = checkWait(NUM_ENDS, true) && ok;
+
+    cout << "testConduitSelector: " << (ok ? "passed" : "FAILED") << endl;
+    return(ok ? 0 : 1);
+}
@@ -0,0 +1,163 @@
+/**
+ *    File: testConduitWakeup.cc
+ *
+ *  Copyright (c) 2009, Massachusetts Institute of Technology
+ *  All rights reserved.
+ *
+ *  \author  $LastChangedBy$
+ *  \date    $LastChangedDate$
+ *  \version $LastChangedRevision$
+ *  \brief   Test of the ConduitWakeup a ConduitSelector sleeps on. A
+ *           wait() given a count read before a notify() must return at
+ *           once; a wait() with nothing to wake it must time out; a
+ *           consumer parked without a timeout must be woken. Two
+ *           threads then pass a token back and forth, each sleeping on
+ *           its own wakeup until the other notifies it, so that any
+ *           lost wake hangs the test until the alarm fails it.
+ *
+ *  $Id$
+ *
+ */
+#include <ConduitWakeup.h>
+
+#include <pthread.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/time.h>
+#include <iostream>
+
+using namespace ipvtol;
+using std::cout;
+using std::endl;
+
+namespace
+{
+    const int   NUM_ROUNDS = 20000;
+    const int   TIME_LIMIT = 60;        // seconds, a lost wake hangs
+
+    double now()
+     {
+       struct timeval   tv;
+       gettimeofday(&tv, NULL);
+       return(tv.tv_sec + 1.0e-6 * tv.tv_usec);
+     }
+
+    //  a token passed between two threads, each with its own wakeup
+    struct PingPong
+    {
+        ConduitWakeup   wakeup[2];
+        volatile int    turn;           // whose move it is
+        int             rounds;
+    };
+
+    struct Side
+    {
+        PingPong   *game;
+        int         me;
+    };
+
+    void *player(void *arg)
+     {
+       Side       *s = static_cast<Side *>(arg);
+       PingPong   *g = s->game;
+
+       for (int r=0; r<g->rounds; r++)
+         {
+           //  as ConduitSelector::wait(): read the count, check, sleep
+           for (;;)
+             {
+               int   seen = g->wakeup[s->me].getSeq();
+               __sync_synchronize();
+               if (g->turn == s->me)
+                   break;
+               g->wakeup[s->me].wait(seen, -1.0);
+             }
+           g->turn = 1 - s->me;
+           __sync_synchronize();
+           g->wakeup[1 - s->me].notify();
+         }
+       return(NULL);
+     }
+
+    struct Late
+    {
+        ConduitWakeup   *wakeup;
+        int              delayUs;
+    };
+
+    void *notifyLate(void *arg)
+     {
+       Late   *l = static_cast<Late *>(arg);
+       usleep(l->delayUs);
+       l->wakeup->notify();
+       return(NULL);
+     }
+}
+
+
+int main()
+{
+    bool   ok = true;
+    alarm(TIME_LIMIT);
+
+    //  a notify before the wait is not lost
+    ConduitWakeup   w;
+    int             seen = w.getSeq();
+    w.notify();
+    double          t0 = now();
+    w.wait(seen, 10.0);
+    double          early = now() - t0;
+    bool            counted = (w.getSeq() == seen + 1);
+    cout << "notify before wait: returned in " << int(early * 1.0e6)
+         << " us, count " << (counted ? "advanced" : "NOT ADVANCED")
+         << ((early < 1.0) && counted ? "" : "  FAILED") << endl;
+    ok = ok && (early < 1.0) && counted;
+
+    //  nothing to wake it: the wait times out
+    seen = w.getSeq();
+    t0 = now();
+    w.wait(seen, 0.05);
+    double          slept = now() - t0;
+    cout << "timeout of 50 ms: slept " << int(slept * 1.0e3) << " ms"
+         << ((slept >= 0.04) && (slept < 5.0) ? "" : "  FAILED") << endl;
+    ok = ok && (slept >= 0.04) && (slept < 5.0);
+
+    //  parked for ever, woken by another thread
+    Late        late;
+    pthread_t   lateThread;
+    late.wakeup  = &w;
+    late.delayUs = 20000;
+    seen = w.getSeq();
+    t0 = now();
+    pthread_create(&lateThread, NULL, notifyLate, &late);
+    while (w.getSeq() == seen)
+        w.wait(seen, -1.0);
+    double          parked = now() - t0;
+    pthread_join(lateThread, NULL);
+    cout << "parked: woken after " << int(parked * 1.0e3) << " ms"
+         << (parked < 10.0 ? "" : "  FAILED") << endl;
+    ok = ok && (parked < 10.0);
+
+    //  ping pong, each side sleeping until the other's notify
+    PingPong    game;
+    Side        sides[2];
+    pthread_t   threads[2];
+    game.turn   = 0;
+    game.rounds = NUM_ROUNDS;
+    t0 = now();
+    for (int i=0; i<2; i++)
+      {
+        sides[i].game = &game;
+        sides[i].me   = i;
+        pthread_create(&threads[i], NULL, player, &sides[i]);
+      }
+    for (int i=0; i<2; i++)
+        pthread_join(threads[i], NULL);
+    double          secs = now() - t0;
+    cout << NUM_ROUNDS << " rounds of ping pong: " << int(secs * 1.0e3)
+         << " ms, " << game.wakeup[0].getSeq() + game.wakeup[1].getSeq()
+         << " notifies" << endl;
+
+    cout << "testConduitWakeup: " << (ok ? "passed" : "FAILED") << endl;
+    return(ok ? 0 : 1);
+}
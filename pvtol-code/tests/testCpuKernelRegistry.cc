@@ -0,0 +1,167 @@
+/**
+ *    File: testCpuKernelRegistry.cc
+ *
+ *  Copyright (c) 2009, Massachusetts Institute of Technology
+ *  All rights reserved.
+ *
+ *  \author  $LastChangedBy$
+ *  \date    $LastChangedDate$
+ *  \version $LastChangedRevision$
+ *  \brief   Test of the CPU kernel registry and launch pool. Kernels
+ *           registered statically and at run time must be found by name
+ *           and by handle, a name registered again must get the new
+ *           kernel, and unknown names must not be found. A launch must
+ *           run every block of a 3D grid exactly once, with the right
+ *           block index and its own scratch memory. The cost of a small
+ *           launch by name and by handle is printed.
+ *
+ *  $Id$
+ *
+ */
+#include <cpuUtil.h>
+
+#include <stdio.h>
+#include <sys/time.h>
+#include <iomanip>
+#include <iostream>
+#include <vector>
+
+using std::cout;
+using std::endl;
+
+namespace
+{
+    const int   NUM_NAMES = 200;     // most of the 256 registry slots
+    const int   LOC_MEM   = 1024;
+
+    double now()
+     {
+       struct timeval   tv;
+       gettimeofday(&tv, NULL);
+       return(tv.tv_sec + 1.0e-6 * tv.tv_usec);
+     }
+
+    //  params[0]: int * count per block, params[1]: int * scratch errors
+    void cpu_count_blocks(void **params, int *dims, cpuBlockCtx *blk)
+     {
+       int   *counts = *(int **)params[0];
+       int   *errors = *(int **)params[1];
+       int    block  = blk->blockIdx[HLENGTH] +
+                       blk->gridDim[HLENGTH] * (blk->blockIdx[HWIDTH] +
+                       blk->gridDim[HWIDTH] * blk->blockIdx[HDEPTH]);
+
+       //  fill the scratch with this block's number; a block sharing it
+       //   would overwrite some of it
+       int   *scratch = (int *)blk->locMem;
+       int    n = blk->locMemSize / sizeof(int);
+       for (int i=0; i<n; i++)
+           scratch[i] = block;
+       for (int i=0; i<n; i++)
+           if (scratch[i] != block)
+             {
+               __sync_fetch_and_add(errors, 1);
+               break;
+             }
+       __sync_fetch_and_add(&counts[block], 1);
+     }
+    CPU_REGISTER_KERNEL(cpu_count_blocks);
+
+    //  params[0]: int * set to the kernel's tag
+    void cpu_tag_1(void **params, int *, cpuBlockCtx *)
+     { **(int **)params[0] = 1; }
+    void cpu_tag_2(void **params, int *, cpuBlockCtx *)
+     { **(int **)params[0] = 2; }
+
+    void cpu_nop(void **, int *, cpuBlockCtx *)
+     { }
+}
+
+
+int main()
+{
+    bool        ok = true;
+    HTaskInfo   info;
+    memset(&info, 0, sizeof(info));
+    int         dims[3] = { 1, 1, 1 };
+
+    //  the registry: many names, then one registered again
+    int   tag = 0;
+    int  *tagPtr = &tag;
+    void *tagParams[1] = { &tagPtr };
+    int   tagSizes[1] = { sizeof(int *) };
+    int   misplaced = 0;
+    std::vector<int>   handles(NUM_NAMES);
+    char  name[32];
+    for (int i=0; i<NUM_NAMES; i++)
+      {
+        sprintf(name, "cpu_tag_%03d", i);
+        handles[i] = cpuRegisterKernel(name, (i % 2) ? cpu_tag_2 : cpu_tag_1);
+      }
+    for (int i=0; i<NUM_NAMES; i++)
+      {
+        sprintf(name, "cpu_tag_%03d", i);
+        tag = 0;
+        cpuLaunchKernel(name, dims, 1, tagSizes, tagParams, NULL, NULL, 0,
+                        &info);
+        if ((handles[i] < 0) || (cpuFindKernel(name) != handles[i]) ||
+            (tag != ((i % 2) ? 2 : 1)))
+            misplaced++;
+      }
+    int   again = cpuRegisterKernel("cpu_tag_000", cpu_tag_2);
+    tag = 0;
+    cpuLaunchKernelHandle(again, dims, 1, tagSizes, tagParams, NULL, NULL, 0,
+                          &info);
+    bool  replaced = (again == handles[0]) && (tag == 2);
+    bool  unknown  = (cpuFindKernel("cpu_no_such_kernel") == -1);
+    bool  registryOk = (misplaced == 0) && replaced && unknown &&
+                       (cpuFindKernel("cpu_count_blocks") >= 0);
+    cout << NUM_NAMES + 1 << " kernels registered: " << misplaced
+         << " misplaced, re-registration " << (replaced ? "replaces" : "FAILED")
+         << ", unknown names " << (unknown ? "not found" : "FOUND")
+         << (registryOk ? "" : "  FAILED") << endl;
+    ok = ok && registryOk;
+
+    //  a 3D grid, every block once, each with private scratch
+    int                gDim[3] = { 7, 5, 3 };
+    int                bDim[3] = { 64, 1, 1 };
+    int                numBlocks = gDim[0] * gDim[1] * gDim[2];
+    std::vector<int>   counts(numBlocks, 0);
+    int                scratchErrors = 0;
+    int               *countsPtr = &counts[0];
+    int               *errorsPtr = &scratchErrors;
+    void              *gridParams[2] = { &countsPtr, &errorsPtr };
+    int                gridSizes[2] = { sizeof(int *), sizeof(int *) };
+    const int          LAUNCHES = 20;
+    for (int i=0; i<LAUNCHES; i++)
+        cpuLaunchKernel("cpu_count_blocks", dims, 2, gridSizes, gridParams,
+                        gDim, bDim, LOC_MEM, &info);
+    int   wrongCounts = 0;
+    for (int b=0; b<numBlocks; b++)
+        if (counts[b] != LAUNCHES)
+            wrongCounts++;
+    bool  gridOk = (wrongCounts == 0) && (scratchErrors == 0);
+    cout << LAUNCHES << " launches of a " << gDim[0] << "x" << gDim[1] << "x"
+         << gDim[2] << " grid: " << wrongCounts << " blocks miscounted, "
+         << scratchErrors << " scratch collisions"
+         << (gridOk ? "" : "  FAILED") << endl;
+    ok = ok && gridOk;
+
+    //  what a launch costs beside the kernel
+    int          handle = cpuRegisterKernel("cpu_nop", cpu_nop);
+    const int    REPS = 200000;
+    double       start = now();
+    for (int i=0; i<REPS; i++)
+        cpuLaunchKernel("cpu_nop", dims, 0, NULL, NULL, NULL, NULL, 0, &info);
+    double       byName = (now() - start) / REPS;
+    start = now();
+    for (int i=0; i<REPS; i++)
+        cpuLaunchKernelHandle(handle, dims, 0, NULL, NULL, NULL, NULL, 0,
+                              &info);
+    double       byHandle = (now() - start) / REPS;
+    cout << std::fixed << std::setprecision(0)
+         << "one block launch: " << byName * 1.0e9 << " ns by name, "
+         << byHandle * 1.0e9 << " ns by handle" << endl;
+
+    cout << "testCpuKernelRegistry: " << (ok ? "passed" : "FAILED") << endl;
+    return(ok ? 0 : 1);
+}
@@ -0,0 +1,148 @@
+/**
+ *    File: testCpuMoveData.cc
+ *
+ *  Copyright (c) 2009, Massachusetts Institute of Technology
+ *  All rights reserved.
+ *
+ *  \author  $LastChangedBy$
+ *  \date    $LastChangedDate$
+ *  \version $LastChangedRevision$
+ *  \brief   Test of cpuMoveData and cpuClearMem. Packed and padded
+ *           sources and destinations, small ones and ones large enough to
+ *           be split across threads and written with streaming stores,
+ *           must copy and clear every row exactly and leave the padding
+ *           between rows untouched. The bandwidth of a large packed copy
+ *           is printed beside memcpy's.
+ *
+ *  $Id$
+ *
+ */
+#include <cpuUtil.h>
+
+#include <sys/time.h>
+#include <iomanip>
+#include <iostream>
+#include <vector>
+
+using std::cout;
+using std::endl;
+
+namespace
+{
+    const unsigned char   PAD = 0x55;
+
+    double now()
+     {
+       struct timeval   tv;
+       gettimeofday(&tv, NULL);
+       return(tv.tv_sec + 1.0e-6 * tv.tv_usec);
+     }
+
+    //  one shape, one source and one destination pitch; a stride of 1
+    //   means packed, as the conduits pass it
+    bool checkShape(int *dims, int srcPad, int dstPad)
+     {
+       const int   typeSize = 4;
+       size_t      rowBytes = (size_t)dims[HLENGTH] * typeSize;
+       size_t      rows     = (size_t)dims[HWIDTH] * dims[HDEPTH];
+       int         srcStride = srcPad ? rowBytes + srcPad : 1;
+       int         dstStride = dstPad ? rowBytes + dstPad : 1;
+       size_t      srcPitch  = rowBytes + srcPad;
+       size_t      dstPitch  = rowBytes + dstPad;
+       HTaskInfo   info;
+       memset(&info, 0, sizeof(info));
+
+       //  the destination starts one byte in, off any alignment
+       std::vector<char>   src(srcPitch * rows);
+       std::vector<char>   dstBuff(dstPitch * rows + 1, (char)PAD);
+       char               *dst = &dstBuff[1];
+       for (size_t i=0; i<src.size(); i++)
+           src[i] = (char)(i * 7 + 3);
+
+       int   wrongRows = 0, padHit = 0;
+       cpuMoveData(dst, dstStride, &info, &src[0], srcStride, &info,
+                   dims, typeSize, "testCpuMoveData");
+       for (size_t r=0; r<rows; r++)
+         {
+           if (memcmp(dst + r * dstPitch, &src[r * srcPitch], rowBytes) != 0)
+               wrongRows++;
+           if (dstPad && ((unsigned char)dst[r * dstPitch + rowBytes] != PAD))
+               padHit++;
+         }
+
+       cpuClearMem(dims, typeSize, dstStride, dst, &info);
+       for (size_t r=0; r<rows; r++)
+         {
+           for (size_t k=0; k<rowBytes; k++)
+               if (dst[r * dstPitch + k] != 0)
+                 {
+                   wrongRows++;
+                   break;
+                 }
+           if (dstPad && ((unsigned char)dst[r * dstPitch + rowBytes] != PAD))
+               padHit++;
+         }
+       if ((unsigned char)dstBuff[0] != PAD)
+           padHit++;
+
+       bool   ok = (wrongRows == 0) && (padHit == 0);
+       if (!ok)
+           cout << dims[HLENGTH] << "x" << dims[HWIDTH] << "x" << dims[HDEPTH]
+                << " pads " << srcPad << "/" << dstPad << ": " << wrongRows
+                << " wrong rows, " << padHit << " pad bytes written  FAILED"
+                << endl;
+       return(ok);
+     }
+}
+
+
+int main()
+{
+    bool   ok = true;
+    int    numCases = 0;
+
+    int    shapes[][3] = { {    3,    1, 1 },
+                           {    7,    5, 3 },
+                           { 1000, 1000, 4 },      // 16 MB, split by rows
+                           { 4096, 1024, 1 } };    // 16 MB
+    int    pads[] = { 0, 13, 64 };
+
+    for (int s=0; s<4; s++)
+        for (int a=0; a<3; a++)
+            for (int b=0; b<3; b++)
+              {
+                ok = checkShape(shapes[s], pads[a], pads[b]) && ok;
+                numCases++;
+              }
+    cout << numCases << " shapes and pitches copied and cleared"
+         << (ok ? "" : ", some FAILED") << endl;
+
+    //  a 128 MB packed copy, threaded with streaming stores
+    int         dims[3] = { 1 << 22, 1, 8 };
+    size_t      bytes = (size_t)dims[HLENGTH] * dims[HDEPTH] * 4;
+    std::vector<char>   a(bytes, 1), b(bytes, 2);
+    HTaskInfo   info;
+    memset(&info, 0, sizeof(info));
+
+    const int   REPS = 5;
+    double      start = now();
+    for (int i=0; i<REPS; i++)
+        cpuMoveData(&b[0], 1, &info, &a[0], 1, &info, dims, 4, "bandwidth");
+    double      moveSecs = now() - start;
+    bool        same = (memcmp(&a[0], &b[0], bytes) == 0);
+
+    start = now();
+    for (int i=0; i<REPS; i++)
+        memcpy(&b[0], &a[0], bytes);
+    double      copySecs = now() - start;
+
+    cout << std::fixed << std::setprecision(1)
+         << "128 MB packed copy: cpuMoveData "
+         << REPS * bytes / moveSecs / 1.0e9 << " GB/s, memcpy "
+         << REPS * bytes / copySecs / 1.0e9 << " GB/s"
+         << (same ? "" : "  FAILED") << endl;
+    ok = ok && same;
+
+    cout << "testCpuMoveData: " << (ok ? "passed" : "FAILED") << endl;
+    return(ok ? 0 : 1);
+}
@@ -0,0 +1,237 @@
+/**
+ *    File: testCpuStreams.cc
+ *
+ *  Copyright (c) 2009, Massachusetts Institute of Technology
+ *  All rights reserved.
+ *
+ *  \author  $LastChangedBy$
+ *  \date    $LastChangedDate$
+ *  \version $LastChangedRevision$
+ *  \brief   Test of the CPU streams and events the hUtil async calls run
+ *           on. A stream must run its operations in the order queued
+ *           while the caller carries on; an event must stay incomplete
+ *           until its stream reaches it; a stream waiting on an event
+ *           must not run past it early. A copy stream and a compute
+ *           stream, chained by events, pipeline chunks of a frame, and
+ *           the time is printed beside running the same steps in turn.
+ *
+ *  $Id$
+ *
+ */
+#include <cpuUtil.h>
+
+#include <unistd.h>
+#include <sys/time.h>
+#include <iomanip>
+#include <iostream>
+#include <vector>
+
+using std::cout;
+using std::endl;
+
+namespace
+{
+    const int   NUM_OPS    = 10000;
+    const int   NUM_CHUNKS = 8;
+    const int   CHUNK      = 1 << 18;   // floats
+    const int   STEP_USEC  = 5000;      // each copy and each kernel
+
+    double now()
+     {
+       struct timeval   tv;
+       gettimeofday(&tv, NULL);
+       return(tv.tv_sec + 1.0e-6 * tv.tv_usec);
+     }
+
+    //  operations own their argument, as the hUtil async calls do
+    struct AppendOp
+    {
+        std::vector<int>   *log;
+        int                 value;
+    };
+
+    void appendOp(void *arg)
+     {
+       AppendOp   *op = static_cast<AppendOp *>(arg);
+       op->log->push_back(op->value);
+       delete op;
+     }
+
+    void gateOp(void *arg)
+     {
+       volatile int   *open = static_cast<volatile int *>(arg);
+       while (!*open)
+           usleep(100);
+     }
+
+    struct ChunkOp
+    {
+        float   *dst;
+        float   *src;
+    };
+
+    //  a host to device copy, stood in for by a copy and a wait
+    void copyOp(void *arg)
+     {
+       ChunkOp    *op = static_cast<ChunkOp *>(arg);
+       int         dims[3] = { CHUNK, 1, 1 };
+       HTaskInfo   info;
+       memset(&info, 0, sizeof(info));
+       cpuMoveData(op->dst, 1, &info, op->src, 1, &info, dims, sizeof(float),
+                   "copyOp");
+       usleep(STEP_USEC);
+       delete op;
+     }
+
+    //  a kernel, which reads what copyOp wrote
+    void kernelOp(void *arg)
+     {
+       ChunkOp   *op = static_cast<ChunkOp *>(arg);
+       for (int i=0; i<CHUNK; i++)
+           op->dst[i] = op->src[i] + 1.0f;
+       usleep(STEP_USEC);
+       delete op;
+     }
+
+    //  copy each chunk on one stream, and process it on another once its
+    //   copy's event is complete; or, with no streams, do each in turn
+    bool runPipeline(bool useStreams, double &secs)
+     {
+       std::vector<float>   in(NUM_CHUNKS * CHUNK);
+       std::vector<float>   staged(NUM_CHUNKS * CHUNK, -1.0f);
+       std::vector<float>   out(NUM_CHUNKS * CHUNK, -1.0f);
+       for (unsigned int i=0; i<in.size(); i++)
+           in[i] = float(i % 1000);
+
+       cpuStream   copyStream    = cpuStreamCreate();
+       cpuStream   computeStream = cpuStreamCreate();
+       std::vector<cpuEvent>   copied(NUM_CHUNKS);
+       for (int c=0; c<NUM_CHUNKS; c++)
+           copied[c] = cpuEventCreate();
+
+       double   start = now();
+       for (int c=0; c<NUM_CHUNKS; c++)
+         {
+           ChunkOp   *copy = new ChunkOp;
+           copy->dst = &staged[c * CHUNK];
+           copy->src = &in[c * CHUNK];
+           ChunkOp   *kernel = new ChunkOp;
+           kernel->dst = &out[c * CHUNK];
+           kernel->src = &staged[c * CHUNK];
+
+           if (useStreams)
+             {
+               cpuStreamEnqueue(copyStream, copyOp, copy);
+               cpuEventRecord(copied[c], copyStream);
+               cpuStreamWaitEvent(computeStream, copied[c]);
+               cpuStreamEnqueue(computeStream, kernelOp, kernel);
+             }
+            else
+             {
+               copyOp(copy);
+               kernelOp(kernel);
+             }
+         }
+       cpuStreamSynchronize(computeStream);
+       secs = now() - start;
+
+       int   wrong = 0;
+       for (unsigned int i=0; i<out.size(); i++)
+           if (out[i] != in[i] + 1.0f)
+               wrong++;
+
+       for (int c=0; c<NUM_CHUNKS; c++)
+           cpuEventDestroy(copied[c]);
+       cpuStreamDestroy(copyStream);
+       cpuStreamDestroy(computeStream);
+       return(wrong == 0);
+     }
+}
+
+
+int main()
+{
+    bool   ok = true;
+
+    //  order, while the caller carries on
+    cpuStream          stream = cpuStreamCreate();
+    std::vector<int>   log;
+    volatile int       open = 0;
+    cpuStreamEnqueue(stream, gateOp, (void *)&open);
+    double   start = now();
+    for (int i=0; i<NUM_OPS; i++)
+      {
+        AppendOp   *op = new AppendOp;
+        op->log   = &log;
+        op->value = i;
+        cpuStreamEnqueue(stream, appendOp, op);
+      }
+    double   queueSecs = now() - start;
+
+    //  an event behind the gate is incomplete until the gate opens
+    cpuEvent   event = cpuEventCreate();
+    bool       freshComplete = (cpuEventQuery(event) == 1);
+    cpuEventRecord(event, stream);
+    bool       heldBack = (cpuEventQuery(event) == 0) && log.empty();
+    open = 1;
+    cpuEventWait(event);
+    bool       reached = (cpuEventQuery(event) == 1) &&
+                         (log.size() == (unsigned int)NUM_OPS);
+
+    int   outOfOrder = 0;
+    for (unsigned int i=0; i<log.size(); i++)
+        if (log[i] != (int)i)
+            outOfOrder++;
+    bool   streamOk = (outOfOrder == 0) && freshComplete && heldBack &&
+                      reached;
+    cout << NUM_OPS << " operations queued in "
+         << std::fixed << std::setprecision(1) << queueSecs * 1.0e3
+         << " ms while the stream was held, " << outOfOrder
+         << " out of order; event " << (heldBack ? "held back" : "EARLY")
+         << ", then " << (reached ? "complete" : "INCOMPLETE")
+         << (streamOk ? "" : "  FAILED") << endl;
+    ok = ok && streamOk;
+
+    //  a stream waiting on another's event
+    cpuStream   other = cpuStreamCreate();
+    log.clear();
+    open = 0;
+    cpuStreamEnqueue(stream, gateOp, (void *)&open);
+    AppendOp   *first = new AppendOp;
+    first->log   = &log;
+    first->value = 1;
+    cpuStreamEnqueue(stream, appendOp, first);
+    cpuEventRecord(event, stream);
+    cpuStreamWaitEvent(other, event);
+    AppendOp   *second = new AppendOp;
+    second->log   = &log;
+    second->value = 2;
+    cpuStreamEnqueue(other, appendOp, second);
+    usleep(20000);
+    bool   waited = log.empty();
+    open = 1;
+    cpuStreamSynchronize(other);
+    bool   chained = waited && (log.size() == 2) && (log[0] == 1) &&
+                     (log[1] == 2);
+    cout << "cross stream wait: "
+         << (chained ? "ran after the event" : "RAN EARLY") << endl;
+    ok = ok && chained;
+
+    cpuEventDestroy(event);
+    cpuStreamDestroy(other);
+    cpuStreamDestroy(stream);
+
+    //  copies overlapping kernels
+    double   serialSecs, pipelinedSecs;
+    bool     serialOk    = runPipeline(false, serialSecs);
+    bool     pipelinedOk = runPipeline(true, pipelinedSecs);
+    cout << std::setprecision(0) << NUM_CHUNKS << " chunks, "
+         << STEP_USEC / 1000 << " ms copy and " << STEP_USEC / 1000
+         << " ms kernel each: in turn " << serialSecs * 1.0e3
+         << " ms, on two streams " << pipelinedSecs * 1.0e3 << " ms"
+         << ((serialOk && pipelinedOk) ? "" : "  FAILED") << endl;
+    ok = ok && serialOk && pipelinedOk;
+
+    cout << "testCpuStreams: " << (ok ? "passed" : "FAILED") << endl;
+    return(ok ? 0 : 1);
+}
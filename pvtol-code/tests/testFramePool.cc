@@ -0,0 +1,176 @@
+/**
+ *    File: testFramePool.cc
+ *
+ *  Copyright (c) 2009, Massachusetts Institute of Technology
+ *  All rights reserved.
+ *
+ *  \author  $LastChangedBy$
+ *  \date    $LastChangedDate$
+ *  \version $LastChangedRevision$
+ *  \brief   Test of the FramePool. The frames must be built once each,
+ *           start on their own cache lines and be destroyed by clear(),
+ *           with and without huge pages. Then frames are handed from a
+ *           writer to a reader through a free and a filled
+ *           MpmcIndexRing, as SharedConduit does, and no heap allocation
+ *           may happen once setup is over.
+ *
+ *  $Id$
+ *
+ */
+#include <FramePool.h>
+#include <MpmcIndexRing.h>
+
+#include <new>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <iostream>
+
+using namespace ipvtol;
+using std::cout;
+using std::endl;
+
+namespace
+{
+    const int   DEPTH      = 7;
+    const int   NUM_FRAMES = 100000;
+
+    volatile unsigned long   s_numNew = 0;
+
+    struct Frame
+    {
+        double   data[100];      // an odd size, not a cache line multiple
+        int      value;
+        Frame() : value(-1)                 { s_numBuilt++; }
+        Frame(int v) : value(v)             { s_numBuilt++; }
+        Frame(const Frame &f) : value(f.value) { s_numBuilt++; }
+        ~Frame()                            { s_numBuilt--; }
+
+        static int   s_numBuilt;
+    };
+    int   Frame::s_numBuilt = 0;
+
+    struct Handoff
+    {
+        FramePool<Frame>   pool;
+        MpmcIndexRing      freeRing;
+        MpmcIndexRing      filledRing;
+        long               sum;
+    };
+
+    void *reader(void *arg)
+     {
+       Handoff   *h = static_cast<Handoff *>(arg);
+       for (int i=0; i<NUM_FRAMES; i++)
+         {
+           unsigned int   idx;
+           h->filledRing.pop(idx);
+           h->sum += h->pool.get(idx)->value;
+           h->freeRing.push(idx);
+         }
+       return(NULL);
+     }
+
+    bool checkLayout(bool huge)
+     {
+       FramePool<Frame>   pool;
+       pool.setHugePages(huge);
+       pool.create(DEPTH, 42);
+
+       const FramePoolStats   &stats = pool.getStats();
+       bool   ok = (pool.size() == DEPTH) && (Frame::s_numBuilt == DEPTH) &&
+                   (stats.frames == DEPTH) && (stats.allocations == 1) &&
+                   (stats.frameStride % 64 == 0) &&
+                   (stats.frameStride >= sizeof(Frame)) &&
+                   (stats.arenaBytes >= DEPTH * stats.frameStride);
+       for (int i=0; i<DEPTH; i++)
+         {
+           if ((((uintptr_t)pool.get(i)) % 64 != 0) ||
+               (pool.get(i)->value != 42))
+               ok = false;
+         }
+
+       cout << (huge ? "huge pages requested: " : "ordinary pages:       ")
+            << stats.frames << " frames, stride " << stats.frameStride
+            << ", arena " << stats.arenaBytes << " bytes, huge pages "
+            << (stats.hugePages ? "yes" : "no") << ", "
+            << stats.allocations << " allocation";
+
+       pool.clear();
+       ok = ok && (Frame::s_numBuilt == 0) && (pool.size() == 0);
+       cout << (ok ? "" : "  FAILED") << endl;
+       return(ok);
+     }
+
+    bool checkHandoff()
+     {
+       Handoff   h;
+       h.pool.create(DEPTH);
+       h.freeRing.reset(DEPTH);
+       h.filledRing.reset(DEPTH);
+       h.sum = 0;
+       for (int i=0; i<DEPTH; i++)
+           h.freeRing.push(i);
+
+       pthread_t   thread;
+       pthread_create(&thread, NULL, reader, &h);
+
+       //  setup is over once the reader is running
+       unsigned long   before = s_numNew;
+       long            expect = 0;
+       for (int i=0; i<NUM_FRAMES; i++)
+         {
+           unsigned int   idx;
+           h.freeRing.pop(idx);
+           h.pool.get(idx)->value = i;
+           expect += i;
+           h.filledRing.push(idx);
+         }
+       pthread_join(thread, NULL);
+       unsigned long   during = s_numNew - before;
+
+       bool   ok = (h.sum == expect) && (during == 0) &&
+                   (h.pool.getStats().allocations == 1);
+       cout << "handoff: " << NUM_FRAMES << " frames through " << DEPTH
+            << " slots, " << during << " heap allocations, "
+            << h.pool.getStats().allocations << " arena allocation"
+            << (ok ? "" : "  FAILED") << endl;
+       return(ok);
+     }
+}
+
+
+//  count the heap allocations made while frames are handed off
+void *operator new(size_t bytes)
+{
+    __sync_fetch_and_add(&s_numNew, 1);
+    void   *p = malloc(bytes ? bytes : 1);
+    if (p == NULL)
+        throw std::bad_alloc();
+    return(p);
+}
+
+void operator delete(void *p) throw()
+{
+    free(p);
+}
+
+#if __cplusplus >= 201402L
+void operator delete(void *p, size_t) throw()
+{
+    free(p);
+}
+#endif
+
+
+int main()
+{
+    bool   ok = true;
+
+    ok = checkLayout(false) && ok;
+    ok = checkLayout(true)  && ok;
+    ok = checkHandoff()     && ok;
+
+    cout << "testFramePool: " << (ok ? "passed" : "FAILED") << endl;
+    return(ok ? 0 : 1);
+}
@@ -0,0 +1,188 @@
+/**
+ *    File: testHaloExchange.cc
+ *
+ *  Copyright (c) 2009, Massachusetts Institute of Technology
+ *  All rights reserved.
+ *
+ *  \author  $LastChangedBy$
+ *  \date    $LastChangedDate$
+ *  \version $LastChangedRevision$
+ *  \brief   Test of HaloExchange. Each processor fills the elements it
+ *           owns with a function of their global index and poisons its
+ *           halos; after an exchange every halo element must hold the
+ *           value of the global element it overlaps. Two layouts are
+ *           checked, a 2D BLOCK array split by columns, whose halo comes
+ *           from the other processor, and a 1D BLOCK_CYCLIC array, whose
+ *           halos alternate between the two processors. Each exchange is
+ *           repeated, with new values, to reuse the persistent requests.
+ *
+ *           Run on 2 processes.
+ *
+ *  $Id$
+ *
+ */
+#include <Pvtol.h>
+#include <HaloExchange.h>
+
+#include <iostream>
+#include <vector>
+
+using namespace ipvtol;
+using std::cout;
+using std::endl;
+
+namespace
+{
+    const int   PASSES = 3;
+    const float POISON = -1.0f;
+
+    float value(int pass, int globalIdx)
+     { return(float(pass * 100000 + globalIdx)); }
+
+    /** A local block and its halo, as global element ranges */
+    struct Span
+      {
+        int   globalStart;
+        int   len;          // owned + halo
+        int   ownedLen;
+      };
+
+
+    //  2D, ROWS x COLS, Grid(1, 2), BLOCK with overlap in dim 1.
+    //   Pitfalls' block size, round((64 + 2) / 2) - 2 = 31, gives
+    //   processor 0 columns [0,31) plus the halo [31,33), and
+    //   processor 1 columns [31,64).
+    int testBlock2D(int me, RankId *ranks)
+    {
+        const int      ROWS = 8;
+        const int      COLS = 64;
+        const Span     spans[2] = { { 0, 33, 31 }, { 31, 33, 33 } };
+        const Span    &s = spans[me];
+        int            bad = 0;
+
+        RuntimeMap     map(RankList(2, ranks), Grid(1, 2),
+                           DataDistDescription(BlockDist(), BlockDist(2)));
+        unsigned int   global[2] = { ROWS, COLS };
+        unsigned int   local[2];
+
+        HaloExchange::computeLocalLengths(map, 2, global, local);
+        if ((local[0] != (unsigned int)ROWS) ||
+            (local[1] != (unsigned int)s.len))
+          {
+            cout << "testHaloExchange: BLOCK local lengths " << local[0]
+                 << "x" << local[1] << ", expected " << ROWS << "x"
+                 << s.len << endl;
+            return(1);
+          }
+
+        std::vector<float>   buff(ROWS * s.len);
+        int                  strides[2] = { s.len, 1 };
+        HaloExchange         halo(map, 2, global, &buff[0], strides,
+                                  sizeof(float));
+
+        for (int pass=0; pass<PASSES; pass++) {
+            for (int r=0; r<ROWS; r++)
+                for (int c=0; c<s.len; c++)
+                    buff[r * s.len + c] = (c < s.ownedLen) ?
+                        value(pass, r * COLS + s.globalStart + c) : POISON;
+
+            halo.exchange();
+
+            for (int r=0; r<ROWS; r++)
+                for (int c=0; c<s.len; c++)
+                    if (buff[r * s.len + c] !=
+                        value(pass, r * COLS + s.globalStart + c))
+                        bad++;
+        }//endFor each pass
+
+        if (bad)
+            cout << "testHaloExchange: BLOCK on " << me << ", " << bad
+                 << " wrong elements" << endl;
+        return(bad);
+    }
+
+
+    //  1D, N elements, BLOCK_CYCLIC of 8 with an overlap of 3. Blocks
+    //   0, 2 and 4 are on processor 0 and 1 and 3 on processor 1, so
+    //   the halos of each are owned by the other; block 4 is the last
+    //   and has none.
+    int testBlockCyclic1D(int me, RankId *ranks)
+    {
+        const int      N = 40;
+        const Span     spans0[3] = { { 0, 11, 8 }, { 16, 11, 8 },
+                                     { 32, 8, 8 } };
+        const Span     spans1[2] = { { 8, 11, 8 }, { 24, 11, 8 } };
+        const Span    *spans = (me == 0) ? spans0 : spans1;
+        int            numSpans = (me == 0) ? 3 : 2;
+        int            bad = 0;
+
+        RuntimeMap     map(RankList(2, ranks), Grid(2),
+                           DataDistDescription(BlockCyclicDist(8, 3)));
+        unsigned int   global[1] = { N };
+        unsigned int   local[1];
+        int            localLen = 0;
+
+        for (int i=0; i<numSpans; i++)
+            localLen += spans[i].len;
+
+        HaloExchange::computeLocalLengths(map, 1, global, local);
+        if (local[0] != (unsigned int)localLen)
+          {
+            cout << "testHaloExchange: BLOCK_CYCLIC local length "
+                 << local[0] << ", expected " << localLen << endl;
+            return(1);
+          }
+
+        std::vector<float>   buff(localLen);
+        int                  strides[1] = { 1 };
+        HaloExchange         halo(map, 1, global, &buff[0], strides,
+                                  sizeof(float));
+
+        for (int pass=0; pass<PASSES; pass++) {
+            float  *p = &buff[0];
+            for (int i=0; i<numSpans; i++)
+                for (int k=0; k<spans[i].len; k++)
+                    *p++ = (k < spans[i].ownedLen) ?
+                        value(pass, spans[i].globalStart + k) : POISON;
+
+            //  split form, as a stencil overlapping its interior uses it
+            halo.begin();
+            halo.end();
+
+            p = &buff[0];
+            for (int i=0; i<numSpans; i++)
+                for (int k=0; k<spans[i].len; k++)
+                    if (*p++ != value(pass, spans[i].globalStart + k))
+                        bad++;
+        }//endFor each pass
+
+        if (bad)
+            cout << "testHaloExchange: BLOCK_CYCLIC on " << me << ", "
+                 << bad << " wrong elements" << endl;
+        return(bad);
+    }
+}
+
+
+int main(int argc, char *argv[])
+{
+    PvtolProgram   prog(argc, argv);
+    CommScope     &cs = prog.getCurrentTask().getCommScope();
+    int            me = prog.getProcId();
+    RankId         ranks[2] = { 0, 1 };
+    int            bad = 0;
+
+    if (cs.getNumProcs() != 2)
+      {
+        cout << "testHaloExchange: needs 2 processes" << endl;
+        return(1);
+      }
+
+    bad += testBlock2D(me, ranks);
+    bad += testBlockCyclic1D(me, ranks);
+
+    cout << "testHaloExchange[" << me << "]: "
+         << (bad ? "FAILED" : "passed") << endl;
+
+    return(bad ? 1 : 0);
+}
@@ -0,0 +1,232 @@
+/**
+ *    File: testLocalXferRing.cc
+ *
+ *  Copyright (c) 2009, Massachusetts Institute of Technology
+ *  All rights reserved.
+ *
+ *  \author  $LastChangedBy$
+ *  \date    $LastChangedDate$
+ *  \version $LastChangedRevision$
+ *  \brief   Test of the LocalXferRing, one producer thread and one
+ *           consumer thread passing frames through a small ring, as a
+ *           same process Conduit does. Every frame must arrive once and
+ *           in order, the consumer must see the EOC after the last
+ *           frame, and neither thread may sleep through a wake.
+ *
+ *           Runs in-process and process shared rings, of depth 1 and 4,
+ *           and a lossy ring whose slow consumer makes the producer
+ *           discard the oldest frames: the frames which do arrive must
+ *           still be in order, and none may be lost uncounted.
+ *
+ *  $Id$
+ *
+ */
+#include <LocalXferRing.h>
+
+#include <pthread.h>
+#include <sys/time.h>
+#include <iostream>
+#include <vector>
+
+using namespace ipvtol;
+using std::cout;
+using std::endl;
+
+namespace
+{
+    const int   NUM_FRAMES = 2000000;   // fewer at depth 1, every frame waits
+    const int   SLOW_CONSUMER = 2000;   // lossy, polls per frame read
+
+    struct Pass
+    {
+        LocalXferRing      ring;
+        std::vector<int>   slots;
+        int                numFrames;
+        int                received;
+        int                outOfOrder;
+        int                newestDropped;   // lossy, by the producer
+        bool               sawEOC;
+    };
+
+    double now()
+     {
+       struct timeval   tv;
+       gettimeofday(&tv, NULL);
+       return(tv.tv_sec + 1.0e-6 * tv.tv_usec);
+     }
+
+    void *producer(void *arg)
+     {
+       Pass   *p = static_cast<Pass *>(arg);
+       int     depth = p->ring.getDepth();
+
+       for (int i=0; i<p->numFrames; i++)
+         {
+           if (p->ring.full())
+               p->ring.waitForSpace();
+           p->slots[i % depth] = i;
+           p->ring.publish();
+         }
+       p->ring.postEOC();
+       return(NULL);
+     }
+
+    void *consumer(void *arg)
+     {
+       Pass   *p = static_cast<Pass *>(arg);
+       int     depth = p->ring.getDepth();
+
+       for (int i=0; ; i++)
+         {
+           if (p->ring.empty() && !p->ring.eocPosted())
+               p->ring.waitForData();
+           if (p->ring.empty())
+             {
+               p->sawEOC = (p->ring.eocPosted() == 1);
+               p->ring.clearEOC();
+               break;
+             }
+           if (p->slots[i % depth] != i)
+               p->outOfOrder++;
+           p->received++;
+           p->ring.consume();
+         }
+       return(NULL);
+     }
+
+    //  as a lossy Conduit does: write the head slot, then make room
+    //   for it by dropping the oldest frame, or drop it instead
+    void *lossyProducer(void *arg)
+     {
+       Pass   *p = static_cast<Pass *>(arg);
+       int     depth = p->ring.getDepth();
+       int     published = 0;
+
+       for (int i=0; i<p->numFrames; i++)
+         {
+           for (volatile int k=0; k<SLOW_CONSUMER/8; k++)
+               ;
+           p->slots[published % depth] = i;
+           if (p->ring.full() && !p->ring.dropOldest())
+             {
+               p->newestDropped++;
+               continue;
+             }
+           p->ring.publish();
+           published++;
+         }
+       p->ring.postEOC();
+       return(NULL);
+     }
+
+    void *lossyConsumer(void *arg)
+     {
+       Pass   *p = static_cast<Pass *>(arg);
+       int     depth = p->ring.getDepth();
+       int     taken = 0;
+       int     last  = -1;
+
+       for (;;)
+         {
+           if (p->ring.empty() && !p->ring.eocPosted())
+               p->ring.waitForData();
+           p->ring.claim();
+           if (p->ring.empty())
+             {
+               p->ring.unclaim();
+               if (!p->ring.eocPosted())
+                   continue;
+               p->sawEOC = (p->ring.eocPosted() == 1);
+               p->ring.clearEOC();
+               break;
+             }
+
+           int   v = p->slots[(taken + p->ring.numDropped()) % depth];
+           if (v <= last)
+               p->outOfOrder++;     // or a repeat
+           last = v;
+           p->received++;
+
+           for (volatile int k=0; k<SLOW_CONSUMER; k++)
+               ;
+           taken++;
+           p->ring.consume();
+           p->ring.unclaim();
+         }
+       return(NULL);
+     }
+
+    bool runLossyPass(int depth, int numFrames)
+     {
+       Pass   p;
+       p.ring.reset(depth);
+       p.ring.setLimit(depth - 1);     // the head slot is being written
+       p.slots.assign(depth, -1);
+       p.numFrames  = numFrames;
+       p.received   = 0;
+       p.outOfOrder = 0;
+       p.newestDropped = 0;
+       p.sawEOC     = false;
+
+       pthread_t   prod, cons;
+       pthread_create(&cons, NULL, lossyConsumer, &p);
+       pthread_create(&prod, NULL, lossyProducer, &p);
+       pthread_join(prod, NULL);
+       pthread_join(cons, NULL);
+
+       int    oldest = p.ring.numDropped();
+       int    newest = p.newestDropped;
+       bool   ok = (p.received > 0) && (oldest > 0) &&
+                   (p.outOfOrder == 0) && p.sawEOC &&
+                   (p.received + oldest + newest == numFrames);
+
+       cout << "depth " << depth << " lossy  : " << p.received
+            << " frames, " << p.outOfOrder << " out of order, " << oldest
+            << " oldest and " << newest << " newest dropped, EOC " << (p.sawEOC ? "seen" : "MISSING")
+            << (ok ? "" : "  FAILED") << endl;
+       return(ok);
+     }
+
+    bool runPass(int depth, bool shared, int numFrames)
+     {
+       Pass   p;
+       p.ring.reset(depth, shared);
+       p.slots.assign(depth, -1);
+       p.numFrames  = numFrames;
+       p.received   = 0;
+       p.outOfOrder = 0;
+       p.sawEOC     = false;
+
+       double      start = now();
+       pthread_t   prod, cons;
+       pthread_create(&cons, NULL, consumer, &p);
+       pthread_create(&prod, NULL, producer, &p);
+       pthread_join(prod, NULL);
+       pthread_join(cons, NULL);
+       double      secs = now() - start;
+
+       bool   ok = (p.received == numFrames) && (p.outOfOrder == 0) &&
+                   p.sawEOC && p.ring.empty() && (p.ring.eocPosted() == 0);
+
+       cout << "depth " << depth << (shared ? " shared " : " private")
+            << ": " << p.received << " frames, " << p.outOfOrder
+            << " out of order, EOC " << (p.sawEOC ? "seen" : "MISSING")
+            << ", " << int(numFrames / secs / 1.0e3) << "k frames/s"
+            << (ok ? "" : "  FAILED") << endl;
+       return(ok);
+     }
+}
+
+
+int main()
+{
+    bool   ok = true;
+
+    ok = runPass(1, false, NUM_FRAMES / 10) && ok;
+    ok = runPass(4, false, NUM_FRAMES)      && ok;
+    ok = runPass(4, true,  NUM_FRAMES)      && ok;
+    ok = runLossyPass(4, NUM_FRAMES / 100)  && ok;
+
+    cout << "testLocalXferRing: " << (ok ? "passed" : "FAILED") << endl;
+    return(ok ? 0 : 1);
+}
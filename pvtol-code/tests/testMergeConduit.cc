@@ -0,0 +1,183 @@
+/**
+ *    File: testMergeConduit.cc
+ *
+ *  Copyright (c) 2009, Massachusetts Institute of Technology
+ *  All rights reserved.
+ *
+ *  \author  $LastChangedBy$
+ *  \date    $LastChangedDate$
+ *  \version $LastChangedRevision$
+ *  \brief   Test of a MergeConduit collecting the frames of two
+ *           producers into one consumer. The producers send different
+ *           numbers of frames, so one stream ends early and the other
+ *           must still be delivered, and each ends with an EOC; wait()
+ *           must return false only once both streams have ended. Three
+ *           passes:
+ *             - SEQUENCE order, numbered as a round robin fan-out would
+ *               be; the frames must arrive in number order.
+ *             - SEQUENCE order, numbered by the producers with
+ *               setSeqNum(), leaving numbers which are never sent; the
+ *               frames must still arrive in order, past the gaps.
+ *             - ARRIVAL order; every frame must arrive, and each
+ *               producer's frames in the order sent.
+ *           Every frame must carry the data sent with its number.
+ *
+ *           Run on 3 processes; rank 0 extracts, ranks 1 and 2 insert.
+ *
+ *  $Id$
+ *
+ */
+#include <Pvtol.h>
+#include <MergeConduit.h>
+
+#include <iostream>
+
+using namespace ipvtol;
+using std::cout;
+using std::endl;
+
+namespace
+{
+    typedef HierArray<1, float, Dense<1, float> >   Frame;
+    typedef MergeConduit<Frame>                      Merge;
+
+    const int   LEN        = 256;
+    const int   DEPTH      = 4;
+    const int   NUM_INPUTS = 2;
+    const int   COUNTS[NUM_INPUTS] = { 30, 10 };   // input 1 ends early
+    const int   STRIDE     = 3;     // setSeqNum() pass: k*3+i, 3k+2 unsent
+
+    float value(int seqNum, int i)
+     { return(float(seqNum * LEN + i)); }
+
+    //  the number the k-th frame of an input is sent with
+    int seqNumOf(int input, int k, bool numbered)
+     { return(numbered ? k * STRIDE + input : k * NUM_INPUTS + input); }
+
+    //  the input a frame number was sent on
+    int inputOf(int seqNum, bool numbered)
+     { return(seqNum % (numbered ? STRIDE : NUM_INPUTS)); }
+
+    void produce(Merge &merge, int input, bool numbered)
+     {
+       Merge::InsertIf   ins = merge.getInsertIf(input);
+
+       for (int k=0; k<COUNTS[input]; k++)
+         {
+           int     seqNum = seqNumOf(input, k, numbered);
+           Frame  &frame  = ins.getHandle();
+           for (int i=0; i<LEN; i++)
+               frame(Index<1>(i)) = value(seqNum, i);
+           if (numbered)
+               ins.setSeqNum(seqNum);
+           ins.insert();
+         }
+       ins.insertEOC();
+     }
+
+    //  returns the number of frames wrong
+    int consume(Merge &merge, Merge::OrderType order, bool numbered,
+                const char *pass)
+     {
+       Merge::ExtractIf   ext = merge.getExtractIf();
+       int                received[NUM_INPUTS] = { 0, 0 };
+       int                lastOf[NUM_INPUTS] = { -1, -1 };
+       int                last = -1;
+       int                bad  = 0;
+
+       while (ext.wait())
+         {
+           int     seqNum = ext.getSeqNum();
+           int     input  = ext.getInput();
+           Frame  &frame  = ext.getHandle();
+
+           bool    wrong = (input != inputOf(seqNum, numbered)) ||
+                           (seqNum <= lastOf[input]) ||
+                           ((order == Merge::SEQUENCE) && (seqNum <= last));
+           for (int i=0; i<LEN && !wrong; i++)
+               if (frame(Index<1>(i)) != value(seqNum, i))
+                   wrong = true;
+           if (wrong)
+             {
+               cout << "testMergeConduit: " << pass << ": frame "
+                    << seqNum << " from input " << input << " is wrong"
+                    << endl;
+               bad++;
+             }
+
+           lastOf[input] = seqNum;
+           last = seqNum;
+           received[input]++;
+           ext.release();
+         }
+
+       for (int i=0; i<NUM_INPUTS; i++)
+           if (received[i] != COUNTS[i])
+             {
+               cout << "testMergeConduit: " << pass << ": " << received[i]
+                    << " of " << COUNTS[i] << " frames from input " << i
+                    << endl;
+               bad++;
+             }
+       if (!ext.isAtEOC())
+         {
+           cout << "testMergeConduit: " << pass << ": not at the EOC"
+                << endl;
+           bad++;
+         }
+
+       cout << "testMergeConduit: " << pass << ": " << received[0] << " + "
+            << received[1] << " frames, " << (bad ? "FAILED" : "passed")
+            << endl;
+       return(bad);
+     }
+
+    int runPass(const char *pass, Merge::OrderType order, bool numbered,
+                int me)
+     {
+       RankId         consumer = 0;
+       RankId         producer[NUM_INPUTS] = { 1, 2 };
+       unsigned int   lengths[1] = { LEN };
+       RuntimeMap     dstMap(RankList(1, &consumer), Grid(1),
+                             DataDistDescription(BlockDist()));
+
+       Merge   merge(pass, NUM_INPUTS, order);
+       for (int i=0; i<NUM_INPUTS; i++)
+         {
+           RuntimeMap   srcMap(RankList(1, &producer[i]), Grid(1),
+                               DataDistDescription(BlockDist()));
+           merge.getInsertIf(i).setup(srcMap, DEPTH, lengths);
+         }
+       merge.getExtractIf().setup(dstMap, DEPTH, lengths);
+       merge.setupComplete();
+
+       for (int i=0; i<NUM_INPUTS; i++)
+           if (me == producer[i])
+               produce(merge, i, numbered);
+
+       if (me == consumer)
+           return(consume(merge, order, numbered, pass));
+       return(0);
+     }
+}
+
+
+int main(int argc, char *argv[])
+{
+    PvtolProgram   prog(argc, argv);
+    CommScope     &cs = prog.getCurrentTask().getCommScope();
+    int            me = prog.getProcId();
+    int            bad = 0;
+
+    if (cs.getNumProcs() < NUM_INPUTS + 1)
+      {
+        cout << "testMergeConduit: needs 3 processes" << endl;
+        return(1);
+      }
+
+    bad += runPass("sequence", Merge::SEQUENCE, false, me);
+    bad += runPass("numbered", Merge::SEQUENCE, true,  me);
+    bad += runPass("arrival",  Merge::ARRIVAL,  false, me);
+
+    return(bad ? 1 : 0);
+}
@@ -0,0 +1,156 @@
+/**
+ *    File: testMpmcIndexRing.cc
+ *
+ *  Copyright (c) 2009, Massachusetts Institute of Technology
+ *  All rights reserved.
+ *
+ *  \author  $LastChangedBy$
+ *  \date    $LastChangedDate$
+ *  \version $LastChangedRevision$
+ *  \brief   Test of the MpmcIndexRing with 1 or 4 producer threads and
+ *           1 or 4 consumer threads sharing a small ring, as the writers
+ *           and readers of a SharedConduit do. Every index must be
+ *           popped exactly once, each consumer must see any one
+ *           producer's indices in the order they were pushed, and the
+ *           ring must be empty at the end.
+ *
+ *  $Id$
+ *
+ */
+#include <MpmcIndexRing.h>
+
+#include <pthread.h>
+#include <sys/time.h>
+#include <iostream>
+#include <vector>
+
+using namespace ipvtol;
+using std::cout;
+using std::endl;
+
+namespace
+{
+    const int            NUM_ITEMS = 1600000;   // in all, per pass
+    const int            CAPACITY  = 8;
+    const unsigned int   STOP      = 0xffffffffu;
+
+    struct Pass
+    {
+        MpmcIndexRing      ring;
+        int                numProducers;
+        int                perProducer;
+        std::vector<int>   seen;         // times each index was popped
+        int                outOfOrder;
+    };
+
+    struct Thread
+    {
+        Pass   *pass;
+        int     id;
+    };
+
+    double now()
+     {
+       struct timeval   tv;
+       gettimeofday(&tv, NULL);
+       return(tv.tv_sec + 1.0e-6 * tv.tv_usec);
+     }
+
+    void *producer(void *arg)
+     {
+       Thread   *t = static_cast<Thread *>(arg);
+       Pass     *p = t->pass;
+       unsigned int   base = t->id * p->perProducer;
+
+       for (int i=0; i<p->perProducer; i++)
+           p->ring.push(base + i);
+       return(NULL);
+     }
+
+    void *consumer(void *arg)
+     {
+       Thread   *t = static_cast<Thread *>(arg);
+       Pass     *p = t->pass;
+       std::vector<int>   last(p->numProducers, -1);
+
+       for (;;)
+         {
+           unsigned int   idx;
+           p->ring.pop(idx);
+           if (idx == STOP)
+               break;
+
+           int   from = idx / p->perProducer;
+           int   n    = idx % p->perProducer;
+           if (n <= last[from])
+               __sync_fetch_and_add(&p->outOfOrder, 1);
+           last[from] = n;
+           __sync_fetch_and_add(&p->seen[idx], 1);
+         }
+       return(NULL);
+     }
+
+    bool runPass(int numProducers, int numConsumers)
+     {
+       Pass   p;
+       p.ring.reset(CAPACITY);
+       p.numProducers = numProducers;
+       p.perProducer  = NUM_ITEMS / numProducers;
+       p.seen.assign(numProducers * p.perProducer, 0);
+       p.outOfOrder   = 0;
+
+       std::vector<Thread>      args(numProducers + numConsumers);
+       std::vector<pthread_t>   threads(numProducers + numConsumers);
+
+       double   start = now();
+       for (int i=0; i<numProducers + numConsumers; i++)
+         {
+           args[i].pass = &p;
+           args[i].id   = (i < numProducers) ? i : i - numProducers;
+           pthread_create(&threads[i], NULL,
+                          (i < numProducers) ? producer : consumer,
+                          &args[i]);
+         }
+       for (int i=0; i<numProducers; i++)
+           pthread_join(threads[i], NULL);
+
+       //  every index is queued ahead of the stops
+       for (int i=0; i<numConsumers; i++)
+           p.ring.push(STOP);
+       for (int i=numProducers; i<numProducers + numConsumers; i++)
+           pthread_join(threads[i], NULL);
+       double   secs = now() - start;
+
+       int   lost = 0, repeated = 0;
+       for (unsigned int i=0; i<p.seen.size(); i++)
+         {
+           if (p.seen[i] == 0)
+               lost++;
+           else if (p.seen[i] > 1)
+               repeated++;
+         }
+       bool   ok = (lost == 0) && (repeated == 0) && (p.outOfOrder == 0) &&
+                   p.ring.empty();
+
+       cout << numProducers << " producers / " << numConsumers
+            << " consumers: " << p.seen.size() << " indices, " << lost
+            << " lost, " << repeated << " repeated, " << p.outOfOrder
+            << " out of order, " << int(p.seen.size() / secs / 1.0e3)
+            << "k indices/s" << (ok ? "" : "  FAILED") << endl;
+       return(ok);
+     }
+}
+
+
+int main()
+{
+    bool   ok = true;
+
+    ok = runPass(1, 1) && ok;
+    ok = runPass(1, 4) && ok;
+    ok = runPass(4, 1) && ok;
+    ok = runPass(4, 4) && ok;
+
+    cout << "testMpmcIndexRing: " << (ok ? "passed" : "FAILED") << endl;
+    return(ok ? 0 : 1);
+}
@@ -0,0 +1,131 @@
+/**
+ *    File: testRoutePermutedInFlight.cc
+ *
+ *  Copyright (c) 2009, Massachusetts Institute of Technology
+ *  All rights reserved.
+ *
+ *  \author  $LastChangedBy$
+ *  \date    $LastChangedDate$
+ *  \version $LastChangedRevision$
+ *  \brief   Test of a permuting (TRANSPOSE_102) Route with several
+ *           non-blocking sends in flight at once, as a Conduit with a
+ *           depth greater than one makes them. Each frame is packed into
+ *           its SendRequest's staging buffer, so every frame must arrive
+ *           intact, transposed, in its own slot.
+ *
+ *           Run on 2 processes; rank 0 sends, rank 1 receives.
+ *
+ *  $Id$
+ *
+ */
+#include <Pvtol.h>
+
+#include <iostream>
+#include <vector>
+
+using namespace ipvtol;
+using std::cout;
+using std::endl;
+
+namespace
+{
+    const int   ROWS  = 256;
+    const int   COLS  = 320;   // a frame is well above the eager limit
+    const int   DEPTH = 4;
+    const int   PASSES = 3;
+
+    float value(int pass, int frame, int r, int c)
+     { return(float(((pass * DEPTH + frame) * ROWS + r) * COLS + c)); }
+}
+
+
+int main(int argc, char *argv[])
+{
+    PvtolProgram   prog(argc, argv);
+    CommScope     &cs = prog.getCurrentTask().getCommScope();
+    int            me = prog.getProcId();
+    int            bad = 0;
+
+    if (cs.getNumProcs() < 2)
+      {
+        cout << "testRoutePermutedInFlight: needs 2 processes" << endl;
+        return(1);
+      }
+
+    //  one buffer holding DEPTH frames, the Route moves one frame and
+    //   the offsets pick the slot, just as a Conduit does
+    const int          slot = ROWS * COLS;
+    std::vector<float> srcBuff(DEPTH * slot, 0.0f);
+    std::vector<float> dstBuff(DEPTH * slot, -1.0f);
+
+    Length<2>   srcLen;
+    Length<2>   dstLen;
+    srcLen[0] = ROWS;  srcLen[1] = COLS;
+    dstLen[0] = COLS;  dstLen[1] = ROWS;
+
+    Dense<2, float>   srcBlock(srcLen, &srcBuff[0]);
+    Dense<2, float>   dstBlock(dstLen, &dstBuff[0]);
+    HierArray<2, float, Dense<2, float> >   src(srcLen, srcBlock);
+    HierArray<2, float, Dense<2, float> >   dst(dstLen, dstBlock);
+
+    RankId      srcRank = 0;
+    RankId      dstRank = 1;
+    RuntimeMap  srcMap(RankList(1, &srcRank), Grid(1, 1),
+                       DataDistDescription(BlockDist(), BlockDist()));
+    RuntimeMap  dstMap(RankList(1, &dstRank), Grid(1, 1),
+                       DataDistDescription(BlockDist(), BlockDist()));
+    std::vector<int>   srcProcs(1, srcRank);
+    std::vector<int>   dstProcs(1, dstRank);
+
+    Route   route(&src, &dst, srcMap, dstMap,
+                  me == srcRank, me == dstRank,
+                  srcProcs, dstProcs, Route::TRANSPOSE_102);
+
+    std::vector<SendRequest *>   reqs(DEPTH);
+    for (int k=0; k<DEPTH; k++)
+        reqs[k] = new SendRequest(route);
+
+    for (int pass=0; pass<PASSES; pass++) {
+        if (me == srcRank)
+          {
+            for (int k=0; k<DEPTH; k++) {
+                float  *f = &srcBuff[k * slot];
+                for (int r=0; r<ROWS; r++)
+                    for (int c=0; c<COLS; c++)
+                        f[r * COLS + c] = value(pass, k, r, c);
+            }
+          }
+
+        //  every frame is issued before any is waited on
+        for (int k=0; k<DEPTH; k++)
+            route.isend(k * slot, k * slot, *reqs[k]);
+
+        for (int k=0; k<DEPTH; k++)
+            reqs[k]->wait();
+
+        if (me == dstRank)
+          {
+            for (int k=0; k<DEPTH; k++) {
+                const float  *f = &dstBuff[k * slot];
+                int           wrong = 0;
+                for (int c=0; c<COLS; c++)
+                    for (int r=0; r<ROWS; r++)
+                        if (f[c * ROWS + r] != value(pass, k, r, c))
+                            wrong++;
+                if (wrong)
+                    cout << "pass " << pass << " frame " << k << ": "
+                         << wrong << " wrong elements" << endl;
+                bad += wrong;
+            }
+          }
+    }//endFor each pass
+
+    for (int k=0; k<DEPTH; k++)
+        delete reqs[k];
+
+    if (me == dstRank)
+        cout << "testRoutePermutedInFlight: " << PASSES * DEPTH
+             << " frames, " << (bad ? "FAILED" : "passed") << endl;
+
+    return(bad ? 1 : 0);
+}
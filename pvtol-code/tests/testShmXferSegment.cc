@@ -0,0 +1,200 @@
+/**
+ *    File: testShmXferSegment.cc
+ *
+ *  Copyright (c) 2009, Massachusetts Institute of Technology
+ *  All rights reserved.
+ *
+ *  \author  $LastChangedBy$
+ *  \date    $LastChangedDate$
+ *  \version $LastChangedRevision$
+ *  \brief   Test of the ShmXferSegment, a producer and a consumer in two
+ *           processes, fork()ed, passing frames through a segment as a
+ *           Conduit between two processes of one host does. The
+ *           consumer open()s the segment by name and the producer then
+ *           unlink()s it. Every frame, with its length and sequence
+ *           number, must arrive once and in order, followed by the EOC.
+ *           The ring is shallow and each side naps now and then, so the
+ *           other parks on its futex; were the futexes process private
+ *           no wake would reach the other process, and the alarm fails
+ *           the test.
+ *
+ *  $Id$
+ *
+ */
+#include <ShmXferSegment.h>
+
+#include <signal.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <iostream>
+
+using namespace ipvtol;
+using std::cout;
+using std::endl;
+
+namespace
+{
+    const int      DEPTH      = 2;
+    const int      SLOT_ELTS  = 1024;
+    const size_t   SLOT_BYTES = SLOT_ELTS * sizeof(int);
+    const size_t   AUX_BYTES  = 64;
+    const int      NUM_FRAMES = 20000;
+    const int      TIME_LIMIT = 60;     // seconds, a missed wake hangs
+    const int      PAUSE_EVERY = 2000;  // frames between naps, see nap()
+
+    int frameLength(int f)
+     { return(1 + f % SLOT_ELTS); }
+
+    int value(int f, int i)
+     { return(f * 7 + i); }
+
+    //  each side naps now and then, long enough for the other to give
+    //   up spinning and park on its futex
+    void nap(int f, int offset)
+     {
+       if ((f % PAUSE_EVERY) == offset)
+           usleep(2000);
+     }
+
+    //  the consumer; returns the exit status of its process
+    int consume(const std::string &name, int ready)
+     {
+       ShmXferSegment   seg;
+       char             ok = seg.open(name, DEPTH, SLOT_BYTES, AUX_BYTES);
+
+       //  tell the producer it may unlink the name
+       if (write(ready, &ok, 1) != 1 || !ok)
+         {
+           cout << "testShmXferSegment: consumer could not open "
+                << name << endl;
+           return(1);
+         }
+
+       LocalXferRing   &ring = seg.getRing();
+       int             *data = (int *)seg.getData();
+       int              bad  = 0;
+
+       for (int f=0; f<NUM_FRAMES; f++)
+         {
+           if (ring.empty())
+               ring.waitForData();
+           if (ring.empty())
+             {
+               cout << "testShmXferSegment: EOC before frame " << f << endl;
+               return(1);
+             }
+
+           int   slot = f % DEPTH;
+           int  *frame = data + slot * SLOT_ELTS;
+           int   len = seg.getFrameLength(slot);
+           if ((len != frameLength(f)) || (seg.getFrameSeqNum(slot) != f))
+               bad++;
+           for (int i=0; i<len && i<SLOT_ELTS; i++)
+               if (frame[i] != value(f, i))
+                 {
+                   bad++;
+                   break;
+                 }
+           ring.consume();
+           nap(f, 0);
+         }
+
+       ring.waitForData();
+       if (!ring.empty() || (ring.eocPosted() != 1))
+         {
+           cout << "testShmXferSegment: no EOC after the last frame" << endl;
+           bad++;
+         }
+
+       if (bad)
+           cout << "testShmXferSegment: " << bad << " frames wrong" << endl;
+       return(bad ? 1 : 0);
+     }
+
+    //  the producer
+    void produce(ShmXferSegment &seg)
+     {
+       LocalXferRing   &ring = seg.getRing();
+       int             *data = (int *)seg.getData();
+
+       for (int f=0; f<NUM_FRAMES; f++)
+         {
+           if (ring.full())
+               ring.waitForSpace();
+
+           int   slot = f % DEPTH;
+           int  *frame = data + slot * SLOT_ELTS;
+           int   len = frameLength(f);
+           for (int i=0; i<len; i++)
+               frame[i] = value(f, i);
+           seg.setFrame(slot, len, f);
+           ring.publish();
+           nap(f, PAUSE_EVERY / 2);
+         }
+       ring.postEOC();
+     }
+}
+
+
+int main()
+{
+    std::string      name = ShmXferSegment::makeName("testShmXferSegment",
+                                                     getpid(),
+                                                     ShmXferSegment::nextTag());
+    ShmXferSegment   seg;
+    int              ok = 1;
+
+    if (!seg.create(name, DEPTH, SLOT_BYTES, AUX_BYTES))
+      {
+        cout << "testShmXferSegment: could not create " << name << endl;
+        return(1);
+      }
+
+    //  a segment of another shape must not open
+    ShmXferSegment   other;
+    if (other.open(name, DEPTH + 1, SLOT_BYTES, AUX_BYTES))
+      {
+        cout << "testShmXferSegment: opened with the wrong depth" << endl;
+        ok = 0;
+      }
+
+    int   pipeFds[2];
+    if (pipe(pipeFds) != 0)
+        return(1);
+
+    alarm(TIME_LIMIT);
+    pid_t   child = fork();
+    if (child < 0)
+        return(1);
+    if (child == 0)
+      {
+        alarm(TIME_LIMIT);      // not inherited
+        ::close(pipeFds[0]);
+        _exit(consume(name, pipeFds[1]));
+      }
+    ::close(pipeFds[1]);
+
+    char   opened = 0;
+    if ((read(pipeFds[0], &opened, 1) != 1) || !opened)
+        ok = 0;
+    seg.unlink();
+
+    //  the name is gone, the mappings stay
+    if (other.open(name, DEPTH, SLOT_BYTES, AUX_BYTES))
+      {
+        cout << "testShmXferSegment: opened after unlink" << endl;
+        ok = 0;
+      }
+
+    if (opened)
+        produce(seg);
+
+    int   status = 0;
+    waitpid(child, &status, 0);
+    if (!WIFEXITED(status) || (WEXITSTATUS(status) != 0))
+        ok = 0;
+
+    cout << "testShmXferSegment: " << NUM_FRAMES << " frames, depth "
+         << DEPTH << ", " << (ok ? "passed" : "FAILED") << endl;
+    return(ok ? 0 : 1);
+}
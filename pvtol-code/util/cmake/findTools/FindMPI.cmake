@@ -107,6 +107,7 @@ IF(NOT USE_MPI_COMPILER)
     LINK_LIBRARIES(${NUMA_LIB})
     LINK_LIBRARIES(util)
     LINK_LIBRARIES(pthread)
+    LINK_LIBRARIES(rt)
 
 ENDIF(NOT USE_MPI_COMPILER)
 